@@ -0,0 +1,83 @@
+#include "app/AdpcmCodec.h"
+
+namespace adpcm {
+
+static const int8_t kIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const int16_t kStepTable[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+// code を適用して予測値とステップ番号を進める（符号化・復号で共通）
+static inline void apply(State& state, uint8_t code) {
+    int32_t step = kStepTable[state.stepIndex];
+    int32_t delta = step >> 3;
+    if (code & 4) delta += step;
+    if (code & 2) delta += step >> 1;
+    if (code & 1) delta += step >> 2;
+
+    int32_t predictor = state.predictor + ((code & 8) ? -delta : delta);
+    if (predictor > 32767) predictor = 32767;
+    if (predictor < -32768) predictor = -32768;
+    state.predictor = static_cast<int16_t>(predictor);
+
+    int index = state.stepIndex + kIndexTable[code];
+    if (index < 0) index = 0;
+    if (index > 88) index = 88;
+    state.stepIndex = static_cast<uint8_t>(index);
+}
+
+static inline uint8_t encodeSample(State& state, int16_t sample) {
+    int32_t step = kStepTable[state.stepIndex];
+    int32_t diff = static_cast<int32_t>(sample) - state.predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    if (diff >= (step >> 1)) {
+        code |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= (step >> 2)) {
+        code |= 1;
+    }
+    apply(state, code);
+    return code;
+}
+
+size_t encode(State& state, const int16_t* samples, size_t count, uint8_t* out) {
+    size_t i = 0;
+    size_t n = 0;
+    for (; i + 1 < count; i += 2) {
+        uint8_t lo = encodeSample(state, samples[i]);
+        uint8_t hi = encodeSample(state, samples[i + 1]);
+        out[n++] = static_cast<uint8_t>(lo | (hi << 4));
+    }
+    if (i < count) {
+        out[n++] = encodeSample(state, samples[i]);
+    }
+    return n;
+}
+
+void decode(State& state, const uint8_t* bytes, size_t count, int16_t* out) {
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t code = (i & 1) ? (bytes[i >> 1] >> 4) : (bytes[i >> 1] & 0x0F);
+        apply(state, code);
+        out[i] = state.predictor;
+    }
+}
+
+}  // namespace adpcm
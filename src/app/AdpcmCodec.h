@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * IMA-ADPCM（4 bit/サンプル）
+ * - 16 bit PCM を 1/4 に圧縮する。乗算なし・テーブル 2 つだけなので 1 サンプル数十サイクル
+ * - 1 byte に 2 サンプル（先のサンプルが下位 4 bit）
+ * - 状態（予測値とステップ番号）をブロックの先頭に書いておけば、どのブロックからでも復号できる
+ */
+namespace adpcm {
+
+struct State {
+    int16_t predictor = 0;
+    uint8_t stepIndex = 0;
+};
+
+// samples 個を out に書き、書いたバイト数（(samples + 1) / 2）を返す。state は更新される
+size_t encode(State& state, const int16_t* samples, size_t count, uint8_t* out);
+
+// bytes から count 個のサンプルを復号する。state は更新される
+void decode(State& state, const uint8_t* bytes, size_t count, int16_t* out);
+
+}  // namespace adpcm
@@ -0,0 +1,73 @@
+#pragma once
+
+// === UUID設定（既定値。実行時は CMD_CONFIG_SET / CMD_CONFIG_SAVE で変えられる。app/RuntimeConfig.h） ===
+#define SERVICE_UUID        "12345678-1234-1234-1234-1234567890AC"
+#define CHARACTERISTIC_UUID "87654321-4321-4321-4321-BA0987654321"
+#define STREAM_CHAR_UUID    "87654322-4321-4321-4321-BA0987654321"
+#define COMMAND_CHAR_UUID   "87654323-4321-4321-4321-BA0987654321"
+#define STATS_CHAR_UUID     "87654324-4321-4321-4321-BA0987654321"
+#define DEVICE_NAME         "M5-BLE-TEST"
+// =====================================================
+
+// ハートビートの Notify の既定の周期 [ms]（CMD_CONFIG_SET で保存でき、CMD_TRIGGER_SET でも変えられる）
+#define NOTIFY_PERIOD_MS    2000
+
+// 切断後に広告を再開するまでの待ち時間 [ms]
+#define ADVERTISING_RESTART_DELAY_MS 500
+
+// loop() 1回あたりの待ち時間 [ms]（CPU負荷軽減）
+#define LOOP_DELAY_MS       10
+
+// loop() 1回で送るストリームパケットの上限
+#define MAX_PACKETS_PER_LOOP 4
+
+// 再送用に保持する送信済みパケット数
+#define RETRANSMIT_HISTORY  8
+
+// 送信・受信リングバッファのサイズ [byte]（2 のべき乗）
+#define TX_RING_SIZE        8192
+#define RX_RING_SIZE        2048
+// 優先レーン（タッチなど）の送信リング [byte]
+#define URGENT_RING_SIZE    256
+
+// 受信トレースのバッファサイズ [byte]
+#define TRACE_BUFFER_SIZE   16384
+
+// タイムラインのイベント数（2 のべき乗、1 イベント 12 byte）
+#define TIMELINE_CAPACITY   1024
+
+// loop() の間隔がこれを超えたらストールとしてタイムラインに記録する [ms]
+#define LOOP_STALL_THRESHOLD_MS 50
+
+// IMU の FIFO を 1 回の readFifo() で読むサンプル数
+#define IMU_READ_BATCH      32
+
+// IMU の差分符号化でキーフレームを入れる間隔（レコード数）。欠落から復帰するまでの最大レコード数になる
+#define IMU_KEYFRAME_INTERVAL 16
+
+// 姿勢（クォータニオン）をレコードにまとめて待つ最大時間。長いほどヘッダの割合が減る
+#define ORIENTATION_MAX_HOLD_MS 50
+
+// マイクのダブルバッファ 1 面あたりのサンプル数（16 kHz で 32 ms）
+#define MIC_BUFFER_SAMPLES  512
+
+// カメラのチャンクは送信待ちがこのパケット数を下回ったときだけ積む
+#define CAMERA_QUEUE_PACKETS 3
+
+// 切断中のレコードを溜める RAM のリング [byte] と、あふれた分を書き出すフラッシュのブロック数の上限
+#define BACKLOG_RAM_SIZE     8192
+#define BACKLOG_MAX_BLOCKS   64
+// 切断中のストリームが想定する MTU（再接続後の MTU がこれより小さいと、溜めたレコードを送れない）
+#define BACKLOG_MTU          247
+// 再生中は送信待ちがこのバイト数を下回ったときだけ溜めたレコードを積む（ライブのデータの余地を残す）
+#define BACKLOG_REPLAY_QUEUE 4096
+
+// GATT が変わったあと、Service Changed を送る接続の数（送れた接続だけ数え、送り終えたら記録を消す）
+#define SERVICE_CHANGED_CONNECTIONS 3
+
+// フラッシュへの書き込みのまとめ方の既定（WriteMode::Timed）で、溜め始めてから書くまでの最大時間 [ms]
+#define STORAGE_FLUSH_DELAY_MS 5000
+
+// 時系列ログ：セグメントのファイル数の上限と、1 セグメントのページ（4 KB）数
+#define LOG_MAX_SEGMENTS      16
+#define LOG_PAGES_PER_SEGMENT 16
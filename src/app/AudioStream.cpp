@@ -0,0 +1,223 @@
+#include "app/AudioStream.h"
+
+#include "app/Streams.h"
+#include "app/Wire.h"
+#include "diag/Profiler.h"
+
+bool AudioStream::start(uint32_t sampleRate, const SpectrumConfig* spectrum) {
+    stop();
+    if (mic == nullptr || sampleRate == 0) {
+        return false;
+    }
+    if (spectrum != nullptr && !analyzer.configure(*spectrum, sampleRate, dsp::defaultBackend())) {
+        return false;
+    }
+    if (!mic->start(sampleRate)) {
+        return false;
+    }
+    spectrumMode = spectrum != nullptr;
+    rate = sampleRate;
+    nextSample = 0;
+    encoder = adpcm::State();
+    encodeTicks = 0;
+    encodeMaxTicks = 0;
+    counters = {};
+    underrunBase = 0;
+    paused = false;
+    running = true;
+    return true;
+}
+
+void AudioStream::stop() {
+    if (running) {
+        if (!paused) {
+            mic->stop();
+        }
+        running = false;
+        paused = false;
+    }
+}
+
+void AudioStream::setPaused(bool value, uint32_t nowUs) {
+    if (!running || value == paused) {
+        return;
+    }
+    if (value) {
+        underrunBase += mic->underruns();
+        mic->stop();
+        pausedUs = nowUs;
+        paused = true;
+        return;
+    }
+    paused = false;
+    if (!mic->start(rate)) {
+        running = false;
+        return;
+    }
+    nextSample += static_cast<uint32_t>(static_cast<uint64_t>(nowUs - pausedUs) * rate / 1000000u);
+    encoder = adpcm::State();  // 波形がつながらないので予測を始め直す（状態は各レコードに入っている）
+}
+
+size_t AudioStream::samplesPerRecord(size_t packetCapacity) {
+    size_t overhead = frame::kPacketHeaderSize + frame::kRecordHeaderSize + kRecordHeaderSize;
+    if (packetCapacity <= overhead) {
+        return 0;
+    }
+    size_t n = (packetCapacity - overhead) * 2;
+    return n < kMaxSamplesPerRecord ? n : kMaxSamplesPerRecord;
+}
+
+size_t AudioStream::encodeRecord(uint32_t firstSample, adpcm::State& state, const int16_t* samples, size_t count,
+                                 uint8_t* out) {
+    wire::putU32(out, firstSample);
+    wire::putU16(out + 4, static_cast<uint16_t>(state.predictor));
+    out[6] = state.stepIndex;
+    wire::putU16(out + 7, static_cast<uint16_t>(count));
+    return kRecordHeaderSize + adpcm::encode(state, samples, count, out + kRecordHeaderSize);
+}
+
+void AudioStream::poll(size_t packetCapacity) {
+    if (!running || paused) {
+        return;
+    }
+    size_t perRecord = samplesPerRecord(packetCapacity);
+
+    size_t count;
+    const int16_t* samples;
+    while ((samples = mic->acquire(count)) != nullptr) {
+        counters.samplesCaptured += static_cast<uint32_t>(count);
+
+        uint32_t start = profiler::ticks();
+        if (spectrumMode) {
+            publishSpectrum(samples, count, packetCapacity);
+        } else {
+            publishBuffer(samples, count, perRecord);
+        }
+        uint32_t elapsed = profiler::ticks() - start;
+        mic->release();
+
+        encodeTicks += elapsed;
+        if (elapsed > encodeMaxTicks) {
+            encodeMaxTicks = elapsed;
+        }
+    }
+
+    uint32_t ticksPerUs = profiler::ticksPerMicrosecond();
+    counters.encodeUs = static_cast<uint32_t>(encodeTicks / ticksPerUs);
+    counters.encodeMaxUs = encodeMaxTicks / ticksPerUs;
+    counters.underruns = underrunBase + mic->underruns();
+}
+
+void AudioStream::publishBuffer(const int16_t* samples, size_t count, size_t perRecord) {
+    if (perRecord == 0) {
+        // 送れなくても符号化状態は進めておく（次に送るレコードの状態が正しくなるように）
+        uint8_t scratch[64];
+        while (count > 0) {
+            size_t n = count < sizeof(scratch) * 2 ? count : sizeof(scratch) * 2;
+            adpcm::encode(encoder, samples, n, scratch);
+            counters.samplesDropped += static_cast<uint32_t>(n);
+            nextSample += static_cast<uint32_t>(n);
+            samples += n;
+            count -= n;
+        }
+        return;
+    }
+    uint8_t record[kRecordHeaderSize + kMaxSamplesPerRecord / 2];
+    while (count > 0) {
+        size_t n = count < perRecord ? count : perRecord;
+        size_t len = encodeRecord(nextSample, encoder, samples, n, record);
+        if (scheduler.enqueue(STREAM_AUDIO, record, len)) {
+            counters.samplesSent += static_cast<uint32_t>(n);
+            ++counters.records;
+        } else {
+            counters.samplesDropped += static_cast<uint32_t>(n);
+        }
+        nextSample += static_cast<uint32_t>(n);
+        samples += n;
+        count -= n;
+    }
+}
+
+void AudioStream::publishSpectrum(const int16_t* samples, size_t count, size_t packetCapacity) {
+    uint8_t record[kSpectrumHeaderSize + SpectrumAnalyzer::kMaxBins];
+    size_t bins = analyzer.binCount();
+    size_t len = kSpectrumHeaderSize + bins;
+    bool fits = packetCapacity >= frame::kPacketHeaderSize + frame::kRecordHeaderSize + len;
+    while (count > 0) {
+        size_t used = analyzer.feed(samples, count);
+        samples += used;
+        count -= used;
+        if (!analyzer.ready()) {
+            if (used == 0) {
+                break;
+            }
+            continue;
+        }
+        const uint8_t* values = analyzer.bins();
+        if (triggers != nullptr && triggers->gated(STREAM_SPECTRUM)) {
+            uint8_t peak = 0;
+            for (size_t k = 0; k < bins; ++k) {
+                peak = values[k] > peak ? values[k] : peak;
+            }
+            if (!triggers->admit(STREAM_SPECTRUM, peak * 0.5f - 120.0f)) {
+                analyzer.consume();
+                ++counters.spectraSuppressed;
+                continue;
+            }
+        }
+        const SpectrumConfig& config = analyzer.config();
+        wire::putU32(record, analyzer.firstSample());
+        wire::putU16(record + 4, static_cast<uint16_t>(analyzer.outputRate()));
+        wire::putU16(record + 6, config.fftSize);
+        record[8] = config.average;
+        record[9] = static_cast<uint8_t>(bins);
+        for (size_t k = 0; k < bins; ++k) {
+            record[kSpectrumHeaderSize + k] = values[k];
+        }
+        analyzer.consume();
+        if (fits && scheduler.enqueue(STREAM_SPECTRUM, record, len)) {
+            ++counters.spectra;
+            ++counters.records;
+        } else {
+            ++counters.spectraDropped;
+        }
+    }
+}
+
+void AudioStream::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_AUDIO_START, &AudioStream::cmdStart, this);
+    dispatcher.registerHandler(CMD_AUDIO_STOP, &AudioStream::cmdStop, this);
+}
+
+void AudioStream::cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    AudioStream* self = static_cast<AudioStream*>(context);
+    if (len != 2 && len != 9) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    SpectrumConfig spectrum = {};
+    if (len == 9) {
+        spectrum.decimation = args[2];
+        spectrum.filter = args[3];
+        spectrum.cutoffHz = wire::getU16(args + 4);
+        spectrum.fftSize = wire::getU16(args + 6);
+        spectrum.average = args[8];
+    }
+    if (!self->start(wire::getU16(args), len == 9 ? &spectrum : nullptr)) {
+        reply.status = CommandStatus::Failed;
+    }
+}
+
+void AudioStream::cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    AudioStream* self = static_cast<AudioStream*>(context);
+    self->stop();
+    const AudioStreamStats& s = self->counters;
+    reply.appendU32(s.samplesCaptured);
+    reply.appendU32(s.samplesDropped);
+    reply.appendU32(s.underruns);
+    reply.appendU32(s.encodeUs);
+    reply.appendU32(s.encodeMaxUs);
+    reply.appendU32(s.spectra);
+}
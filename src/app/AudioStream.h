@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AdpcmCodec.h"
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/NotifyScheduler.h"
+#include "app/SpectrumAnalyzer.h"
+#include "app/TriggerTable.h"
+#include "hal/Microphone.h"
+
+/**
+ * マイク入力を IMA-ADPCM で圧縮して STREAM_AUDIO のレコードにしてストリームに流す
+ * 16 kHz なら 8 KB/s（レコードヘッダ込みで約 8.4 KB/s）で、MTU 247 なら 1 秒あたり 36 パケット程度
+ *
+ * レコード（リトルエンディアン）
+ *   u32 firstSample  先頭サンプルの通番（start() から数える。セントラル側で欠落検出に使う）
+ *   i16 predictor    このレコードを復号する前のエンコーダ状態
+ *   u8  stepIndex
+ *   u16 count        サンプル数
+ *   u8  data[(count + 1) / 2]  4 bit × count（先のサンプルが下位 4 bit）
+ *
+ * レコードごとに状態を持たせるので、途中のパケットが欠けても次のレコードから復号を再開できる。
+ *
+ * スペクトルモード（start() に SpectrumConfig を渡す）では音声そのものは送らず、
+ * SpectrumAnalyzer で求めた振幅スペクトルを STREAM_SPECTRUM のレコードにする
+ *   u32 firstSample  平均した最初のフレームの先頭サンプルの通番（入力レート）
+ *   u16 sampleRate   間引き後のサンプリング周波数（ビン k の周波数 = k × sampleRate / fftSize）
+ *   u16 fftSize
+ *   u8  average      平均したフレーム数
+ *   u8  count        ビン数（fftSize / 2）
+ *   u8  bins[count]  0.5 dB 刻みの dBFS（app/SpectrumAnalyzer.h）
+ * トリガー（setTriggers()）はスペクトルの最大のビン [dBFS] で、スペクトルごとに送るかどうかを決める。
+ * 16 kHz を 1/2 に間引いて 256 点・4 フレーム平均なら 7.8 レコード/s（約 1.1 KB/s）で、ADPCM の 1/8 程度。
+ *
+ * 符号化（スペクトルモードでは DSP 処理）にかかった CPU 時間は profiler::ticks() で数える（APP_PROFILING に関係なく有効）。
+ *
+ * poll() は loop() から呼ぶこと（NotifyScheduler と同じタスク）。
+ */
+
+struct AudioStreamStats {
+    uint32_t samplesCaptured;
+    uint32_t samplesSent;
+    uint32_t samplesDropped;  // 送信リング満杯・MTU 不足で捨てたサンプル
+    uint32_t records;
+    uint32_t underruns;       // マイク側の取りこぼし（loop() がバッファを返すのが遅れた）
+    uint32_t encodeUs;        // 符号化（スペクトルモードでは DSP 処理）にかかった時間の合計
+    uint32_t encodeMaxUs;     // 1 バッファの符号化にかかった時間の最大値
+    uint32_t spectra;         // 送ったスペクトル
+    uint32_t spectraDropped;  // 送信リング満杯・MTU 不足で捨てたスペクトル
+    uint32_t spectraSuppressed;  // トリガーの条件を満たさず送らなかったスペクトル
+};
+
+class AudioStream {
+public:
+    static constexpr size_t kRecordHeaderSize = 9;
+    static constexpr size_t kMaxSamplesPerRecord = (frame::kMaxRecordPayload - kRecordHeaderSize) * 2;
+    static constexpr size_t kSpectrumHeaderSize = 10;
+
+    explicit AudioStream(NotifyScheduler& scheduler) : scheduler(scheduler) {}
+
+    void setMicrophone(hal::Microphone* mic) { this->mic = mic; }
+    void setTriggers(TriggerTable* triggers) { this->triggers = triggers; }
+
+    // マイクがない・レートを受け付けなければ false。spectrum を渡すとスペクトルモードになる
+    bool start(uint32_t sampleRate, const SpectrumConfig* spectrum = nullptr);
+    void stop();
+    bool isRunning() const { return running; }
+    // 動かしたまま休ませる（ストリームを誰も受け取らない間）。休んでいる間はマイクを止めてバッファを読まない。
+    // 再開したら録音を始め直し、休んでいた時間の分だけサンプルの通番を進める（通番がそのまま時刻になるので）
+    void setPaused(bool paused, uint32_t nowUs);
+    bool isPaused() const { return paused; }
+
+    // 録音済みのバッファをすべて符号化してレコードを積む
+    void poll(size_t packetCapacity);
+
+    bool isSpectrum() const { return spectrumMode; }
+
+    // CMD_AUDIO_START / CMD_AUDIO_STOP を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    const AudioStreamStats& stats() const { return counters; }
+
+    // packetCapacity のパケット 1 つに入るサンプル数（偶数。0 なら MTU が小さすぎる）
+    static size_t samplesPerRecord(size_t packetCapacity);
+
+    // レコードを out に書き、その長さを返す。state は count サンプル分進む
+    static size_t encodeRecord(uint32_t firstSample, adpcm::State& state, const int16_t* samples, size_t count,
+                               uint8_t* out);
+
+private:
+    void publishBuffer(const int16_t* samples, size_t count, size_t perRecord);
+    void publishSpectrum(const int16_t* samples, size_t count, size_t packetCapacity);
+
+    static void cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    NotifyScheduler& scheduler;
+    hal::Microphone* mic = nullptr;
+    TriggerTable* triggers = nullptr;
+
+    bool running = false;
+    bool paused = false;
+    uint32_t pausedUs = 0;
+    uint32_t underrunBase = 0;  // 始め直す前までの underruns()
+    uint32_t rate = 0;
+    uint32_t nextSample = 0;
+    adpcm::State encoder;
+    bool spectrumMode = false;
+    SpectrumAnalyzer analyzer;
+    uint64_t encodeTicks = 0;
+    uint32_t encodeMaxTicks = 0;
+
+    AudioStreamStats counters = {};
+};
@@ -0,0 +1,312 @@
+#include "app/Backlog.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "app/NotifyScheduler.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+
+void Backlog::blockPath(uint16_t slot, char* out, size_t len) {
+    snprintf(out, len, "/backlog%02u.blk", static_cast<unsigned>(slot));
+}
+
+void Backlog::setStore(hal::FileStore* store) {
+    fileStore = store;
+    clear();
+    if (fileStore == nullptr) {
+        active = false;
+        return;
+    }
+    // 前回の起動で残ったブロック（seq は引き継がないので読めない）
+    for (uint16_t slot = 0; slot < BACKLOG_MAX_BLOCKS; ++slot) {
+        char path[24];
+        blockPath(slot, path, sizeof(path));
+        if (fileStore->size(path) >= 0) {
+            fileStore->remove(path);
+        }
+    }
+}
+
+bool Backlog::setEnabled(bool enable) {
+    if (enable && fileStore == nullptr) {
+        return false;
+    }
+    if (!enable) {
+        clear();
+    }
+    active = enable;
+    return true;
+}
+
+// 溜めているレコードをすべて捨てる（seq は続きから振る）
+void Backlog::clear() {
+    while (blockCount > 0) {
+        char path[24];
+        blockPath(firstBlock, path, sizeof(path));
+        fileStore->remove(path);
+        firstBlock = (firstBlock + 1) % BACKLOG_MAX_BLOCKS;
+        --blockCount;
+    }
+    ring.clear();
+    firstBlock = 0;
+    loadedSlot = -1;
+    oldestSeq = nextSeq;
+    ringSeq = nextSeq;
+    replaySeq = nextSeq;
+    replaying = false;
+}
+
+bool Backlog::store(uint8_t stream, const uint8_t* data, size_t len) {
+    if (!active || len > kMaxPayload) {
+        ++counters.dropped;
+        return false;
+    }
+    uint8_t entry[4 + kMaxPayload];
+    wire::putU32(entry, clock.millis());
+    std::memcpy(entry + 4, data, len);
+    if (!ring.push(stream, entry, 4 + len)) {
+        // spill() より先にリングが埋まった。1 ブロック書き出して空ける
+        writeBlock(false);
+        if (!ring.push(stream, entry, 4 + len)) {
+            ++counters.dropped;
+            return false;
+        }
+    }
+    ++nextSeq;
+    ++counters.stored;
+    return true;
+}
+
+void Backlog::spill() {
+    if (active && ring.used() >= BACKLOG_RAM_SIZE / 2) {
+        writeBlock(false);
+    }
+}
+
+// リングの先頭からブロック 1 つ分を詰めて書き出す。partial なら埋まっていなくても書く
+bool Backlog::writeBlock(bool partial) {
+    if (ring.empty() || (!partial && ring.used() < kBlockSize)) {
+        return true;
+    }
+    loadedSlot = -1;  // block を書き出しに使うので、読み込んであった内容は消える
+
+    size_t size = kBlockHeaderSize;
+    uint16_t count = 0;
+    uint8_t record[4 + kMaxPayload];
+    int len;
+    while ((len = ring.peekLength()) >= 0 && size + 2 + static_cast<size_t>(len) <= kBlockSize) {
+        uint8_t stream = 0;
+        ring.pop(stream, record, sizeof(record));
+        block[size] = stream;
+        block[size + 1] = static_cast<uint8_t>(len - 4);
+        std::memcpy(block + size + 2, record, static_cast<size_t>(len));
+        size += 2 + static_cast<size_t>(len);
+        ++count;
+    }
+    uint32_t firstSeq = ringSeq;
+    ringSeq += count;
+    wire::putU16(block, kBlockMagic);
+    wire::putU16(block + 2, count);
+    wire::putU32(block + 4, firstSeq);
+
+    if (blockCount == BACKLOG_MAX_BLOCKS) {
+        dropOldestBlock();
+    }
+    uint16_t slot = (firstBlock + blockCount) % BACKLOG_MAX_BLOCKS;
+    char path[24];
+    blockPath(slot, path, sizeof(path));
+    // フラッシュが一杯なら古いブロックから捨てる（どれもなければこのブロックを捨てる）
+    while (!fileStore->write(path, block, size)) {
+        if (blockCount == 0) {
+            counters.dropped += count;
+            oldestSeq = ringSeq;
+            replaySeq = ringSeq;
+            return false;
+        }
+        dropOldestBlock();
+    }
+    blockInfo[slot] = {firstSeq, count};
+    ++blockCount;
+    ++counters.blockWrites;
+    counters.spilledBytes += static_cast<uint32_t>(size);
+    return true;
+}
+
+// いちばん古いブロックを消す。受け取りを確認していないレコードが残っていれば捨てたものとして数える
+void Backlog::dropOldestBlock() {
+    const BlockInfo& info = blockInfo[firstBlock];
+    uint32_t end = info.firstSeq + info.count;
+    if (end > oldestSeq) {
+        counters.dropped += end - (info.firstSeq > oldestSeq ? info.firstSeq : oldestSeq);
+        oldestSeq = end;
+    }
+    if (replaySeq < oldestSeq) {
+        replaySeq = oldestSeq;
+    }
+    char path[24];
+    blockPath(firstBlock, path, sizeof(path));
+    fileStore->remove(path);
+    if (loadedSlot == firstBlock) {
+        loadedSlot = -1;
+    }
+    firstBlock = (firstBlock + 1) % BACKLOG_MAX_BLOCKS;
+    --blockCount;
+}
+
+void Backlog::onConnect() {
+    // RAM に残っている分もブロックにしておく（再生はブロックからだけ読む）
+    while (active && !ring.empty()) {
+        writeBlock(true);
+    }
+    replaying = false;  // セントラルの CMD_BACKLOG_ACK を待つ
+}
+
+void Backlog::onDisconnect() {
+    // 受け取りを確認していないレコードは、次の接続で ACK された seq の次から送り直す
+    replaying = false;
+    replaySeq = oldestSeq;
+}
+
+void Backlog::acknowledge(uint32_t seq) {
+    uint32_t next = seq + 1;
+    if (next > nextSeq || next == 0) {
+        next = nextSeq;  // 溜めたことのない seq（前回の起動のもの）
+    }
+    if (!replaying) {
+        replaying = true;
+        replaySeq = next > oldestSeq ? next : oldestSeq;
+    } else if (next > replaySeq) {
+        replaySeq = next;
+    }
+    if (next > oldestSeq) {
+        oldestSeq = next;
+    }
+    // 受け取り済みのレコードだけのブロックを消す
+    while (blockCount > 0 && blockInfo[firstBlock].firstSeq + blockInfo[firstBlock].count <= oldestSeq) {
+        dropOldestBlock();
+    }
+}
+
+bool Backlog::loadBlock(uint16_t slot) {
+    if (loadedSlot == slot) {
+        return true;
+    }
+    char path[24];
+    blockPath(slot, path, sizeof(path));
+    size_t n = fileStore->read(path, 0, block, kBlockSize);
+    const BlockInfo& info = blockInfo[slot];
+    if (n < kBlockHeaderSize || wire::getU16(block) != kBlockMagic || wire::getU16(block + 2) != info.count ||
+        wire::getU32(block + 4) != info.firstSeq) {
+        return false;
+    }
+    loadedSlot = slot;
+    loadedSize = n;
+    cursorOffset = kBlockHeaderSize;
+    cursorSeq = info.firstSeq;
+    return true;
+}
+
+void Backlog::pump(NotifyScheduler& scheduler, size_t queueLimit) {
+    if (!replaying) {
+        return;
+    }
+    while (replaySeq < nextSeq && blockCount > 0 && scheduler.queuedBytes() < queueLimit) {
+        // replaySeq の入っているブロック（ブロックは seq の順に並んでいる）
+        uint16_t slot = firstBlock;
+        for (uint16_t i = 0; i < blockCount; ++i) {
+            slot = (firstBlock + i) % BACKLOG_MAX_BLOCKS;
+            if (replaySeq < blockInfo[slot].firstSeq + blockInfo[slot].count) {
+                break;
+            }
+        }
+        const BlockInfo& info = blockInfo[slot];
+        if (replaySeq >= info.firstSeq + info.count) {
+            break;  // RAM にしかないレコード（接続中は溜めないので来ない）
+        }
+        if (replaySeq < info.firstSeq) {
+            replaySeq = info.firstSeq;
+        }
+        if (!loadBlock(slot)) {
+            // 読めないブロックは飛ばす
+            counters.dropped += info.firstSeq + info.count - replaySeq;
+            replaySeq = info.firstSeq + info.count;
+            continue;
+        }
+
+        // ACK で先に進んだときは、ブロックの中を replaySeq まで読み飛ばす
+        if (cursorSeq > replaySeq) {
+            cursorOffset = kBlockHeaderSize;
+            cursorSeq = info.firstSeq;
+        }
+        while (cursorSeq < replaySeq && cursorOffset + kEntryHeaderSize <= loadedSize) {
+            cursorOffset += kEntryHeaderSize + block[cursorOffset + 1];
+            ++cursorSeq;
+        }
+        const uint8_t* entry = block + cursorOffset;
+        size_t len = cursorOffset + kEntryHeaderSize <= loadedSize ? entry[1] : 0;
+        if (cursorSeq != replaySeq || cursorOffset + kEntryHeaderSize + len > loadedSize) {
+            loadedSlot = -1;  // 壊れたブロック
+            counters.dropped += info.firstSeq + info.count - replaySeq;
+            replaySeq = info.firstSeq + info.count;
+            continue;
+        }
+
+        uint8_t record[kWrapHeaderSize + kMaxPayload];
+        wire::putU32(record, replaySeq);
+        record[4] = entry[0];
+        std::memcpy(record + 5, entry + 2, 4 + len);
+        if (!scheduler.enqueue(STREAM_BACKLOG, record, kWrapHeaderSize + len)) {
+            break;
+        }
+        cursorOffset += kEntryHeaderSize + len;
+        ++cursorSeq;
+        ++replaySeq;
+        ++counters.replayed;
+    }
+}
+
+void Backlog::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_BACKLOG_ENABLE, &Backlog::cmdEnable, this);
+    dispatcher.registerHandler(CMD_BACKLOG_ACK, &Backlog::cmdAck, this);
+    dispatcher.registerHandler(CMD_BACKLOG_STATUS, &Backlog::cmdStatus, this);
+}
+
+// [enable u8]
+void Backlog::cmdEnable(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    Backlog* self = static_cast<Backlog*>(context);
+    if (len != 1 || args[0] > 1) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (!self->setEnabled(args[0] != 0)) {
+        reply.status = CommandStatus::Failed;  // FileStore が渡されていない
+    }
+}
+
+// [seq u32] → [replaySeq u32][pending u32]
+void Backlog::cmdAck(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    Backlog* self = static_cast<Backlog*>(context);
+    if (len != 4) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    self->acknowledge(wire::getU32(args));
+    reply.appendU32(self->replaySeq);
+    reply.appendU32(self->pending());
+}
+
+void Backlog::cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    Backlog* self = static_cast<Backlog*>(context);
+    reply.appendU8(self->active ? 1 : 0);
+    reply.appendU32(self->nextSeq);
+    reply.appendU32(self->pending());
+    reply.appendU16(self->blockCount);
+    reply.appendU32(self->counters.stored);
+    reply.appendU32(self->counters.dropped);
+    reply.appendU32(self->counters.replayed);
+    reply.appendU32(self->counters.blockWrites);
+    reply.appendU32(self->counters.spilledBytes);
+}
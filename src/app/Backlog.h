@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/RecordRing.h"
+#include "hal/Clock.h"
+#include "hal/FileStore.h"
+
+class NotifyScheduler;
+
+/**
+ * 切断中のストア・アンド・フォワード
+ * - 有効にすると、切断中もストリームを止めず、NotifyScheduler に積まれたレコードをここに溜める
+ * - レコードには 1 から始まる通番（seq）を振り、まず RAM のリング（BACKLOG_RAM_SIZE）に入れる
+ * - リングが半分を超えたら、フラッシュのページ（kBlockSize）に詰めてブロックのファイルに書き出す
+ *   ブロックが BACKLOG_MAX_BLOCKS 個あるか書けなければ、いちばん古いブロックを捨てる
+ * - 再接続したら RAM の残りもブロックにして、セントラルが CMD_BACKLOG_ACK で受け取った最後の seq を
+ *   送ってきたら、その次から STREAM_BACKLOG で再生する（送信待ちが queueLimit 未満の間は loop() ごとに積む）
+ * - 再生中の CMD_BACKLOG_ACK は受け取り済みの通知で、その seq までのブロックを消す
+ *
+ * ブロックのファイル = [magic u16][count u16][firstSeq u32] + count 個の [stream u8][len u8][deviceMs u32][data]
+ * STREAM_BACKLOG のレコード = [seq u32][stream u8][deviceMs u32][元のレコード]
+ *
+ * seq は切れ目なく振るので、セントラルは重複（途中で切れたときの再送）を seq で捨てられる。
+ * 溜めている間のレコードは BACKLOG_MTU のパケットに収まる大きさで作ること（offlineCapacity()）。
+ * 再生時の MTU がそれより小さいと、収まらないレコードは送れずに捨てる。
+ * 起動時に前回のブロックは消す（電源を切ったら溜めたレコードは失われる）。
+ */
+
+struct BacklogStats {
+    uint32_t stored;       // 溜めたレコード
+    uint32_t dropped;      // 溜められずに捨てたレコード（古いブロックを含む）
+    uint32_t replayed;     // 再生で送信待ちに積んだレコード
+    uint32_t blockWrites;  // フラッシュに書いたブロック
+    uint32_t spilledBytes;
+};
+
+class Backlog {
+public:
+    static constexpr size_t kBlockSize = 4096;
+    static constexpr size_t kBlockHeaderSize = 8;
+    static constexpr size_t kEntryHeaderSize = 6;
+    static constexpr size_t kWrapHeaderSize = 9;
+    static constexpr size_t kMaxPayload = frame::kMaxRecordPayload - kWrapHeaderSize;
+    static constexpr uint16_t kBlockMagic = 0xB10C;
+
+    explicit Backlog(hal::Clock& clock) : clock(clock) {}
+
+    // 前回のブロックを消して使い始める。store がなければ有効にできない
+    void setStore(hal::FileStore* store);
+    bool setEnabled(bool enable);
+    bool enabled() const { return active; }
+
+    // 切断中のストリームが 1 パケットの大きさとして使う値（再生時に前に付ける分を除く）
+    static size_t offlineCapacity() { return frame::packetCapacity(BACKLOG_MTU) - kWrapHeaderSize; }
+
+    // 切断中に NotifyScheduler::enqueue() から呼ばれる。溜められなければ false
+    bool store(uint8_t stream, const uint8_t* data, size_t len);
+    // 切断中に毎 loop() 呼ぶ。RAM のリングが半分を超えていたらフラッシュに書き出す
+    void spill();
+
+    void onConnect();
+    void onDisconnect();
+    // 積んだ再生のレコードが送られずに捨てられた（セントラルがストリームの購読をやめた）。
+    // ACK された seq の次から送り直す（再生は続ける）
+    void rewind() { replaySeq = oldestSeq; }
+
+    // 接続中に毎 loop() 呼ぶ。送信待ちが queueLimit 未満の間、再生するレコードを積む
+    void pump(NotifyScheduler& scheduler, size_t queueLimit);
+
+    // セントラルが seq まで受け取った。再生していなければ seq + 1 から再生を始める
+    void acknowledge(uint32_t seq);
+
+    // 受け取りを確認していないレコードの数
+    uint32_t pending() const { return nextSeq - oldestSeq; }
+    uint32_t replayCursor() const { return replaySeq; }
+    uint16_t blocks() const { return blockCount; }
+    const BacklogStats& stats() const { return counters; }
+
+    // CMD_BACKLOG_ENABLE / CMD_BACKLOG_ACK / CMD_BACKLOG_STATUS を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+private:
+    struct BlockInfo {
+        uint32_t firstSeq;
+        uint16_t count;
+    };
+
+    static void blockPath(uint16_t slot, char* out, size_t len);
+    bool writeBlock(bool partial);
+    void dropOldestBlock();
+    void clear();
+    bool loadBlock(uint16_t slot);
+
+    static void cmdEnable(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdAck(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    hal::FileStore* fileStore = nullptr;
+    bool active = false;
+    bool replaying = false;
+
+    uint32_t nextSeq = 1;    // 次に溜めるレコードの seq
+    uint32_t oldestSeq = 1;  // 残っているいちばん古いレコードの seq（受け取り確認済みの次）
+    uint32_t ringSeq = 1;    // RAM のリングの先頭のレコードの seq
+    uint32_t replaySeq = 1;  // 次に再生するレコードの seq
+
+    // RAM のリング：tag = stream、レコード = [deviceMs u32][data]
+    RecordRing<BACKLOG_RAM_SIZE> ring;
+
+    // ブロック：blockInfo[(firstBlock + i) % BACKLOG_MAX_BLOCKS] が i 番目に古い
+    BlockInfo blockInfo[BACKLOG_MAX_BLOCKS] = {};
+    uint16_t firstBlock = 0;
+    uint16_t blockCount = 0;
+
+    // 書き出し・再生で使うブロック 1 つ分のバッファ（loadedSlot は読み込んであるブロック）
+    uint8_t block[kBlockSize];
+    int32_t loadedSlot = -1;
+    size_t loadedSize = 0;
+    size_t cursorOffset = 0;  // loadedSlot の中の cursorSeq のエントリの位置
+    uint32_t cursorSeq = 0;
+
+    BacklogStats counters = {};
+};
@@ -0,0 +1,668 @@
+#include "app/BleApp.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "app/Dsp.h"
+#include "app/HotPath.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+#include "diag/Profiler.h"
+#include "diag/Timeline.h"
+
+// 画面レイアウト（行の y 座標）
+static constexpr int16_t kTitleRow = 10;
+static constexpr int16_t kStatusRow = 40;
+static constexpr int16_t kAdvertisingRow = 60;
+static constexpr int16_t kRxRow = 80;
+static constexpr int16_t kTxRow = 100;
+
+BleApp::BleApp(hal::Clock& clock, hal::SerialPort& serial, hal::Display& display, hal::BlePeripheral& ble)
+    : clock(clock), serial(serial), display(display), ble(ble), scheduler(clock, ble) {
+    imuStream.setTriggers(&triggers);
+    imuStream.setBusGuard(&BleApp::imuBusInUse, this);
+    cameraStream.setBusGuard(&BleApp::cameraBusInUse, this);
+    orientationStream.setTriggers(&triggers);
+    audioStream.setTriggers(&triggers);
+    config.setTriggers(&triggers);
+    scheduler.setBacklog(&backlog);
+    scheduler.setRecorder(&recordLog);
+    storage.setMode(WriteMode::Timed, STORAGE_FLUSH_DELAY_MS);
+}
+
+void BleApp::setup() {
+    timeline::setClock(&clock);
+
+    serial.println("M5Stack BLE Auto-Connect Example");
+
+    // 画面初期化
+    display.clear();
+    drawLine(kTitleRow, hal::Color::White, "BLE Peripheral");
+
+    registerCommands();
+
+    // 保存した設定（なければ AppConfig.h の既定値）
+    if (config.load()) {
+        serial.println("Config loaded");
+    }
+
+    // BLE初期化
+    initBLE();
+
+    drawLine(kStatusRow, hal::Color::Yellow, "Status: Advertising");
+}
+
+// BLE初期化関数
+void BleApp::initBLE() {
+    serial.println("Initializing BLE...");
+
+    ble.begin(config.deviceName(), this);
+
+    // サービス・キャラクタリスティック作成（表は app/GattTable.h。Notify用の 2902 ディスクリプタは HAL 側で付与）
+    static constexpr uint16_t kHandleCount = gatt::serviceHandleCount();
+    hal::ServiceId service = ble.addService(config.uuid(CONFIG_SERVICE_UUID), kHandleCount);
+    hal::CharId* const slots[gatt::kCharCount] = {&dataChar, &streamChar, &commandChar, &statsChar};
+    for (const gatt::CharDef& def : gatt::kChars) {
+        *slots[def.role] = ble.addCharacteristic(service, config.uuid(def.field), def.properties);
+    }
+    databaseHashChar = ble.addCharacteristic(service, gatt::kDatabaseHashUuid, hal::PROP_READ);
+    gatt::databaseHash(config, databaseHash);
+    ble.setValue(databaseHashChar, databaseHash, sizeof(databaseHash));
+    checkDatabaseHash();
+    statsValue.bind(statsChar);
+    scheduler.setCharacteristic(streamChar);
+    scheduler.setRuntimeStats(&stats);
+    scheduler.setClockSync(&clockSync);
+
+    // 初期値設定
+    static const char kInitialValue[] = "hello";
+    ble.setValue(dataChar, reinterpret_cast<const uint8_t*>(kInitialValue), sizeof(kInitialValue) - 1);
+
+    ble.startService(service);
+
+    // 広告開始
+    ble.advertiseService(config.uuid(CONFIG_SERVICE_UUID));
+    ble.startAdvertising();
+
+    serial.println("BLE advertising started");
+    serial.print("Device name: ");
+    serial.println(config.deviceName());
+}
+
+// /gatt.bin = [hash 16 byte][残りの Service Changed の回数 u8]
+static const char kGattStatePath[] = "/gatt.bin";
+static constexpr size_t kGattStateSize = gatt::kDatabaseHashSize + 1;
+
+// 前回の起動の GATT と比べる。変わっていたら、次の SERVICE_CHANGED_CONNECTIONS 回の接続で Service Changed を送る。
+// 残りの回数はフラッシュに残すので、接続する前に再起動しても忘れない
+// （記録がなければ初めての起動なので、キャッシュしているセントラルはいない）
+void BleApp::checkDatabaseHash() {
+    uint8_t stored[kGattStateSize];
+    size_t n = storage.read(kGattStatePath, 0, stored, sizeof(stored));
+    bool sameDatabase = n >= gatt::kDatabaseHashSize && std::memcmp(stored, databaseHash, sizeof(databaseHash)) == 0;
+    if (sameDatabase) {
+        serviceChangedRemaining = n >= kGattStateSize ? stored[gatt::kDatabaseHashSize] : 0;
+        if (serviceChangedRemaining > SERVICE_CHANGED_CONNECTIONS) {
+            serviceChangedRemaining = SERVICE_CHANGED_CONNECTIONS;
+        }
+        return;
+    }
+    serviceChangedRemaining = n >= gatt::kDatabaseHashSize ? SERVICE_CHANGED_CONNECTIONS : 0;
+    saveGattState();
+}
+
+void BleApp::saveGattState() {
+    uint8_t state[kGattStateSize];
+    std::memcpy(state, databaseHash, sizeof(databaseHash));
+    state[gatt::kDatabaseHashSize] = serviceChangedRemaining;
+    storage.write(kGattStatePath, state, sizeof(state));
+}
+
+// GATT が変わってから送り終えていなければ、接続したセントラルに Service Changed を送る。
+// セントラルはアドレスでは見分けない（スマートフォンのアドレスは 15 分ほどで変わる）ので、送る接続の数で区切る
+void BleApp::announceServiceChanged() {
+    if (serviceChangedRemaining == 0 || !ble.indicateServiceChanged()) {
+        return;  // 送れなければ次の接続でもう一度
+    }
+    --serviceChangedRemaining;
+    ++serviceChangedSent;
+    saveGattState();
+}
+
+void BleApp::registerCommands() {
+    dispatcher.registerHandler(CMD_PING, &BleApp::cmdPing, this);
+    dispatcher.registerHandler(CMD_GET_INFO, &BleApp::cmdGetInfo, this);
+    dispatcher.registerHandler(CMD_RESET_STATS, &BleApp::cmdResetStats, this);
+    dispatcher.registerHandler(CMD_TRACE_START, &BleApp::cmdTraceStart, this);
+    dispatcher.registerHandler(CMD_TRACE_STOP, &BleApp::cmdTraceStop, this);
+    dispatcher.registerHandler(CMD_TRACE_DUMP, &BleApp::cmdTraceDump, this);
+    dispatcher.registerHandler(CMD_TIMELINE_START, &BleApp::cmdTimelineStart, this);
+    dispatcher.registerHandler(CMD_TIMELINE_STOP, &BleApp::cmdTimelineStop, this);
+    dispatcher.registerHandler(CMD_TIMELINE_DUMP, &BleApp::cmdTimelineDump, this);
+    scheduler.registerCommands(dispatcher);
+    imuStream.registerCommands(dispatcher);
+    audioStream.registerCommands(dispatcher);
+    cameraStream.registerCommands(dispatcher);
+    touchStream.registerCommands(dispatcher);
+    orientationStream.registerCommands(dispatcher);
+    clockSync.registerCommands(dispatcher);
+    triggers.registerCommands(dispatcher);
+    config.registerCommands(dispatcher);
+    backlog.registerCommands(dispatcher);
+    recordLog.registerCommands(dispatcher);
+    storage.registerCommands(dispatcher);
+    subscriptions.registerCommands(dispatcher);
+    profiler::registerCommands(dispatcher);
+    dsp::registerCommands(dispatcher);
+}
+
+// 画面 1 行の描画（タイムラインに UI フレームとして記録する）
+void BleApp::drawLine(int16_t y, hal::Color color, const char* text) {
+    TIMELINE_SCOPE(TL_UI_FRAME, TRACK_UI, y);
+    display.drawLine(y, color, text);
+}
+
+// 広告再開関数（切断時に呼ばれる）
+void BleApp::restartAdvertising() {
+    clock.delay(ADVERTISING_RESTART_DELAY_MS);  // 安定のため少し待つ
+    ble.startAdvertising();
+    serial.println("Advertising restarted");
+
+    drawLine(kAdvertisingRow, hal::Color::Magenta, "Advertising restarted");
+}
+
+void BleApp::loop() {
+    TIMELINE_SCOPE(TL_LOOP, TRACK_LOOP, 0);
+
+    uint32_t nowUs = clock.micros();
+    if (lastLoopUs != 0) {
+        uint32_t interval = nowUs - lastLoopUs;
+        stats.recordLoopInterval(interval);
+        if (interval > LOOP_STALL_THRESHOLD_MS * 1000) {
+            TIMELINE_SPAN(TL_STALL, TRACK_LOOP, 0, lastLoopUs, interval);
+        }
+    }
+    lastLoopUs = nowUs;
+
+    // 切断後の広告再開処理
+    if (shouldRestartAdvertising.exchange(false)) {
+        restartAdvertising();
+    }
+
+    bool connected = deviceConnected.load();
+    // 購読されていないキャラクタリスティックの値は作らない（ストリームはログに記録している間だけ動かす）
+    bool dataSubscribed = connected && subscriptions.enabled(dataChar);
+    bool streamSubscribed = connected && subscriptions.enabled(streamChar);
+    bool producersWanted = streamSubscribed || recordLog.recording();
+    // 止めている間に IMU の FIFO・マイクのバッファをあふれさせない（再開したら時刻を合わせ直す）
+    imuStream.setPaused(connected && !producersWanted);
+    audioStream.setPaused(connected && !producersWanted, clock.micros());
+    bool suspend = connected && !streamSubscribed;
+    if (suspend && !scheduler.isSuspended()) {
+        backlog.rewind();  // 送信待ちの STREAM_BACKLOG も捨てるので、ACK された seq の次から送り直す
+    }
+    scheduler.setSuspended(suspend);
+
+    // タッチは他の処理（描画・シリアル）を待たずに優先レーンで送る
+    touchStream.poll(connected && producersWanted);
+    if (streamSubscribed) {
+        scheduler.tickUrgent();
+        touchStream.afterSend();
+    }
+
+    // 接続状態が変化した時の処理
+    if (!connected && oldDeviceConnected) {
+        // 切断された直後（広告再開はshouldRestartAdvertisingで処理）
+        oldDeviceConnected = connected;
+        clockSync.reset();  // 次のセントラルは別の時計
+        cameraStream.stop();  // 遅れたフレームは要らないので溜めない
+        recordLog.cancelQuery();
+        // 切断は電源を切る前触れのことが多いので、どのモードでもここまでの分は書いておく
+        recordLog.flush();
+        storage.sync();
+        if (backlog.enabled()) {
+            // ストリームは止めずに、再接続までのレコードをバックログに溜める
+            backlog.onDisconnect();
+            scheduler.setOffline(true);
+        } else {
+            triggers.reset();
+            orientationStream.stop();
+            imuStream.stop();
+            audioStream.stop();
+        }
+    }
+
+    // 新規接続された時の処理
+    if (connected && !oldDeviceConnected) {
+        oldDeviceConnected = connected;
+        serial.println("New connection established");
+        announceServiceChanged();
+        if (scheduler.isOffline()) {
+            scheduler.setOffline(false);
+            backlog.onConnect();
+        }
+    }
+
+    processRx();
+    pumpDump();
+
+    // 接続中はトリガー（既定は設定の周期ごと）に従ってハートビートを送信
+    // （どちらのキャラクタリスティックも購読されていなければ作らない）
+    if ((dataSubscribed || streamSubscribed) && triggers.admit(STREAM_HEARTBEAT, 0.0f)) {
+        sendNotify(dataSubscribed);
+    }
+
+    if (connected) {
+        if (producersWanted) {
+            uint32_t start = profiler::ticks();
+            pollProducers(scheduler.usableCapacity());
+            subscriptions.recordActive(profiler::ticks() - start);
+        } else {
+            subscriptions.recordGated();
+        }
+        if (streamSubscribed) {
+            backlog.pump(scheduler, BACKLOG_REPLAY_QUEUE);
+            recordLog.pump(scheduler, TX_RING_SIZE / 2);
+            scheduler.tick();
+            touchStream.afterSend();
+        }
+    } else if (scheduler.isOffline()) {
+        // 切断中：再生時に前に付ける分を空けたレコードを作り、溜まったらフラッシュに書き出す
+        size_t capacity = Backlog::offlineCapacity();
+        orientationStream.poll(capacity);
+        imuStream.poll(capacity);
+        audioStream.poll(capacity);
+        backlog.spill();
+    }
+
+    // ログの RAM のページも同じ期限で閉じる（ページで待った分があるので、閉じたらすぐに書く）
+    if (recordLog.hasPending() && storage.due(recordLog.pendingSinceMs())) {
+        recordLog.flush();
+        storage.sync();
+    }
+    storage.poll();
+}
+
+void BleApp::pollProducers(size_t capacity) {
+    orientationStream.poll(capacity);
+    imuStream.poll(capacity);
+    audioStream.poll(capacity);
+    cameraStream.poll(capacity);
+}
+
+void BleApp::sendNotify(bool dataSubscribed) {
+    uint32_t counter = notifyCounter++;
+
+    char msg[gatt::kChars[gatt::CHAR_DATA].maxLength];
+    int len = snprintf(msg, sizeof(msg), "ping %lu", static_cast<unsigned long>(counter));
+    if (dataSubscribed) {
+        ble.setValue(dataChar, reinterpret_cast<const uint8_t*>(msg), static_cast<size_t>(len));
+        if (ble.notify(dataChar)) {
+            stats.recordNotify(static_cast<uint32_t>(len), clock.millis());
+        }
+    }
+
+    // ストリーム側にも同じカウンタをハートビートとして流す
+    uint8_t heartbeat[4];
+    wire::putU32(heartbeat, counter);
+    publish(STREAM_HEARTBEAT, heartbeat, sizeof(heartbeat));
+
+    serial.print("Notify: ");
+    serial.println(msg);
+
+    char line[40];
+    snprintf(line, sizeof(line), "TX: %s", msg);
+    drawLine(kTxRow, hal::Color::Green, line);
+}
+
+bool BleApp::publish(uint8_t stream, const uint8_t* data, size_t len) {
+    return scheduler.enqueue(stream, data, len);
+}
+
+// BLE タスクから積まれた書き込みを処理する
+void BleApp::processRx() {
+    uint8_t data[kRxStampSize + kMaxAttValue];
+    uint8_t ch;
+    int len;
+    while ((len = rxRing.pop(ch, data, sizeof(data))) >= 0) {
+        PROFILE_ZONE(ZONE_RX_DISPATCH);
+        if (ch == dataChar) {
+            handleDataWrite(data, static_cast<size_t>(len));
+        } else if (ch == commandChar && len >= static_cast<int>(kRxStampSize)) {
+            clockSync.setReceiveTime(wire::getU32(data));
+            handleCommandWrite(data + kRxStampSize, static_cast<size_t>(len) - kRxStampSize);
+        }
+    }
+}
+
+void BleApp::handleDataWrite(const uint8_t* data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+
+    // 受信データは NUL 終端されていないので表示用にコピーする
+    char text[64];
+    size_t n = len < sizeof(text) - 1 ? len : sizeof(text) - 1;
+    for (size_t i = 0; i < n; ++i) {
+        text[i] = static_cast<char>(data[i]);
+    }
+    text[n] = '\0';
+
+    serial.print("RX: ");
+    serial.println(text);
+
+    char line[72];
+    snprintf(line, sizeof(line), "RX: %s", text);
+    drawLine(kRxRow, hal::Color::Cyan, line);
+}
+
+void BleApp::handleCommandWrite(const uint8_t* data, size_t len) {
+    if (reassembler.feed(data, len) != Reassembler::Result::Complete) {
+        return;
+    }
+
+    uint8_t response[2 + CommandReply::kMaxPayload];
+    size_t n = dispatcher.dispatch(reassembler.message(), reassembler.messageLength(), response, sizeof(response));
+    sendReply(response, n);
+}
+
+// 応答は書き込みと同じフラグメントヘッダを付け、MTU に収まる大きさに分けて Notify する
+// （MTU 23 でも応答を切り詰めない。1 回で収まる応答は 0xC0 の 1 フラグメント）
+void BleApp::sendReply(const uint8_t* response, size_t len) {
+    uint8_t fragment[frame::kMaxPacketSize];
+    size_t chunk = frame::packetCapacity(ble.mtu()) - 1;
+    size_t offset = 0;
+    for (uint8_t index = 0; offset < len; ++index) {
+        size_t n = len - offset < chunk ? len - offset : chunk;
+        fragment[0] = static_cast<uint8_t>((index & Reassembler::kIndexMask) | (offset == 0 ? Reassembler::kFirst : 0) |
+                                           (offset + n == len ? Reassembler::kLast : 0));
+        std::memcpy(fragment + 1, response + offset, n);
+        ble.setValue(commandChar, fragment, 1 + n);
+        if (!ble.notify(commandChar)) {
+            return;  // 続きを送っても LAST まで揃わないので、セントラルはこの応答を捨てる
+        }
+        stats.recordNotify(static_cast<uint32_t>(1 + n), clock.millis());
+        offset += n;
+    }
+}
+
+// カメラとバスを共用する IMU・タッチが動いているか
+bool BleApp::cameraBusInUse(void* context) {
+    BleApp* self = static_cast<BleApp*>(context);
+    return self->imuStream.isRunning() || self->touchStream.isAttached();
+}
+
+// IMU とバスを共用するカメラが動いているか
+bool BleApp::imuBusInUse(void* context) {
+    BleApp* self = static_cast<BleApp*>(context);
+    return self->cameraStream.isRunning() && self->cameraStream.sharesSensorBus();
+}
+
+void BleApp::cmdPing(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)context;
+    if (!reply.append(args, len)) {
+        reply.status = CommandStatus::BadArguments;
+    }
+}
+
+void BleApp::cmdGetInfo(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    BleApp* app = static_cast<BleApp*>(context);
+    reply.appendU8(frame::kVersion);
+    reply.appendU16(app->ble.mtu());
+    reply.appendU16(static_cast<uint16_t>(app->scheduler.queuedBytes()));
+}
+
+void BleApp::cmdResetStats(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    (void)reply;
+    static_cast<BleApp*>(context)->stats.reset();
+}
+
+void BleApp::cmdTraceStart(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    (void)reply;
+    BleApp* app = static_cast<BleApp*>(context);
+    app->trace.start(app->clock.micros());
+
+    // 接続中に記録を始めたときは、再生側も接続状態から始まるように接続イベントを先頭に入れる
+    if (app->deviceConnected) {
+        app->trace.recordConnect(app->clock.micros(), app->connectionId);
+    }
+}
+
+void BleApp::cmdTraceStop(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    BleApp* app = static_cast<BleApp*>(context);
+    app->trace.stop();
+    reply.appendU32(static_cast<uint32_t>(app->trace.length()));
+}
+
+static size_t readTrace(void* context, size_t offset, uint8_t* out, size_t len) {
+    const RxTrace* trace = static_cast<const RxTrace*>(context);
+    size_t n = trace->length() - offset < len ? trace->length() - offset : len;
+    std::memcpy(out, trace->data() + offset, n);
+    return n;
+}
+
+static size_t readTimeline(void* context, size_t offset, uint8_t* out, size_t len) {
+    (void)context;
+    return timeline::readSerialized(offset, out, len);
+}
+
+void BleApp::cmdTraceDump(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    BleApp* app = static_cast<BleApp*>(context);
+    if (len != 1 || args[0] > 1) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (app->trace.isRecording() ||
+        !app->startDump("TRACE", STREAM_TRACE, &readTrace, &app->trace, app->trace.length(), args[0])) {
+        reply.status = CommandStatus::Busy;
+        return;
+    }
+    reply.appendU32(static_cast<uint32_t>(app->dump.length));
+}
+
+void BleApp::cmdTimelineStart(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)context;
+    (void)args;
+    (void)len;
+#if APP_TIMELINE
+    (void)reply;
+    timeline::start();
+#else
+    reply.status = CommandStatus::Failed;  // APP_TIMELINE=0 でビルドされている
+#endif
+}
+
+void BleApp::cmdTimelineStop(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)context;
+    (void)args;
+    (void)len;
+    timeline::stop();
+    reply.appendU32(static_cast<uint32_t>(timeline::serializedLength()));
+}
+
+void BleApp::cmdTimelineDump(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    BleApp* app = static_cast<BleApp*>(context);
+    if (len != 1 || args[0] > 1) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (timeline::isRecording() || !app->startDump("TIMELINE", STREAM_TIMELINE, &readTimeline, nullptr,
+                                                   timeline::serializedLength(), args[0])) {
+        reply.status = CommandStatus::Busy;
+        return;
+    }
+    reply.appendU32(static_cast<uint32_t>(app->dump.length));
+}
+
+// target: 0=シリアル 1=ストリーム。別のダンプが進行中なら false
+bool BleApp::startDump(const char* label, uint8_t stream, DumpReader reader, void* context, size_t length,
+                       uint8_t target) {
+    if (dump.target != DumpTarget::None) {
+        return false;
+    }
+    dump.target = target == 0 ? DumpTarget::Serial : DumpTarget::Stream;
+    dump.label = label;
+    dump.stream = stream;
+    dump.reader = reader;
+    dump.context = context;
+    dump.offset = 0;
+    dump.length = length;
+    if (dump.target == DumpTarget::Serial) {
+        char line[40];
+        snprintf(line, sizeof(line), "%s BEGIN %lu", label, static_cast<unsigned long>(length));
+        serial.println(line);
+    }
+    return true;
+}
+
+// ダンプを少しずつ進める（loop() を長く止めないように 1 回の量を制限する）
+void BleApp::pumpDump() {
+    static constexpr size_t kSerialBytesPerLine = 32;
+    static constexpr int kSerialLinesPerLoop = 8;
+    static constexpr size_t kStreamChunk = 200;
+
+    if (dump.target == DumpTarget::Serial) {
+        static const char kHex[] = "0123456789abcdef";
+        for (int i = 0; i < kSerialLinesPerLoop && dump.offset < dump.length; ++i) {
+            uint8_t bytes[kSerialBytesPerLine];
+            size_t n = dump.reader(dump.context, dump.offset, bytes,
+                                   dump.length - dump.offset < sizeof(bytes) ? dump.length - dump.offset
+                                                                             : sizeof(bytes));
+            char line[24 + kSerialBytesPerLine * 2];
+            int pos = snprintf(line, sizeof(line), "%s %06lx ", dump.label, static_cast<unsigned long>(dump.offset));
+            for (size_t b = 0; b < n; ++b) {
+                line[pos++] = kHex[bytes[b] >> 4];
+                line[pos++] = kHex[bytes[b] & 0x0F];
+            }
+            line[pos] = '\0';
+            serial.println(line);
+            dump.offset += n;
+            if (n == 0) {
+                break;
+            }
+        }
+        if (dump.offset >= dump.length) {
+            char line[24];
+            snprintf(line, sizeof(line), "%s END", dump.label);
+            serial.println(line);
+            dump.target = DumpTarget::None;
+        }
+    } else if (dump.target == DumpTarget::Stream) {
+        if (!deviceConnected) {
+            dump.target = DumpTarget::None;
+            return;
+        }
+        // 送信待ちが半分を超えたら次の loop() まで待つ（ダンプで他のストリームを押し出さない）
+        while (dump.offset < dump.length && scheduler.queuedBytes() < TX_RING_SIZE / 2) {
+            uint8_t record[4 + kStreamChunk];
+            wire::putU32(record, static_cast<uint32_t>(dump.offset));
+            size_t n = dump.reader(dump.context, dump.offset, record + 4,
+                                   dump.length - dump.offset < kStreamChunk ? dump.length - dump.offset
+                                                                            : kStreamChunk);
+            if (n == 0 || !publish(dump.stream, record, 4 + n)) {
+                break;
+            }
+            dump.offset += n;
+        }
+        if (dump.offset >= dump.length) {
+            dump.target = DumpTarget::None;
+        }
+    }
+}
+
+// 接続時の処理
+void BleApp::onConnect(uint16_t connId) {
+    connectionId = connId;
+    subscriptions.reset();  // CCCD は接続ごと（セントラルが書き直すまで未購読）
+    deviceConnected = true;
+    stats.recordConnect(clock.millis());
+    trace.recordConnect(clock.micros(), connId);
+    TIMELINE_INSTANT(TL_CONNECT, TRACK_BLE, connId);
+    serial.println("Central connected");
+
+    drawLine(kStatusRow, hal::Color::Green, "Status: Connected");
+}
+
+// 切断時の処理
+void BleApp::onDisconnect(uint16_t connId) {
+    deviceConnected = false;
+    stats.recordDisconnect(clock.millis());
+    trace.recordDisconnect(clock.micros(), connId);
+    TIMELINE_INSTANT(TL_DISCONNECT, TRACK_BLE, connId);
+    serial.println("Central disconnected");
+
+    // 切断時は広告を再開する（メインループで処理）
+    shouldRestartAdvertising = true;
+
+    drawLine(kStatusRow, hal::Color::Yellow, "Status: Disconnected");
+}
+
+// 書き込み時の処理（BLE タスク）：rxRing に積んで loop() で処理する
+HOT_PATH void BleApp::onWrite(hal::CharId ch, const uint8_t* data, size_t len) {
+    stats.recordWrite(static_cast<uint32_t>(len));
+    trace.recordWrite(clock.micros(), ch, data, len);
+    TIMELINE_INSTANT(TL_WRITE_RECEIVED, TRACK_BLE, len);
+
+    // ATT の値の上限を超える書き込みはスタックから来ないはずだが、来たら積まずに数える
+    // （processRx() の受け取り口より大きいレコードはリングに残り続けてしまう）
+    if (len > kMaxAttValue) {
+        oversizedWrites.fetch_add(1);
+        return;
+    }
+
+    // コマンドには受信時刻を前に付ける（時刻同期の t2。loop() で処理するまでの遅れを含めない）
+    bool pushed;
+    if (ch == commandChar) {
+        uint8_t stamped[kRxStampSize + kMaxAttValue];
+        wire::putU32(stamped, clock.micros());
+        std::memcpy(stamped + kRxStampSize, data, len);
+        pushed = rxRing.push(ch, stamped, kRxStampSize + len);
+    } else {
+        pushed = rxRing.push(ch, data, len);
+    }
+    if (!pushed) {
+        stats.recordDrop();
+    }
+}
+
+// 読み出し時の処理（BLE タスク）：統計は読まれた時点の値を返す
+void BleApp::onRead(hal::CharId ch) {
+    if (ch != statsChar) {
+        return;
+    }
+    StatsPayload payload;
+    stats.snapshot(clock.millis(), payload);
+    statsValue.set(payload);
+}
+
+// CCCD の書き込み（BLE タスク）
+void BleApp::onSubscribeChanged(hal::CharId ch, bool enabled) {
+    subscriptions.set(ch, enabled);
+}
+
+// MTU 交換完了時の処理
+void BleApp::onMtuChanged(uint16_t mtu) {
+    TIMELINE_INSTANT(TL_MTU_CHANGE, TRACK_BLE, mtu);
+
+    char line[24];
+    snprintf(line, sizeof(line), "MTU: %u", mtu);
+    serial.println(line);
+}
+
+// コネクションパラメータ更新時の処理
+void BleApp::onConnParamsUpdated(uint16_t interval, uint16_t latency, uint16_t timeout) {
+    TIMELINE_INSTANT(TL_PARAM_UPDATE, TRACK_BLE, interval);
+
+    char line[96];
+    snprintf(line, sizeof(line), "Conn params: interval %u.%02u ms, latency %u, timeout %u ms", interval * 5 / 4,
+             (interval * 125) % 100, latency, timeout * 10);
+    serial.println(line);
+}
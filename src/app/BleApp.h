@@ -0,0 +1,229 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/AudioStream.h"
+#include "app/Backlog.h"
+#include "app/CameraStream.h"
+#include "app/ClockSync.h"
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/GattTable.h"
+#include "app/ImuStream.h"
+#include "app/NotifyScheduler.h"
+#include "app/OrientationStream.h"
+#include "app/Reassembler.h"
+#include "app/RecordLog.h"
+#include "app/RecordRing.h"
+#include "app/RuntimeConfig.h"
+#include "app/RuntimeStats.h"
+#include "app/Subscriptions.h"
+#include "app/TouchStream.h"
+#include "app/TriggerTable.h"
+#include "app/TypedCharacteristic.h"
+#include "app/WriteBehind.h"
+#include "diag/RxTrace.h"
+#include "diag/Timeline.h"
+#include "hal/BlePeripheral.h"
+#include "hal/Camera.h"
+#include "hal/Clock.h"
+#include "hal/Display.h"
+#include "hal/FileStore.h"
+#include "hal/Imu.h"
+#include "hal/Microphone.h"
+#include "hal/SerialPort.h"
+#include "hal/Touch.h"
+
+/**
+ * BLE ペリフェラルのアプリケーションロジック
+ * - 自動接続・再接続処理（切断時は広告を再開）
+ * - 接続中のクライアントにハートビートの Notify を送信（周期は STREAM_HEARTBEAT のトリガーで変えられる）
+ * - 受信データをシリアルと画面に表示
+ * - ストリーム用キャラクタリスティック：レコードを NotifyScheduler で MTU サイズのパケットに詰めて Notify
+ * - コマンド用キャラクタリスティック：分割書き込みを復元してハンドラに振り分け
+ * - 統計キャラクタリスティック：読み出し時に RuntimeStats のスナップショット（StatsPayload）を返す
+ * - 受信トレース：コマンドで記録を始めると、書き込み・接続イベントを RxTrace に残す
+ * - タイムライン：接続・書き込み・Notify・描画・ストールを diag/Timeline に記録（APP_TIMELINE=1）
+ * - IMU ストリーム：CMD_IMU_START で FIFO のサンプルを STREAM_IMU に流す（切断で停止）
+ * - 音声ストリーム：CMD_AUDIO_START でマイク入力を ADPCM にして STREAM_AUDIO に流す（切断で停止）
+ * - カメラストリーム：CMD_CAMERA_START で JPEG を分割して STREAM_CAMERA に流す（遅れたフレームは捨てる）
+ *   カメラが IMU・タッチとバスを共用しているとき（CoreS3 の内部 I2C）は、どちらかが動いている間は
+ *   カメラを、カメラが動いている間は IMU を始めない
+ * - 姿勢ストリーム：CMD_ORIENTATION_START で IMU のサンプルから推定した姿勢を STREAM_ORIENTATION に流す
+ * - 時刻同期：CMD_TIME_SYNC の交換でセントラルの時計との対応を推定し、各パケットに同期時刻を付ける
+ * - タッチストリーム：タッチイベントを優先レーンで STREAM_TOUCH に流す（loop() の先頭で送る）
+ * - トリガー：CMD_TRIGGER_SET でストリームごとに送る条件（変化・エッジ・ハートビート）を決める（切断で既定に戻す）
+ * - バックログ：CMD_BACKLOG_ENABLE すると切断中もストリーム（カメラ以外）を止めずに、レコードを RAM と
+ *               フラッシュに溜め、再接続後に STREAM_BACKLOG で再生する（トリガーも切断で戻さない）
+ * - 設定：デバイス名・UUID・ハートビートの周期は起動時にフラッシュの設定（app/RuntimeConfig.h）を読み、
+ *         CMD_CONFIG_SET で変えて CMD_CONFIG_SAVE で保存する
+ * - 時系列ログ：CMD_LOG_START で選んだストリームをフラッシュのセグメントに記録し、CMD_LOG_QUERY で
+ *               seq・時刻の範囲を STREAM_LOG で返す
+ * - GATT のキャッシュ：Database Hash を置き、GATT が変わったら、変わってからまだ知らせていないセントラルに
+ *                      接続したときに Service Changed を送る（ハッシュと知らせたセントラルはフラッシュの /gatt.bin）
+ *
+ * ハードウェアには hal:: のインターフェース経由でのみアクセスするので、
+ * 実機（M5Unified + BLEDevice）とネイティブ環境（モック）の両方で動く。
+ *
+ * BLE タスクからの書き込みは rxRing に積むだけにして、処理はすべて loop() で行う。
+ */
+class BleApp : public hal::BleListener {
+public:
+    BleApp(hal::Clock& clock, hal::SerialPort& serial, hal::Display& display, hal::BlePeripheral& ble);
+
+    // センサを使う場合は setup() の前に渡す
+    void attachImu(hal::Imu* imu) { imuStream.setImu(imu); }
+    void attachMicrophone(hal::Microphone* mic) { audioStream.setMicrophone(mic); }
+    void attachCamera(hal::Camera* camera) { cameraStream.setCamera(camera); }
+    void attachTouch(hal::TouchInput* touch) { touchStream.setTouch(touch); }
+    // 切断中のレコードを溜める・時系列ログを記録する場合は setup() の前に渡す
+    // （書き込みはすべて storage でまとめてから store に書く）
+    void attachStorage(hal::FileStore* store) {
+        storage.setBacking(store);
+        config.setStore(&storage);
+        backlog.setStore(&storage);
+        recordLog.setStore(&storage);
+    }
+
+    void setup();
+    void loop();
+
+    // ストリームにレコードを積む（loop() と同じタスクから呼ぶこと）。満杯なら false
+    bool publish(uint8_t stream, const uint8_t* data, size_t len);
+
+    CommandDispatcher& commands() { return dispatcher; }
+    NotifyScheduler& streamScheduler() { return scheduler; }
+    RuntimeStats& runtimeStats() { return stats; }
+    RxTrace& rxTrace() { return trace; }
+    ImuStream& imu() { return imuStream; }
+    AudioStream& audio() { return audioStream; }
+    CameraStream& camera() { return cameraStream; }
+    TouchStream& touch() { return touchStream; }
+    OrientationStream& orientation() { return orientationStream; }
+    ClockSync& timeSync() { return clockSync; }
+    TriggerTable& triggerTable() { return triggers; }
+    RuntimeConfig& settings() { return config; }
+    Backlog& backlogStore() { return backlog; }
+    RecordLog& log() { return recordLog; }
+    WriteBehind& storageWrites() { return storage; }
+    Subscriptions& subscriptionState() { return subscriptions; }
+
+    bool isConnected() const { return deviceConnected; }
+    // GATT が変わって、Service Changed をまだ送る（次の接続で送る）
+    bool serviceChangePending() const { return serviceChangedRemaining > 0; }
+    // この起動で Service Changed を送った接続の数
+    uint32_t serviceChangeAnnounced() const { return serviceChangedSent; }
+    uint32_t notifyCount() const { return notifyCounter; }
+    // ATT の値の上限（512 byte）を超えていて捨てた書き込み
+    uint32_t oversizedWriteCount() const { return oversizedWrites; }
+
+    // hal::BleListener
+    void onConnect(uint16_t connId) override;
+    void onDisconnect(uint16_t connId) override;
+    void onWrite(hal::CharId ch, const uint8_t* data, size_t len) override;
+    void onRead(hal::CharId ch) override;
+    void onSubscribeChanged(hal::CharId ch, bool enabled) override;
+    void onMtuChanged(uint16_t mtu) override;
+    void onConnParamsUpdated(uint16_t interval, uint16_t latency, uint16_t timeout) override;
+
+private:
+    void initBLE();
+    void checkDatabaseHash();
+    void saveGattState();
+    void announceServiceChanged();
+    void registerCommands();
+    void restartAdvertising();
+    void sendNotify(bool dataSubscribed);
+    void pollProducers(size_t capacity);
+    void processRx();
+    void handleDataWrite(const uint8_t* data, size_t len);
+    void handleCommandWrite(const uint8_t* data, size_t len);
+    void sendReply(const uint8_t* response, size_t len);
+    void drawLine(int16_t y, hal::Color color, const char* text);
+
+    // 診断データのダンプ（シリアルへ 16 進、またはストリームへ）
+    using DumpReader = size_t (*)(void* context, size_t offset, uint8_t* out, size_t len);
+    bool startDump(const char* label, uint8_t stream, DumpReader reader, void* context, size_t length,
+                   uint8_t target);
+    void pumpDump();
+
+    static bool cameraBusInUse(void* context);
+    static bool imuBusInUse(void* context);
+
+    static void cmdPing(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdGetInfo(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdResetStats(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdTraceStart(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdTraceStop(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdTraceDump(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdTimelineStart(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdTimelineStop(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdTimelineDump(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    hal::SerialPort& serial;
+    hal::Display& display;
+    hal::BlePeripheral& ble;
+
+    hal::CharId dataChar = hal::kInvalidId;
+    hal::CharId streamChar = hal::kInvalidId;
+    hal::CharId commandChar = hal::kInvalidId;
+    hal::CharId statsChar = hal::kInvalidId;
+    hal::CharId databaseHashChar = hal::kInvalidId;
+    TypedCharacteristic<StatsPayload> statsValue{ble};
+
+    // BLE タスクから書き換えられるフラグ
+    std::atomic<bool> deviceConnected{false};
+    std::atomic<bool> shouldRestartAdvertising{false};
+    uint16_t connectionId = 0;
+
+    bool oldDeviceConnected = false;
+    uint8_t databaseHash[gatt::kDatabaseHashSize] = {};
+    uint8_t serviceChangedRemaining = 0;  // Service Changed を送る残りの接続の数（/gatt.bin に残す）
+    uint32_t serviceChangedSent = 0;
+    uint32_t notifyCounter = 0;
+    uint32_t lastLoopUs = 0;
+
+    RuntimeStats stats;
+
+    // データパス
+    NotifyScheduler scheduler;
+    // コマンドの Write は先頭に受信時刻 [u32 us] を付けて積む（長い書き込みでも値は 512 byte まで）
+    static constexpr size_t kRxStampSize = 4;
+    static constexpr size_t kMaxAttValue = 512;
+    RecordRing<RX_RING_SIZE> rxRing;
+    std::atomic<uint32_t> oversizedWrites{0};
+    Reassembler reassembler;
+    CommandDispatcher dispatcher;
+    TriggerTable triggers{clock};
+    RuntimeConfig config;
+    ImuStream imuStream{clock, scheduler};
+    AudioStream audioStream{scheduler};
+    CameraStream cameraStream{clock, scheduler};
+    TouchStream touchStream{clock, scheduler};
+    OrientationStream orientationStream{clock, scheduler, imuStream};
+    ClockSync clockSync{clock};
+    Backlog backlog{clock};
+    RecordLog recordLog{clock};
+    WriteBehind storage{clock};
+    Subscriptions subscriptions;
+
+    // 受信トレース
+    uint8_t traceBuffer[TRACE_BUFFER_SIZE];
+    RxTrace trace{traceBuffer, sizeof(traceBuffer)};
+
+    // 進行中のダンプ（同時に 1 つだけ）
+    enum class DumpTarget : uint8_t { None, Serial, Stream };
+    struct DumpJob {
+        DumpTarget target = DumpTarget::None;
+        const char* label = nullptr;
+        uint8_t stream = 0;
+        DumpReader reader = nullptr;
+        void* context = nullptr;
+        size_t offset = 0;
+        size_t length = 0;
+    };
+    DumpJob dump;
+};
@@ -0,0 +1,219 @@
+#include "app/CameraStream.h"
+
+#include "app/AppConfig.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+
+static uint16_t clampU16(uint32_t v) {
+    return v > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(v);
+}
+
+bool CameraStream::start(uint16_t width, uint16_t height, uint8_t quality, uint16_t intervalMs,
+                         uint16_t maxLatencyMs) {
+    stop();
+    if (camera == nullptr || maxLatencyMs == 0) {
+        return false;
+    }
+    if (camera->sharesSensorBus() && busInUse != nullptr && busInUse(busContext)) {
+        return false;
+    }
+    if (!camera->start(width, height, quality)) {
+        return false;
+    }
+    this->intervalMs = intervalMs;
+    this->maxLatencyMs = maxLatencyMs;
+    startMs = clock.millis();
+    nextCaptureMs = startMs;
+    latencySumMs = 0;
+    counters = {};
+    running = true;
+    return true;
+}
+
+void CameraStream::stop() {
+    if (!running) {
+        return;
+    }
+    if (state == State::Sending) {
+        camera->release();
+    }
+    if (state != State::Idle) {
+        discardQueuedChunks();
+    }
+    state = State::Idle;
+    camera->stop();
+    running = false;
+}
+
+size_t CameraStream::chunkSize(size_t packetCapacity) {
+    size_t overhead = frame::kPacketHeaderSize + frame::kRecordHeaderSize + kChunkHeaderSize;
+    if (packetCapacity <= overhead) {
+        return 0;
+    }
+    size_t n = packetCapacity - overhead;
+    return n < kMaxChunk ? n : kMaxChunk;
+}
+
+void CameraStream::poll(size_t packetCapacity) {
+    if (!running) {
+        return;
+    }
+    uint32_t now = clock.millis();
+
+    // 期限を過ぎたフレームは打ち切る
+    if (state != State::Idle && now - captureStartMs > maxLatencyMs) {
+        abortFrame();
+        if (!running) {
+            return;
+        }
+    }
+    if (state == State::Sending) {
+        pumpChunks(packetCapacity);
+    }
+    if (state == State::Draining && static_cast<int32_t>(scheduler.recordsDequeued() - lastRecord) >= 0) {
+        finishFrame(now);
+        if (!running) {
+            return;
+        }
+    }
+
+    if (static_cast<int32_t>(now - nextCaptureMs) >= 0) {
+        if (state != State::Idle) {
+            ++counters.framesSkipped;
+        } else {
+            captureFrame();
+            if (state == State::Sending) {
+                pumpChunks(packetCapacity);
+            }
+        }
+        nextCaptureMs += intervalMs;
+        if (static_cast<int32_t>(clock.millis() - nextCaptureMs) >= 0) {
+            nextCaptureMs = clock.millis() + intervalMs;
+        }
+        // 1 枚だけのときは送り終わるまで次を撮らない
+        if (intervalMs == 0) {
+            nextCaptureMs = clock.millis() + 0x7FFFFFFF;
+        }
+    }
+}
+
+void CameraStream::captureFrame() {
+    uint32_t begin = clock.millis();
+    if (!camera->capture(current)) {
+        return;
+    }
+    uint32_t elapsed = clock.millis() - begin;
+    if (elapsed > counters.captureMaxMs) {
+        counters.captureMaxMs = elapsed;
+    }
+    captureStartMs = begin;
+    ++counters.framesCaptured;
+    counters.lastFrameBytes = static_cast<uint32_t>(current.length);
+    ++frameId;
+    offset = 0;
+    state = State::Sending;
+}
+
+void CameraStream::pumpChunks(size_t packetCapacity) {
+    size_t chunk = chunkSize(packetCapacity);
+    if (chunk == 0) {
+        abortFrame();
+        return;
+    }
+    size_t limit = CAMERA_QUEUE_PACKETS * packetCapacity;
+    uint8_t record[kChunkHeaderSize + kMaxChunk];
+    while (offset < current.length && scheduler.queuedBytes() < limit) {
+        size_t n = current.length - offset < chunk ? current.length - offset : chunk;
+        wire::putU16(record, frameId);
+        wire::putU32(record + 2, static_cast<uint32_t>(offset));
+        wire::putU32(record + 6, static_cast<uint32_t>(current.length));
+        for (size_t i = 0; i < n; ++i) {
+            record[kChunkHeaderSize + i] = current.data[offset + i];
+        }
+        if (!scheduler.enqueue(STREAM_CAMERA, record, kChunkHeaderSize + n)) {
+            break;
+        }
+        offset += n;
+        counters.bytesSent += static_cast<uint32_t>(n);
+    }
+    if (offset >= current.length) {
+        lastRecord = scheduler.stats().recordsQueued;
+        camera->release();
+        state = State::Draining;
+    }
+}
+
+void CameraStream::finishFrame(uint32_t nowMs) {
+    uint32_t latency = nowMs - captureStartMs;
+    ++counters.framesSent;
+    latencySumMs += latency;
+    counters.latencyLastMs = latency;
+    counters.latencyAvgMs = static_cast<uint32_t>(latencySumMs / counters.framesSent);
+    if (latency > counters.latencyMaxMs) {
+        counters.latencyMaxMs = latency;
+    }
+    uint32_t elapsed = nowMs - startMs;
+    counters.fpsX100 = elapsed > 0 ? static_cast<uint32_t>(counters.framesSent * 100000ull / elapsed) : 0;
+
+    state = State::Idle;
+    if (intervalMs == 0) {
+        stop();
+    }
+}
+
+void CameraStream::abortFrame() {
+    if (state == State::Sending) {
+        camera->release();
+    }
+    discardQueuedChunks();
+    ++counters.framesAborted;
+    state = State::Idle;
+    if (intervalMs == 0) {
+        stop();
+    }
+}
+
+// 送りかけのフレームのチャンクで、まだパケットに詰められていないものを送信待ちから取り除く
+void CameraStream::discardQueuedChunks() {
+    uint8_t id[2];
+    wire::putU16(id, frameId);
+    scheduler.discardQueued(STREAM_CAMERA, id, sizeof(id));
+}
+
+void CameraStream::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_CAMERA_START, &CameraStream::cmdStart, this);
+    dispatcher.registerHandler(CMD_CAMERA_STOP, &CameraStream::cmdStop, this);
+    dispatcher.registerHandler(CMD_CAMERA_STATS, &CameraStream::cmdStats, this);
+}
+
+void CameraStream::cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    CameraStream* self = static_cast<CameraStream*>(context);
+    if (len != 9) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (!self->start(wire::getU16(args), wire::getU16(args + 2), args[4], wire::getU16(args + 5),
+                     wire::getU16(args + 7))) {
+        reply.status = CommandStatus::Failed;
+    }
+}
+
+void CameraStream::cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    static_cast<CameraStream*>(context)->stop();
+    cmdStats(context, args, len, reply);
+}
+
+void CameraStream::cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    const CameraStreamStats& s = static_cast<CameraStream*>(context)->counters;
+    reply.appendU32(s.framesCaptured);
+    reply.appendU32(s.framesSent);
+    reply.appendU32(s.framesSkipped);
+    reply.appendU32(s.framesAborted);
+    reply.appendU16(clampU16(s.fpsX100));
+    reply.appendU16(clampU16(s.latencyAvgMs));
+    reply.appendU16(clampU16(s.latencyMaxMs));
+    reply.appendU16(clampU16(s.captureMaxMs));
+    reply.appendU32(s.lastFrameBytes);
+}
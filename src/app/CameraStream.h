@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/NotifyScheduler.h"
+#include "hal/Camera.h"
+#include "hal/Clock.h"
+
+/**
+ * カメラの JPEG を分割して STREAM_CAMERA のレコードにしてストリームに流す
+ *
+ * レコード（リトルエンディアン）
+ *   u16 frameId
+ *   u32 offset      このチャンクのフレーム内位置
+ *   u32 frameSize   JPEG 全体のバイト数（offset + len == frameSize で最後のチャンク）
+ *   u8  data[]
+ *
+ * リンクが追いつかないときは遅れたフレームを送らず、フレーム単位で捨てる
+ * - 撮影時刻になっても前のフレームが送り終わっていなければ、その回は撮らない（skipped）
+ * - 撮影から maxLatencyMs を過ぎても送り終わらないフレームは残りのチャンクを出さない（aborted）
+ *   送信待ちに積んであったそのフレームのチャンクも取り除く（NotifyScheduler::discardQueued()）。
+ *   BLE スタックに渡し済みのパケットの分は届くことがあるが、フレームは揃わないので、
+ *   セントラルは frameId が変わった時点で、揃っていないフレームを捨てればよい
+ * - stop() で送りかけのフレームも同じように取り除く
+ * チャンクは送信待ちが CAMERA_QUEUE_PACKETS パケット分を下回ったときだけ積むので、
+ * 他のストリーム（IMU・音声）より優先度は低い。
+ *
+ * レイテンシ = 撮影開始から最後のチャンクがパケットに詰められるまで。
+ *
+ * poll() は loop() から呼ぶこと（NotifyScheduler と同じタスク）。
+ */
+
+struct CameraStreamStats {
+    uint32_t framesCaptured;
+    uint32_t framesSent;
+    uint32_t framesSkipped;  // 前のフレームが送り終わらず撮らなかった回数
+    uint32_t framesAborted;  // maxLatencyMs を超えて途中で打ち切ったフレーム
+    uint32_t bytesSent;
+    uint32_t lastFrameBytes;
+    uint32_t captureMaxMs;   // capture()（撮影 + JPEG 圧縮）にかかった時間の最大値
+    uint32_t latencyLastMs;
+    uint32_t latencyAvgMs;
+    uint32_t latencyMaxMs;
+    uint32_t fpsX100;        // start() からの平均フレームレート × 100
+};
+
+class CameraStream {
+public:
+    static constexpr size_t kChunkHeaderSize = 10;
+    static constexpr size_t kMaxChunk = frame::kMaxRecordPayload - kChunkHeaderSize;
+
+    CameraStream(hal::Clock& clock, NotifyScheduler& scheduler) : clock(clock), scheduler(scheduler) {}
+
+    void setCamera(hal::Camera* camera) { this->camera = camera; }
+    // カメラがセンサーとバスを共用しているとき、inUse(context) が true なら start() を断る
+    void setBusGuard(bool (*inUse)(void* context), void* context) {
+        busInUse = inUse;
+        busContext = context;
+    }
+    bool sharesSensorBus() const { return camera != nullptr && camera->sharesSensorBus(); }
+
+    // intervalMs ごとに 1 枚撮る（0 なら 1 枚だけ撮って止まる）
+    bool start(uint16_t width, uint16_t height, uint8_t quality, uint16_t intervalMs, uint16_t maxLatencyMs);
+    void stop();
+    bool isRunning() const { return running; }
+
+    void poll(size_t packetCapacity);
+
+    // CMD_CAMERA_START / CMD_CAMERA_STOP / CMD_CAMERA_STATS を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    const CameraStreamStats& stats() const { return counters; }
+
+    // packetCapacity のパケット 1 つに入るチャンクの大きさ（0 なら MTU が小さすぎる）
+    static size_t chunkSize(size_t packetCapacity);
+
+private:
+    enum class State : uint8_t { Idle, Sending, Draining };
+
+    void captureFrame();
+    void pumpChunks(size_t packetCapacity);
+    void finishFrame(uint32_t nowMs);
+    void abortFrame();
+    void discardQueuedChunks();
+
+    static void cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    NotifyScheduler& scheduler;
+    hal::Camera* camera = nullptr;
+    bool (*busInUse)(void* context) = nullptr;
+    void* busContext = nullptr;
+
+    bool running = false;
+    uint16_t intervalMs = 0;
+    uint16_t maxLatencyMs = 0;
+    uint32_t startMs = 0;
+    uint32_t nextCaptureMs = 0;
+
+    // 送信中のフレーム
+    State state = State::Idle;
+    hal::CameraFrame current = {};
+    uint16_t frameId = 0;
+    size_t offset = 0;
+    uint32_t captureStartMs = 0;
+    uint32_t lastRecord = 0;  // 最後のチャンクを積んだ時点の recordsQueued
+    uint64_t latencySumMs = 0;
+
+    CameraStreamStats counters = {};
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * 固定長のキャラクタリスティックの値（ファームウェアとホスト側のデコーダで共有する）
+ * - 値は packed の構造体をそのままのバイト列で、リトルエンディアン（ESP32 もホストも）
+ * - フィールドの位置は offsetof の static_assert で固定する。並びを変えるとコンパイルが通らない
+ * - ホスト側はこのヘッダだけを include して decode() で読む（ほかのヘッダに依存しない）
+ *
+ * フィールドは末尾に足し、足したら kVersion を上げる。
+ */
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "characteristic payloads are little-endian");
+
+// 統計キャラクタリスティックの値（56 byte。v1 は loopStallMaxUs までの 48 byte）
+struct __attribute__((packed)) StatsPayload {
+    static constexpr uint8_t kVersion = 2;
+
+    uint8_t version;
+    uint8_t reserved[3];
+    uint32_t uptimeMs;
+    uint32_t notifiesSent;
+    uint32_t bytesSent;
+    uint32_t drops;  // 送信・受信リングのあふれ、MTU 超過で捨てたレコード
+    uint32_t writesReceived;
+    uint32_t bytesReceived;
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t lastReconnectMs;  // 直近の切断→再接続にかかった時間
+    uint32_t maxReconnectMs;
+    uint32_t loopStallMaxUs;  // loop() の呼び出し間隔の最大値
+    uint32_t firstNotifyMs;     // 直近の接続から最初の Notify までの時間（v2）
+    uint32_t maxFirstNotifyMs;  // （v2）
+};
+static_assert(sizeof(StatsPayload) == 56, "StatsPayload layout changed");
+static_assert(offsetof(StatsPayload, uptimeMs) == 4 && offsetof(StatsPayload, drops) == 16 &&
+                  offsetof(StatsPayload, connects) == 28 && offsetof(StatsPayload, loopStallMaxUs) == 44 &&
+                  offsetof(StatsPayload, firstNotifyMs) == 48,
+              "StatsPayload layout changed");
+
+namespace payload {
+
+// 固定長の値として送れる型（memcpy でそのまま読み書きでき、パディングがない）
+template <typename T>
+constexpr bool isFixedLayout() {
+    return std::is_trivially_copyable<T>::value && std::is_standard_layout<T>::value && alignof(T) == 1;
+}
+
+// 受け取った値を読む。大きさか版が合わなければ false（out は変えない）
+template <typename T>
+bool decode(const uint8_t* data, size_t len, T& out) {
+    static_assert(isFixedLayout<T>(), "payload must be a packed trivially copyable struct");
+    if (len != sizeof(T) || data[0] != T::kVersion) {
+        return false;
+    }
+    std::memcpy(&out, data, sizeof(T));
+    return true;
+}
+
+}  // namespace payload
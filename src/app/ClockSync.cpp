@@ -0,0 +1,188 @@
+#include "app/ClockSync.h"
+
+#include <cmath>
+
+#include "app/Wire.h"
+
+uint64_t ClockSync::extend(uint32_t us) {
+    if (!started) {
+        started = true;
+        lastLow = us;
+        lastExtended = us;
+    }
+    // 最後に見た時刻との差（±35 分）で伸ばすので、少し前の時刻（t2 など）を渡しても戻らない
+    int32_t diff = static_cast<int32_t>(us - lastLow);
+    uint64_t extended = lastExtended + static_cast<int64_t>(diff);
+    if (diff > 0) {
+        lastLow = us;
+        lastExtended = extended;
+    }
+    return extended;
+}
+
+void ClockSync::reset() {
+    awaiting = false;
+    historyCount = 0;
+    historyHead = 0;
+    epochCount = 0;
+    fitted = false;
+    drift = 0;
+    counters = {};
+}
+
+void ClockSync::addExchange(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+    int64_t roundTrip = static_cast<int64_t>(t4 - t1) - static_cast<int64_t>(t3 - t2);
+    if (roundTrip < 0) {
+        roundTrip = 0;
+    }
+    Sample s;
+    s.deviceUs = t2 + (t3 - t2) / 2;
+    s.offsetUs = (static_cast<int64_t>(t1 - t2) + static_cast<int64_t>(t4 - t3)) / 2;
+    s.delayUs = roundTrip > 0xFFFFFFFF ? 0xFFFFFFFF : static_cast<uint32_t>(roundTrip);
+    ++counters.exchanges;
+    counters.lastDelayUs = s.delayUs;
+
+    if (epochCount == 0 || s.delayUs < epochBest.delayUs) {
+        epochBest = s;
+    }
+    if (++epochCount == kEpoch) {
+        history[historyHead] = epochBest;
+        historyHead = (historyHead + 1) % kHistory;
+        if (historyCount < kHistory) {
+            ++historyCount;
+        }
+        epochCount = 0;
+    }
+    refit();
+}
+
+void ClockSync::refit() {
+    const Sample* points[kHistory + 1];
+    size_t n = 0;
+    for (size_t i = 0; i < historyCount; ++i) {
+        points[n++] = &history[i];
+    }
+    if (epochCount > 0) {
+        points[n++] = &epochBest;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    // 時刻・オフセットは最初の点からの差を double で扱う
+    uint64_t ref = points[0]->deviceUs;
+    int64_t base = points[0]->offsetUs;
+    double weights[kHistory + 1];
+    double sumW = 0;
+    double meanT = 0;
+    double meanO = 0;
+    uint64_t first = ref;
+    uint64_t last = ref;
+    uint32_t minDelay = 0xFFFFFFFF;
+    for (size_t i = 0; i < n; ++i) {
+        double d = static_cast<double>(points[i]->delayUs) + kDelayFloorUs;
+        weights[i] = 1.0 / (d * d);
+        sumW += weights[i];
+        meanT += weights[i] * static_cast<double>(static_cast<int64_t>(points[i]->deviceUs - ref));
+        meanO += weights[i] * static_cast<double>(points[i]->offsetUs - base);
+        if (points[i]->deviceUs < first) first = points[i]->deviceUs;
+        if (points[i]->deviceUs > last) last = points[i]->deviceUs;
+        if (points[i]->delayUs < minDelay) minDelay = points[i]->delayUs;
+    }
+    meanT /= sumW;
+    meanO /= sumW;
+
+    // 時間の幅が短いうちはドリフトを前の値のままにする
+    if (n >= 2 && last - first >= kMinDriftSpanUs) {
+        double sxx = 0;
+        double sxy = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double dt = static_cast<double>(static_cast<int64_t>(points[i]->deviceUs - ref)) - meanT;
+            sxy += weights[i] * dt * (static_cast<double>(points[i]->offsetUs - base) - meanO);
+            sxx += weights[i] * dt * dt;
+        }
+        drift = sxy / sxx;
+    }
+
+    // 重み付き平均の時刻を基準にする（そこでは当てはめの誤差が最小）
+    refDeviceUs = ref + static_cast<int64_t>(std::llround(meanT));
+    baseOffset = base;
+    intercept = meanO;
+    fitted = true;
+
+    double sumSq = 0;
+    for (size_t i = 0; i < n; ++i) {
+        double dt = static_cast<double>(static_cast<int64_t>(points[i]->deviceUs - refDeviceUs));
+        double error = static_cast<double>(points[i]->offsetUs - baseOffset) - (intercept + drift * dt);
+        sumSq += weights[i] * error * error;
+    }
+    counters.residualUs = static_cast<uint32_t>(std::sqrt(sumSq / sumW));
+    counters.minDelayUs = minDelay;
+    counters.samples = static_cast<uint8_t>(n);
+}
+
+int64_t ClockSync::offsetUs() const {
+    return baseOffset + static_cast<int64_t>(std::llround(intercept));
+}
+
+uint64_t ClockSync::toCentral(uint64_t deviceUs) const {
+    double dt = static_cast<double>(static_cast<int64_t>(deviceUs - refDeviceUs));
+    return deviceUs + baseOffset + static_cast<int64_t>(std::llround(intercept + drift * dt));
+}
+
+size_t ClockSync::encodeTag(uint8_t* out) {
+    if (!fitted) {
+        return 0;
+    }
+    uint32_t now = clock.micros();
+    wire::putU32(out, now);
+    wire::putU64(out + 4, toCentral(extend(now)));
+    return kTagSize;
+}
+
+void ClockSync::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_TIME_SYNC, &ClockSync::cmdSync, this);
+    dispatcher.registerHandler(CMD_TIME_STATUS, &ClockSync::cmdStatus, this);
+}
+
+void ClockSync::cmdSync(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    ClockSync* self = static_cast<ClockSync*>(context);
+    if (len != 17) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    uint8_t seq = args[0];
+    uint64_t t1 = wire::getU64(args + 1);
+    uint64_t prevT4 = wire::getU64(args + 9);
+    uint64_t t2 = self->extend(self->receiveUs);
+
+    // 前の交換の t4 が届いたら 1 組できる
+    if (self->awaiting && prevT4 != 0 && seq == static_cast<uint8_t>(self->lastSeq + 1)) {
+        self->addExchange(self->lastT1, self->lastT2, self->lastT3, prevT4);
+    } else if (self->awaiting) {
+        ++self->counters.ignored;
+    }
+
+    // 応答はこのハンドラから戻ってすぐ Notify されるので、ここでの時刻を t3 とする
+    uint64_t t3 = self->deviceNowUs();
+    self->awaiting = true;
+    self->lastSeq = seq;
+    self->lastT1 = t1;
+    self->lastT2 = t2;
+    self->lastT3 = t3;
+    reply.appendU8(seq);
+    reply.appendU64(t2);
+    reply.appendU64(t3);
+}
+
+void ClockSync::cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    ClockSync* self = static_cast<ClockSync*>(context);
+    reply.appendU8(self->fitted ? 1 : 0);
+    reply.appendU8(self->counters.samples);
+    reply.appendU64(static_cast<uint64_t>(self->offsetUs()));
+    reply.appendU32(static_cast<uint32_t>(self->driftPpb()));
+    reply.appendU32(self->counters.residualUs);
+    reply.appendU32(self->counters.minDelayUs);
+}
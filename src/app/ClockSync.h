@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CommandDispatcher.h"
+#include "hal/Clock.h"
+
+/**
+ * セントラルの時計とデバイスの時計の対応（オフセットとドリフト）を推定する
+ *
+ * NTP と同じ 4 時刻の交換を Command キャラクタリスティックの Write / Notify で行う
+ *   t1 セントラルが CMD_TIME_SYNC を書いた時刻（セントラルの時計）
+ *   t2 デバイスが Write を受けた時刻（BLE タスクの onWrite() で記録）
+ *   t3 デバイスが応答を Notify する直前の時刻
+ *   t4 セントラルが応答を受けた時刻（次の CMD_TIME_SYNC の prevT4 で知らせる）
+ *   offset = ((t1 - t2) + (t4 - t3)) / 2（セントラル = デバイス + offset）、delay = (t4 - t1) - (t3 - t2)
+ * BLE の往復はコネクションイベント待ちで片道の遅れが非対称になりやすく、1 回の交換の誤差は delay / 2
+ * まであり得る。そこで kEpoch 回の交換ごとに delay が最小のものだけを残し（NTP のクロックフィルタと同じ）、
+ * 残した直近 kHistory 点のオフセットを時刻に対して重み 1 / (delay + kDelayFloorUs)² の最小二乗で直線に
+ * 当てはめる（傾きがドリフト）。交換を続けるほど推定は更新される。
+ * 片道 0〜7.5 ms の遅れでは、0.5 秒ごとの交換を 2 分続けると誤差の中央値が 0.2 ms 程度になる
+ * （ネイティブのシナリオで確かめている）。
+ *
+ * 同期が取れている間は、NotifyScheduler が各パケットの先頭に STREAM_CLOCK のレコード
+ *   u32 deviceUs   パケットを作った時刻（デバイスの micros()。他のレコードの時刻と同じ時計）
+ *   u64 centralUs  その時刻をセントラルの時計に直したもの
+ * を入れる。セントラルはこの組から同じパケット内の時刻（IMU の timestampUs など）を自分の時計に直せる。
+ *
+ * デバイスの時刻は 32 bit の micros() を 64 bit に伸ばして扱う（loop() から 35 分以内の間隔で呼ばれる前提）。
+ * 当てはめは double で計算する（交換ごとに 1 回なので FPU がなくても問題にならない）。
+ */
+
+struct ClockSyncStats {
+    uint32_t exchanges;   // t4 まで揃った交換
+    uint32_t ignored;     // seq が続いていない・prevT4 が 0 で捨てた交換
+    uint32_t lastDelayUs;
+    uint32_t minDelayUs;  // 当てはめに使った点の最小 delay
+    uint32_t residualUs;  // 当てはめ残差（重み付き RMS）
+    uint8_t samples;      // 当てはめに使った点の数
+};
+
+class ClockSync {
+public:
+    static constexpr size_t kEpoch = 8;
+    static constexpr size_t kHistory = 32;
+    static constexpr uint32_t kDelayFloorUs = 500;
+    static constexpr uint32_t kMinDriftSpanUs = 2000000;  // ドリフトを求めるのに必要な時間の幅
+    static constexpr size_t kTagSize = 12;
+
+    explicit ClockSync(hal::Clock& clock) : clock(clock) {}
+
+    // 64 bit に伸ばしたデバイスの時刻
+    uint64_t deviceNowUs() { return extend(clock.micros()); }
+    uint64_t extend(uint32_t us);
+
+    // 次に処理するコマンドの Write を受けた時刻（t2）
+    void setReceiveTime(uint32_t us) { receiveUs = us; }
+
+    // 4 時刻を 1 組加えて推定し直す
+    void addExchange(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+    void reset();
+
+    bool synced() const { return fitted; }
+    uint64_t toCentral(uint64_t deviceUs) const;
+    int64_t offsetUs() const;
+    int32_t driftPpb() const { return static_cast<int32_t>(drift * 1e9); }
+
+    // STREAM_CLOCK のペイロードを out に書き、その長さを返す（同期していなければ 0）
+    size_t encodeTag(uint8_t* out);
+
+    // CMD_TIME_SYNC / CMD_TIME_STATUS を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    const ClockSyncStats& stats() const { return counters; }
+
+private:
+    struct Sample {
+        uint64_t deviceUs;  // (t2 + t3) / 2
+        int64_t offsetUs;
+        uint32_t delayUs;
+    };
+
+    void refit();
+
+    static void cmdSync(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    bool started = false;
+    uint32_t lastLow = 0;
+    uint64_t lastExtended = 0;
+    uint32_t receiveUs = 0;
+
+    // t4 を待っている交換
+    bool awaiting = false;
+    uint8_t lastSeq = 0;
+    uint64_t lastT1 = 0;
+    uint64_t lastT2 = 0;
+    uint64_t lastT3 = 0;
+
+    // kEpoch 回ごとに delay が最小だった交換（と、進行中の区間の最小）
+    Sample history[kHistory];
+    size_t historyCount = 0;
+    size_t historyHead = 0;
+    Sample epochBest = {};
+    size_t epochCount = 0;
+
+    // offset(t) = baseOffset + intercept + drift * (t - refDeviceUs)
+    bool fitted = false;
+    uint64_t refDeviceUs = 0;
+    int64_t baseOffset = 0;
+    double intercept = 0;
+    double drift = 0;
+
+    ClockSyncStats counters = {};
+};
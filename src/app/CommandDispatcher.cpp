@@ -0,0 +1,66 @@
+#include "app/CommandDispatcher.h"
+
+#include <cstring>
+
+#include "app/HotPath.h"
+#include "app/Wire.h"
+
+bool CommandReply::append(const uint8_t* data, size_t len) {
+    if (length + len > kMaxPayload) {
+        return false;
+    }
+    std::memcpy(payload + length, data, len);
+    length += len;
+    return true;
+}
+
+bool CommandReply::appendU16(uint16_t v) {
+    uint8_t b[2];
+    wire::putU16(b, v);
+    return append(b, sizeof(b));
+}
+
+bool CommandReply::appendU32(uint32_t v) {
+    uint8_t b[4];
+    wire::putU32(b, v);
+    return append(b, sizeof(b));
+}
+
+bool CommandReply::appendU64(uint64_t v) {
+    uint8_t b[8];
+    wire::putU64(b, v);
+    return append(b, sizeof(b));
+}
+
+bool CommandDispatcher::registerHandler(uint8_t opcode, CommandHandler handler, void* context) {
+    if (opcode >= kMaxOpcodes || table[opcode].handler != nullptr) {
+        return false;
+    }
+    table[opcode] = {handler, context};
+    return true;
+}
+
+HOT_PATH size_t CommandDispatcher::dispatch(const uint8_t* message, size_t len, uint8_t* out, size_t cap) {
+    if (len == 0 || cap < 2) {
+        return 0;
+    }
+    uint8_t opcode = message[0];
+    CommandReply reply;
+
+    if (opcode < kMaxOpcodes && table[opcode].handler != nullptr) {
+        table[opcode].handler(table[opcode].context, message + 1, len - 1, reply);
+        ++dispatched;
+    } else {
+        reply.status = CommandStatus::UnknownCommand;
+    }
+
+    // 切り詰めた payload を Ok で返さない
+    if (reply.length > cap - 2) {
+        reply.status = CommandStatus::ReplyTooLong;
+        reply.length = 0;
+    }
+    out[0] = static_cast<uint8_t>(opcode | CommandReply::kResponseFlag);
+    out[1] = static_cast<uint8_t>(reply.status);
+    std::memcpy(out + 2, reply.payload, reply.length);
+    return 2 + reply.length;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * コマンドメッセージ（[opcode u8][args...]）をハンドラに振り分ける
+ * - ハンドラ表は opcode で直接引く固定長配列（探索なし・ヒープなし）
+ * - 応答は [opcode | 0x80][status u8][payload] としてコマンド用キャラクタリスティックで Notify する
+ *   書き込みと同じく、Notify ごとに先頭 1 byte のフラグメントヘッダ（app/Reassembler.h）を付けて MTU に合わせて分ける
+ */
+
+enum class CommandStatus : uint8_t {
+    Ok = 0,
+    UnknownCommand = 1,
+    BadArguments = 2,
+    Busy = 3,
+    Failed = 4,
+    ReplyTooLong = 5,  // 応答が out に入らなかった（payload なし）
+};
+
+// 組み込みコマンド
+enum CommandOpcode : uint8_t {
+    CMD_PING = 0x01,      // args をそのまま返す
+    CMD_GET_INFO = 0x02,  // [protocol u8][mtu u16][streamQueued u16]
+    CMD_RETRANSMIT = 0x03,  // [seq u16][count u8] → [queued u8]
+    CMD_RESET_STATS = 0x04,  // 統計カウンタを 0 に戻す
+    CMD_GET_PROFILE = 0x05,  // [zone u8] → ゾーンの集計（diag/Profiler.h）
+    CMD_RESET_PROFILE = 0x06,
+    CMD_TRACE_START = 0x07,  // 受信トレースの記録開始（以前の記録は消える）
+    CMD_TRACE_STOP = 0x08,
+    CMD_TRACE_DUMP = 0x09,   // [target u8: 0=シリアル 1=ストリーム] → [length u32]
+    CMD_TIMELINE_START = 0x0A,  // タイムラインの記録開始（以前の記録は消える）
+    CMD_TIMELINE_STOP = 0x0B,
+    CMD_TIMELINE_DUMP = 0x0C,   // [target u8: 0=シリアル 1=ストリーム] → [length u32]
+    CMD_IMU_START = 0x0D,  // [rateHz u16][accelRangeG u8][gyroRangeDps u16]([encoding u8]) → [periodUs u16]
+                           //   encoding: 0=STREAM_IMU 1=STREAM_IMU_DELTA（省略時 0）
+    CMD_IMU_STOP = 0x0E,   // → [samplesRead u32][samplesDropped u32][fifoOverruns u32]
+                           //   [rawBytes u32][encodedBytes u32][encodeNsPerSample u32]
+    CMD_AUDIO_START = 0x0F,  // [sampleRate u16]([decimation u8][filter u8][cutoffHz u16][fftSize u16][average u8])
+                             //   後ろを付けると STREAM_SPECTRUM のスペクトルモード（app/SpectrumAnalyzer.h）
+    CMD_AUDIO_STOP = 0x10,   // → [captured u32][dropped u32][underruns u32][encodeUs u32][encodeMaxUs u32]
+                             //   [spectra u32]
+    CMD_CAMERA_START = 0x11,  // [width u16][height u16][quality u8][intervalMs u16][maxLatencyMs u16]
+    CMD_CAMERA_STOP = 0x12,   // → CMD_CAMERA_STATS と同じ
+    CMD_CAMERA_STATS = 0x13,  // → [captured u32][sent u32][skipped u32][aborted u32][fps×100 u16]
+                              //   [latencyAvgMs u16][latencyMaxMs u16][captureMaxMs u16][lastFrameBytes u32]
+    CMD_TOUCH_STATS = 0x14,   // [reset u8] → [events u32][dropped u32][overflows u32][detectAvgUs u32]
+                              //   [detectMaxUs u32][latencyAvgUs u32][latencyMaxUs u32]
+    CMD_ORIENTATION_START = 0x15,  // [rateHz u16][algorithm u8][gainX1000 u16][raw u8] → [periodUs u16]
+                                   //   IMU ストリームの動作中のみ。raw=0 で STREAM_IMU を止める
+    CMD_ORIENTATION_STOP = 0x16,   // → [updates u32][sent u32][dropped u32][resets u32]
+                                   //   [updateAvgNs u32][updateMaxNs u32]
+    CMD_TIME_SYNC = 0x17,    // [seq u8][t1 u64][prevT4 u64] → [seq u8][t2 u64][t3 u64]（app/ClockSync.h）
+    CMD_TIME_STATUS = 0x18,  // → [synced u8][samples u8][offsetUs i64][driftPpb i32][residualUs u32]
+                             //   [minDelayUs u32]
+    CMD_DSP_BENCH = 0x19,    // → [espDsp u8][firNs u32][biquadNs u32][fftNs u32]（スカラー版）
+                             //   [firNs u32][biquadNs u32][fftNs u32]（esp-dsp 版、なければ 0）
+    CMD_TRIGGER_SET = 0x1A,    // [stream u8][mode u8][thresholdX1000 i32][heartbeatMs u32]（app/TriggerTable.h）
+    CMD_TRIGGER_STATS = 0x1B,  // [stream u8][reset u8] → [mode u8][admitted u32][suppressed u32][heartbeats u32]
+    CMD_BACKLOG_ENABLE = 0x1C,  // [enable u8]（切断中のレコードを溜める。app/Backlog.h）
+    CMD_BACKLOG_ACK = 0x1D,     // [seq u32] → [replaySeq u32][pending u32]
+    CMD_BACKLOG_STATUS = 0x1E,  // → [enabled u8][nextSeq u32][pending u32][blocks u16][stored u32][dropped u32]
+                                //   [replayed u32][blockWrites u32][spilledBytes u32]
+    CMD_LOG_START = 0x1F,  // [streamMask u16]（時系列ログに記録するストリーム。app/RecordLog.h）
+    CMD_LOG_STOP = 0x20,   // → [nextSeq u32]（RAM のページも書き出す）
+    CMD_LOG_QUERY = 0x21,  // [key u8: 0=seq 1=時刻][from u32][to u32][step u16] → [startSeq u32]
+    CMD_LOG_STATUS = 0x22,  // → [recording u8][firstSeq u32][nextSeq u32][segments u8][pages u16][records u32]
+                            //   [pagesWritten u32][bytesWritten u32][queries u32][pagesRead u32][recordsSent u32]
+    CMD_CONFIG_GET = 0x23,   // [field u8] → [値]（app/RuntimeConfig.h）
+    CMD_CONFIG_SET = 0x24,   // [field u8][値] → [applied u8]
+    CMD_CONFIG_SAVE = 0x25,  // [erase u8]
+    CMD_STORAGE_MODE = 0x26,   // [mode u8: 0=Batched 1=Timed 2=Immediate][maxDelayMs u32]（app/WriteBehind.h）
+    CMD_STORAGE_STATS = 0x27,  // [reset u8] → [mode u8][logicalBytes u32][programmedBytes u32][commits u32]
+                               //   [partialCommits u32][amplificationX100 u16][flushAvgUs u32][flushMaxUs u32]
+                               //   [staged u16]
+    CMD_SUBSCRIPTIONS = 0x28,  // [reset u8] → [mask u16][activeLoops u32][gatedLoops u32][producerAvgUs u32]
+                               //   [savedUs u32][changes u32]（app/Subscriptions.h）
+};
+
+struct CommandReply {
+    static constexpr size_t kMaxPayload = 64;
+    static constexpr uint8_t kResponseFlag = 0x80;
+
+    CommandStatus status = CommandStatus::Ok;
+    uint8_t payload[kMaxPayload];
+    size_t length = 0;
+
+    // payload に追記する。入らなければ false
+    bool append(const uint8_t* data, size_t len);
+    bool appendU8(uint8_t v) { return append(&v, 1); }
+    bool appendU16(uint16_t v);
+    bool appendU32(uint32_t v);
+    bool appendU64(uint64_t v);
+};
+
+using CommandHandler = void (*)(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+class CommandDispatcher {
+public:
+    static constexpr size_t kMaxOpcodes = 64;
+
+    bool registerHandler(uint8_t opcode, CommandHandler handler, void* context);
+
+    // 応答フレームを out に書き、その長さを返す（0 なら応答なし）
+    size_t dispatch(const uint8_t* message, size_t len, uint8_t* out, size_t cap);
+
+    uint32_t dispatchedCount() const { return dispatched; }
+
+private:
+    struct Entry {
+        CommandHandler handler;
+        void* context;
+    };
+
+    Entry table[kMaxOpcodes] = {};
+    uint32_t dispatched = 0;
+};
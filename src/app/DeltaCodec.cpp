@@ -0,0 +1,37 @@
+#include "app/DeltaCodec.h"
+
+#include "app/Wire.h"
+
+namespace delta {
+
+size_t encodeSample(const int32_t* prev, const int32_t* values, size_t channels, uint8_t* out) {
+    size_t n = 0;
+    for (size_t c = 0; c < channels; ++c) {
+        uint32_t d = static_cast<uint32_t>(values[c]);
+        if (prev != nullptr) {
+            d -= static_cast<uint32_t>(prev[c]);
+        }
+        n += wire::putVarint(out + n, wire::zigzag(static_cast<int32_t>(d)));
+    }
+    return n;
+}
+
+size_t decodeSample(const int32_t* prev, const uint8_t* in, size_t len, size_t channels, int32_t* out) {
+    size_t n = 0;
+    for (size_t c = 0; c < channels; ++c) {
+        uint32_t v;
+        size_t used = wire::getVarint(in + n, len - n, v);
+        if (used == 0) {
+            return 0;
+        }
+        n += used;
+        uint32_t d = static_cast<uint32_t>(wire::unzigzag(v));
+        if (prev != nullptr) {
+            d += static_cast<uint32_t>(prev[c]);
+        }
+        out[c] = static_cast<int32_t>(d);
+    }
+    return n;
+}
+
+}  // namespace delta
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * ゆっくり変わる数値列（センサ値・カウンタ）の差分 + zigzag varint 符号化
+ *
+ * 1 サンプルは channels 個の int32。前のサンプルとの差分を zigzag して LEB128 で書く
+ * （差分は 2^32 で折り返すので、どんな値の組でも復号できる）。prev を渡さなければ
+ * 値そのものを書く（キーフレーム）。差分が ±63 以内なら 1 チャンネル 1 byte。
+ *
+ * 途中のレコードが欠けると次のキーフレームまで復号できないので、使う側で
+ * 一定間隔ごとにキーフレームを挟むこと。
+ */
+
+namespace delta {
+
+constexpr size_t kMaxChannels = 8;
+
+// 1 サンプルの最大長
+constexpr size_t maxSampleSize(size_t channels) {
+    return channels * 5;
+}
+
+// out に書いたバイト数を返す（out は maxSampleSize(channels) 以上）
+size_t encodeSample(const int32_t* prev, const int32_t* values, size_t channels, uint8_t* out);
+
+// in から 1 サンプル読んで out に書き、読んだバイト数を返す（途中切れ・不正なら 0）
+size_t decodeSample(const int32_t* prev, const uint8_t* in, size_t len, size_t channels, int32_t* out);
+
+}  // namespace delta
@@ -0,0 +1,309 @@
+#include "app/Dsp.h"
+
+#include <cmath>
+
+#include "diag/Profiler.h"
+
+namespace dsp {
+
+static constexpr float kPi = 3.14159265358979f;
+
+Backend defaultBackend() {
+    return DSP_HAS_ESP_DSP ? Backend::EspDsp : Backend::Scalar;
+}
+
+void designLowpass(float cutoff, float* coeffs, size_t taps) {
+    float center = 0.5f * static_cast<float>(taps - 1);
+    float sum = 0.0f;
+    for (size_t i = 0; i < taps; ++i) {
+        float t = static_cast<float>(i) - center;
+        float sinc = t == 0.0f ? 2.0f * cutoff : std::sin(2.0f * kPi * cutoff * t) / (kPi * t);
+        float window = 0.54f - 0.46f * std::cos(2.0f * kPi * static_cast<float>(i) / static_cast<float>(taps - 1));
+        coeffs[i] = sinc * window;
+        sum += coeffs[i];
+    }
+    // 直流の利得を 1 にそろえる
+    for (size_t i = 0; i < taps; ++i) {
+        coeffs[i] /= sum;
+    }
+}
+
+// ===== FIR =====
+
+bool FirDecimator::init(const float* coeffs, size_t taps, size_t decimation, Backend backend) {
+    if (taps == 0 || taps > kMaxFirTaps || taps % 4 != 0 || decimation == 0) {
+        return false;
+    }
+    if (backend == Backend::EspDsp && !DSP_HAS_ESP_DSP) {
+        return false;
+    }
+    for (size_t i = 0; i < taps; ++i) {
+        this->coeffs[i] = coeffs[i];
+    }
+    this->taps = taps;
+    this->decim = decimation;
+    this->backend = backend;
+    reset();
+    return true;
+}
+
+void FirDecimator::reset() {
+    for (float& d : delay) {
+        d = 0.0f;
+    }
+    pos = 0;
+#if DSP_HAS_ESP_DSP
+    if (backend == Backend::EspDsp) {
+        dsps_fird_init_f32(&fir, coeffs, delay, static_cast<int>(taps), static_cast<int>(decim));
+    }
+#endif
+}
+
+size_t FirDecimator::process(const float* in, size_t n, float* out) {
+    size_t outputs = n / decim;
+#if DSP_HAS_ESP_DSP
+    if (backend == Backend::EspDsp) {
+        return static_cast<size_t>(dsps_fird_f32(&fir, in, out, static_cast<int>(outputs)));
+    }
+#endif
+    // esp-dsp の ANSI 版と同じ循環バッファ（係数は最も古いサンプルから順に掛ける）
+    for (size_t i = 0; i < outputs; ++i) {
+        for (size_t k = 0; k < decim; ++k) {
+            delay[pos++] = *in++;
+            if (pos >= taps) {
+                pos = 0;
+            }
+        }
+        float acc = 0.0f;
+        size_t c = 0;
+        for (size_t j = pos; j < taps; ++j) {
+            acc += coeffs[c++] * delay[j];
+        }
+        for (size_t j = 0; j < pos; ++j) {
+            acc += coeffs[c++] * delay[j];
+        }
+        out[i] = acc;
+    }
+    return outputs;
+}
+
+// ===== Biquad =====
+
+void Biquad::setLowpass(float frequency, float q) {
+    float w0 = 2.0f * kPi * frequency;
+    float alpha = std::sin(w0) / (2.0f * q);
+    float c = std::cos(w0);
+    float a0 = 1.0f + alpha;
+    coef[0] = (1.0f - c) / 2.0f / a0;
+    coef[1] = (1.0f - c) / a0;
+    coef[2] = coef[0];
+    coef[3] = -2.0f * c / a0;
+    coef[4] = (1.0f - alpha) / a0;
+    reset();
+}
+
+void Biquad::setHighpass(float frequency, float q) {
+    float w0 = 2.0f * kPi * frequency;
+    float alpha = std::sin(w0) / (2.0f * q);
+    float c = std::cos(w0);
+    float a0 = 1.0f + alpha;
+    coef[0] = (1.0f + c) / 2.0f / a0;
+    coef[1] = -(1.0f + c) / a0;
+    coef[2] = coef[0];
+    coef[3] = -2.0f * c / a0;
+    coef[4] = (1.0f - alpha) / a0;
+    reset();
+}
+
+void Biquad::process(const float* in, float* out, size_t n) {
+#if DSP_HAS_ESP_DSP
+    if (backend == Backend::EspDsp) {
+        dsps_biquad_f32(in, out, static_cast<int>(n), coef, w);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        float d = in[i] - coef[3] * w[0] - coef[4] * w[1];
+        out[i] = coef[0] * d + coef[1] * w[0] + coef[2] * w[1];
+        w[1] = w[0];
+        w[0] = d;
+    }
+}
+
+// ===== FFT =====
+
+bool Fft::init(size_t size, Backend backend) {
+    if (size < 4 || size > kMaxFftSize || (size & (size - 1)) != 0) {
+        return false;
+    }
+#if DSP_HAS_ESP_DSP
+    if (backend == Backend::EspDsp) {
+        // 回転因子のテーブルは esp-dsp 側で 1 つだけ持つ
+        static bool tableReady = false;
+#if defined(CONFIG_DSP_MAX_FFT_SIZE)
+        static constexpr int kTableSize = CONFIG_DSP_MAX_FFT_SIZE;
+#else
+        static constexpr int kTableSize = kMaxFftSize;
+#endif
+        if (!tableReady) {
+            if (dsps_fft2r_init_fc32(nullptr, kTableSize) != ESP_OK) {
+                return false;
+            }
+            tableReady = true;
+        }
+    }
+#else
+    if (backend == Backend::EspDsp) {
+        return false;
+    }
+#endif
+    n = size;
+    this->backend = backend;
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        window[i] = 0.5f - 0.5f * std::cos(2.0f * kPi * static_cast<float>(i) / static_cast<float>(n));
+        sum += window[i];
+    }
+    // 片側スペクトルなので 2 倍し、窓の平均値で割って正弦波の振幅に合わせる
+    gain = 2.0f / sum;
+    for (size_t k = 0; k < n / 2; ++k) {
+        float angle = 2.0f * kPi * static_cast<float>(k) / static_cast<float>(n);
+        twiddle[2 * k] = std::cos(angle);
+        twiddle[2 * k + 1] = std::sin(angle);
+    }
+    return true;
+}
+
+void Fft::transformScalar() {
+    // ビット反転の並べ替え
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; (j & bit) != 0; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float re = work[2 * i];
+            float im = work[2 * i + 1];
+            work[2 * i] = work[2 * j];
+            work[2 * i + 1] = work[2 * j + 1];
+            work[2 * j] = re;
+            work[2 * j + 1] = im;
+        }
+    }
+    // 時間間引きのバタフライ
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len / 2;
+        size_t step = n / len;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t k = 0; k < half; ++k) {
+                float wr = twiddle[2 * k * step];
+                float wi = -twiddle[2 * k * step + 1];
+                size_t a = 2 * (i + k);
+                size_t b = 2 * (i + k + half);
+                float xr = work[b] * wr - work[b + 1] * wi;
+                float xi = work[b] * wi + work[b + 1] * wr;
+                work[b] = work[a] - xr;
+                work[b + 1] = work[a + 1] - xi;
+                work[a] += xr;
+                work[a + 1] += xi;
+            }
+        }
+    }
+}
+
+void Fft::magnitude(const float* in, float* out) {
+    for (size_t i = 0; i < n; ++i) {
+        work[2 * i] = in[i] * window[i];
+        work[2 * i + 1] = 0.0f;
+    }
+#if DSP_HAS_ESP_DSP
+    if (backend == Backend::EspDsp) {
+        dsps_fft2r_fc32(work, static_cast<int>(n));
+        dsps_bit_rev_fc32(work, static_cast<int>(n));
+    } else {
+        transformScalar();
+    }
+#else
+    transformScalar();
+#endif
+    for (size_t k = 0; k < n / 2; ++k) {
+        float re = work[2 * k];
+        float im = work[2 * k + 1];
+        out[k] = std::sqrt(re * re + im * im) * (k == 0 ? 0.5f * gain : gain);
+    }
+}
+
+// ===== ベンチマーク =====
+
+static uint32_t perCallNs(uint32_t elapsedTicks, uint32_t calls) {
+    return static_cast<uint32_t>(static_cast<uint64_t>(elapsedTicks) * 1000 / profiler::ticksPerMicrosecond() /
+                                 calls);
+}
+
+bool measure(Backend backend, KernelTimes& out) {
+    static constexpr size_t kSamples = 512;
+    static constexpr size_t kTaps = 32;
+    static constexpr uint32_t kCalls = 16;
+    // ループタスクのスタックを使わないよう static に置く
+    static float input[kSamples];
+    static float output[kSamples];
+    static float coeffs[kTaps];
+    static FirDecimator fir;
+    static Biquad biquad;
+    static Fft fft;
+
+    for (size_t i = 0; i < kSamples; ++i) {
+        input[i] = 0.25f * std::sin(2.0f * kPi * 440.0f * static_cast<float>(i) / 16000.0f);
+    }
+    designLowpass(0.2f, coeffs, kTaps);
+    if (!fir.init(coeffs, kTaps, 2, backend) || !fft.init(kMaxFftSize, backend)) {
+        return false;
+    }
+    biquad.setLowpass(0.1f, 0.7071f);
+    biquad.setBackend(backend);
+
+    uint32_t start = profiler::ticks();
+    for (uint32_t i = 0; i < kCalls; ++i) {
+        fir.process(input, kSamples, output);
+    }
+    out.firNs = perCallNs(profiler::ticks() - start, kCalls);
+
+    start = profiler::ticks();
+    for (uint32_t i = 0; i < kCalls; ++i) {
+        biquad.process(input, output, kSamples);
+    }
+    out.biquadNs = perCallNs(profiler::ticks() - start, kCalls);
+
+    start = profiler::ticks();
+    for (uint32_t i = 0; i < kCalls; ++i) {
+        fft.magnitude(input, output);
+    }
+    out.fftNs = perCallNs(profiler::ticks() - start, kCalls);
+    return true;
+}
+
+// → [espDsp u8][firScalarNs u32][biquadScalarNs u32][fftScalarNs u32]
+//   [firEspDspNs u32][biquadEspDspNs u32][fftEspDspNs u32]（esp-dsp がなければ後半は 0）
+static void cmdBench(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)context;
+    (void)args;
+    (void)len;
+    KernelTimes scalar = {};
+    KernelTimes accelerated = {};
+    measure(Backend::Scalar, scalar);
+    bool hasEspDsp = measure(Backend::EspDsp, accelerated);
+    reply.appendU8(hasEspDsp ? 1 : 0);
+    reply.appendU32(scalar.firNs);
+    reply.appendU32(scalar.biquadNs);
+    reply.appendU32(scalar.fftNs);
+    reply.appendU32(accelerated.firNs);
+    reply.appendU32(accelerated.biquadNs);
+    reply.appendU32(accelerated.fftNs);
+}
+
+void registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_DSP_BENCH, &cmdBench, nullptr);
+}
+
+}  // namespace dsp
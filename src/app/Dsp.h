@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CommandDispatcher.h"
+
+// ESP32-S3 向けに最適化された esp-dsp のカーネルが使えるか
+// （Arduino コアに同梱されていない版もあるので、ヘッダの有無で決める）
+#if defined(ESP_PLATFORM) && defined(__has_include)
+#if __has_include(<esp_dsp.h>)
+#define DSP_HAS_ESP_DSP 1
+#include <esp_dsp.h>
+#endif
+#endif
+#ifndef DSP_HAS_ESP_DSP
+#define DSP_HAS_ESP_DSP 0
+#endif
+
+/**
+ * センサー・音声向けの信号処理カーネル（float、モノラル）
+ * - FirDecimator：FIR ローパス + 間引き
+ * - Biquad      ：2 次 IIR（直接形 II、係数は b0 b1 b2 a1 a2）
+ * - Fft         ：Hann 窓をかけた実信号の振幅スペクトル（基数 2）
+ *
+ * どれも Backend::EspDsp なら esp-dsp（S3 のベクトル命令版）、Backend::Scalar なら
+ * ここにある C++ 実装で計算する。スカラー版はネイティブ環境でも動くので、
+ * ホスト上のテストとベンチマークはこちらを使い、実機では CMD_DSP_BENCH で両者を比べる。
+ * 2 つの実装は同じ式・同じ状態の持ち方にしてあり、結果は丸め誤差の範囲で一致する。
+ */
+
+namespace dsp {
+
+enum class Backend : uint8_t {
+    Scalar = 0,
+    EspDsp = 1,
+};
+
+static constexpr size_t kMaxFirTaps = 64;
+static constexpr size_t kMaxFftSize = 256;
+
+// esp-dsp があればそれ、なければスカラー版
+Backend defaultBackend();
+
+// 窓関数法（Hamming）のローパス FIR 係数。cutoff は入力のサンプリング周波数に対する比（0 < cutoff < 0.5）
+// 係数は対称なので、畳み込みの向き（esp-dsp は古いサンプルから順に掛ける）に依存しない
+void designLowpass(float cutoff, float* coeffs, size_t taps);
+
+class FirDecimator {
+public:
+    // taps は 4 の倍数（S3 版の制約）、decimation は 1 以上
+    bool init(const float* coeffs, size_t taps, size_t decimation, Backend backend);
+    void reset();
+
+    // in[n]（n は decimation の倍数）を in[n / decimation] に間引いて out に書き、出力数を返す
+    size_t process(const float* in, size_t n, float* out);
+
+    size_t decimation() const { return decim; }
+
+private:
+    alignas(16) float coeffs[kMaxFirTaps] = {};
+    alignas(16) float delay[kMaxFirTaps] = {};
+    size_t taps = 0;
+    size_t decim = 1;
+    size_t pos = 0;
+    Backend backend = Backend::Scalar;
+#if DSP_HAS_ESP_DSP
+    fir_f32_t fir = {};
+#endif
+};
+
+class Biquad {
+public:
+    // RBJ の設計式。frequency はサンプリング周波数に対する比
+    void setLowpass(float frequency, float q);
+    void setHighpass(float frequency, float q);
+    void setBackend(Backend backend) { this->backend = backend; }
+    void reset() { w[0] = w[1] = 0.0f; }
+
+    // in と out は同じでもよい
+    void process(const float* in, float* out, size_t n);
+
+private:
+    float coef[5] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    float w[2] = {};
+    Backend backend = Backend::Scalar;
+};
+
+class Fft {
+public:
+    // size は 2 のべき乗で kMaxFftSize 以下
+    bool init(size_t size, Backend backend);
+
+    // in[size] に窓をかけて変換し、out[size / 2] に振幅（正弦波の振幅と同じ単位）を書く
+    void magnitude(const float* in, float* out);
+
+    size_t size() const { return n; }
+
+private:
+    void transformScalar();
+
+    alignas(16) float work[kMaxFftSize * 2];  // 複素数（re, im）の並び
+    float window[kMaxFftSize];
+    float twiddle[kMaxFftSize];               // cos, sin × size / 2
+    float gain = 1.0f;
+    size_t n = 0;
+    Backend backend = Backend::Scalar;
+};
+
+// 各カーネルの 1 回あたりの時間 [ns]（ベンチマーク用の固定の入力で測る）
+// FIR は 512 → 256 サンプル（32 タップ）、IIR は 512 サンプル、FFT は 256 点
+struct KernelTimes {
+    uint32_t firNs;
+    uint32_t biquadNs;
+    uint32_t fftNs;
+};
+
+// backend が使えなければ false
+bool measure(Backend backend, KernelTimes& out);
+
+// CMD_DSP_BENCH を登録する
+void registerCommands(CommandDispatcher& dispatcher);
+
+}  // namespace dsp
@@ -0,0 +1,86 @@
+#include "app/FrameCodec.h"
+
+#include <cstring>
+
+#include "app/HotPath.h"
+#include "app/Wire.h"
+
+namespace frame {
+
+HOT_PATH size_t encodeRecord(uint8_t* out, size_t cap, uint8_t stream, const uint8_t* payload, size_t len) {
+    if (len > kMaxRecordPayload || kRecordHeaderSize + len > cap) {
+        return 0;
+    }
+    out[0] = stream;
+    out[1] = static_cast<uint8_t>(len);
+    std::memcpy(out + kRecordHeaderSize, payload, len);
+    return kRecordHeaderSize + len;
+}
+
+HOT_PATH void PacketBuilder::begin(uint8_t* buffer, size_t capacity, uint16_t seq, uint32_t timestamp) {
+    this->buffer = buffer;
+    this->capacity = capacity;
+    records = 0;
+    if (capacity < kPacketHeaderSize) {
+        size = capacity;  // 何も入らない
+        return;
+    }
+    buffer[0] = kVersion;
+    buffer[1] = 0;
+    wire::putU16(&buffer[2], seq);
+    wire::putU32(&buffer[4], timestamp);
+    size = kPacketHeaderSize;
+}
+
+HOT_PATH bool PacketBuilder::add(uint8_t stream, const uint8_t* payload, size_t len) {
+    if (records == 0xFF) {
+        return false;
+    }
+    size_t n = encodeRecord(buffer + size, capacity - size, stream, payload, len);
+    if (n == 0) {
+        return false;
+    }
+    size += n;
+    ++records;
+    return true;
+}
+
+HOT_PATH size_t PacketBuilder::finish() {
+    if (size >= kPacketHeaderSize) {
+        buffer[1] = records;
+    }
+    return size;
+}
+
+bool PacketReader::begin(const uint8_t* data, size_t len, PacketHeader& header) {
+    if (len < kPacketHeaderSize || data[0] != kVersion) {
+        return false;
+    }
+    header.version = data[0];
+    header.recordCount = data[1];
+    header.seq = wire::getU16(&data[2]);
+    header.timestamp = wire::getU32(&data[4]);
+    this->data = data;
+    size = len;
+    offset = kPacketHeaderSize;
+    remaining = header.recordCount;
+    return true;
+}
+
+bool PacketReader::next(uint8_t& stream, const uint8_t*& payload, uint8_t& len) {
+    if (remaining == 0 || offset + kRecordHeaderSize > size) {
+        return false;
+    }
+    uint8_t n = data[offset + 1];
+    if (offset + kRecordHeaderSize + n > size) {
+        return false;
+    }
+    stream = data[offset];
+    len = n;
+    payload = data + offset + kRecordHeaderSize;
+    offset += kRecordHeaderSize + n;
+    --remaining;
+    return true;
+}
+
+}  // namespace frame
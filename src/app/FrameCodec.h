@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * ストリーム用キャラクタリスティックの Notify パケット形式
+ *
+ *   PacketHeader (8 byte)
+ *     u8  version     (= kVersion)
+ *     u8  recordCount
+ *     u16 seq         パケット通番（セントラル側で欠落検出に使う）
+ *     u32 timestamp   パケット生成時刻 [ms]
+ *   Record × recordCount
+ *     u8  stream      ストリーム番号（StreamId）
+ *     u8  len
+ *     u8  payload[len]
+ *
+ * 1パケットは ATT_MTU - 3 バイトに収まるように複数レコードを詰める。
+ */
+namespace frame {
+
+constexpr uint8_t kVersion = 1;
+constexpr size_t kPacketHeaderSize = 8;
+constexpr size_t kRecordHeaderSize = 2;
+constexpr size_t kMaxRecordPayload = 255;
+
+// Notify の ATT ヘッダ（opcode + handle）
+constexpr size_t kAttHeaderSize = 3;
+constexpr uint16_t kDefaultMtu = 23;
+constexpr size_t kMaxPacketSize = 512 - kAttHeaderSize;
+
+// MTU から 1 パケットの最大サイズを求める
+inline size_t packetCapacity(uint16_t mtu) {
+    size_t cap = mtu > kAttHeaderSize ? mtu - kAttHeaderSize : 0;
+    return cap < kMaxPacketSize ? cap : kMaxPacketSize;
+}
+
+struct PacketHeader {
+    uint8_t version;
+    uint8_t recordCount;
+    uint16_t seq;
+    uint32_t timestamp;
+};
+
+// 1レコード分を out に書く。書いたバイト数（入らなければ 0）を返す
+size_t encodeRecord(uint8_t* out, size_t cap, uint8_t stream, const uint8_t* payload, size_t len);
+
+// レコードを 1 パケットに詰めていく
+class PacketBuilder {
+public:
+    void begin(uint8_t* buffer, size_t capacity, uint16_t seq, uint32_t timestamp);
+
+    // 入らなければ false（パケットはそのまま）
+    bool add(uint8_t stream, const uint8_t* payload, size_t len);
+
+    // ヘッダのレコード数を確定してパケット長を返す
+    size_t finish();
+
+    bool fits(size_t payloadLen) const { return kRecordHeaderSize + payloadLen <= capacity - size; }
+    uint8_t count() const { return records; }
+    size_t length() const { return size; }
+
+private:
+    uint8_t* buffer = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;
+    uint8_t records = 0;
+};
+
+// 受信側（セントラル・シミュレータ・ツール）用のパケット読み出し
+class PacketReader {
+public:
+    bool begin(const uint8_t* data, size_t len, PacketHeader& header);
+    bool next(uint8_t& stream, const uint8_t*& payload, uint8_t& len);
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    uint8_t remaining = 0;
+};
+
+}  // namespace frame
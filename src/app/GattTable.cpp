@@ -0,0 +1,31 @@
+#include "app/GattTable.h"
+
+#include "app/Wire.h"
+
+namespace gatt {
+
+// FNV-1a（64 bit）を 2 つの初期値で回して 16 byte にする
+static void mix(uint64_t* state, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        for (size_t h = 0; h < 2; ++h) {
+            state[h] = (state[h] ^ data[i]) * 0x100000001B3ull;
+        }
+    }
+}
+
+void databaseHash(const RuntimeConfig& config, uint8_t* out) {
+    uint64_t state[2] = {0xCBF29CE484222325ull, 0x84222325CBF29CE4ull};
+    uint8_t handles[2];
+    wire::putU16(handles, serviceHandleCount());
+    mix(state, handles, sizeof(handles));
+    mix(state, config.uuid(CONFIG_SERVICE_UUID).bytes, 16);
+    for (const CharDef& def : kChars) {
+        mix(state, config.uuid(def.field).bytes, 16);
+        mix(state, &def.properties, 1);
+    }
+    mix(state, kDatabaseHashUuid.bytes, 16);
+    wire::putU64(out, state[0]);
+    wire::putU64(out + 8, state[1]);
+}
+
+}  // namespace gatt
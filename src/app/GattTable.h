@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/CharPayloads.h"
+#include "app/FrameCodec.h"
+#include "app/RuntimeConfig.h"
+#include "hal/BlePeripheral.h"
+
+/**
+ * GATT データベースの宣言（サービスとキャラクタリスティックはここにだけ書く）
+ * - UUID の既定値（AppConfig.h の文字列）はコンパイル時に 16 byte にする。書き間違いはコンパイルエラー
+ *   起動時は文字列を解析しない（設定で上書きした UUID も 16 byte のまま持つ）
+ * - BleApp::initBLE() はこの表の順に登録する。サービスの属性ハンドルの数も表から数える
+ * - maxLength は値の最大バイト数。値を作る側はこれを超えないことをコンパイル時に確かめる
+ * - 表の後に Database Hash（0x2B2A）を置く。セントラルは接続したら（探索せずに）Read By Type で読み、
+ *   キャッシュした値と同じなら探索を省ける。値は databaseHash() で、実際に登録する UUID・プロパティ・
+ *   ハンドルの並びから作る（Bluetooth の仕様の AES-CMAC ではないが、セントラルは値が変わったかしか見ない）
+ */
+
+namespace gatt {
+
+// キャラクタリスティックの役割（BleApp が持つ CharId の並び）
+enum CharRole : uint8_t {
+    CHAR_DATA = 0,     // "ping n"（Read / Write / Notify）
+    CHAR_STREAM = 1,   // ストリームのパケット（Notify）
+    CHAR_COMMAND = 2,  // コマンドと応答（Write / Write NR / Notify）
+    CHAR_STATS = 3,    // StatsPayload（Read）
+    kCharCount = 4,
+};
+
+struct CharDef {
+    CharRole role;
+    ConfigField field;  // UUID を上書きする設定
+    hal::Uuid defaultUuid;
+    uint8_t properties;
+    uint16_t maxLength;
+};
+
+constexpr hal::Uuid kServiceUuid = hal::uuid(SERVICE_UUID);
+
+constexpr CharDef kChars[kCharCount] = {
+    {CHAR_DATA, CONFIG_DATA_UUID, hal::uuid(CHARACTERISTIC_UUID),
+     hal::PROP_READ | hal::PROP_WRITE | hal::PROP_NOTIFY, 32},
+    {CHAR_STREAM, CONFIG_STREAM_UUID, hal::uuid(STREAM_CHAR_UUID), hal::PROP_NOTIFY, frame::kMaxPacketSize},
+    {CHAR_COMMAND, CONFIG_COMMAND_UUID, hal::uuid(COMMAND_CHAR_UUID),
+     hal::PROP_WRITE | hal::PROP_WRITE_NR | hal::PROP_NOTIFY, frame::kMaxPacketSize},
+    {CHAR_STATS, CONFIG_STATS_UUID, hal::uuid(STATS_CHAR_UUID), hal::PROP_READ, sizeof(StatsPayload)},
+};
+
+// Database Hash（Read のみ。値は 16 byte）
+constexpr hal::Uuid kDatabaseHashUuid = hal::uuid("00002B2A-0000-1000-8000-00805F9B34FB");
+constexpr size_t kDatabaseHashSize = 16;
+
+// サービス宣言 1 + キャラクタリスティックごとに宣言と値の 2（Notify・Indicate なら CCCD で +1）+ Database Hash 2
+constexpr uint16_t serviceHandleCount() {
+    uint16_t count = 1 + 2;
+    for (const CharDef& def : kChars) {
+        count += (def.properties & (hal::PROP_NOTIFY | hal::PROP_INDICATE)) != 0 ? 3 : 2;
+    }
+    return count;
+}
+
+constexpr bool rolesInOrder() {
+    for (size_t i = 0; i < kCharCount; ++i) {
+        if (kChars[i].role != i || kChars[i].field != CONFIG_DATA_UUID + i || kChars[i].maxLength > 512) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(rolesInOrder(), "kChars must be listed in CharRole / ConfigField order, values up to 512 bytes");
+static_assert(kChars[CHAR_STATS].maxLength == sizeof(StatsPayload), "stats characteristic holds a StatsPayload");
+
+// いまの設定で登録する GATT データベースのハッシュ（UUID かプロパティかハンドルの並びが変われば変わる）
+void databaseHash(const RuntimeConfig& config, uint8_t* out);
+
+}  // namespace gatt
@@ -0,0 +1,29 @@
+#pragma once
+
+/**
+ * ホットパスの関数を IRAM に置く（実機のみ）
+ * - フラッシュ上のコードは命令キャッシュを通して実行されるので、キャッシュミス（フラッシュからの読み込み）が
+ *   Notify と受信処理の所要時間のばらつきになる。HOT_PATH を付けた関数は IRAM に置き、ミスが起きない
+ * - 付けるのは、毎 loop()・毎パケット・毎書き込みで通る短い関数だけ（IRAM は小さい）
+ *     ペーシングと送信  NotifyScheduler::enqueue / tick / readyForNewPacket / buildPacket / send
+ *     エンコーダ        frame::encodeRecord / PacketBuilder
+ *     受信と振り分け    BleApp::onWrite（BLE タスク）/ Reassembler::feed / CommandDispatcher::dispatch
+ *   RecordRing の push / pop などは HOT_INLINE（always_inline）で呼び出し元に必ず展開させ、上の関数と一緒に
+ *   IRAM に入れる（ただの inline だと -Os で展開されなかった分がフラッシュの COMDAT に置かれる）
+ * - 呼び出し先がフラッシュにあれば（BLE スタック・コマンドのハンドラなど）、その分のミスは残る
+ * - APP_HOT_IRAM=0 で外す（CMD_GET_PROFILE の ZONE_SCHED_TICK・ZONE_RX_DISPATCH で比べる）
+ *   ネイティブ環境では何もしない
+ */
+
+#ifndef APP_HOT_IRAM
+#define APP_HOT_IRAM 1
+#endif
+
+#if APP_HOT_IRAM && defined(ARDUINO_ARCH_ESP32)
+#include <esp_attr.h>
+#define HOT_PATH IRAM_ATTR
+#define HOT_INLINE inline __attribute__((always_inline))
+#else
+#define HOT_PATH
+#define HOT_INLINE inline
+#endif
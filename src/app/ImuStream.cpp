@@ -0,0 +1,316 @@
+#include "app/ImuStream.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "app/DeltaCodec.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+#include "diag/Profiler.h"
+
+// 1 回の poll() で readFifo() を呼ぶ上限（FIFO を読み切れなくても loop() を止めない）
+static constexpr int kMaxReadsPerPoll = 8;
+
+bool ImuStream::start(const hal::ImuConfig& config, ImuEncoding encoding) {
+    stop();
+    if (imu == nullptr || config.rateHz == 0 || 1000000u / config.rateHz > 0xFFFF) {
+        return false;
+    }
+    if (busInUse != nullptr && busInUse(busContext)) {
+        return false;
+    }
+    if (!imu->start(config)) {
+        return false;
+    }
+    current = config;
+    this->encoding = encoding;
+    havePrevious = false;
+    encodeTicks = 0;
+    samplesEncoded = 0;
+    period = static_cast<uint16_t>(1000000u / config.rateHz);
+    nextIndex = 0;
+    anchorIndex = 0;
+    anchorUs = clock.micros() + period;
+    counters = {};
+    overrunBase = 0;
+    paused = false;
+    running = true;
+    return true;
+}
+
+void ImuStream::stop() {
+    if (running) {
+        if (!paused) {
+            imu->stop();
+        }
+        running = false;
+        paused = false;
+    }
+}
+
+void ImuStream::setPaused(bool value) {
+    if (!running || value == paused) {
+        return;
+    }
+    if (value) {
+        overrunBase += imu->fifoOverruns();
+        imu->stop();
+        pausedUs = clock.micros();
+        paused = true;
+        return;
+    }
+    paused = false;
+    if (!imu->start(current)) {
+        running = false;
+        return;
+    }
+    // 休んでいた間にセンサが出したはずのサンプルの分だけ通番を進める（セントラルからは欠落に見える）
+    uint32_t now = clock.micros();
+    nextIndex += (now - pausedUs) / period;
+    anchorIndex = nextIndex;
+    anchorUs = now + period;
+    havePrevious = false;  // 差分の連鎖が切れるので、次はキーフレームから
+}
+
+size_t ImuStream::samplesPerRecord(size_t packetCapacity) {
+    size_t overhead = frame::kPacketHeaderSize + frame::kRecordHeaderSize + kRecordHeaderSize;
+    if (packetCapacity <= overhead) {
+        return 0;
+    }
+    size_t n = (packetCapacity - overhead) / kSampleSize;
+    return n < kMaxSamplesPerRecord ? n : kMaxSamplesPerRecord;
+}
+
+size_t ImuStream::deltaRecordBudget(size_t packetCapacity) {
+    size_t overhead = frame::kPacketHeaderSize + frame::kRecordHeaderSize;
+    if (packetCapacity <= overhead + kDeltaHeaderSize + delta::maxSampleSize(kChannels)) {
+        return 0;
+    }
+    size_t n = packetCapacity - overhead;
+    return n < frame::kMaxRecordPayload ? n : frame::kMaxRecordPayload;
+}
+
+size_t ImuStream::encodeRecord(uint32_t firstIndex, uint32_t timestampUs, uint16_t periodUs,
+                               const hal::ImuSample* samples, size_t count, uint8_t* out) {
+    wire::putU32(out, firstIndex);
+    wire::putU32(out + 4, timestampUs);
+    wire::putU16(out + 8, periodUs);
+    out[10] = static_cast<uint8_t>(count);
+    uint8_t* p = out + kRecordHeaderSize;
+    for (size_t i = 0; i < count; ++i) {
+        const hal::ImuSample& s = samples[i];
+        wire::putU16(p + 0, static_cast<uint16_t>(s.ax));
+        wire::putU16(p + 2, static_cast<uint16_t>(s.ay));
+        wire::putU16(p + 4, static_cast<uint16_t>(s.az));
+        wire::putU16(p + 6, static_cast<uint16_t>(s.gx));
+        wire::putU16(p + 8, static_cast<uint16_t>(s.gy));
+        wire::putU16(p + 10, static_cast<uint16_t>(s.gz));
+        p += kSampleSize;
+    }
+    return kRecordHeaderSize + count * kSampleSize;
+}
+
+void ImuStream::poll(size_t packetCapacity) {
+    if (!running || paused) {
+        return;
+    }
+    size_t perRecord = samplesPerRecord(packetCapacity);
+    uint32_t backlog = 0;
+    bool drained = false;
+
+    for (int i = 0; i < kMaxReadsPerPoll; ++i) {
+        size_t n = imu->readFifo(batch, IMU_READ_BATCH);
+        if (n > 0) {
+            counters.samplesRead += static_cast<uint32_t>(n);
+            backlog += static_cast<uint32_t>(n);
+            if (sink != nullptr) {
+                sink->onImuSamples(nextIndex, timestampOf(nextIndex), batch, n);
+            }
+            uint8_t stream = encoding == ImuEncoding::Delta ? STREAM_IMU_DELTA : STREAM_IMU;
+            if (raw && !admit(stream, batch, n)) {
+                counters.samplesSuppressed += static_cast<uint32_t>(n);
+                nextIndex += static_cast<uint32_t>(n);
+                havePrevious = false;  // 差分の連鎖が切れるので、次はキーフレームから
+            } else if (raw && encoding == ImuEncoding::Delta) {
+                publishDelta(batch, n, deltaRecordBudget(packetCapacity));
+            } else if (raw) {
+                publishBatch(batch, n, perRecord);
+            } else {
+                nextIndex += static_cast<uint32_t>(n);
+            }
+        }
+        if (n < IMU_READ_BATCH) {
+            drained = true;
+            break;
+        }
+    }
+    counters.fifoOverruns = overrunBase + imu->fifoOverruns();
+    if (backlog > counters.maxBacklog) {
+        counters.maxBacklog = backlog;
+    }
+
+    // FIFO を読み切った時点の時刻 ≒ 最後のサンプルの時刻として外挿の起点を補正する
+    if (drained && backlog > 0) {
+        uint32_t last = nextIndex - 1;
+        int32_t error = static_cast<int32_t>(clock.micros() - timestampOf(last));
+        int32_t limit = 4 * static_cast<int32_t>(period);
+        if (error > limit || error < -limit) {
+            anchorIndex = last;
+            anchorUs = clock.micros();
+        } else {
+            anchorUs += error / 8;
+        }
+    }
+}
+
+// | |加速度| - 1 g | の最大値 [g] をトリガーのレベルにする
+bool ImuStream::admit(uint8_t stream, const hal::ImuSample* samples, size_t count) const {
+    if (triggers == nullptr || !triggers->gated(stream)) {
+        return true;
+    }
+    float lsbPerG = 32768.0f / static_cast<float>(current.accelRangeG);
+    float maxSq = 0.0f;
+    float minSq = 1e30f;
+    for (size_t i = 0; i < count; ++i) {
+        float ax = samples[i].ax;
+        float ay = samples[i].ay;
+        float az = samples[i].az;
+        float sq = ax * ax + ay * ay + az * az;
+        maxSq = sq > maxSq ? sq : maxSq;
+        minSq = sq < minSq ? sq : minSq;
+    }
+    // 平方根は最大と最小の 2 回だけ
+    float high = std::sqrt(maxSq) / lsbPerG - 1.0f;
+    float low = 1.0f - std::sqrt(minSq) / lsbPerG;
+    return triggers->admit(stream, high > low ? high : low);
+}
+
+void ImuStream::publishBatch(const hal::ImuSample* samples, size_t count, size_t perRecord) {
+    if (perRecord == 0) {
+        counters.samplesDropped += static_cast<uint32_t>(count);
+        nextIndex += static_cast<uint32_t>(count);
+        return;
+    }
+    uint8_t record[kRecordHeaderSize + kMaxSamplesPerRecord * kSampleSize];
+    while (count > 0) {
+        size_t n = count < perRecord ? count : perRecord;
+        size_t len = encodeRecord(nextIndex, timestampOf(nextIndex), period, samples, n, record);
+        if (scheduler.enqueue(STREAM_IMU, record, len)) {
+            counters.samplesSent += static_cast<uint32_t>(n);
+            ++counters.records;
+            counters.rawBytes += static_cast<uint32_t>(len);
+            counters.encodedBytes += static_cast<uint32_t>(len);
+        } else {
+            counters.samplesDropped += static_cast<uint32_t>(n);
+        }
+        nextIndex += static_cast<uint32_t>(n);
+        samples += n;
+        count -= n;
+    }
+}
+
+static void toChannels(const hal::ImuSample& s, int32_t* out) {
+    out[0] = s.ax;
+    out[1] = s.ay;
+    out[2] = s.az;
+    out[3] = s.gx;
+    out[4] = s.gy;
+    out[5] = s.gz;
+}
+
+void ImuStream::publishDelta(const hal::ImuSample* samples, size_t count, size_t budget) {
+    if (budget == 0) {
+        counters.samplesDropped += static_cast<uint32_t>(count);
+        nextIndex += static_cast<uint32_t>(count);
+        havePrevious = false;
+        return;
+    }
+    uint8_t record[frame::kMaxRecordPayload];
+    while (count > 0) {
+        bool keyframe = !havePrevious || recordsSinceKeyframe >= IMU_KEYFRAME_INTERVAL;
+        int32_t prev[kChannels];
+        std::memcpy(prev, previous, sizeof(prev));
+
+        // 予算に収まるところまで詰める（収まらなかったサンプルは次のレコードの先頭になる）
+        uint32_t begin = profiler::ticks();
+        size_t pos = kDeltaHeaderSize;
+        size_t n = 0;
+        while (n < count && n < 0xFF) {
+            int32_t values[kChannels];
+            uint8_t encoded[delta::maxSampleSize(kChannels)];
+            toChannels(samples[n], values);
+            size_t len = delta::encodeSample(n == 0 && keyframe ? nullptr : prev, values, kChannels, encoded);
+            if (pos + len > budget) {
+                break;
+            }
+            std::memcpy(record + pos, encoded, len);
+            std::memcpy(prev, values, sizeof(prev));
+            pos += len;
+            ++n;
+        }
+        wire::putU32(record, nextIndex);
+        wire::putU32(record + 4, timestampOf(nextIndex));
+        wire::putU16(record + 8, period);
+        record[10] = static_cast<uint8_t>(n);
+        record[11] = keyframe ? kFlagKeyframe : 0;
+        encodeTicks += profiler::ticks() - begin;
+        samplesEncoded += static_cast<uint32_t>(n);
+
+        if (scheduler.enqueue(STREAM_IMU_DELTA, record, pos)) {
+            std::memcpy(previous, prev, sizeof(previous));
+            havePrevious = true;
+            recordsSinceKeyframe = keyframe ? 1 : recordsSinceKeyframe + 1;
+            counters.samplesSent += static_cast<uint32_t>(n);
+            ++counters.records;
+            counters.rawBytes += static_cast<uint32_t>(kRecordHeaderSize + n * kSampleSize);
+            counters.encodedBytes += static_cast<uint32_t>(pos);
+        } else {
+            // 差分の連鎖が切れるので、次はキーフレームから
+            counters.samplesDropped += static_cast<uint32_t>(n);
+            havePrevious = false;
+        }
+        nextIndex += static_cast<uint32_t>(n);
+        samples += n;
+        count -= n;
+    }
+    counters.encodeNsPerSample = samplesEncoded > 0
+                                     ? static_cast<uint32_t>(encodeTicks * 1000 / profiler::ticksPerMicrosecond() /
+                                                             samplesEncoded)
+                                     : 0;
+}
+
+void ImuStream::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_IMU_START, &ImuStream::cmdStart, this);
+    dispatcher.registerHandler(CMD_IMU_STOP, &ImuStream::cmdStop, this);
+}
+
+void ImuStream::cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    ImuStream* self = static_cast<ImuStream*>(context);
+    if ((len != 5 && len != 6) || (len == 6 && args[5] > static_cast<uint8_t>(ImuEncoding::Delta))) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    hal::ImuConfig config;
+    config.rateHz = wire::getU16(args);
+    config.accelRangeG = args[2];
+    config.gyroRangeDps = wire::getU16(args + 3);
+    ImuEncoding encoding = len == 6 ? static_cast<ImuEncoding>(args[5]) : ImuEncoding::Raw;
+    if (!self->start(config, encoding)) {
+        reply.status = CommandStatus::Failed;
+        return;
+    }
+    reply.appendU16(self->period);
+}
+
+void ImuStream::cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    ImuStream* self = static_cast<ImuStream*>(context);
+    self->stop();
+    reply.appendU32(self->counters.samplesRead);
+    reply.appendU32(self->counters.samplesDropped);
+    reply.appendU32(self->counters.fifoOverruns);
+    reply.appendU32(self->counters.rawBytes);
+    reply.appendU32(self->counters.encodedBytes);
+    reply.appendU32(self->counters.encodeNsPerSample);
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/NotifyScheduler.h"
+#include "app/TriggerTable.h"
+#include "hal/Clock.h"
+#include "hal/Imu.h"
+
+/**
+ * IMU のハードウェア FIFO をまとめて読み出し、STREAM_IMU のレコードにしてストリームに流す
+ *
+ * レコード（リトルエンディアン）
+ *   u32 firstIndex   先頭サンプルの通番（start() から数える。セントラル側で欠落検出に使う）
+ *   u32 timestampUs  先頭サンプルの推定時刻
+ *   u16 periodUs     サンプル間隔
+ *   u8  count
+ *   i16 ax ay az gx gy gz × count
+ *
+ * 差分符号化（ImuEncoding::Delta）では STREAM_IMU_DELTA に次の形式で流す
+ *   u32 firstIndex, u32 timestampUs, u16 periodUs, u8 count（ここまで同じ）
+ *   u8  flags        bit0: キーフレーム（先頭サンプルが差分でなく値そのもの）
+ *   ax ay az gx gy gz × count を delta::encodeSample() で（app/DeltaCodec.h）
+ * 差分はレコードをまたいで続き、IMU_KEYFRAME_INTERVAL レコードごと（と送信リングが満杯で
+ * レコードを捨てた直後）にキーフレームを入れる。セントラルは firstIndex が飛んだら
+ * 次のキーフレームまでレコードを捨てればよい。
+ *
+ * 1 レコードは 1 パケットに収まる数だけ詰める（MTU 247 なら 18 サンプル）。
+ * 時刻は start() を起点にサンプル通番から periodUs 刻みで外挿し、FIFO を読み切ったときの時刻で
+ * 少しずつ補正する（センサの発振器と CPU の時計のずれを吸収する。誤差は 1 周期程度）。
+ *
+ * setSink() したシンク（OrientationStream など）には、読み出したサンプルをすべて（送信リングが
+ * 満杯で捨てたものも）渡す。raw = false にすると STREAM_IMU のレコードは積まない。
+ *
+ * setTriggers() でトリガーを付けると、FIFO から 1 回に読んだサンプルごとに送るかどうかを決める
+ * （送らないサンプルは符号化しない。samplesSuppressed に数える）。
+ *
+ * poll() は loop() から呼ぶこと（NotifyScheduler と同じタスク）。
+ */
+
+enum class ImuEncoding : uint8_t {
+    Raw = 0,    // STREAM_IMU（i16 × 6 そのまま）
+    Delta = 1,  // STREAM_IMU_DELTA（差分 + zigzag varint）
+};
+
+struct ImuStreamStats {
+    uint32_t samplesRead;
+    uint32_t samplesSent;
+    uint32_t samplesDropped;  // 送信リング満杯・MTU 不足で捨てたサンプル
+    uint32_t samplesSuppressed;  // トリガーの条件を満たさず送らなかったサンプル
+    uint32_t records;
+    uint32_t fifoOverruns;    // センサ側 FIFO のあふれ（読み出しが間に合わなかった）
+    uint32_t maxBacklog;      // 1 回の poll() で読んだサンプル数の最大値
+    uint32_t rawBytes;        // 送ったレコードを STREAM_IMU の形式で送った場合のバイト数
+    uint32_t encodedBytes;    // 実際に送ったレコードのバイト数（rawBytes / encodedBytes が圧縮率）
+    uint32_t encodeNsPerSample;  // レコードの符号化にかかった 1 サンプルあたりの時間の平均
+};
+
+// ImuStream が FIFO から読み出したサンプルを受け取る
+class ImuSampleSink {
+public:
+    virtual ~ImuSampleSink() = default;
+
+    // firstIndex は先頭サンプルの通番（start() で 0 に戻る）、firstUs はその推定時刻
+    virtual void onImuSamples(uint32_t firstIndex, uint32_t firstUs, const hal::ImuSample* samples,
+                              size_t count) = 0;
+};
+
+class ImuStream {
+public:
+    static constexpr size_t kRecordHeaderSize = 11;
+    static constexpr size_t kSampleSize = 12;
+    static constexpr size_t kMaxSamplesPerRecord = (frame::kMaxRecordPayload - kRecordHeaderSize) / kSampleSize;
+    static constexpr size_t kDeltaHeaderSize = 12;
+    static constexpr size_t kChannels = 6;
+    static constexpr uint8_t kFlagKeyframe = 0x01;
+
+    ImuStream(hal::Clock& clock, NotifyScheduler& scheduler) : clock(clock), scheduler(scheduler) {}
+
+    void setImu(hal::Imu* imu) { this->imu = imu; }
+    // inUse(context) が true の間（IMU のバスを他のドライバが使っている）は start() を断る
+    void setBusGuard(bool (*inUse)(void* context), void* context) {
+        busInUse = inUse;
+        busContext = context;
+    }
+
+    // IMU がない・設定を受け付けなければ false
+    bool start(const hal::ImuConfig& config, ImuEncoding encoding = ImuEncoding::Raw);
+    void stop();
+    bool isRunning() const { return running; }
+    // 動かしたまま休ませる（ストリームを誰も受け取らない間）。休んでいる間はセンサを止めて FIFO を読まない。
+    // 再開したら FIFO を空にして始め直し、休んでいた時間の分だけ通番を進めて時刻の起点を合わせ直す
+    // （古いサンプルに外挿した時刻を付けて送らない）
+    void setPaused(bool paused);
+    bool isPaused() const { return paused; }
+    uint16_t periodUs() const { return period; }
+    const hal::ImuConfig& config() const { return current; }
+
+    // サンプルの受け取り先と、STREAM_IMU に生のサンプルを流すかどうか
+    void setSink(ImuSampleSink* sink, bool raw) {
+        this->sink = sink;
+        this->raw = raw;
+    }
+
+    void setTriggers(TriggerTable* triggers) { this->triggers = triggers; }
+
+    // FIFO を読み切ってレコードを積む。packetCapacity は現在の MTU でのパケット最大長
+    void poll(size_t packetCapacity);
+
+    // CMD_IMU_START / CMD_IMU_STOP を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    const ImuStreamStats& stats() const { return counters; }
+
+    // packetCapacity のパケット 1 つに入るサンプル数（0 なら MTU が小さすぎる）
+    static size_t samplesPerRecord(size_t packetCapacity);
+    // 差分符号化のレコード 1 つに使えるバイト数（ヘッダ込み。0 なら MTU が小さすぎる）
+    static size_t deltaRecordBudget(size_t packetCapacity);
+
+    // レコードを out に書き、その長さを返す（out は kRecordHeaderSize + count * kSampleSize 以上）
+    static size_t encodeRecord(uint32_t firstIndex, uint32_t timestampUs, uint16_t periodUs,
+                               const hal::ImuSample* samples, size_t count, uint8_t* out);
+
+private:
+    void publishBatch(const hal::ImuSample* samples, size_t count, size_t perRecord);
+    void publishDelta(const hal::ImuSample* samples, size_t count, size_t budget);
+    bool admit(uint8_t stream, const hal::ImuSample* samples, size_t count) const;
+    uint32_t timestampOf(uint32_t index) const { return anchorUs + (index - anchorIndex) * period; }
+
+    static void cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    NotifyScheduler& scheduler;
+    hal::Imu* imu = nullptr;
+    bool (*busInUse)(void* context) = nullptr;
+    void* busContext = nullptr;
+
+    ImuSampleSink* sink = nullptr;
+    TriggerTable* triggers = nullptr;
+    bool raw = true;
+
+    bool running = false;
+    bool paused = false;
+    uint32_t pausedUs = 0;
+    uint32_t overrunBase = 0;  // 始め直す前までの fifoOverruns()
+    hal::ImuConfig current = {};
+    ImuEncoding encoding = ImuEncoding::Raw;
+    uint16_t period = 0;
+    uint32_t nextIndex = 0;
+    uint32_t anchorIndex = 0;
+    uint32_t anchorUs = 0;
+
+    // 差分符号化の状態（最後に送ったサンプル）
+    int32_t previous[kChannels] = {};
+    bool havePrevious = false;
+    uint32_t recordsSinceKeyframe = 0;
+    uint64_t encodeTicks = 0;
+    uint32_t samplesEncoded = 0;
+
+    hal::ImuSample batch[IMU_READ_BATCH];
+    ImuStreamStats counters = {};
+};
@@ -0,0 +1,326 @@
+#include "app/NotifyScheduler.h"
+
+#include <cstring>
+
+#include "app/Backlog.h"
+#include "app/HotPath.h"
+#include "app/RecordLog.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+#include "diag/Profiler.h"
+#include "diag/Timeline.h"
+
+NotifyScheduler::NotifyScheduler(hal::Clock& clock, hal::BlePeripheral& ble) : clock(clock), ble(ble) {
+    for (auto& slot : history) {
+        slot.seq = 0;
+        slot.length = 0;
+        slot.urgentRecords = 0;
+    }
+}
+
+HOT_PATH bool NotifyScheduler::enqueue(uint8_t stream, const uint8_t* data, size_t len) {
+    if (recorder != nullptr) {
+        recorder->capture(stream, data, len);
+    }
+    if (suspended && !offline) {
+        ++suspendedCount;
+        return true;
+    }
+    bool wasEmpty = ring.empty();
+    bool accepted = offline && backlog != nullptr ? backlog->store(stream, data, len)
+                                                  : len <= frame::kMaxRecordPayload && ring.push(stream, data, len);
+    if (!accepted) {
+        ++counters.recordsDropped;
+        if (runtimeStats != nullptr) {
+            runtimeStats->recordDrop();
+        }
+        return false;
+    }
+    if (wasEmpty && !offline) {
+        firstPendingMs = clock.millis();
+    }
+    ++counters.recordsQueued;
+    return true;
+}
+
+bool NotifyScheduler::enqueueUrgent(uint8_t stream, const uint8_t* data, size_t len) {
+    if (recorder != nullptr) {
+        recorder->capture(stream, data, len);
+    }
+    if (suspended) {
+        ++suspendedCount;
+        return true;
+    }
+    if (len > frame::kMaxRecordPayload || !urgentRing.push(stream, data, len)) {
+        ++counters.recordsDropped;
+        if (runtimeStats != nullptr) {
+            runtimeStats->recordDrop();
+        }
+        return false;
+    }
+    ++urgentQueuedCount;
+    return true;
+}
+
+void NotifyScheduler::setOffline(bool value) {
+    if (value && !offline && backlog != nullptr) {
+        // 再生中だったレコードは、次の接続で ACK された seq の次から送り直すので捨てる
+        uint8_t record[frame::kMaxRecordPayload];
+        uint8_t stream = 0;
+        int len;
+        while ((len = ring.pop(stream, record, sizeof(record))) >= 0) {
+            ++dequeued;
+            if (stream != STREAM_BACKLOG && !backlog->store(stream, record, static_cast<size_t>(len))) {
+                ++counters.recordsDropped;
+            }
+        }
+    }
+    offline = value;
+}
+
+void NotifyScheduler::setSuspended(bool value) {
+    if (value && !suspended) {
+        ring.clear();
+        urgentRing.clear();
+        stalled = nullptr;
+        retransmitCount = 0;
+    }
+    suspended = value;
+}
+
+size_t NotifyScheduler::discardQueued(uint8_t stream, const uint8_t* prefix, size_t prefixLen) {
+    // 今あるレコードを 1 周だけ取り出し、残すものを末尾に積み直す（取り出した分の空きがあるので必ず積める）
+    size_t remaining = ring.used();
+    size_t discarded = 0;
+    uint8_t record[frame::kMaxRecordPayload];
+    uint8_t tag = 0;
+    int len;
+    while (remaining > 0 && (len = ring.pop(tag, record, sizeof(record))) >= 0) {
+        remaining -= RecordRing<TX_RING_SIZE>::kHeaderSize + static_cast<size_t>(len);
+        if (tag == stream && static_cast<size_t>(len) >= prefixLen && std::memcmp(record, prefix, prefixLen) == 0) {
+            ++dequeued;
+            ++discarded;
+            ++counters.recordsDropped;
+            if (runtimeStats != nullptr) {
+                runtimeStats->recordDrop();
+            }
+            continue;
+        }
+        ring.push(tag, record, static_cast<size_t>(len));
+    }
+    return discarded;
+}
+
+void NotifyScheduler::tickUrgent() {
+    if (streamChar == hal::kInvalidId || suspended) {
+        return;
+    }
+    uint8_t budget = policy.maxPacketsPerTick;
+    sendUrgent(budget);
+}
+
+// 拒否されていたパケットと優先レーンを送る。リンクが詰まっていたら false
+bool NotifyScheduler::sendUrgent(uint8_t& budget) {
+    // 前回拒否されたパケットを先に送る（順序を崩さない）
+    if (stalled != nullptr) {
+        if (!send(*stalled)) {
+            ++counters.notifyRetries;
+            return false;
+        }
+        urgentSentCount += stalled->urgentRecords;
+        stalled = nullptr;
+        --budget;
+    }
+
+    // 優先レーン（ペーシング・保留時間は見ない）
+    size_t capacity = frame::packetCapacity(ble.mtu());
+    while (budget > 0 && !urgentRing.empty()) {
+        HistorySlot* slot = buildPacket(urgentRing, capacity, true);
+        if (slot == nullptr) {
+            continue;
+        }
+        ++counters.urgentPackets;
+        if (!send(*slot)) {
+            stalled = slot;
+            ++counters.notifyRetries;
+            return false;
+        }
+        urgentSentCount += slot->urgentRecords;
+        --budget;
+    }
+    return true;
+}
+
+HOT_PATH void NotifyScheduler::tick() {
+    PROFILE_ZONE(ZONE_SCHED_TICK);
+    if (streamChar == hal::kInvalidId || suspended) {
+        return;
+    }
+    uint8_t budget = policy.maxPacketsPerTick;
+    if (!sendUrgent(budget)) {
+        return;
+    }
+
+    // セントラルから要求された再送
+    while (budget > 0 && retransmitCount > 0) {
+        HistorySlot* slot = findHistory(retransmitQueue[retransmitHead]);
+        if (slot != nullptr) {
+            if (!send(*slot)) {
+                return;
+            }
+            ++counters.retransmits;
+            --budget;
+        } else {
+            ++counters.retransmitMisses;
+        }
+        retransmitHead = (retransmitHead + 1) % kRetransmitQueue;
+        --retransmitCount;
+    }
+
+    // 新しいパケット
+    size_t capacity = frame::packetCapacity(ble.mtu());
+    while (budget > 0 && readyForNewPacket(capacity)) {
+        HistorySlot* slot = buildPacket(ring, capacity, false);
+        if (slot == nullptr) {
+            continue;
+        }
+        if (!send(*slot)) {
+            stalled = slot;
+            ++counters.notifyRetries;
+            return;
+        }
+        --budget;
+    }
+}
+
+size_t NotifyScheduler::usableCapacity() const {
+    size_t capacity = frame::packetCapacity(ble.mtu());
+    size_t tag = clockSync != nullptr && clockSync->synced() ? frame::kRecordHeaderSize + ClockSync::kTagSize : 0;
+    return capacity > tag ? capacity - tag : 0;
+}
+
+HOT_PATH bool NotifyScheduler::readyForNewPacket(size_t capacity) const {
+    if (ring.empty()) {
+        return false;
+    }
+    if (policy.minPacketIntervalUs > 0 && clock.micros() - lastSendUs < policy.minPacketIntervalUs) {
+        return false;
+    }
+    if (policy.maxBatchDelayMs > 0) {
+        // パケットが埋まるだけ溜まっていなければ、保留時間が過ぎるまで待つ
+        size_t payloadRoom = capacity - frame::kPacketHeaderSize;
+        bool full = ring.used() >= payloadRoom;
+        if (!full && clock.millis() - firstPendingMs < policy.maxBatchDelayMs) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// source から詰められるだけ詰めて履歴スロットにパケットを作る
+template <size_t N>
+HOT_PATH NotifyScheduler::HistorySlot* NotifyScheduler::buildPacket(RecordRing<N>& source, size_t capacity, bool urgent) {
+    HistorySlot& slot = history[seq % RETRANSMIT_HISTORY];
+    frame::PacketBuilder builder;
+    builder.begin(slot.data, capacity, seq, clock.millis());
+
+    uint8_t record[frame::kMaxRecordPayload];
+    int len;
+
+    // 同期時刻のタグ（先頭のレコードと一緒に入らなければ付けない）
+    size_t tags = 0;
+    len = source.peekLength();
+    if (clockSync != nullptr && len >= 0 &&
+        builder.fits(frame::kRecordHeaderSize + ClockSync::kTagSize + static_cast<size_t>(len))) {
+        size_t tagLen = clockSync->encodeTag(record);
+        if (tagLen > 0) {
+            builder.add(STREAM_CLOCK, record, tagLen);
+            tags = 1;
+        }
+    }
+    while ((len = source.peekLength()) >= 0 && builder.fits(static_cast<size_t>(len))) {
+        uint8_t stream = 0;
+        source.pop(stream, record, sizeof(record));
+        builder.add(stream, record, static_cast<size_t>(len));
+        if (!urgent) {
+            ++dequeued;
+        }
+    }
+
+    if (builder.count() == tags) {
+        // MTU に収まらないレコードは送れないので捨てる
+        uint8_t stream = 0;
+        source.pop(stream, record, sizeof(record));
+        if (urgent) {
+            ++urgentSentCount;  // 送れないまま待たせないよう、送ったものとして数える
+        } else {
+            ++dequeued;
+        }
+        ++counters.recordsDropped;
+        if (runtimeStats != nullptr) {
+            runtimeStats->recordDrop();
+        }
+        return nullptr;
+    }
+
+    counters.recordsSent += builder.count() - tags;
+    slot.urgentRecords = urgent ? static_cast<uint8_t>(builder.count() - tags) : 0;
+    slot.seq = seq++;
+    slot.length = static_cast<uint16_t>(builder.finish());
+    TIMELINE_INSTANT(TL_NOTIFY_QUEUED, TRACK_LOOP, slot.seq);
+    return &slot;
+}
+
+HOT_PATH bool NotifyScheduler::send(const HistorySlot& slot) {
+    TIMELINE_SCOPE(TL_NOTIFY_SENT, TRACK_LOOP, slot.seq);
+    ble.setValue(streamChar, slot.data, slot.length);
+    if (!ble.notify(streamChar)) {
+        return false;
+    }
+    lastSendUs = clock.micros();
+    ++counters.packetsSent;
+    counters.bytesSent += slot.length;
+    if (runtimeStats != nullptr) {
+        runtimeStats->recordNotify(slot.length, clock.millis());
+    }
+    return true;
+}
+
+NotifyScheduler::HistorySlot* NotifyScheduler::findHistory(uint16_t wanted) {
+    HistorySlot& slot = history[wanted % RETRANSMIT_HISTORY];
+    // まだ送っていない seq や上書き済みのスロットは再送できない
+    uint16_t age = static_cast<uint16_t>(seq - wanted);
+    if (slot.length == 0 || slot.seq != wanted || age == 0 || age > RETRANSMIT_HISTORY) {
+        return nullptr;
+    }
+    return &slot;
+}
+
+uint8_t NotifyScheduler::requestRetransmit(uint16_t first, uint8_t count) {
+    uint8_t queued = 0;
+    for (uint8_t i = 0; i < count && retransmitCount < kRetransmitQueue; ++i) {
+        uint16_t s = static_cast<uint16_t>(first + i);
+        if (findHistory(s) == nullptr) {
+            ++counters.retransmitMisses;
+            continue;
+        }
+        retransmitQueue[(retransmitHead + retransmitCount) % kRetransmitQueue] = s;
+        ++retransmitCount;
+        ++queued;
+    }
+    return queued;
+}
+
+void NotifyScheduler::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_RETRANSMIT, &NotifyScheduler::cmdRetransmit, this);
+}
+
+// [seq u16][count u8] → [queued u8]
+void NotifyScheduler::cmdRetransmit(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    if (len != 3) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    NotifyScheduler* scheduler = static_cast<NotifyScheduler*>(context);
+    reply.appendU8(scheduler->requestRetransmit(wire::getU16(args), args[2]));
+}
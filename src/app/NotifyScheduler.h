@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/ClockSync.h"
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/RecordRing.h"
+#include "app/RuntimeStats.h"
+#include "hal/BlePeripheral.h"
+#include "hal/Clock.h"
+
+class Backlog;
+class RecordLog;
+
+/**
+ * ストリーム用キャラクタリスティックの送信スケジューラ
+ * - enqueue() されたレコードを MTU サイズのパケットに詰めて Notify する
+ * - ペーシング：1 tick あたりのパケット数・パケット間隔・部分パケットの保留時間を PacingPolicy で制御
+ * - 優先レーン：enqueueUrgent() したレコードは別のリングに積み、ペーシングと保留時間を無視して
+ *               次の tick の先頭で専用のパケットにして送る（タッチ入力など遅らせたくないもの）
+ * - 時刻同期：setClockSync() すると、同期が取れている間は各パケットの先頭に STREAM_CLOCK のレコードを入れる
+ *             ストリームはその分を引いた usableCapacity() を 1 パケットの大きさとして使うこと
+ * - 再送：BLE スタックが notify() を拒否したパケットは次の tick で同じ seq のまま再送する
+ *         セントラルは欠落した seq を CMD_RETRANSMIT で要求でき、履歴に残っていれば再送する
+ * - 切断中：setOffline(true) の間は enqueue() したレコードを Backlog に溜める（app/Backlog.h）
+ * - 記録：setRecorder() すると、積まれたレコードを接続に関係なく RecordLog にも渡す（app/RecordLog.h）
+ * - 未購読：setSuspended(true) の間（セントラルがストリームの Notify を有効にしていない）は
+ *           enqueue() したレコードを RecordLog にだけ渡して送らない
+ *
+ * enqueue() と tick() は同じタスク（loop()）から呼ぶこと。
+ */
+
+struct PacingPolicy {
+    uint8_t maxPacketsPerTick;     // 1 tick で送るパケット数の上限
+    uint32_t minPacketIntervalUs;  // パケット間の最小間隔（0 なら制限なし）
+    uint32_t maxBatchDelayMs;      // パケットが埋まるまで待つ最大時間（0 なら即送信）
+
+    // できるだけ早く送る（レイテンシ最小・パケット効率は悪い）
+    static constexpr PacingPolicy eager() { return {MAX_PACKETS_PER_LOOP, 0, 0}; }
+    // 部分パケットを maxBatchDelayMs だけ保留して詰め込み率を上げる
+    static constexpr PacingPolicy batched(uint32_t delayMs) { return {MAX_PACKETS_PER_LOOP, 0, delayMs}; }
+    // コネクションイベントに合わせて一定間隔で流す
+    static constexpr PacingPolicy paced(uint32_t intervalUs, uint32_t delayMs) { return {1, intervalUs, delayMs}; }
+};
+
+struct SchedulerStats {
+    uint32_t packetsSent;
+    uint32_t bytesSent;
+    uint32_t recordsQueued;     // enqueue() で受け付けたレコード
+    uint32_t recordsSent;
+    uint32_t recordsDropped;    // リング満杯・MTU 超過・discardQueued() で捨てたレコード
+    uint32_t notifyRetries;     // notify() 拒否による再試行
+    uint32_t retransmits;       // セントラル要求による再送
+    uint32_t retransmitMisses;  // 履歴から消えていて再送できなかった seq
+    uint32_t urgentPackets;     // 優先レーンのパケット
+};
+
+class NotifyScheduler {
+public:
+    NotifyScheduler(hal::Clock& clock, hal::BlePeripheral& ble);
+
+    void setCharacteristic(hal::CharId ch) { streamChar = ch; }
+    void setPolicy(const PacingPolicy& policy) { this->policy = policy; }
+    void setRuntimeStats(RuntimeStats* stats) { runtimeStats = stats; }
+    void setClockSync(ClockSync* sync) { clockSync = sync; }
+    void setBacklog(Backlog* backlog) { this->backlog = backlog; }
+    void setRecorder(RecordLog* log) { recorder = log; }
+    // 切断中は enqueue() を Backlog に回す。切断したときに送れていなかったレコードも Backlog に移す
+    void setOffline(bool offline);
+    bool isOffline() const { return offline; }
+    // 未購読の間は送らない。送れていなかったレコードと再送の予約も捨てる（購読し直したら新しいレコードから送る）
+    void setSuspended(bool suspended);
+    bool isSuspended() const { return suspended; }
+    // 未購読の間に積まれて送らなかったレコードの累計
+    uint32_t recordsSuspended() const { return suspendedCount; }
+    const PacingPolicy& pacing() const { return policy; }
+
+    // レコードを送信待ちに積む。満杯なら false
+    bool enqueue(uint8_t stream, const uint8_t* data, size_t len);
+    // 優先レーンに積む。満杯なら false
+    bool enqueueUrgent(uint8_t stream, const uint8_t* data, size_t len);
+
+    // 接続中に毎 loop() 呼ぶ
+    void tick();
+    // 優先レーンだけを送る（優先レコードを積んだ直後に呼べば loop() の残りを待たずに送れる）
+    void tickUrgent();
+
+    // 送信待ちのうち、stream のレコードでペイロードが prefix で始まるものを取り除く（順序は保つ）。
+    // 取り除いた数を返す（recordsDropped に数える）。パケットに詰めたあとのものは取り除けない
+    size_t discardQueued(uint8_t stream, const uint8_t* prefix, size_t prefixLen);
+
+    // seq から count 個のパケットの再送を予約する。予約できた数を返す
+    uint8_t requestRetransmit(uint16_t seq, uint8_t count);
+
+    // CMD_RETRANSMIT を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    size_t queuedBytes() const { return ring.used(); }
+    // リングから取り出したレコードの累計（enqueue() 時の recordsQueued と比べれば、そのレコードが
+    // パケットに詰められたかどうかが分かる）
+    uint32_t recordsDequeued() const { return dequeued; }
+    // 優先レーンで受け付けたレコード・notify() が通ったレコードの累計
+    uint32_t urgentQueued() const { return urgentQueuedCount; }
+    uint32_t urgentSent() const { return urgentSentCount; }
+    uint16_t nextSeq() const { return seq; }
+    // ストリームのレコードに使えるパケットの大きさ（同期中は時刻のタグの分を除いた packetCapacity()）
+    size_t usableCapacity() const;
+    const SchedulerStats& stats() const { return counters; }
+
+private:
+    struct HistorySlot {
+        uint16_t seq;
+        uint16_t length;
+        uint8_t urgentRecords;  // 優先レーンのパケットならレコード数
+        uint8_t data[frame::kMaxPacketSize];
+    };
+
+    bool send(const HistorySlot& slot);
+    bool sendUrgent(uint8_t& budget);
+    bool readyForNewPacket(size_t capacity) const;
+    template <size_t N>
+    HistorySlot* buildPacket(RecordRing<N>& source, size_t capacity, bool urgent);
+    HistorySlot* findHistory(uint16_t seq);
+
+    static void cmdRetransmit(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    hal::BlePeripheral& ble;
+    hal::CharId streamChar = hal::kInvalidId;
+    RuntimeStats* runtimeStats = nullptr;
+    ClockSync* clockSync = nullptr;
+    Backlog* backlog = nullptr;
+    RecordLog* recorder = nullptr;
+    bool offline = false;
+    bool suspended = false;
+    uint32_t suspendedCount = 0;
+    PacingPolicy policy = PacingPolicy::eager();
+
+    RecordRing<TX_RING_SIZE> ring;
+    RecordRing<URGENT_RING_SIZE> urgentRing;
+    uint32_t urgentQueuedCount = 0;
+    uint32_t urgentSentCount = 0;
+    uint32_t firstPendingMs = 0;
+    uint32_t lastSendUs = 0;
+    uint16_t seq = 0;
+    uint32_t dequeued = 0;
+
+    // 直近に送ったパケット（再送用）。history[seq % N]
+    HistorySlot history[RETRANSMIT_HISTORY];
+    HistorySlot* stalled = nullptr;  // notify() に拒否されたパケット
+
+    static constexpr size_t kRetransmitQueue = 16;
+    uint16_t retransmitQueue[kRetransmitQueue];
+    uint8_t retransmitHead = 0;
+    uint8_t retransmitCount = 0;
+
+    SchedulerStats counters = {};
+};
@@ -0,0 +1,91 @@
+#include "app/OrientationFilter.h"
+
+#include <cmath>
+
+static inline float invSqrt(float v) {
+    return 1.0f / std::sqrt(v);
+}
+
+void OrientationFilter::configure(Algorithm algorithm, float gain) {
+    this->algorithm = algorithm;
+    this->gain = gain;
+    reset();
+}
+
+void OrientationFilter::update(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+    if (algorithm == Algorithm::Mahony) {
+        updateMahony(gx, gy, gz, ax, ay, az, dt);
+    } else {
+        updateMadgwick(gx, gy, gz, ax, ay, az, dt);
+    }
+}
+
+// 角速度による変化 + 補正項 (qDot) を dt だけ積分して正規化する
+void OrientationFilter::integrate(float gx, float gy, float gz, float qDotW, float qDotX, float qDotY, float qDotZ,
+                                  float dt) {
+    qDotW += 0.5f * (-q.x * gx - q.y * gy - q.z * gz);
+    qDotX += 0.5f * (q.w * gx + q.y * gz - q.z * gy);
+    qDotY += 0.5f * (q.w * gy - q.x * gz + q.z * gx);
+    qDotZ += 0.5f * (q.w * gz + q.x * gy - q.y * gx);
+
+    float w = q.w + qDotW * dt;
+    float x = q.x + qDotX * dt;
+    float y = q.y + qDotY * dt;
+    float z = q.z + qDotZ * dt;
+    float norm = invSqrt(w * w + x * x + y * y + z * z);
+    q = {w * norm, x * norm, y * norm, z * norm};
+}
+
+void OrientationFilter::updateMadgwick(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+    float sW = 0.0f;
+    float sX = 0.0f;
+    float sY = 0.0f;
+    float sZ = 0.0f;
+
+    // 自由落下などで加速度が 0 のときはジャイロだけで進める
+    float accelSq = ax * ax + ay * ay + az * az;
+    if (accelSq > 0.0f) {
+        float norm = invSqrt(accelSq);
+        ax *= norm;
+        ay *= norm;
+        az *= norm;
+
+        // 推定した重力方向と測った加速度の差 f と、そのヤコビアン J から勾配 J^T f を求める
+        float fX = 2.0f * (q.x * q.z - q.w * q.y) - ax;
+        float fY = 2.0f * (q.w * q.x + q.y * q.z) - ay;
+        float fZ = 2.0f * (0.5f - q.x * q.x - q.y * q.y) - az;
+        sW = -2.0f * q.y * fX + 2.0f * q.x * fY;
+        sX = 2.0f * q.z * fX + 2.0f * q.w * fY - 4.0f * q.x * fZ;
+        sY = -2.0f * q.w * fX + 2.0f * q.z * fY - 4.0f * q.y * fZ;
+        sZ = 2.0f * q.x * fX + 2.0f * q.y * fY;
+
+        float sSq = sW * sW + sX * sX + sY * sY + sZ * sZ;
+        if (sSq > 0.0f) {
+            float sNorm = gain * invSqrt(sSq);
+            sW *= sNorm;
+            sX *= sNorm;
+            sY *= sNorm;
+            sZ *= sNorm;
+        }
+    }
+    integrate(gx, gy, gz, -sW, -sX, -sY, -sZ, dt);
+}
+
+void OrientationFilter::updateMahony(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+    float accelSq = ax * ax + ay * ay + az * az;
+    if (accelSq > 0.0f) {
+        float norm = invSqrt(accelSq);
+        ax *= norm;
+        ay *= norm;
+        az *= norm;
+
+        // 推定した重力方向 v と測った加速度の外積が姿勢の誤差
+        float vX = 2.0f * (q.x * q.z - q.w * q.y);
+        float vY = 2.0f * (q.w * q.x + q.y * q.z);
+        float vZ = q.w * q.w - q.x * q.x - q.y * q.y + q.z * q.z;
+        gx += gain * (ay * vZ - az * vY);
+        gy += gain * (az * vX - ax * vZ);
+        gz += gain * (ax * vY - ay * vX);
+    }
+    integrate(gx, gy, gz, 0.0f, 0.0f, 0.0f, 0.0f, dt);
+}
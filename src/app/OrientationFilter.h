@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * 6 軸（加速度 + ジャイロ）の姿勢推定フィルタ
+ * - Madgwick：加速度の誤差の勾配で補正する（gain = beta）
+ * - Mahony   ：加速度の誤差を角速度にフィードバックする（gain = Kp、積分項なし）
+ * 地磁気を使わないのでヨーはジャイロの積分だけで決まり、時間とともにずれる。
+ *
+ * ESP32-S3 の FPU は単精度だけなので、すべて float で計算する（double を混ぜると
+ * ソフトウェア演算になって 1 桁遅くなる）。三角関数は使わない。
+ */
+
+struct Quaternion {
+    float w;
+    float x;
+    float y;
+    float z;
+};
+
+class OrientationFilter {
+public:
+    enum class Algorithm : uint8_t {
+        Madgwick = 0,
+        Mahony = 1,
+    };
+
+    void configure(Algorithm algorithm, float gain);
+    void reset() { q = {1.0f, 0.0f, 0.0f, 0.0f}; }
+
+    // gx, gy, gz [rad/s]、ax, ay, az は任意の単位（正規化して使う）、dt [s]
+    void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+    const Quaternion& orientation() const { return q; }
+
+private:
+    void updateMadgwick(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    void updateMahony(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    void integrate(float gx, float gy, float gz, float qDotW, float qDotX, float qDotY, float qDotZ, float dt);
+
+    Algorithm algorithm = Algorithm::Madgwick;
+    float gain = 0.1f;
+    Quaternion q = {1.0f, 0.0f, 0.0f, 0.0f};
+};
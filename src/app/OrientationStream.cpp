@@ -0,0 +1,196 @@
+#include "app/OrientationStream.h"
+
+#include <cmath>
+
+#include "app/AppConfig.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+#include "diag/Profiler.h"
+
+static int16_t quantize(float v) {
+    float scaled = v * 32767.0f;
+    if (scaled > 32767.0f) scaled = 32767.0f;
+    if (scaled < -32767.0f) scaled = -32767.0f;
+    return static_cast<int16_t>(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+bool OrientationStream::start(uint16_t rateHz, OrientationFilter::Algorithm algorithm, float gain, bool keepRaw) {
+    stop();
+    const hal::ImuConfig& config = imu.config();
+    if (!imu.isRunning() || rateHz == 0 || rateHz > config.rateHz || config.rateHz % rateHz != 0 || gain < 0.0f) {
+        return false;
+    }
+    decimation = config.rateHz / rateHz;
+    outputPeriod = static_cast<uint16_t>(imu.periodUs() * decimation);
+    gyroScale = static_cast<float>(config.gyroRangeDps) / 32768.0f * (3.14159265f / 180.0f);
+    dt = static_cast<float>(imu.periodUs()) * 1e-6f;
+    filter.configure(algorithm, gain);
+    primed = false;
+    untilOutput = decimation;
+    pendingCount = 0;
+    updateTicks = 0;
+    updateMaxTicks = 0;
+    counters = {};
+    running = true;
+    imu.setSink(this, keepRaw);
+    return true;
+}
+
+void OrientationStream::stop() {
+    if (!running) {
+        return;
+    }
+    flush();
+    imu.setSink(nullptr, true);
+    running = false;
+}
+
+size_t OrientationStream::quaternionsPerRecord(size_t packetCapacity) {
+    size_t overhead = frame::kPacketHeaderSize + frame::kRecordHeaderSize + kRecordHeaderSize;
+    if (packetCapacity <= overhead) {
+        return 0;
+    }
+    size_t n = (packetCapacity - overhead) / kQuaternionSize;
+    return n < kMaxPerRecord ? n : kMaxPerRecord;
+}
+
+size_t OrientationStream::encodeRecord(uint32_t firstIndex, uint32_t timestampUs, uint16_t periodUs,
+                                       const Quaternion* q, size_t count, uint8_t* out) {
+    wire::putU32(out, firstIndex);
+    wire::putU32(out + 4, timestampUs);
+    wire::putU16(out + 8, periodUs);
+    out[10] = static_cast<uint8_t>(count);
+    uint8_t* p = out + kRecordHeaderSize;
+    for (size_t i = 0; i < count; ++i) {
+        // q と -q は同じ姿勢なので w ≥ 0 にそろえて w を省く
+        float sign = q[i].w < 0.0f ? -1.0f : 1.0f;
+        wire::putU16(p + 0, static_cast<uint16_t>(quantize(sign * q[i].x)));
+        wire::putU16(p + 2, static_cast<uint16_t>(quantize(sign * q[i].y)));
+        wire::putU16(p + 4, static_cast<uint16_t>(quantize(sign * q[i].z)));
+        p += kQuaternionSize;
+    }
+    return kRecordHeaderSize + count * kQuaternionSize;
+}
+
+float OrientationStream::tiltDegrees(const Quaternion& q) {
+    // 回転後の z 軸の z 成分 = cos(傾き)
+    float c = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+    c = c > 1.0f ? 1.0f : (c < -1.0f ? -1.0f : c);
+    return std::acos(c) * (180.0f / 3.14159265f);
+}
+
+void OrientationStream::poll(size_t packetCapacity) {
+    perRecord = quaternionsPerRecord(packetCapacity);
+    if (running && pendingCount > 0 && clock.micros() - pendingSinceUs >= ORIENTATION_MAX_HOLD_MS * 1000u) {
+        flush();
+    }
+}
+
+void OrientationStream::onImuSamples(uint32_t firstIndex, uint32_t firstUs, const hal::ImuSample* samples,
+                                     size_t count) {
+    if (!running) {
+        return;
+    }
+    if (primed && firstIndex != expectedIndex) {
+        // IMU が別のレートで再起動されたら出力間隔を保てないので止める
+        if (imu.periodUs() * decimation != outputPeriod) {
+            stop();
+            return;
+        }
+        flush();
+        filter.reset();
+        untilOutput = decimation;
+        ++counters.resets;
+    }
+    primed = true;
+    expectedIndex = firstIndex + static_cast<uint32_t>(count);
+
+    uint16_t imuPeriod = imu.periodUs();
+    for (size_t i = 0; i < count; ++i) {
+        const hal::ImuSample& s = samples[i];
+        uint32_t start = profiler::ticks();
+        filter.update(s.gx * gyroScale, s.gy * gyroScale, s.gz * gyroScale, s.ax, s.ay, s.az, dt);
+        uint32_t elapsed = profiler::ticks() - start;
+        updateTicks += elapsed;
+        if (elapsed > updateMaxTicks) {
+            updateMaxTicks = elapsed;
+        }
+        ++counters.updates;
+
+        if (--untilOutput > 0) {
+            continue;
+        }
+        untilOutput = decimation;
+        if (pendingCount == 0) {
+            pendingIndex = firstIndex + static_cast<uint32_t>(i);
+            pendingUs = firstUs + static_cast<uint32_t>(i) * imuPeriod;
+            pendingSinceUs = clock.micros();
+        }
+        pending[pendingCount++] = filter.orientation();
+        if (pendingCount >= perRecord || pendingCount == kMaxPerRecord) {
+            flush();
+        }
+    }
+
+    uint32_t ticksPerUs = profiler::ticksPerMicrosecond();
+    counters.updateAvgNs = static_cast<uint32_t>(updateTicks * 1000 / ticksPerUs / counters.updates);
+    counters.updateMaxNs = static_cast<uint32_t>(static_cast<uint64_t>(updateMaxTicks) * 1000 / ticksPerUs);
+}
+
+void OrientationStream::flush() {
+    if (pendingCount == 0) {
+        return;
+    }
+    uint32_t n = static_cast<uint32_t>(pendingCount);
+    pendingCount = 0;
+    if (perRecord == 0 || n > perRecord) {
+        counters.quaternionsDropped += n;
+        return;
+    }
+    if (triggers != nullptr && triggers->gated(STREAM_ORIENTATION) &&
+        !triggers->admit(STREAM_ORIENTATION, tiltDegrees(pending[n - 1]))) {
+        counters.quaternionsSuppressed += n;
+        return;
+    }
+    uint8_t record[kRecordHeaderSize + kMaxPerRecord * kQuaternionSize];
+    size_t len = encodeRecord(pendingIndex, pendingUs, outputPeriod, pending, n, record);
+    if (scheduler.enqueue(STREAM_ORIENTATION, record, len)) {
+        counters.quaternionsSent += n;
+        ++counters.records;
+    } else {
+        counters.quaternionsDropped += n;
+    }
+}
+
+void OrientationStream::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_ORIENTATION_START, &OrientationStream::cmdStart, this);
+    dispatcher.registerHandler(CMD_ORIENTATION_STOP, &OrientationStream::cmdStop, this);
+}
+
+void OrientationStream::cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    OrientationStream* self = static_cast<OrientationStream*>(context);
+    if (len != 6 || args[2] > static_cast<uint8_t>(OrientationFilter::Algorithm::Mahony)) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    auto algorithm = static_cast<OrientationFilter::Algorithm>(args[2]);
+    float gain = static_cast<float>(wire::getU16(args + 3)) / 1000.0f;
+    if (!self->start(wire::getU16(args), algorithm, gain, args[5] != 0)) {
+        reply.status = CommandStatus::Failed;
+        return;
+    }
+    reply.appendU16(self->outputPeriod);
+}
+
+void OrientationStream::cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    OrientationStream* self = static_cast<OrientationStream*>(context);
+    self->stop();
+    reply.appendU32(self->counters.updates);
+    reply.appendU32(self->counters.quaternionsSent);
+    reply.appendU32(self->counters.quaternionsDropped);
+    reply.appendU32(self->counters.resets);
+    reply.appendU32(self->counters.updateAvgNs);
+    reply.appendU32(self->counters.updateMaxNs);
+}
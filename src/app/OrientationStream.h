@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/ImuStream.h"
+#include "app/NotifyScheduler.h"
+#include "app/OrientationFilter.h"
+#include "app/TriggerTable.h"
+#include "hal/Clock.h"
+
+/**
+ * IMU のサンプルを姿勢推定フィルタに通し、間引いたクォータニオンを STREAM_ORIENTATION に流す
+ * 生のサンプル（12 byte）の代わりに 6 byte の姿勢を出力レートだけ送るので、帯域は
+ * 400 Hz の生データ → 100 Hz の姿勢で 1/8 程度になる。
+ *
+ * レコード（リトルエンディアン）
+ *   u32 firstIndex   先頭の姿勢を計算した IMU サンプルの通番（ImuStream と同じ）
+ *   u32 timestampUs  その推定時刻
+ *   u16 periodUs     姿勢の間隔
+ *   u8  count
+ *   i16 x y z × count  クォータニオンの虚部 × 32767（w = sqrt(1 - x² - y² - z²)、w ≥ 0 にそろえる）
+ *
+ * フィルタは IMU の全サンプルで更新する（間引くのは出力だけ）。通番が飛んだら（IMU の再起動・
+ * 取りこぼし）フィルタを初期化し直し、IMU のレートが変わっていたら止まる。1 回の更新にかかった時間を profiler::ticks() で数える。
+ * レコードは 1 パケットに収まる数か ORIENTATION_MAX_HOLD_MS のどちらかに達したら積む。
+ * トリガー（setTriggers()）はレコードの最後の姿勢の傾き [deg] で、レコード単位に送るかどうかを決める。
+ *
+ * ImuStream::poll() の中から呼ばれるので、loop() のタスク（Arduino ではアプリケーションコア）で動く。
+ * poll() は ImuStream::poll() より先に呼ぶこと。
+ */
+
+struct OrientationStreamStats {
+    uint32_t updates;             // フィルタの更新回数（= 受け取った IMU サンプル数）
+    uint32_t quaternionsSent;
+    uint32_t quaternionsDropped;  // 送信リング満杯・MTU 不足で捨てた姿勢
+    uint32_t quaternionsSuppressed;  // トリガーの条件を満たさず送らなかった姿勢
+    uint32_t records;
+    uint32_t resets;              // 通番が飛んでフィルタを初期化し直した回数
+    uint32_t updateAvgNs;         // 1 回の更新にかかった時間の平均
+    uint32_t updateMaxNs;
+};
+
+class OrientationStream : public ImuSampleSink {
+public:
+    static constexpr size_t kRecordHeaderSize = 11;
+    static constexpr size_t kQuaternionSize = 6;
+    static constexpr size_t kMaxPerRecord = (frame::kMaxRecordPayload - kRecordHeaderSize) / kQuaternionSize;
+
+    OrientationStream(hal::Clock& clock, NotifyScheduler& scheduler, ImuStream& imu)
+        : clock(clock), scheduler(scheduler), imu(imu) {}
+
+    // IMU ストリームが止まっている・rateHz が IMU のレートを割り切らなければ false
+    bool start(uint16_t rateHz, OrientationFilter::Algorithm algorithm, float gain, bool keepRaw);
+    void stop();
+    bool isRunning() const { return running; }
+    uint16_t periodUs() const { return outputPeriod; }
+
+    void setTriggers(TriggerTable* triggers) { this->triggers = triggers; }
+
+    // 保留時間を過ぎた姿勢をレコードにする
+    void poll(size_t packetCapacity);
+
+    void onImuSamples(uint32_t firstIndex, uint32_t firstUs, const hal::ImuSample* samples, size_t count) override;
+
+    // CMD_ORIENTATION_START / CMD_ORIENTATION_STOP を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    const OrientationStreamStats& stats() const { return counters; }
+    const Quaternion& orientation() const { return filter.orientation(); }
+
+    // 鉛直からの傾き [deg]（センサの z 軸と重力のなす角）
+    static float tiltDegrees(const Quaternion& q);
+
+    // packetCapacity のパケット 1 つに入る姿勢の数（0 なら MTU が小さすぎる）
+    static size_t quaternionsPerRecord(size_t packetCapacity);
+
+    // レコードを out に書き、その長さを返す（out は kRecordHeaderSize + count * kQuaternionSize 以上）
+    static size_t encodeRecord(uint32_t firstIndex, uint32_t timestampUs, uint16_t periodUs, const Quaternion* q,
+                               size_t count, uint8_t* out);
+
+private:
+    void flush();
+
+    static void cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    NotifyScheduler& scheduler;
+    ImuStream& imu;
+    OrientationFilter filter;
+    TriggerTable* triggers = nullptr;
+
+    bool running = false;
+    uint32_t decimation = 1;
+    uint16_t outputPeriod = 0;
+    float gyroScale = 0.0f;  // LSB → rad/s
+    float dt = 0.0f;
+    bool primed = false;  // 最初のサンプルを受け取った
+    uint32_t expectedIndex = 0;
+    uint32_t untilOutput = 0;
+    size_t perRecord = 0;
+
+    // まだレコードにしていない姿勢
+    Quaternion pending[kMaxPerRecord];
+    size_t pendingCount = 0;
+    uint32_t pendingIndex = 0;
+    uint32_t pendingUs = 0;
+    uint32_t pendingSinceUs = 0;
+
+    uint64_t updateTicks = 0;
+    uint32_t updateMaxTicks = 0;
+
+    OrientationStreamStats counters = {};
+};
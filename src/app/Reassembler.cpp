@@ -0,0 +1,54 @@
+#include "app/Reassembler.h"
+
+#include <cstring>
+
+#include "app/HotPath.h"
+
+void Reassembler::reset() {
+    size = 0;
+    nextIndex = 0;
+    active = false;
+}
+
+Reassembler::Result Reassembler::fail() {
+    ++errors;
+    reset();
+    return Result::Error;
+}
+
+HOT_PATH Reassembler::Result Reassembler::feed(const uint8_t* data, size_t len) {
+    if (len == 0) {
+        return fail();
+    }
+    uint8_t header = data[0];
+    uint8_t index = header & kIndexMask;
+
+    if (header & kFirst) {
+        // 途中のメッセージがあっても新しい FIRST で上書きする
+        if (active) {
+            ++errors;
+        }
+        size = 0;
+        nextIndex = 0;
+        active = true;
+    } else if (!active) {
+        return fail();
+    }
+
+    if (index != nextIndex) {
+        return fail();
+    }
+    size_t chunk = len - 1;
+    if (size + chunk > kMaxMessage) {
+        return fail();
+    }
+    std::memcpy(buffer + size, data + 1, chunk);
+    size += chunk;
+    nextIndex = (nextIndex + 1) & kIndexMask;
+
+    if (header & kLast) {
+        active = false;
+        return Result::Complete;
+    }
+    return Result::Incomplete;
+}
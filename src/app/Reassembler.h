@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * コマンド用キャラクタリスティックへの分割書き込みを1メッセージに復元する
+ *
+ * 各書き込みの先頭 1 バイトがフラグメントヘッダ:
+ *   bit7 FIRST / bit6 LAST / bit0-5 フラグメント番号（FIRST で 0 から始まり mod 64）
+ * 1回で収まるメッセージは 0xC0 を付けて送る。
+ * 番号が飛んだ・FIRST なしで始まった・上限超過の場合はメッセージ全体を捨てる。
+ * デバイスからの応答の Notify も同じヘッダで分ける（セントラルも Reassembler と同じ手順で復元する）。
+ */
+class Reassembler {
+public:
+    static constexpr size_t kMaxMessage = 512;
+
+    static constexpr uint8_t kFirst = 0x80;
+    static constexpr uint8_t kLast = 0x40;
+    static constexpr uint8_t kIndexMask = 0x3F;
+
+    enum class Result : uint8_t {
+        Incomplete,
+        Complete,
+        Error,
+    };
+
+    Result feed(const uint8_t* data, size_t len);
+
+    // Complete を返した直後のみ有効
+    const uint8_t* message() const { return buffer; }
+    size_t messageLength() const { return size; }
+
+    uint32_t errorCount() const { return errors; }
+    void reset();
+
+private:
+    Result fail();
+
+    uint8_t buffer[kMaxMessage];
+    size_t size = 0;
+    uint8_t nextIndex = 0;
+    bool active = false;
+    uint32_t errors = 0;
+};
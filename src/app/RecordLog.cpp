@@ -0,0 +1,458 @@
+#include "app/RecordLog.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "app/NotifyScheduler.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+
+// 時刻同期のタグ・再生・問い合わせの結果は記録しない
+static constexpr uint16_t kLoggableStreams =
+    static_cast<uint16_t>(((1u << (STREAM_LOG + 1)) - 1) & ~((1u << STREAM_CLOCK) | (1u << STREAM_BACKLOG) |
+                                                             (1u << STREAM_LOG)));
+
+void RecordLog::segmentPath(uint16_t segment, char* out, size_t len) {
+    snprintf(out, len, "/log%02u.seg", static_cast<unsigned>(segment % LOG_MAX_SEGMENTS));
+}
+
+void RecordLog::setStore(hal::FileStore* store) {
+    fileStore = store;
+    mask = 0;
+    query = {};
+    firstPage = 0;
+    pageCount = 0;
+    headSegment = 0;
+    headPages = 0;
+    headBytes = 0;
+    headSeq = 1;
+    timeBase = 0;
+    readCount = 0;
+    if (fileStore != nullptr) {
+        recover();
+    }
+    pageSize = kPageHeaderSize;
+    pageRecords = 0;
+    pageFirstSeq = headSeq;
+}
+
+// セグメントのページの見出しだけを読んで索引を作る
+void RecordLog::recover() {
+    struct Found {
+        uint16_t slot;
+        uint32_t firstSeq;
+        int32_t size;
+    };
+    Found found[LOG_MAX_SEGMENTS];
+    size_t foundCount = 0;
+    uint8_t header[kPageHeaderSize];
+    char path[20];
+    for (uint16_t slot = 0; slot < LOG_MAX_SEGMENTS; ++slot) {
+        segmentPath(slot, path, sizeof(path));
+        int32_t size = fileStore->size(path);
+        if (size < 0) {
+            continue;
+        }
+        if (size < static_cast<int32_t>(kPageHeaderSize) || fileStore->read(path, 0, header, sizeof(header)) !=
+                                                                sizeof(header) ||
+            wire::getU16(header) != kPageMagic) {
+            fileStore->remove(path);
+            continue;
+        }
+        // firstSeq の順に並べる
+        size_t i = foundCount++;
+        for (; i > 0 && found[i - 1].firstSeq > wire::getU32(header + 6); --i) {
+            found[i] = found[i - 1];
+        }
+        found[i] = {slot, wire::getU32(header + 6), size};
+    }
+
+    uint32_t expectSeq = 1;
+    uint32_t lastMs = 0;
+    uint16_t segment = 0;
+    for (size_t f = 0; f < foundCount; ++f) {
+        // セグメントの番号はファイル名（番号 % LOG_MAX_SEGMENTS）と合わせて増やす
+        segment = f == 0 ? found[f].slot
+                         : static_cast<uint16_t>(segment + 1 +
+                                                 (found[f].slot + LOG_MAX_SEGMENTS - 1 - segment % LOG_MAX_SEGMENTS) %
+                                                     LOG_MAX_SEGMENTS);
+        segmentPath(segment, path, sizeof(path));
+        uint32_t offset = 0;
+        uint16_t segmentPages = 0;
+        while (offset + kPageHeaderSize <= static_cast<uint32_t>(found[f].size) &&
+               segmentPages < LOG_PAGES_PER_SEGMENT && pageCount < kMaxPages) {
+            if (fileStore->read(path, offset, header, sizeof(header)) != sizeof(header)) {
+                break;
+            }
+            PageInfo info = {segment, wire::getU16(header + 2), wire::getU16(header + 4), offset,
+                             wire::getU32(header + 6), wire::getU32(header + 10), wire::getU32(header + 14)};
+            // 書きかけのページ（電源断）から先は使わない
+            if (wire::getU16(header) != kPageMagic || info.length < kPageHeaderSize || info.length > kPageSize ||
+                offset + info.length > static_cast<uint32_t>(found[f].size) || info.count == 0 ||
+                info.firstSeq < expectSeq) {
+                break;
+            }
+            index[(firstPage + pageCount) % kMaxPages] = info;
+            ++pageCount;
+            ++segmentPages;
+            expectSeq = info.firstSeq + info.count;
+            lastMs = info.lastMs;
+            offset += info.length;
+        }
+        if (segmentPages == 0) {
+            fileStore->remove(path);
+        }
+    }
+
+    // 途中まで書いたセグメントには追記せず、次のセグメントから書く
+    headSegment = foundCount > 0 ? static_cast<uint16_t>(segment + 1) : 0;
+    headSeq = expectSeq;
+    timeBase = pageCount > 0 ? lastMs + 1 : 0;
+}
+
+bool RecordLog::start(uint16_t streamMask) {
+    if (fileStore == nullptr || streamMask == 0 || (streamMask & ~kLoggableStreams) != 0) {
+        return false;
+    }
+    mask = streamMask;
+    return true;
+}
+
+void RecordLog::stop() {
+    mask = 0;
+    flush();
+    if (fileStore != nullptr) {
+        fileStore->sync();
+    }
+}
+
+uint32_t RecordLog::firstSeq() const {
+    return pageCount > 0 ? pageAt(0).firstSeq : pageFirstSeq;
+}
+
+uint8_t RecordLog::segments() const {
+    if (pageCount == 0) {
+        return 0;
+    }
+    return static_cast<uint8_t>(static_cast<uint16_t>(pageAt(pageCount - 1).segment - pageAt(0).segment) + 1);
+}
+
+bool RecordLog::append(uint8_t stream, const uint8_t* data, size_t len) {
+    if (fileStore == nullptr || len > kMaxPayload) {
+        ++counters.dropped;
+        return false;
+    }
+    if (pageSize + kEntryHeaderSize + len > kPageSize) {
+        flush();
+    }
+    uint32_t now = clock.millis() + timeBase;
+    if (pageRecords == 0) {
+        pageFirstSeq = headSeq;
+        pageFirstMs = now;
+    }
+    uint8_t* entry = page + pageSize;
+    entry[0] = stream;
+    entry[1] = static_cast<uint8_t>(len);
+    wire::putU32(entry + 2, now);
+    std::memcpy(entry + kEntryHeaderSize, data, len);
+    pageSize += kEntryHeaderSize + len;
+    pageLastMs = now;
+    ++pageRecords;
+    ++headSeq;
+    ++counters.records;
+    return true;
+}
+
+bool RecordLog::flush() {
+    if (pageRecords == 0) {
+        return true;
+    }
+    wire::putU16(page, kPageMagic);
+    wire::putU16(page + 2, static_cast<uint16_t>(pageSize));
+    wire::putU16(page + 4, pageRecords);
+    wire::putU32(page + 6, pageFirstSeq);
+    wire::putU32(page + 10, pageFirstMs);
+    wire::putU32(page + 14, pageLastMs);
+
+    bool written = false;
+    for (int attempt = 0; attempt < 2 && !written; ++attempt) {
+        if (headPages == LOG_PAGES_PER_SEGMENT) {
+            ++headSegment;
+            headPages = 0;
+            headBytes = 0;
+        }
+        char path[20];
+        segmentPath(headSegment, path, sizeof(path));
+        if (headPages == 0) {
+            // 新しいセグメントを始める。同じファイル名の古いセグメントは消す
+            while (pageCount > 0 && segments() >= LOG_MAX_SEGMENTS) {
+                dropOldestSegment();
+            }
+            fileStore->remove(path);
+        }
+        if (fileStore->append(path, page, pageSize)) {
+            written = true;
+            break;
+        }
+        // フラッシュが一杯。途中まで書けたかもしれないセグメントは閉じ、古いセグメントを消してやり直す
+        if (headPages == 0) {
+            fileStore->remove(path);
+        }
+        headPages = LOG_PAGES_PER_SEGMENT;
+        if (pageCount > 0 && pageAt(0).segment != headSegment) {
+            dropOldestSegment();
+        }
+    }
+
+    if (written) {
+        if (pageCount == kMaxPages) {
+            dropOldestSegment();
+        }
+        index[(firstPage + pageCount) % kMaxPages] = {headSegment, static_cast<uint16_t>(pageSize), pageRecords,
+                                                      headBytes,   pageFirstSeq, pageFirstMs, pageLastMs};
+        ++pageCount;
+        ++headPages;
+        headBytes += static_cast<uint32_t>(pageSize);
+        ++counters.pagesWritten;
+        counters.bytesWritten += static_cast<uint32_t>(pageSize);
+    } else {
+        counters.dropped += pageRecords;
+    }
+    pageSize = kPageHeaderSize;
+    pageRecords = 0;
+    pageFirstSeq = headSeq;
+    return written;
+}
+
+void RecordLog::dropOldestSegment() {
+    uint16_t segment = pageAt(0).segment;
+    while (pageCount > 0 && pageAt(0).segment == segment) {
+        firstPage = (firstPage + 1) % kMaxPages;
+        --pageCount;
+    }
+    char path[20];
+    segmentPath(segment, path, sizeof(path));
+    fileStore->remove(path);
+    if (segment == headSegment) {
+        headPages = 0;
+        headBytes = 0;
+    }
+}
+
+// seq の入っているページ（firstSeq <= seq の最後のページ）。なければ -1
+int32_t RecordLog::findPageBySeq(uint32_t seq) const {
+    if (pageCount == 0 || seq < pageAt(0).firstSeq) {
+        return -1;
+    }
+    uint16_t lo = 0;
+    uint16_t hi = pageCount;
+    while (hi - lo > 1) {
+        uint16_t mid = static_cast<uint16_t>((lo + hi) / 2);
+        if (pageAt(mid).firstSeq <= seq) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// seq の入っているページを readBuffer に読み、readOffset を seq のエントリに合わせる
+bool RecordLog::loadPageFor(uint32_t seq) {
+    bool cached = readCount > 0 && seq >= readFirstSeq && seq < readFirstSeq + readCount;
+    if (!cached) {
+        if (seq >= pageFirstSeq) {
+            // まだ書き出していない RAM のページ
+            if (pageRecords == 0) {
+                return false;
+            }
+            std::memcpy(readBuffer, page, pageSize);
+            readLength = pageSize;
+            readFirstSeq = pageFirstSeq;
+            readCount = pageRecords;
+        } else {
+            int32_t i = findPageBySeq(seq);
+            if (i < 0) {
+                return false;
+            }
+            const PageInfo& info = pageAt(static_cast<uint16_t>(i));
+            char path[20];
+            segmentPath(info.segment, path, sizeof(path));
+            readCount = 0;
+            readLength = fileStore->read(path, info.offset, readBuffer, info.length);
+            ++counters.pagesRead;
+            if (readLength != info.length || wire::getU16(readBuffer) != kPageMagic ||
+                wire::getU32(readBuffer + 6) != info.firstSeq) {
+                return false;
+            }
+            readFirstSeq = info.firstSeq;
+            readCount = info.count;
+        }
+        readOffset = kPageHeaderSize;
+        readSeq = readFirstSeq;
+    } else if (seq < readSeq) {
+        readOffset = kPageHeaderSize;
+        readSeq = readFirstSeq;
+    }
+    while (readSeq < seq && readOffset + kEntryHeaderSize <= readLength) {
+        readOffset += kEntryHeaderSize + readBuffer[readOffset + 1];
+        ++readSeq;
+    }
+    return readSeq == seq && readOffset + kEntryHeaderSize + readBuffer[readOffset + 1] <= readLength;
+}
+
+bool RecordLog::beginQuery(QueryKey key, uint32_t from, uint32_t to, uint16_t step) {
+    if (query.active || fileStore == nullptr || step == 0 || to < from || key > ByTime) {
+        return false;
+    }
+    query = {true, false, key, from, to, step, 0, 0, 0};
+    if (key == BySeq) {
+        query.cursor = from > firstSeq() ? from : firstSeq();
+    } else {
+        // lastMs >= from の最初のページから（なければ RAM のページ）
+        uint16_t lo = 0;
+        uint16_t hi = pageCount;
+        while (lo < hi) {
+            uint16_t mid = static_cast<uint16_t>((lo + hi) / 2);
+            if (pageAt(mid).lastMs < from) {
+                lo = static_cast<uint16_t>(mid + 1);
+            } else {
+                hi = mid;
+            }
+        }
+        query.cursor = lo < pageCount ? pageAt(lo).firstSeq : pageFirstSeq;
+    }
+    ++counters.queries;
+    return true;
+}
+
+void RecordLog::pump(NotifyScheduler& scheduler, size_t queueLimit) {
+    // 範囲外・間引いたレコードは積まずに進むので、1 回に調べる数も制限する
+    static constexpr int kScanPerPump = 256;
+
+    for (int scanned = 0; query.active && scanned < kScanPerPump && scheduler.queuedBytes() < queueLimit;
+         ++scanned) {
+        if (query.finished) {
+            uint8_t end[4];
+            wire::putU32(end, query.sent);
+            if (scheduler.enqueue(STREAM_LOG, end, sizeof(end))) {
+                query.active = false;
+            }
+            return;
+        }
+        if (query.cursor < firstSeq()) {
+            query.cursor = firstSeq();  // 古いセグメントが消えた
+        }
+        uint32_t seq = query.cursor;
+        if (seq >= headSeq || (query.key == BySeq && seq > query.to)) {
+            query.finished = true;
+            continue;
+        }
+        if (!loadPageFor(seq)) {
+            // 読めないページは飛ばす
+            int32_t i = seq < pageFirstSeq ? findPageBySeq(seq) : -1;
+            if (i < 0) {
+                query.finished = true;
+            } else {
+                query.cursor = pageAt(static_cast<uint16_t>(i)).firstSeq + pageAt(static_cast<uint16_t>(i)).count;
+            }
+            continue;
+        }
+
+        const uint8_t* entry = readBuffer + readOffset;
+        uint32_t timeMs = wire::getU32(entry + 2);
+        if (query.key == ByTime) {
+            if (timeMs > query.to) {
+                query.finished = true;
+                continue;
+            }
+            if (timeMs < query.from) {
+                ++query.cursor;
+                continue;
+            }
+        }
+        if (query.matched % query.step == 0) {
+            uint8_t len = entry[1];
+            uint8_t record[kResultHeaderSize + kMaxPayload];
+            wire::putU32(record, seq);
+            wire::putU32(record + 4, timeMs);
+            record[8] = entry[0];
+            std::memcpy(record + kResultHeaderSize, entry + kEntryHeaderSize, len);
+            if (!scheduler.enqueue(STREAM_LOG, record, kResultHeaderSize + len)) {
+                return;
+            }
+            ++query.sent;
+            ++counters.recordsSent;
+        }
+        ++query.matched;
+        ++query.cursor;
+    }
+}
+
+void RecordLog::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_LOG_START, &RecordLog::cmdStart, this);
+    dispatcher.registerHandler(CMD_LOG_STOP, &RecordLog::cmdStop, this);
+    dispatcher.registerHandler(CMD_LOG_QUERY, &RecordLog::cmdQuery, this);
+    dispatcher.registerHandler(CMD_LOG_STATUS, &RecordLog::cmdStatus, this);
+}
+
+// [streamMask u16]
+void RecordLog::cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    RecordLog* self = static_cast<RecordLog*>(context);
+    if (len != 2) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (self->fileStore == nullptr) {
+        reply.status = CommandStatus::Failed;
+        return;
+    }
+    if (!self->start(wire::getU16(args))) {
+        reply.status = CommandStatus::BadArguments;
+    }
+}
+
+// → [nextSeq u32]
+void RecordLog::cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    RecordLog* self = static_cast<RecordLog*>(context);
+    self->stop();
+    reply.appendU32(self->headSeq);
+}
+
+// [key u8][from u32][to u32][step u16] → [startSeq u32]
+void RecordLog::cmdQuery(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    RecordLog* self = static_cast<RecordLog*>(context);
+    if (len != 11) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (self->query.active) {
+        reply.status = CommandStatus::Busy;
+        return;
+    }
+    if (!self->beginQuery(static_cast<QueryKey>(args[0]), wire::getU32(args + 1), wire::getU32(args + 5),
+                          wire::getU16(args + 9))) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    reply.appendU32(self->query.cursor);
+}
+
+void RecordLog::cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)args;
+    (void)len;
+    RecordLog* self = static_cast<RecordLog*>(context);
+    reply.appendU8(self->recording() ? 1 : 0);
+    reply.appendU32(self->firstSeq());
+    reply.appendU32(self->headSeq);
+    reply.appendU8(self->segments());
+    reply.appendU16(self->pageCount);
+    reply.appendU32(self->counters.records);
+    reply.appendU32(self->counters.pagesWritten);
+    reply.appendU32(self->counters.bytesWritten);
+    reply.appendU32(self->counters.queries);
+    reply.appendU32(self->counters.pagesRead);
+    reply.appendU32(self->counters.recordsSent);
+}
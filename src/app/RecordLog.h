@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "hal/Clock.h"
+#include "hal/FileStore.h"
+
+class NotifyScheduler;
+
+/**
+ * フラッシュ上の追記専用の時系列ログ（ログ構造）
+ * - start() で選んだストリームのレコードを NotifyScheduler::enqueue() から横取りして記録する
+ *   （接続・切断に関係なく記録する。送信とは独立）
+ * - レコードには 1 から始まる通番（seq）とログ時刻 [ms] を付け、RAM のページ（kPageSize）に詰める
+ *   ページが埋まるか flush() したら、いまのセグメントのファイルの末尾に追記する
+ * - セグメント = 最大 LOG_PAGES_PER_SEGMENT ページ。LOG_MAX_SEGMENTS 個を超えたら古いものから消す
+ * - 索引はページごとに 1 つ（seq・時刻の範囲とファイル上の位置）の疎な索引で、RAM に持つ
+ *   問い合わせは索引を二分探索して、範囲にかかるページだけを読む（セグメント全体は読まない）
+ * - 起動時は残っているセグメントのページの見出しだけを読んで索引を作り直し、seq と時刻を続きから振る
+ *
+ * ページ = [magic u16][length u16][count u16][firstSeq u32][firstMs u32][lastMs u32]
+ *          + count 個の [stream u8][len u8][timeMs u32][data]（seq はページの中で連続）
+ * 問い合わせの結果は STREAM_LOG で返す
+ *   レコード [seq u32][timeMs u32][stream u8][元のレコード]
+ *   終わり   [sent u32]（4 byte だけのレコード）
+ *
+ * ログ時刻は起動からの millis() に前回の最後の時刻を足したもので、再起動をまたいでも減らない。
+ * 結果のレコードが MTU に収まらなければ送れずに捨てる。RAM のページは flush() するまで電源断で失われる。
+ */
+
+struct RecordLogStats {
+    uint32_t records;       // 記録したレコード
+    uint32_t dropped;       // 大きすぎる・書けずに捨てたレコード
+    uint32_t pagesWritten;
+    uint32_t bytesWritten;
+    uint32_t queries;
+    uint32_t pagesRead;     // 問い合わせで読んだページ
+    uint32_t recordsSent;   // 問い合わせで送ったレコード
+};
+
+class RecordLog {
+public:
+    static constexpr size_t kPageSize = 4096;
+    static constexpr size_t kPageHeaderSize = 18;
+    static constexpr size_t kEntryHeaderSize = 6;
+    static constexpr size_t kResultHeaderSize = 9;
+    static constexpr size_t kMaxPayload = frame::kMaxRecordPayload - kResultHeaderSize;
+    static constexpr size_t kMaxPages = LOG_MAX_SEGMENTS * LOG_PAGES_PER_SEGMENT;
+    static constexpr uint16_t kPageMagic = 0x1064;
+
+    enum QueryKey : uint8_t {
+        BySeq = 0,
+        ByTime = 1,
+    };
+
+    explicit RecordLog(hal::Clock& clock) : clock(clock) {}
+
+    // 残っているセグメントから索引を作り直す
+    void setStore(hal::FileStore* store);
+
+    // streamMask の bit n がストリーム n。記録できないストリームを含む・store がなければ false
+    bool start(uint16_t streamMask);
+    // 記録をやめて RAM のページを書き出し、store に溜めている分も書かせる（sync()）
+    void stop();
+    bool recording() const { return mask != 0; }
+
+    // NotifyScheduler::enqueue() から呼ばれる。記録するストリームなら append() する
+    void capture(uint8_t stream, const uint8_t* data, size_t len) {
+        if (stream < 16 && (mask & (1u << stream)) != 0) {
+            append(stream, data, len);
+        }
+    }
+    bool append(uint8_t stream, const uint8_t* data, size_t len);
+    // RAM のページをセグメントに書き出す
+    bool flush();
+    // RAM のページにレコードがある。pendingSinceMs() はその最初のレコードの millis()
+    bool hasPending() const { return pageRecords > 0; }
+    uint32_t pendingSinceMs() const { return pageFirstMs - timeBase; }
+
+    // [from, to] の範囲（seq か時刻）を step 個に 1 つずつ返す問い合わせを始める。進行中なら false
+    bool beginQuery(QueryKey key, uint32_t from, uint32_t to, uint16_t step);
+    bool querying() const { return query.active; }
+    void cancelQuery() { query.active = false; }
+    // 接続中に毎 loop() 呼ぶ。送信待ちが queueLimit 未満の間、結果を積む
+    void pump(NotifyScheduler& scheduler, size_t queueLimit);
+
+    uint32_t firstSeq() const;
+    uint32_t nextSeq() const { return headSeq; }
+    uint16_t pages() const { return pageCount; }
+    uint8_t segments() const;
+    const RecordLogStats& stats() const { return counters; }
+
+    // CMD_LOG_START / CMD_LOG_STOP / CMD_LOG_QUERY / CMD_LOG_STATUS を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+private:
+    // 索引（ページ 1 つにつき 1 つ）
+    struct PageInfo {
+        uint16_t segment;
+        uint16_t length;
+        uint16_t count;
+        uint32_t offset;  // セグメントのファイルの中の位置
+        uint32_t firstSeq;
+        uint32_t firstMs;
+        uint32_t lastMs;
+    };
+
+    struct Query {
+        bool active;
+        bool finished;  // 終わりのレコードを積めば完了
+        QueryKey key;
+        uint32_t from;
+        uint32_t to;
+        uint16_t step;
+        uint32_t cursor;   // 次に調べる seq
+        uint32_t matched;  // 範囲に入ったレコード（間引く前）
+        uint32_t sent;
+    };
+
+    static void segmentPath(uint16_t segment, char* out, size_t len);
+    const PageInfo& pageAt(uint16_t i) const { return index[(firstPage + i) % kMaxPages]; }
+    void dropOldestSegment();
+    void recover();
+    int32_t findPageBySeq(uint32_t seq) const;
+    bool loadPageFor(uint32_t seq);
+
+    static void cmdStart(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStop(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdQuery(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    hal::FileStore* fileStore = nullptr;
+    uint16_t mask = 0;
+    uint32_t timeBase = 0;  // ログ時刻 = millis() + timeBase
+
+    // 索引：index[(firstPage + i) % kMaxPages] が i 番目に古いページ
+    PageInfo index[kMaxPages] = {};
+    uint16_t firstPage = 0;
+    uint16_t pageCount = 0;
+    uint16_t headSegment = 0;  // 追記中のセグメント
+    uint16_t headPages = 0;    // 追記中のセグメントに書いたページ数
+    uint32_t headBytes = 0;
+
+    // 追記中の RAM のページ
+    uint8_t page[kPageSize];
+    size_t pageSize = kPageHeaderSize;
+    uint16_t pageRecords = 0;
+    uint32_t pageFirstSeq = 1;
+    uint32_t pageFirstMs = 0;
+    uint32_t pageLastMs = 0;
+    uint32_t headSeq = 1;  // 次に記録するレコードの seq
+
+    // 問い合わせで読んだページ
+    uint8_t readBuffer[kPageSize];
+    size_t readLength = 0;
+    uint32_t readFirstSeq = 0;
+    uint16_t readCount = 0;
+    size_t readOffset = 0;  // readSeq のエントリの位置
+    uint32_t readSeq = 0;
+
+    Query query = {};
+    RecordLogStats counters = {};
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "app/HotPath.h"
+#include "app/Wire.h"
+
+/**
+ * 可変長レコードのリングバッファ（SPSC: 生産者1・消費者1でロックフリー）
+ * - レコード = [tag u8][len u16][payload]
+ * - Capacity は 2 のべき乗（バイト数）
+ * - 満杯なら push() は false を返し、レコードは捨てる（呼び出し側でドロップを数える）
+ *
+ * 生産者は BLE タスクや割り込み後のタスク、消費者は loop() を想定している。
+ * ホットパス（app/HotPath.h）から呼ぶメンバは HOT_INLINE で呼び出し元に展開する。
+ */
+template <size_t Capacity>
+class RecordRing {
+    static_assert(Capacity >= 16 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    static constexpr size_t kHeaderSize = 3;
+
+    HOT_INLINE bool push(uint8_t tag, const uint8_t* data, size_t len) {
+        if (len > 0xFFFF) {
+            return false;
+        }
+        uint32_t head = writeIndex.load(std::memory_order_relaxed);
+        uint32_t tail = readIndex.load(std::memory_order_acquire);
+        if (Capacity - (head - tail) < kHeaderSize + len) {
+            return false;
+        }
+        uint8_t header[kHeaderSize];
+        header[0] = tag;
+        wire::putU16(&header[1], static_cast<uint16_t>(len));
+        copyIn(head, header, kHeaderSize);
+        copyIn(head + kHeaderSize, data, len);
+        writeIndex.store(head + static_cast<uint32_t>(kHeaderSize + len), std::memory_order_release);
+        return true;
+    }
+
+    // 先頭レコードのペイロード長（空なら -1）
+    HOT_INLINE int peekLength() const {
+        uint32_t tail = readIndex.load(std::memory_order_relaxed);
+        uint32_t head = writeIndex.load(std::memory_order_acquire);
+        if (head == tail) {
+            return -1;
+        }
+        uint8_t header[kHeaderSize];
+        copyOut(tail, header, kHeaderSize);
+        return wire::getU16(&header[1]);
+    }
+
+    // 先頭レコードを取り出す。cap が足りなければ取り出さずに -1
+    HOT_INLINE int pop(uint8_t& tag, uint8_t* out, size_t cap) {
+        uint32_t tail = readIndex.load(std::memory_order_relaxed);
+        uint32_t head = writeIndex.load(std::memory_order_acquire);
+        if (head == tail) {
+            return -1;
+        }
+        uint8_t header[kHeaderSize];
+        copyOut(tail, header, kHeaderSize);
+        size_t len = wire::getU16(&header[1]);
+        if (len > cap) {
+            return -1;
+        }
+        tag = header[0];
+        copyOut(tail + kHeaderSize, out, len);
+        readIndex.store(tail + static_cast<uint32_t>(kHeaderSize + len), std::memory_order_release);
+        return static_cast<int>(len);
+    }
+
+    HOT_INLINE bool empty() const {
+        return writeIndex.load(std::memory_order_acquire) == readIndex.load(std::memory_order_acquire);
+    }
+
+    size_t used() const {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+    // 消費者側からのみ呼ぶこと
+    void clear() { readIndex.store(writeIndex.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+    HOT_INLINE void copyIn(uint32_t pos, const uint8_t* src, size_t len) {
+        size_t offset = pos & (Capacity - 1);
+        size_t first = len < Capacity - offset ? len : Capacity - offset;
+        std::memcpy(&buffer[offset], src, first);
+        std::memcpy(&buffer[0], src + first, len - first);
+    }
+
+    HOT_INLINE void copyOut(uint32_t pos, uint8_t* dst, size_t len) const {
+        size_t offset = pos & (Capacity - 1);
+        size_t first = len < Capacity - offset ? len : Capacity - offset;
+        std::memcpy(dst, &buffer[offset], first);
+        std::memcpy(dst + first, &buffer[0], len - first);
+    }
+
+    uint8_t buffer[Capacity];
+    std::atomic<uint32_t> writeIndex{0};
+    std::atomic<uint32_t> readIndex{0};
+};
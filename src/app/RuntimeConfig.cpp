@@ -0,0 +1,164 @@
+#include "app/RuntimeConfig.h"
+
+#include <cstring>
+
+#include "app/AppConfig.h"
+#include "app/GattTable.h"
+#include "app/TriggerTable.h"
+#include "app/Wire.h"
+
+static void copyText(char* out, size_t cap, const char* text, size_t len) {
+    size_t n = len < cap - 1 ? len : cap - 1;
+    std::memcpy(out, text, n);
+    out[n] = '\0';
+}
+
+void RuntimeConfig::resetToDefaults() {
+    periodMs = NOTIFY_PERIOD_MS;
+    copyText(name, sizeof(name), DEVICE_NAME, std::strlen(DEVICE_NAME));
+    uuids[0] = gatt::kServiceUuid;
+    for (size_t i = 1; i < kUuidCount; ++i) {
+        uuids[i] = gatt::kChars[i - 1].defaultUuid;
+    }
+    pendingRestart = false;
+}
+
+uint32_t RuntimeConfig::crc32(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+bool RuntimeConfig::load() {
+    if (fileStore == nullptr) {
+        return false;
+    }
+    uint8_t blob[kHeaderSize + kBodySize + 64];
+    size_t n = fileStore->read(kPath, 0, blob, sizeof(blob));
+    if (n < kHeaderSize || wire::getU32(blob) != kMagic || wire::getU16(blob + 4) == 0) {
+        return false;
+    }
+    size_t size = wire::getU16(blob + 6);
+    // 読み切れない大きさの本体は新しすぎる版なので、CRC を確かめられない
+    if (kHeaderSize + size > n || crc32(blob + kHeaderSize, size) != wire::getU32(blob + 8)) {
+        return false;
+    }
+
+    // v1 のフィールド（本体が短ければ残りは既定値）
+    const uint8_t* body = blob + kHeaderSize;
+    if (size >= 4) {
+        uint32_t period = wire::getU32(body);
+        periodMs = period <= kMaxNotifyPeriodMs ? period : NOTIFY_PERIOD_MS;
+    }
+    if (size >= 4 + kMaxNameLength + 1 && body[4] != '\0') {
+        copyText(name, sizeof(name), reinterpret_cast<const char*>(body + 4),
+                 strnlen(reinterpret_cast<const char*>(body + 4), kMaxNameLength));
+    }
+    for (size_t i = 0; i < kUuidCount; ++i) {
+        size_t offset = 4 + kMaxNameLength + 1 + 16 * i;
+        if (size >= offset + 16) {
+            std::memcpy(uuids[i].bytes, body + offset, 16);
+        }
+    }
+    if (triggers != nullptr) {
+        triggers->setHeartbeatPeriod(periodMs);
+    }
+    return true;
+}
+
+bool RuntimeConfig::save() {
+    if (fileStore == nullptr) {
+        return false;
+    }
+    uint8_t blob[kHeaderSize + kBodySize] = {};
+    uint8_t* body = blob + kHeaderSize;
+    wire::putU32(body, periodMs);
+    std::memcpy(body + 4, name, strnlen(name, kMaxNameLength));
+    for (size_t i = 0; i < kUuidCount; ++i) {
+        std::memcpy(body + 4 + kMaxNameLength + 1 + 16 * i, uuids[i].bytes, 16);
+    }
+    wire::putU32(blob, kMagic);
+    wire::putU16(blob + 4, kVersion);
+    wire::putU16(blob + 6, static_cast<uint16_t>(kBodySize));
+    wire::putU32(blob + 8, crc32(body, kBodySize));
+    return fileStore->write(kPath, blob, sizeof(blob));
+}
+
+bool RuntimeConfig::erase() {
+    return fileStore != nullptr && (fileStore->size(kPath) < 0 || fileStore->remove(kPath));
+}
+
+void RuntimeConfig::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_CONFIG_GET, &RuntimeConfig::cmdGet, this);
+    dispatcher.registerHandler(CMD_CONFIG_SET, &RuntimeConfig::cmdSet, this);
+    dispatcher.registerHandler(CMD_CONFIG_SAVE, &RuntimeConfig::cmdSave, this);
+}
+
+// [field u8] → [値]
+void RuntimeConfig::cmdGet(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    RuntimeConfig* self = static_cast<RuntimeConfig*>(context);
+    if (len != 1 || args[0] > CONFIG_STATS_UUID) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (args[0] == CONFIG_NOTIFY_PERIOD) {
+        reply.appendU32(self->periodMs);
+    } else if (args[0] == CONFIG_DEVICE_NAME) {
+        reply.append(reinterpret_cast<const uint8_t*>(self->name), std::strlen(self->name));
+    } else {
+        reply.append(self->uuid(static_cast<ConfigField>(args[0])).bytes, 16);
+    }
+}
+
+// [field u8][値] → [applied u8: 1=すぐに効いた 0=保存して再起動すると効く]
+void RuntimeConfig::cmdSet(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    RuntimeConfig* self = static_cast<RuntimeConfig*>(context);
+    if (len < 1) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    const uint8_t* value = args + 1;
+    size_t valueLen = len - 1;
+    if (args[0] == CONFIG_NOTIFY_PERIOD) {
+        if (valueLen != 4 || wire::getU32(value) > kMaxNotifyPeriodMs) {
+            reply.status = CommandStatus::BadArguments;
+            return;
+        }
+        self->periodMs = wire::getU32(value);
+        if (self->triggers != nullptr) {
+            self->triggers->setHeartbeatPeriod(self->periodMs);
+        }
+        reply.appendU8(1);
+    } else if (args[0] == CONFIG_DEVICE_NAME) {
+        if (valueLen == 0 || valueLen > kMaxNameLength || std::memchr(value, '\0', valueLen) != nullptr) {
+            reply.status = CommandStatus::BadArguments;
+            return;
+        }
+        copyText(self->name, sizeof(self->name), reinterpret_cast<const char*>(value), valueLen);
+        self->pendingRestart = true;
+        reply.appendU8(0);
+    } else if (args[0] <= CONFIG_STATS_UUID && valueLen == 16) {
+        std::memcpy(self->uuids[args[0] - CONFIG_SERVICE_UUID].bytes, value, 16);
+        self->pendingRestart = true;
+        reply.appendU8(0);
+    } else {
+        reply.status = CommandStatus::BadArguments;
+    }
+}
+
+// [erase u8: 0=いまの設定を保存 1=保存した設定を消す]
+void RuntimeConfig::cmdSave(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    RuntimeConfig* self = static_cast<RuntimeConfig*>(context);
+    if (len != 1 || args[0] > 1) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    if (!(args[0] == 0 ? self->save() : self->erase())) {
+        reply.status = CommandStatus::Failed;
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CommandDispatcher.h"
+#include "hal/BlePeripheral.h"
+#include "hal/FileStore.h"
+
+class TriggerTable;
+
+/**
+ * 実行時の設定（デバイス名・UUID・ハートビートの周期）
+ * - 既定値は app/AppConfig.h のマクロ（UUID は app/GattTable.h でコンパイル時に 16 byte にしたもの）
+ *   保存した設定があれば起動時に 1 回の読み出しで上書きする
+ * - 保存形式はバージョン付きのバイナリ（テキストの解析なし。UUID は 16 byte のまま持つ）
+ *     [magic u32 "M5CF"][version u16][size u16][crc32 u32] + 本体 size byte
+ *     本体 v1 = [notifyPeriodMs u32][deviceName 30 byte（NUL 埋め）][UUID 16 byte × 5]
+ *   フィールドは末尾に足していく。古い版の設定は足りないフィールドを既定値のまま読み、
+ *   新しい版の設定は知っているフィールドだけを読む
+ * - CMD_CONFIG_SET で変えられる。ハートビートの周期はすぐに効き、デバイス名と UUID は
+ *   GATT を作り直せないので CMD_CONFIG_SAVE で保存して再起動したときに効く
+ *
+ * UUID の 16 byte は文字列で書いたときの順（先頭の 2 桁が 1 byte 目）。
+ */
+
+enum ConfigField : uint8_t {
+    CONFIG_NOTIFY_PERIOD = 0,  // [ms u32]（0 でハートビートを止める）
+    CONFIG_DEVICE_NAME = 1,    // 1〜29 文字
+    CONFIG_SERVICE_UUID = 2,   // 以下 UUID 16 byte
+    CONFIG_DATA_UUID = 3,
+    CONFIG_STREAM_UUID = 4,
+    CONFIG_COMMAND_UUID = 5,
+    CONFIG_STATS_UUID = 6,
+};
+
+class RuntimeConfig {
+public:
+    static constexpr uint32_t kMagic = 0x4643354D;  // "M5CF"
+    static constexpr uint16_t kVersion = 1;
+    static constexpr size_t kHeaderSize = 12;
+    static constexpr size_t kMaxNameLength = 29;
+    static constexpr size_t kUuidCount = 5;
+    static constexpr size_t kBodySize = 4 + (kMaxNameLength + 1) + 16 * kUuidCount;
+    static constexpr uint32_t kMaxNotifyPeriodMs = 3600000;
+    static constexpr const char* kPath = "/config.bin";
+
+    RuntimeConfig() { resetToDefaults(); }
+
+    // 保存先（なければ既定値だけで動き、保存できない）
+    void setStore(hal::FileStore* store) { fileStore = store; }
+    // ハートビートの周期を変えたときにすぐ反映する先
+    void setTriggers(TriggerTable* table) { triggers = table; }
+
+    // 保存した設定を読む。なければ・壊れていれば既定値のまま false
+    bool load();
+    bool save();
+    // 保存した設定を消す（次の起動から既定値）
+    bool erase();
+    void resetToDefaults();
+
+    uint32_t notifyPeriodMs() const { return periodMs; }
+    const char* deviceName() const { return name; }
+    // field は CONFIG_SERVICE_UUID〜CONFIG_STATS_UUID
+    const hal::Uuid& uuid(ConfigField field) const { return uuids[(field - CONFIG_SERVICE_UUID) % kUuidCount]; }
+    // 保存すれば再起動で効く変更がある
+    bool restartPending() const { return pendingRestart; }
+
+    // CMD_CONFIG_GET / CMD_CONFIG_SET / CMD_CONFIG_SAVE を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    static uint32_t crc32(const uint8_t* data, size_t len);
+
+private:
+    static void cmdGet(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdSet(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdSave(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::FileStore* fileStore = nullptr;
+    TriggerTable* triggers = nullptr;
+    bool pendingRestart = false;
+
+    uint32_t periodMs;
+    char name[kMaxNameLength + 1];
+    hal::Uuid uuids[kUuidCount];
+};
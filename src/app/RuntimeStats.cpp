@@ -0,0 +1,67 @@
+#include "app/RuntimeStats.h"
+
+void RuntimeStats::storeMax(std::atomic<uint32_t>& target, uint32_t value) {
+    uint32_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void RuntimeStats::recordConnect(uint32_t nowMs) {
+    connects.fetch_add(1, std::memory_order_relaxed);
+    connectedAtMs.store(nowMs, std::memory_order_relaxed);
+    waitingFirstNotify.store(true, std::memory_order_relaxed);
+    if (waitingReconnect.exchange(false, std::memory_order_relaxed)) {
+        uint32_t duration = nowMs - disconnectedAtMs.load(std::memory_order_relaxed);
+        lastReconnectMs.store(duration, std::memory_order_relaxed);
+        storeMax(maxReconnectMs, duration);
+    }
+}
+
+void RuntimeStats::recordFirstNotify(uint32_t nowMs) {
+    if (waitingFirstNotify.exchange(false, std::memory_order_relaxed)) {
+        uint32_t duration = nowMs - connectedAtMs.load(std::memory_order_relaxed);
+        firstNotifyMs.store(duration, std::memory_order_relaxed);
+        storeMax(maxFirstNotifyMs, duration);
+    }
+}
+
+void RuntimeStats::recordDisconnect(uint32_t nowMs) {
+    waitingFirstNotify.store(false, std::memory_order_relaxed);
+    disconnects.fetch_add(1, std::memory_order_relaxed);
+    disconnectedAtMs.store(nowMs, std::memory_order_relaxed);
+    waitingReconnect.store(true, std::memory_order_relaxed);
+}
+
+void RuntimeStats::snapshot(uint32_t uptimeMs, StatsPayload& out) const {
+    out.version = StatsPayload::kVersion;
+    out.reserved[0] = out.reserved[1] = out.reserved[2] = 0;
+    out.uptimeMs = uptimeMs;
+    out.notifiesSent = notifiesSent.load(std::memory_order_relaxed);
+    out.bytesSent = bytesSent.load(std::memory_order_relaxed);
+    out.drops = drops.load(std::memory_order_relaxed);
+    out.writesReceived = writesReceived.load(std::memory_order_relaxed);
+    out.bytesReceived = bytesReceived.load(std::memory_order_relaxed);
+    out.connects = connects.load(std::memory_order_relaxed);
+    out.disconnects = disconnects.load(std::memory_order_relaxed);
+    out.lastReconnectMs = lastReconnectMs.load(std::memory_order_relaxed);
+    out.maxReconnectMs = maxReconnectMs.load(std::memory_order_relaxed);
+    out.loopStallMaxUs = loopStallMaxUs.load(std::memory_order_relaxed);
+    out.firstNotifyMs = firstNotifyMs.load(std::memory_order_relaxed);
+    out.maxFirstNotifyMs = maxFirstNotifyMs.load(std::memory_order_relaxed);
+}
+
+// 接続状態（再接続待ちかどうか）は残して、カウンタだけ 0 に戻す
+void RuntimeStats::reset() {
+    notifiesSent.store(0, std::memory_order_relaxed);
+    bytesSent.store(0, std::memory_order_relaxed);
+    drops.store(0, std::memory_order_relaxed);
+    writesReceived.store(0, std::memory_order_relaxed);
+    bytesReceived.store(0, std::memory_order_relaxed);
+    connects.store(0, std::memory_order_relaxed);
+    disconnects.store(0, std::memory_order_relaxed);
+    lastReconnectMs.store(0, std::memory_order_relaxed);
+    maxReconnectMs.store(0, std::memory_order_relaxed);
+    loopStallMaxUs.store(0, std::memory_order_relaxed);
+    firstNotifyMs.store(0, std::memory_order_relaxed);
+    maxFirstNotifyMs.store(0, std::memory_order_relaxed);
+}
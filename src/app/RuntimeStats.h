@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "app/CharPayloads.h"
+
+/**
+ * 実行時統計カウンタ
+ * - BLE タスクと loop() の両方から更新されるので、すべて relaxed アトミックで数える
+ *   （カウンタ同士の整合性は保証しない。読み出し時点のおおよその値でよい）
+ * - snapshot() で統計キャラクタリスティックの値（StatsPayload。app/CharPayloads.h）を作る
+ */
+
+class RuntimeStats {
+public:
+    void recordNotify(uint32_t bytes, uint32_t nowMs) {
+        notifiesSent.fetch_add(1, std::memory_order_relaxed);
+        bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+        if (waitingFirstNotify.load(std::memory_order_relaxed)) {
+            recordFirstNotify(nowMs);
+        }
+    }
+
+    void recordDrop() { drops.fetch_add(1, std::memory_order_relaxed); }
+
+    void recordWrite(uint32_t bytes) {
+        writesReceived.fetch_add(1, std::memory_order_relaxed);
+        bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // 前回の切断からの時間を再接続時間として記録する。接続から最初の Notify までの時間も測り始める
+    void recordConnect(uint32_t nowMs);
+    void recordDisconnect(uint32_t nowMs);
+
+    void recordLoopInterval(uint32_t us) { storeMax(loopStallMaxUs, us); }
+
+    void snapshot(uint32_t uptimeMs, StatsPayload& out) const;
+    void reset();
+
+private:
+    static void storeMax(std::atomic<uint32_t>& target, uint32_t value);
+    void recordFirstNotify(uint32_t nowMs);
+
+    std::atomic<uint32_t> notifiesSent{0};
+    std::atomic<uint32_t> bytesSent{0};
+    std::atomic<uint32_t> drops{0};
+    std::atomic<uint32_t> writesReceived{0};
+    std::atomic<uint32_t> bytesReceived{0};
+    std::atomic<uint32_t> connects{0};
+    std::atomic<uint32_t> disconnects{0};
+    std::atomic<uint32_t> lastReconnectMs{0};
+    std::atomic<uint32_t> maxReconnectMs{0};
+    std::atomic<uint32_t> loopStallMaxUs{0};
+    std::atomic<uint32_t> firstNotifyMs{0};
+    std::atomic<uint32_t> maxFirstNotifyMs{0};
+
+    std::atomic<uint32_t> disconnectedAtMs{0};
+    std::atomic<bool> waitingReconnect{false};
+    std::atomic<uint32_t> connectedAtMs{0};
+    std::atomic<bool> waitingFirstNotify{false};
+};
@@ -0,0 +1,120 @@
+#include "app/SpectrumAnalyzer.h"
+
+#include <cmath>
+
+bool SpectrumAnalyzer::configure(const SpectrumConfig& config, uint32_t sampleRate, dsp::Backend backend) {
+    uint8_t d = config.decimation;
+    if ((d != 1 && d != 2 && d != 4 && d != 8) || config.average == 0 || config.average > kMaxAverage ||
+        (config.fftSize != 64 && config.fftSize != 128 && config.fftSize != 256) || sampleRate == 0) {
+        return false;
+    }
+    uint32_t rate = sampleRate / d;
+    if (config.filter > SPECTRUM_FILTER_HIGHPASS ||
+        (config.filter != SPECTRUM_FILTER_NONE && (config.cutoffHz == 0 || config.cutoffHz * 2u >= rate))) {
+        return false;
+    }
+
+    // 間引き後のナイキスト周波数の 9 割を通す
+    float coeffs[kFirTaps];
+    dsp::designLowpass(0.45f / static_cast<float>(d), coeffs, kFirTaps);
+    if (!fir.init(coeffs, kFirTaps, d, backend) || !fft.init(config.fftSize, backend)) {
+        return false;
+    }
+    float cutoff = static_cast<float>(config.cutoffHz) / static_cast<float>(rate);
+    if (config.filter == SPECTRUM_FILTER_LOWPASS) {
+        biquad.setLowpass(cutoff, 0.7071f);
+    } else if (config.filter == SPECTRUM_FILTER_HIGHPASS) {
+        biquad.setHighpass(cutoff, 0.7071f);
+    }
+    biquad.setBackend(backend);
+
+    settings = config;
+    fftSize = config.fftSize;
+    outRate = rate;
+    reset();
+    return true;
+}
+
+void SpectrumAnalyzer::reset() {
+    fir.reset();
+    biquad.reset();
+    for (float& p : power) {
+        p = 0.0f;
+    }
+    filled = 0;
+    frames = 0;
+    consumed = 0;
+    blockFirstSample = 0;
+    hasSpectrum = false;
+}
+
+size_t SpectrumAnalyzer::feed(const int16_t* samples, size_t count) {
+    size_t d = settings.decimation;
+    size_t used = 0;
+    while (used < count && !hasSpectrum) {
+        size_t n = (fftSize - filled) * d;
+        n = n < count - used ? n : count - used;
+        n = n < kChunk ? n : kChunk;
+        n -= n % d;
+        if (n == 0) {
+            break;  // decimation の倍数でない端数は受け取らない
+        }
+        for (size_t i = 0; i < n; ++i) {
+            input[i] = static_cast<float>(samples[used + i]) * (1.0f / 32768.0f);
+        }
+        float* out = frame + filled;
+        size_t produced;
+        if (d > 1) {
+            produced = fir.process(input, n, out);
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = input[i];
+            }
+            produced = n;
+        }
+        if (settings.filter != SPECTRUM_FILTER_NONE) {
+            biquad.process(out, out, produced);
+        }
+        filled += produced;
+        used += n;
+        consumed += static_cast<uint32_t>(n);
+        if (filled == fftSize) {
+            finishFrame();
+        }
+    }
+    return used;
+}
+
+void SpectrumAnalyzer::finishFrame() {
+    fft.magnitude(frame, magnitude);
+    size_t bins = fftSize / 2;
+    for (size_t k = 0; k < bins; ++k) {
+        power[k] += magnitude[k] * magnitude[k];
+    }
+    filled = 0;
+    if (++frames < settings.average) {
+        return;
+    }
+
+    // 振幅の 2 乗で平均する（位相がずれたフレームでも打ち消し合わない）
+    float scale = 1.0f / static_cast<float>(frames);
+    for (size_t k = 0; k < bins; ++k) {
+        quantized[k] = quantize(std::sqrt(power[k] * scale));
+        power[k] = 0.0f;
+    }
+    frames = 0;
+    spectrumFirstSample = blockFirstSample;
+    blockFirstSample = consumed;
+    hasSpectrum = true;
+}
+
+uint8_t SpectrumAnalyzer::quantize(float amplitude) {
+    if (amplitude <= 1e-6f) {
+        return 0;
+    }
+    float v = 2.0f * (20.0f * std::log10(amplitude) + 120.0f);
+    if (v <= 0.0f) {
+        return 0;
+    }
+    return v >= 255.0f ? 255 : static_cast<uint8_t>(v + 0.5f);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/Dsp.h"
+
+/**
+ * PCM を間引き → フィルタ → FFT して、平均した振幅スペクトルを 1 バイト/ビンにする
+ *
+ *   int16 PCM ─ FIR ローパス + 1/decimation ─ biquad（任意）─ Hann 窓 + FFT ─ average フレームの平均
+ *
+ * ビンの値は 0.5 dB 刻みの dBFS：value = 2 × (20 log10(振幅 / 32768) + 120)（0〜255 に丸める）
+ * つまり 0 が -120 dBFS 以下、240 がフルスケールの正弦波。
+ * フレームは重ねない（fftSize × decimation 入力サンプルごとに 1 フレーム）。
+ */
+
+struct SpectrumConfig {
+    uint8_t decimation;  // 1 / 2 / 4 / 8
+    uint8_t filter;      // SpectrumFilter
+    uint16_t cutoffHz;   // filter のカットオフ（間引き後のナイキスト周波数未満）
+    uint16_t fftSize;    // 64 / 128 / 256
+    uint8_t average;     // 1 レコードに平均するフレーム数（1〜16）
+};
+
+enum SpectrumFilter : uint8_t {
+    SPECTRUM_FILTER_NONE = 0,
+    SPECTRUM_FILTER_LOWPASS = 1,
+    SPECTRUM_FILTER_HIGHPASS = 2,
+};
+
+class SpectrumAnalyzer {
+public:
+    static constexpr size_t kMaxBins = dsp::kMaxFftSize / 2;
+    static constexpr size_t kFirTaps = 32;
+    static constexpr uint8_t kMaxAverage = 16;
+
+    // 設定がおかしい・backend が使えなければ false
+    bool configure(const SpectrumConfig& config, uint32_t sampleRate, dsp::Backend backend);
+    void reset();
+
+    // samples（decimation の倍数）を取り込む。スペクトルが揃ったらそこで止め、消費したサンプル数を返す
+    size_t feed(const int16_t* samples, size_t count);
+
+    // feed() でスペクトルが揃ったら true。bins() を読んだら consume() で次に進める
+    bool ready() const { return hasSpectrum; }
+    void consume() { hasSpectrum = false; }
+    const uint8_t* bins() const { return quantized; }
+    size_t binCount() const { return fftSize / 2; }
+
+    // 揃ったスペクトルの最初の入力サンプルの通番（reset() から数える）
+    uint32_t firstSample() const { return spectrumFirstSample; }
+    uint32_t outputRate() const { return outRate; }
+    const SpectrumConfig& config() const { return settings; }
+
+    static uint8_t quantize(float amplitude);
+
+private:
+    static constexpr size_t kChunk = 128;  // 1 回に変換する入力サンプル数
+
+    void finishFrame();
+
+    SpectrumConfig settings = {};
+    size_t fftSize = 0;
+    uint32_t outRate = 0;
+    dsp::FirDecimator fir;
+    dsp::Biquad biquad;
+    dsp::Fft fft;
+
+    float input[kChunk];
+    float frame[dsp::kMaxFftSize];
+    float magnitude[kMaxBins];
+    float power[kMaxBins];
+    uint8_t quantized[kMaxBins];
+    size_t filled = 0;
+    uint8_t frames = 0;
+    uint32_t consumed = 0;
+    uint32_t blockFirstSample = 0;
+    uint32_t spectrumFirstSample = 0;
+    bool hasSpectrum = false;
+};
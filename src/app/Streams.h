@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// ストリーム用キャラクタリスティックで送るレコードの種類（FrameCodec の stream）
+enum StreamId : uint8_t {
+    STREAM_HEARTBEAT = 0,  // [counter u32]
+    STREAM_TRACE = 1,      // 受信トレースのダンプ [offset u32][bytes]
+    STREAM_TIMELINE = 2,   // タイムラインのダンプ [offset u32][bytes]
+    STREAM_IMU = 3,        // IMU サンプル（形式は app/ImuStream.h）
+    STREAM_AUDIO = 4,      // IMA-ADPCM 音声（形式は app/AudioStream.h）
+    STREAM_CAMERA = 5,     // JPEG のチャンク（形式は app/CameraStream.h）
+    STREAM_TOUCH = 6,      // タッチイベント（優先レーン、形式は app/TouchStream.h）
+    STREAM_ORIENTATION = 7,  // 姿勢クォータニオン（形式は app/OrientationStream.h）
+    STREAM_IMU_DELTA = 8,    // 差分符号化した IMU サンプル（形式は app/ImuStream.h）
+    STREAM_CLOCK = 9,        // パケット先頭の同期時刻 [deviceUs u32][centralUs u64]（app/ClockSync.h）
+    STREAM_SPECTRUM = 10,    // 音声の振幅スペクトル（形式は app/AudioStream.h）
+    STREAM_BACKLOG = 11,     // 切断中に溜めたレコードの再生（形式は app/Backlog.h）
+    STREAM_LOG = 12,         // 時系列ログの問い合わせの結果（形式は app/RecordLog.h）
+};
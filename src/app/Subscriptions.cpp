@@ -0,0 +1,64 @@
+#include "app/Subscriptions.h"
+
+#include "diag/Profiler.h"
+
+void Subscriptions::set(hal::CharId ch, bool enabled) {
+    if (ch >= 16) {
+        return;
+    }
+    uint16_t bit = static_cast<uint16_t>(1u << ch);
+    if (enabled) {
+        bits.fetch_or(bit);
+    } else {
+        bits.fetch_and(static_cast<uint16_t>(~bit));
+    }
+    changes.fetch_add(1);
+}
+
+void Subscriptions::recordActive(uint32_t elapsedTicks) {
+    ++activeLoops;
+    producerTicks += elapsedTicks;
+}
+
+SubscriptionStats Subscriptions::stats() const {
+    SubscriptionStats s = {};
+    s.activeLoops = activeLoops;
+    s.gatedLoops = gatedLoops;
+    if (activeLoops > 0) {
+        uint64_t avgNs = producerTicks * 1000 / profiler::ticksPerMicrosecond() / activeLoops;
+        s.producerAvgUs = static_cast<uint32_t>(avgNs / 1000);
+        s.savedUs = static_cast<uint32_t>(avgNs * gatedLoops / 1000);
+    }
+    s.changes = changes.load();
+    return s;
+}
+
+void Subscriptions::resetStats() {
+    activeLoops = 0;
+    gatedLoops = 0;
+    producerTicks = 0;
+    changes.store(0);
+}
+
+void Subscriptions::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_SUBSCRIPTIONS, &Subscriptions::cmdStatus, this);
+}
+
+// [reset u8] → [mask u16][activeLoops u32][gatedLoops u32][producerAvgUs u32][savedUs u32][changes u32]
+void Subscriptions::cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    Subscriptions* self = static_cast<Subscriptions*>(context);
+    if (len != 1) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    SubscriptionStats s = self->stats();
+    reply.appendU16(self->mask());
+    reply.appendU32(s.activeLoops);
+    reply.appendU32(s.gatedLoops);
+    reply.appendU32(s.producerAvgUs);
+    reply.appendU32(s.savedUs);
+    reply.appendU32(s.changes);
+    if (args[0] != 0) {
+        self->resetStats();
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CommandDispatcher.h"
+#include "hal/BlePeripheral.h"
+
+/**
+ * セントラルが CCCD（0x2902）で Notify を有効にしているキャラクタリスティック
+ * - set() は BLE タスク（BleListener::onSubscribeChanged）から、enabled() は loop() から呼ぶ
+ * - CCCD は接続ごとの値（ボンディングしないセントラルは接続するたびに書き直す）なので、接続したら reset() する
+ * - BleApp は購読されていないキャラクタリスティックの値を作らない。ストリームのプロデューサ
+ *   （IMU・音声・姿勢・カメラ・タッチ）はストリーム用キャラクタリスティックが購読されているか、
+ *   時系列ログに記録している間だけ動かす
+ * - 浮いた CPU 時間は、動かしていたときのプロデューサの 1 loop() あたりの平均 × 止めていた loop() の数で見積もる
+ */
+
+struct SubscriptionStats {
+    uint32_t activeLoops;    // 接続中にプロデューサを動かした loop()
+    uint32_t gatedLoops;     // 購読されていないのでプロデューサを止めた loop()
+    uint32_t producerAvgUs;  // 動かしたときの 1 loop() あたりのプロデューサの時間
+    uint32_t savedUs;        // gatedLoops × producerAvgUs（見積もり）
+    uint32_t changes;        // CCCD の書き込み
+};
+
+class Subscriptions {
+public:
+    // 接続したとき（どのキャラクタリスティックも未購読に戻す）
+    void reset() { bits.store(0); }
+    void set(hal::CharId ch, bool enabled);
+    bool enabled(hal::CharId ch) const { return ch < 16 && (bits.load() & (1u << ch)) != 0; }
+    uint16_t mask() const { return bits.load(); }
+
+    // loop() ごとに、プロデューサを動かした時間（profiler::ticks()）か止めたことを記録する
+    void recordActive(uint32_t elapsedTicks);
+    void recordGated() { ++gatedLoops; }
+    SubscriptionStats stats() const;
+    void resetStats();
+
+    // CMD_SUBSCRIPTIONS を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+private:
+    static void cmdStatus(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    std::atomic<uint16_t> bits{0};
+    std::atomic<uint32_t> changes{0};
+    uint32_t activeLoops = 0;
+    uint32_t gatedLoops = 0;
+    uint64_t producerTicks = 0;
+};
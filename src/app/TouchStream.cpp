@@ -0,0 +1,100 @@
+#include "app/TouchStream.h"
+
+#include "app/Streams.h"
+#include "app/Wire.h"
+
+size_t TouchStream::encodeRecord(const hal::TouchEvent& event, uint8_t* out) {
+    wire::putU32(out, event.timestampUs);
+    wire::putU16(out + 4, static_cast<uint16_t>(event.x));
+    wire::putU16(out + 6, static_cast<uint16_t>(event.y));
+    out[8] = static_cast<uint8_t>(event.type);
+    out[9] = event.id;
+    return kRecordSize;
+}
+
+void TouchStream::poll(bool connected) {
+    if (touch == nullptr) {
+        return;
+    }
+    hal::TouchEvent events[8];
+    size_t n;
+    while ((n = touch->read(events, 8)) > 0) {
+        if (!connected) {
+            continue;
+        }
+        uint32_t now = clock.micros();
+        for (size_t i = 0; i < n; ++i) {
+            ++counters.events;
+            uint32_t detect = now - events[i].timestampUs;
+            ++detected;
+            detectSumUs += detect;
+            counters.detectAvgUs = static_cast<uint32_t>(detectSumUs / detected);
+            if (detect > counters.detectMaxUs) {
+                counters.detectMaxUs = detect;
+            }
+
+            uint8_t record[kRecordSize];
+            encodeRecord(events[i], record);
+            if (!scheduler.enqueueUrgent(STREAM_TOUCH, record, sizeof(record))) {
+                ++counters.dropped;
+                continue;
+            }
+            // 計測待ちがあふれたら古いものから諦める（イベント自体は送る）
+            if (pendingCount == kMaxPending) {
+                pendingHead = (pendingHead + 1) % kMaxPending;
+                --pendingCount;
+            }
+            pending[(pendingHead + pendingCount) % kMaxPending] = {scheduler.urgentQueued(), events[i].timestampUs};
+            ++pendingCount;
+        }
+    }
+    counters.overflows = touch->overflows() - overflowBase;
+}
+
+void TouchStream::afterSend() {
+    uint32_t now = clock.micros();
+    while (pendingCount > 0 &&
+           static_cast<int32_t>(scheduler.urgentSent() - pending[pendingHead].position) >= 0) {
+        uint32_t latency = now - pending[pendingHead].timestampUs;
+        ++counters.measured;
+        latencySumUs += latency;
+        counters.latencyLastUs = latency;
+        counters.latencyAvgUs = static_cast<uint32_t>(latencySumUs / counters.measured);
+        if (latency > counters.latencyMaxUs) {
+            counters.latencyMaxUs = latency;
+        }
+        pendingHead = (pendingHead + 1) % kMaxPending;
+        --pendingCount;
+    }
+}
+
+void TouchStream::resetStats() {
+    counters = {};
+    detectSumUs = 0;
+    latencySumUs = 0;
+    detected = 0;
+    overflowBase = touch != nullptr ? touch->overflows() : 0;
+}
+
+void TouchStream::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_TOUCH_STATS, &TouchStream::cmdStats, this);
+}
+
+void TouchStream::cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    TouchStream* self = static_cast<TouchStream*>(context);
+    if (len > 1 || (len == 1 && args[0] > 1)) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    const TouchStreamStats& s = self->counters;
+    reply.appendU32(s.events);
+    reply.appendU32(s.dropped);
+    reply.appendU32(s.overflows);
+    reply.appendU32(s.detectAvgUs);
+    reply.appendU32(s.detectMaxUs);
+    reply.appendU32(s.latencyAvgUs);
+    reply.appendU32(s.latencyMaxUs);
+    if (len == 1 && args[0] == 1) {
+        self->resetStats();
+    }
+}
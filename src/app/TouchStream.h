@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CommandDispatcher.h"
+#include "app/NotifyScheduler.h"
+#include "hal/Clock.h"
+#include "hal/Touch.h"
+
+/**
+ * タッチイベントを STREAM_TOUCH のレコードにして NotifyScheduler の優先レーンで送る
+ *
+ * レコード（リトルエンディアン、10 byte）
+ *   u32 timestampUs  割り込みを受けた時刻
+ *   i16 x, y
+ *   u8  type         hal::TouchType（0=Down 1=Move 2=Up）
+ *   u8  id
+ *
+ * レイテンシは割り込みの時刻から数える
+ * - detect: loop() がイベントを読み出すまで
+ * - total : そのレコードを載せたパケットの notify() が通るまで
+ *
+ * poll() → NotifyScheduler::tickUrgent() → afterSend() の順に loop() から呼ぶこと。
+ */
+
+struct TouchStreamStats {
+    uint32_t events;
+    uint32_t dropped;    // 優先レーン満杯で捨てたイベント
+    uint32_t overflows;  // 読み出しが追いつかず HAL 側で捨てた割り込み
+    uint32_t measured;
+    uint32_t detectAvgUs;
+    uint32_t detectMaxUs;
+    uint32_t latencyLastUs;
+    uint32_t latencyAvgUs;
+    uint32_t latencyMaxUs;
+};
+
+class TouchStream {
+public:
+    static constexpr size_t kRecordSize = 10;
+
+    TouchStream(hal::Clock& clock, NotifyScheduler& scheduler) : clock(clock), scheduler(scheduler) {}
+
+    void setTouch(hal::TouchInput* touch) { this->touch = touch; }
+    // タッチは取り付けてあれば常に読み出している
+    bool isAttached() const { return touch != nullptr; }
+
+    // イベントを読み出して優先レーンに積む（未接続なら読み捨てる）
+    void poll(bool connected);
+
+    // 送信済みになったイベントのレイテンシを集計する
+    void afterSend();
+
+    // CMD_TOUCH_STATS を登録する（[reset u8] → 統計。reset=1 なら返した後に 0 に戻す）
+    void registerCommands(CommandDispatcher& dispatcher);
+
+    const TouchStreamStats& stats() const { return counters; }
+    void resetStats();
+
+    static size_t encodeRecord(const hal::TouchEvent& event, uint8_t* out);
+
+private:
+    static constexpr size_t kMaxPending = 16;
+
+    struct Pending {
+        uint32_t position;  // NotifyScheduler::urgentQueued() の値
+        uint32_t timestampUs;
+    };
+
+    static void cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    NotifyScheduler& scheduler;
+    hal::TouchInput* touch = nullptr;
+
+    Pending pending[kMaxPending];
+    uint8_t pendingHead = 0;
+    uint8_t pendingCount = 0;
+    uint64_t detectSumUs = 0;
+    uint64_t latencySumUs = 0;
+    uint32_t detected = 0;
+    uint32_t overflowBase = 0;
+
+    TouchStreamStats counters = {};
+};
@@ -0,0 +1,135 @@
+#include "app/TriggerTable.h"
+
+#include "app/AppConfig.h"
+#include "app/Streams.h"
+#include "app/Wire.h"
+
+bool TriggerTable::supports(uint8_t stream) {
+    switch (stream) {
+        case STREAM_HEARTBEAT:
+        case STREAM_IMU:
+        case STREAM_IMU_DELTA:
+        case STREAM_ORIENTATION:
+        case STREAM_SPECTRUM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void TriggerTable::reset() {
+    for (Slot& slot : slots) {
+        slot = {};
+        slot.rule = {TriggerMode::Always, 0.0f, 0};
+    }
+    // 以前の固定周期の Notify と同じ
+    slots[STREAM_HEARTBEAT].rule = {TriggerMode::HeartbeatOnly, 0.0f, heartbeatPeriodMs};
+}
+
+void TriggerTable::setHeartbeatPeriod(uint32_t ms) {
+    heartbeatPeriodMs = ms;
+    slots[STREAM_HEARTBEAT].rule.heartbeatMs = ms;
+}
+
+bool TriggerTable::setRule(uint8_t stream, const TriggerRule& rule) {
+    if (!supports(stream) || rule.mode > TriggerMode::Edge) {
+        return false;
+    }
+    if (stream == STREAM_HEARTBEAT && rule.mode != TriggerMode::HeartbeatOnly) {
+        return false;
+    }
+    Slot& slot = slots[stream];
+    slot = {};
+    slot.rule = rule;
+    slot.sentMs = clock.millis();
+    return true;
+}
+
+bool TriggerTable::admit(uint8_t stream, float level) {
+    if (stream >= kMaxStreams) {
+        return true;
+    }
+    Slot& slot = slots[stream];
+    const TriggerRule& rule = slot.rule;
+    uint32_t now = clock.millis();
+
+    bool fire = false;
+    switch (rule.mode) {
+        case TriggerMode::Always:
+            fire = true;
+            break;
+        case TriggerMode::HeartbeatOnly:
+            break;
+        case TriggerMode::OnChange: {
+            float change = level - slot.sentLevel;
+            fire = !slot.hasSent || change >= rule.threshold || -change >= rule.threshold;
+            break;
+        }
+        case TriggerMode::Rising:
+        case TriggerMode::Falling:
+        case TriggerMode::Edge: {
+            bool rising = slot.hasLevel && slot.lastLevel < rule.threshold && level >= rule.threshold;
+            bool falling = slot.hasLevel && slot.lastLevel >= rule.threshold && level < rule.threshold;
+            fire = (rule.mode != TriggerMode::Falling && rising) || (rule.mode != TriggerMode::Rising && falling);
+            break;
+        }
+    }
+    slot.lastLevel = level;
+    slot.hasLevel = true;
+
+    // 何も送っていなければ、reset() 後は起動時から、setRule() 後はその時点から数える
+    bool heartbeat = !fire && rule.heartbeatMs > 0 && now - slot.sentMs >= rule.heartbeatMs;
+    if (!fire && !heartbeat) {
+        // STREAM_HEARTBEAT は毎ループ問い合わせるだけなので数えない
+        if (stream != STREAM_HEARTBEAT) {
+            ++slot.counters.suppressed;
+        }
+        return false;
+    }
+    if (heartbeat) {
+        ++slot.counters.heartbeats;
+    }
+    ++slot.counters.admitted;
+    slot.hasSent = true;
+    slot.sentLevel = level;
+    slot.sentMs = now;
+    return true;
+}
+
+void TriggerTable::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_TRIGGER_SET, &TriggerTable::cmdSet, this);
+    dispatcher.registerHandler(CMD_TRIGGER_STATS, &TriggerTable::cmdStats, this);
+}
+
+// [stream u8][mode u8][thresholdX1000 i32][heartbeatMs u32]
+void TriggerTable::cmdSet(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    TriggerTable* self = static_cast<TriggerTable*>(context);
+    if (len != 10) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    TriggerRule rule;
+    rule.mode = static_cast<TriggerMode>(args[1]);
+    rule.threshold = static_cast<float>(static_cast<int32_t>(wire::getU32(args + 2))) / 1000.0f;
+    rule.heartbeatMs = wire::getU32(args + 6);
+    if (!self->setRule(args[0], rule)) {
+        reply.status = CommandStatus::BadArguments;
+    }
+}
+
+// [stream u8][reset u8] → [mode u8][admitted u32][suppressed u32][heartbeats u32]
+void TriggerTable::cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    TriggerTable* self = static_cast<TriggerTable*>(context);
+    if (len != 2 || !supports(args[0])) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    Slot& slot = self->slots[args[0]];
+    reply.appendU8(static_cast<uint8_t>(slot.rule.mode));
+    reply.appendU32(slot.counters.admitted);
+    reply.appendU32(slot.counters.suppressed);
+    reply.appendU32(slot.counters.heartbeats);
+    if (args[1] != 0) {
+        slot.counters = {};
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/CommandDispatcher.h"
+#include "hal/Clock.h"
+
+/**
+ * ストリームごとの送信条件（トリガー）
+ * レコードを積む前に、ストリームが決めたスカラーの「レベル」を admit() に渡し、
+ * false ならそのレコードは作らない（符号化も省く）。
+ *
+ *   Always        すべて送る（既定）
+ *   HeartbeatOnly heartbeatMs ごとに 1 つだけ送る
+ *   OnChange      最後に送ったときのレベルから threshold 以上変わったら送る（最初の 1 つは必ず送る）
+ *   Rising        レベルが threshold を下から上に横切ったら送る
+ *   Falling       レベルが threshold を上から下に横切ったら送る
+ *   Edge          Rising と Falling の両方
+ * heartbeatMs（0 なら無効）だけ何も送っていなければ、条件に関係なく送る。
+ *
+ * トリガーを付けられるストリームとレベル
+ *   STREAM_HEARTBEAT    常に 0（HeartbeatOnly だけ。heartbeatMs = 0 で止める。既定は setHeartbeatPeriod() の周期）
+ *   STREAM_IMU / _DELTA FIFO から 1 回に読んだサンプルの | |加速度| - 1 g | の最大値 [g]
+ *   STREAM_ORIENTATION  レコードの最後の姿勢の傾き（鉛直からの角度）[deg]
+ *   STREAM_SPECTRUM     スペクトルの最大のビン [dBFS]
+ * 送らなかったレコードは欠落と同じに見える（通番が飛ぶ）。差分符号化の IMU は次をキーフレームにする。
+ *
+ * 切断時に reset() で既定のルールに戻す。admit() は loop() のタスクから呼ぶこと。
+ */
+
+enum class TriggerMode : uint8_t {
+    Always = 0,
+    HeartbeatOnly = 1,
+    OnChange = 2,
+    Rising = 3,
+    Falling = 4,
+    Edge = 5,
+};
+
+struct TriggerRule {
+    TriggerMode mode;
+    float threshold;
+    uint32_t heartbeatMs;
+};
+
+struct TriggerStats {
+    uint32_t admitted;    // 送ったレコード（heartbeats を含む）
+    uint32_t suppressed;  // 条件を満たさず作らなかったレコード
+    uint32_t heartbeats;  // 条件を満たさなかったが heartbeatMs で送ったレコード
+};
+
+class TriggerTable {
+public:
+    static constexpr size_t kMaxStreams = 16;
+
+    explicit TriggerTable(hal::Clock& clock) : clock(clock) { reset(); }
+
+    // 全ストリームを既定のルールに戻し、統計も消す
+    void reset();
+    // STREAM_HEARTBEAT の既定の周期（最初は NOTIFY_PERIOD_MS）。いまのルールにもすぐ反映する
+    void setHeartbeatPeriod(uint32_t ms);
+
+    // トリガーを付けられないストリーム・ルールなら false
+    bool setRule(uint8_t stream, const TriggerRule& rule);
+    const TriggerRule& rule(uint8_t stream) const { return slots[stream % kMaxStreams].rule; }
+
+    // Always 以外のルールが付いている（レベルを計算する必要がある）
+    bool gated(uint8_t stream) const { return stream < kMaxStreams && slots[stream].rule.mode != TriggerMode::Always; }
+
+    // level でレコードを送るなら true
+    bool admit(uint8_t stream, float level);
+
+    const TriggerStats& stats(uint8_t stream) const { return slots[stream % kMaxStreams].counters; }
+
+    static bool supports(uint8_t stream);
+
+    // CMD_TRIGGER_SET / CMD_TRIGGER_STATS を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+private:
+    struct Slot {
+        TriggerRule rule;
+        bool hasSent;
+        bool hasLevel;
+        float sentLevel;  // 最後に送ったときのレベル
+        float lastLevel;  // 最後に評価したレベル
+        uint32_t sentMs;
+        TriggerStats counters;
+    };
+
+    static void cmdSet(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    uint32_t heartbeatPeriodMs = NOTIFY_PERIOD_MS;
+    Slot slots[kMaxStreams];
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/CharPayloads.h"
+#include "hal/BlePeripheral.h"
+
+/**
+ * 固定長の値を持つキャラクタリスティック
+ * - T は app/CharPayloads.h の packed の構造体。値の大きさ（kSize）はコンパイル時に決まり、
+ *   文字列への整形や実行時の大きさの計算をせずに、構造体のバイト列をそのまま属性の値にする
+ * - 読む側は payload::decode<T>() で同じ構造体に戻す
+ */
+template <typename T>
+class TypedCharacteristic {
+public:
+    static_assert(payload::isFixedLayout<T>(), "TypedCharacteristic needs a packed trivially copyable struct");
+    static constexpr size_t kSize = sizeof(T);
+
+    explicit TypedCharacteristic(hal::BlePeripheral& ble) : ble(ble) {}
+
+    // addCharacteristic() で作った CharId に結び付ける
+    void bind(hal::CharId ch) { id = ch; }
+    hal::CharId charId() const { return id; }
+
+    void set(const T& value) { ble.setValue(id, reinterpret_cast<const uint8_t*>(&value), kSize); }
+    // 値を入れて Notify する。BLE スタックが受け付けなければ false
+    bool notify(const T& value) {
+        set(value);
+        return ble.notify(id);
+    }
+
+private:
+    hal::BlePeripheral& ble;
+    hal::CharId id = hal::kInvalidId;
+};
@@ -0,0 +1,243 @@
+#include "app/WriteBehind.h"
+
+#include <cstring>
+
+#include "app/Wire.h"
+
+void WriteBehind::setBacking(hal::FileStore* backingStore) {
+    store = backingStore;
+    stagedPath[0] = '\0';
+    stagedBytes = 0;
+    committedSize = 0;
+    if (store != nullptr) {
+        size_t block = store->blockSize();
+        chunk = block > 0 && block < kMaxBlockSize ? block : kMaxBlockSize;
+    }
+}
+
+void WriteBehind::setMode(WriteMode mode, uint32_t delayMs) {
+    writeMode = mode;
+    maxDelayMs = delayMs;
+}
+
+bool WriteBehind::due(uint32_t sinceMs) const {
+    switch (writeMode) {
+        case WriteMode::Batched:
+            return false;
+        case WriteMode::Timed:
+            return clock.millis() - sinceMs >= maxDelayMs;
+        case WriteMode::Immediate:
+            return true;
+    }
+    return false;
+}
+
+void WriteBehind::poll() {
+    if (stagedBytes > 0 && due(stagedSinceMs)) {
+        commit();
+    }
+}
+
+uint16_t WriteBehind::amplificationX100() const {
+    if (counters.logicalBytes == 0) {
+        return 0;
+    }
+    uint64_t ratio = static_cast<uint64_t>(counters.programmedBytes) * 100 / counters.logicalBytes;
+    return ratio > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(ratio);
+}
+
+bool WriteBehind::isStaged(const char* path) const {
+    return stagedPath[0] != '\0' && std::strcmp(stagedPath, path) == 0;
+}
+
+// 溜めている分を下の FileStore に追記する。書けなければ溜めていた分は捨てる
+bool WriteBehind::commit() {
+    if (stagedBytes == 0) {
+        return true;
+    }
+    uint32_t startUs = clock.micros();
+    bool ok = store->append(stagedPath, buffer, stagedBytes);
+    if (ok) {
+        recordCommit(committedSize, stagedBytes, startUs);
+        committedSize += static_cast<uint32_t>(stagedBytes);
+    } else {
+        int32_t size = store->size(stagedPath);
+        committedSize = size > 0 ? static_cast<uint32_t>(size) : 0;
+    }
+    stagedBytes = 0;
+    return ok;
+}
+
+// offset から len バイトを書いた（触れたブロックは丸ごと書き直される）
+void WriteBehind::recordCommit(uint32_t offset, size_t len, uint32_t startUs) {
+    uint32_t us = clock.micros() - startUs;
+    size_t head = offset % chunk;
+    size_t blocks = (head + len + chunk - 1) / chunk;
+    ++counters.commits;
+    if ((offset + len) % chunk != 0) {
+        ++counters.partialCommits;
+    }
+    counters.programmedBytes += static_cast<uint32_t>(blocks * chunk);
+    counters.flushUsTotal += us;
+    if (us > counters.flushMaxUs) {
+        counters.flushMaxUs = us;
+    }
+}
+
+bool WriteBehind::append(const char* path, const uint8_t* data, size_t len) {
+    if (store == nullptr) {
+        return false;
+    }
+    if (!isStaged(path)) {
+        commit();
+        if (std::strlen(path) >= kMaxPath) {
+            // 溜められない長さの名前はそのまま書く
+            uint32_t startUs = clock.micros();
+            int32_t size = store->size(path);
+            if (!store->append(path, data, len)) {
+                return false;
+            }
+            counters.logicalBytes += static_cast<uint32_t>(len);
+            recordCommit(size > 0 ? static_cast<uint32_t>(size) : 0, len, startUs);
+            return true;
+        }
+        std::strcpy(stagedPath, path);
+        int32_t size = store->size(path);
+        committedSize = size > 0 ? static_cast<uint32_t>(size) : 0;
+    }
+
+    // 新しいブロックが要るなら、溜める前に空きを確かめる（書けないことを追記した時点で返す）
+    size_t pending = committedSize % chunk + stagedBytes;
+    size_t newBlocks = (pending + len + chunk - 1) / chunk - (pending + chunk - 1) / chunk;
+    if (newBlocks > 0 && store->freeBytes() < newBlocks * chunk) {
+        return false;
+    }
+
+    counters.logicalBytes += static_cast<uint32_t>(len);
+    while (len > 0) {
+        if (stagedBytes == 0) {
+            stagedSinceMs = clock.millis();
+        }
+        // ファイルの次の消去ブロックの境界まで
+        size_t room = chunk - committedSize % chunk - stagedBytes;
+        size_t n = len < room ? len : room;
+        std::memcpy(buffer + stagedBytes, data, n);
+        stagedBytes += n;
+        data += n;
+        len -= n;
+        if ((committedSize + stagedBytes) % chunk == 0 && !commit()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteBehind::write(const char* path, const uint8_t* data, size_t len) {
+    if (store == nullptr) {
+        return false;
+    }
+    if (isStaged(path)) {
+        stagedBytes = 0;  // 置き換えるので溜めていた分は要らない
+        stagedPath[0] = '\0';
+    }
+    uint32_t startUs = clock.micros();
+    if (!store->write(path, data, len)) {
+        return false;
+    }
+    counters.logicalBytes += static_cast<uint32_t>(len);
+    recordCommit(0, len, startUs);
+    return true;
+}
+
+size_t WriteBehind::read(const char* path, size_t offset, uint8_t* out, size_t len) {
+    if (store == nullptr) {
+        return 0;
+    }
+    if (!isStaged(path) || stagedBytes == 0) {
+        return store->read(path, offset, out, len);
+    }
+    size_t n = 0;
+    if (offset < committedSize) {
+        size_t want = committedSize - offset < len ? committedSize - offset : len;
+        n = store->read(path, offset, out, want);
+        if (n < want) {
+            return n;
+        }
+    }
+    size_t pos = offset + n - committedSize;
+    if (pos < stagedBytes && n < len) {
+        size_t m = stagedBytes - pos < len - n ? stagedBytes - pos : len - n;
+        std::memcpy(out + n, buffer + pos, m);
+        n += m;
+    }
+    return n;
+}
+
+int32_t WriteBehind::size(const char* path) {
+    if (store == nullptr) {
+        return -1;
+    }
+    int32_t size = store->size(path);
+    if (isStaged(path) && stagedBytes > 0) {
+        return (size > 0 ? size : 0) + static_cast<int32_t>(stagedBytes);
+    }
+    return size;
+}
+
+bool WriteBehind::remove(const char* path) {
+    if (store == nullptr) {
+        return false;
+    }
+    if (isStaged(path)) {
+        stagedBytes = 0;
+        stagedPath[0] = '\0';
+    }
+    return store->remove(path);
+}
+
+size_t WriteBehind::freeBytes() {
+    if (store == nullptr) {
+        return 0;
+    }
+    size_t free = store->freeBytes();
+    return free > stagedBytes ? free - stagedBytes : 0;
+}
+
+void WriteBehind::registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_STORAGE_MODE, &WriteBehind::cmdMode, this);
+    dispatcher.registerHandler(CMD_STORAGE_STATS, &WriteBehind::cmdStats, this);
+}
+
+// [mode u8][maxDelayMs u32]
+void WriteBehind::cmdMode(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    WriteBehind* self = static_cast<WriteBehind*>(context);
+    if (len != 5 || args[0] > static_cast<uint8_t>(WriteMode::Immediate) ||
+        (args[0] == static_cast<uint8_t>(WriteMode::Timed) && wire::getU32(args + 1) == 0)) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    self->setMode(static_cast<WriteMode>(args[0]), wire::getU32(args + 1));
+}
+
+// [reset u8] → [mode u8][logicalBytes u32][programmedBytes u32][commits u32][partialCommits u32]
+//              [amplificationX100 u16][flushAvgUs u32][flushMaxUs u32][staged u16]
+void WriteBehind::cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    WriteBehind* self = static_cast<WriteBehind*>(context);
+    if (len != 1) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+    const WriteBehindStats& s = self->counters;
+    reply.appendU8(static_cast<uint8_t>(self->writeMode));
+    reply.appendU32(s.logicalBytes);
+    reply.appendU32(s.programmedBytes);
+    reply.appendU32(s.commits);
+    reply.appendU32(s.partialCommits);
+    reply.appendU16(self->amplificationX100());
+    reply.appendU32(s.commits > 0 ? s.flushUsTotal / s.commits : 0);
+    reply.appendU32(s.flushMaxUs);
+    reply.appendU16(static_cast<uint16_t>(self->stagedBytes));
+    if (args[0] != 0) {
+        self->resetStats();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/AppConfig.h"
+#include "app/CommandDispatcher.h"
+#include "hal/Clock.h"
+#include "hal/FileStore.h"
+
+/**
+ * フラッシュの書き込みをまとめる層（write-behind）。hal::FileStore として他のモジュールの下に挟む
+ * - append() は RAM のブロック（消去ブロック 1 つ分）に溜め、ファイルの次の消去ブロックの境界まで
+ *   埋まったときにだけ書く。小さな追記を繰り返しても、フラッシュにはブロック単位でしか書かない
+ * - write()・remove() はそのまま下に渡す（同じファイルの溜めている分は先に書くか捨てる）
+ * - read()・size() は溜めている分も含めて返す
+ * - 溜められるのは 1 つのファイルだけ。別のファイルに append() したら前のファイルの分を書く
+ *
+ * 書き込みのまとめ方（WriteMode）と、電源が切れたときに失うもの
+ *   Batched    ブロックが埋まったとき・sync() したときだけ書く。溜めている 1 ブロック分までを失う
+ *   Timed      Batched に加えて、溜め始めてから maxDelayMs 経ったら書く。失うのはその時間分まで
+ *   Immediate  毎 poll()（loop() ごと）に書く。失うのは最後の loop() の分まで。書き込みは一番多い
+ * どのモードでも、切断時とログの記録を止めたときは sync() するので、それまでの分は失わない。
+ *
+ * 途中まで埋まったブロックを書くと、LittleFS はそのブロックを丸ごと書き直す（コピーオンライト）。
+ * 書き込み増幅 = 書いたブロックのバイト数（書き込みが触れたブロック × blockSize()）/ 渡されたバイト数
+ */
+
+enum class WriteMode : uint8_t {
+    Batched = 0,
+    Timed = 1,
+    Immediate = 2,
+};
+
+struct WriteBehindStats {
+    uint32_t logicalBytes;     // append()・write() で渡されたバイト数
+    uint32_t programmedBytes;  // フラッシュに書いたブロックのバイト数（見積もり）
+    uint32_t commits;          // 下の FileStore への書き込み
+    uint32_t partialCommits;   // 消去ブロックの境界で終わらなかった書き込み
+    uint32_t flushUsTotal;     // 書き込みにかかった時間
+    uint32_t flushMaxUs;
+};
+
+class WriteBehind : public hal::FileStore {
+public:
+    static constexpr size_t kMaxBlockSize = 4096;
+
+    explicit WriteBehind(hal::Clock& clock) : clock(clock) {}
+
+    // 下の FileStore（消去ブロックが kMaxBlockSize より大きければ kMaxBlockSize ごとにまとめる）
+    void setBacking(hal::FileStore* store);
+    hal::FileStore* backing() const { return store; }
+
+    void setMode(WriteMode mode, uint32_t maxDelayMs);
+    WriteMode mode() const { return writeMode; }
+    uint32_t maxDelay() const { return maxDelayMs; }
+
+    // sinceMs から溜めているデータを、いまのモードで書き出すべきなら true（上の層の RAM のバッファにも使う）
+    bool due(uint32_t sinceMs) const;
+    // 毎 loop() 呼ぶ。モードに従って溜めている分を書く
+    void poll();
+
+    size_t staged() const { return stagedBytes; }
+    // 書き込み増幅 ×100（まだ何も書いていなければ 0）
+    uint16_t amplificationX100() const;
+    const WriteBehindStats& stats() const { return counters; }
+    void resetStats() { counters = {}; }
+
+    // hal::FileStore
+    bool write(const char* path, const uint8_t* data, size_t len) override;
+    bool append(const char* path, const uint8_t* data, size_t len) override;
+    size_t read(const char* path, size_t offset, uint8_t* out, size_t len) override;
+    int32_t size(const char* path) override;
+    bool remove(const char* path) override;
+    size_t blockSize() const override { return chunk; }
+    size_t freeBytes() override;
+    bool sync() override { return commit(); }
+
+    // CMD_STORAGE_MODE / CMD_STORAGE_STATS を登録する
+    void registerCommands(CommandDispatcher& dispatcher);
+
+private:
+    static constexpr size_t kMaxPath = 24;
+
+    bool isStaged(const char* path) const;
+    bool commit();
+    void recordCommit(uint32_t offset, size_t len, uint32_t startUs);
+
+    static void cmdMode(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+    static void cmdStats(void* context, const uint8_t* args, size_t len, CommandReply& reply);
+
+    hal::Clock& clock;
+    hal::FileStore* store = nullptr;
+    size_t chunk = kMaxBlockSize;
+    WriteMode writeMode = WriteMode::Batched;
+    uint32_t maxDelayMs = 0;
+
+    // 溜めているファイルと、その下の FileStore でのバイト数
+    char stagedPath[kMaxPath] = {};
+    uint32_t committedSize = 0;
+    uint8_t buffer[kMaxBlockSize];
+    size_t stagedBytes = 0;
+    uint32_t stagedSinceMs = 0;
+
+    WriteBehindStats counters = {};
+};
@@ -0,0 +1,156 @@
+#include "diag/Profiler.h"
+
+#include <atomic>
+
+#include "app/CommandDispatcher.h"
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#endif
+
+namespace profiler {
+
+// 対数ヒストグラム：16 未満はそのまま、以降は 2 のべき乗ごとに 4 分割（128 バケット）
+static constexpr uint32_t kLinearBuckets = 16;
+static constexpr uint32_t kSubBuckets = 4;
+static constexpr uint32_t kBuckets = kLinearBuckets + (32 - 4) * kSubBuckets;
+
+struct ZoneTable {
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> minTicks{UINT32_MAX};
+    std::atomic<uint32_t> maxTicks{0};
+    std::atomic<uint64_t> totalTicks{0};
+    std::atomic<uint32_t> histogram[kBuckets];
+};
+
+static ZoneTable zones[ZONE_COUNT];
+
+static const char* const kZoneNames[ZONE_COUNT] = {
+    "notify", "setValue", "onWrite", "display", "serial", "imuRead", "schedTick", "rxDispatch",
+};
+
+static uint32_t bucketOf(uint32_t value) {
+    if (value < kLinearBuckets) {
+        return value;
+    }
+    uint32_t exponent = 31 - static_cast<uint32_t>(__builtin_clz(value));
+    uint32_t sub = (value >> (exponent - 2)) & (kSubBuckets - 1);
+    return kLinearBuckets + (exponent - 4) * kSubBuckets + sub;
+}
+
+// バケットに入る値の上限
+static uint32_t bucketUpperBound(uint32_t bucket) {
+    if (bucket < kLinearBuckets) {
+        return bucket;
+    }
+    uint32_t exponent = 4 + (bucket - kLinearBuckets) / kSubBuckets;
+    uint32_t sub = (bucket - kLinearBuckets) % kSubBuckets;
+    uint64_t upper = (static_cast<uint64_t>(kSubBuckets + sub + 1) << (exponent - 2)) - 1;
+    return upper > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(upper);
+}
+
+uint32_t ticksPerMicrosecond() {
+#if defined(__XTENSA__)
+    return getCpuFrequencyMhz();
+#else
+    return 1000;
+#endif
+}
+
+void record(uint8_t zone, uint32_t elapsed) {
+    if (zone >= ZONE_COUNT) {
+        return;
+    }
+    ZoneTable& z = zones[zone];
+    z.count.fetch_add(1, std::memory_order_relaxed);
+    z.totalTicks.fetch_add(elapsed, std::memory_order_relaxed);
+    z.histogram[bucketOf(elapsed)].fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t current = z.minTicks.load(std::memory_order_relaxed);
+    while (elapsed < current && !z.minTicks.compare_exchange_weak(current, elapsed, std::memory_order_relaxed)) {
+    }
+    current = z.maxTicks.load(std::memory_order_relaxed);
+    while (elapsed > current && !z.maxTicks.compare_exchange_weak(current, elapsed, std::memory_order_relaxed)) {
+    }
+}
+
+bool report(uint8_t zone, ZoneReport& out) {
+    if (zone >= ZONE_COUNT) {
+        return false;
+    }
+    const ZoneTable& z = zones[zone];
+    out.count = z.count.load(std::memory_order_relaxed);
+    if (out.count == 0) {
+        out.minTicks = out.avgTicks = out.maxTicks = out.p99Ticks = 0;
+        return true;
+    }
+    out.minTicks = z.minTicks.load(std::memory_order_relaxed);
+    out.maxTicks = z.maxTicks.load(std::memory_order_relaxed);
+    out.avgTicks = static_cast<uint32_t>(z.totalTicks.load(std::memory_order_relaxed) / out.count);
+
+    // 上位 1% に入る最初のバケットの上限を p99 とする
+    uint32_t threshold = out.count - out.count / 100;
+    uint32_t seen = 0;
+    out.p99Ticks = out.maxTicks;
+    for (uint32_t b = 0; b < kBuckets; ++b) {
+        seen += z.histogram[b].load(std::memory_order_relaxed);
+        if (seen >= threshold) {
+            uint32_t upper = bucketUpperBound(b);
+            out.p99Ticks = upper < out.maxTicks ? upper : out.maxTicks;
+            break;
+        }
+    }
+    return true;
+}
+
+void reset() {
+    for (ZoneTable& z : zones) {
+        z.count.store(0, std::memory_order_relaxed);
+        z.minTicks.store(UINT32_MAX, std::memory_order_relaxed);
+        z.maxTicks.store(0, std::memory_order_relaxed);
+        z.totalTicks.store(0, std::memory_order_relaxed);
+        for (auto& bucket : z.histogram) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+const char* zoneName(uint8_t zone) {
+    return zone < ZONE_COUNT ? kZoneNames[zone] : "?";
+}
+
+// [zone u8] → [zone u8][ticksPerUs u16][count u32][min u32][avg u32][max u32][p99 u32]（単位はティック）
+static void cmdGetProfile(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)context;
+    ZoneReport r;
+    if (len != 1 || !report(args[0], r)) {
+        reply.status = CommandStatus::BadArguments;
+        return;
+    }
+#if !APP_PROFILING
+    reply.status = CommandStatus::Failed;  // APP_PROFILING=0 でビルドされている
+    return;
+#endif
+    reply.appendU8(args[0]);
+    reply.appendU16(static_cast<uint16_t>(ticksPerMicrosecond()));
+    reply.appendU32(r.count);
+    reply.appendU32(r.minTicks);
+    reply.appendU32(r.avgTicks);
+    reply.appendU32(r.maxTicks);
+    reply.appendU32(r.p99Ticks);
+}
+
+static void cmdResetProfile(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)context;
+    (void)args;
+    (void)len;
+    (void)reply;
+    reset();
+}
+
+void registerCommands(CommandDispatcher& dispatcher) {
+    dispatcher.registerHandler(CMD_GET_PROFILE, &cmdGetProfile, nullptr);
+    dispatcher.registerHandler(CMD_RESET_PROFILE, &cmdResetProfile, nullptr);
+}
+
+}  // namespace profiler
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+#if !defined(__XTENSA__)
+#include <chrono>
+#endif
+
+class CommandDispatcher;
+
+/**
+ * サイクルカウンタを使ったスコープ計測（プロファイリングゾーン）
+ * - PROFILE_ZONE(id) を置いたスコープの所要時間を、ゾーンごとの固定テーブルに集計する
+ *   （回数・最小・平均・最大・p99。p99 は対数ヒストグラムからの近似で誤差は 25% 以内）
+ * - 実機は Xtensa の CCOUNT レジスタ（CPU クロック単位）、ネイティブは steady_clock [ns]
+ * - APP_PROFILING=0（既定）ではマクロごと消えるので、計測コードのコストはゼロ
+ *
+ * BLE タスクと loop() の両方から記録されるので、集計は relaxed アトミックで行う。
+ */
+
+#ifndef APP_PROFILING
+#define APP_PROFILING 0
+#endif
+
+enum ProfileZoneId : uint8_t {
+    ZONE_NOTIFY = 0,  // BLECharacteristic::notify()
+    ZONE_SET_VALUE,   // BLECharacteristic::setValue()
+    ZONE_ON_WRITE,    // 書き込みコールバック（getValue() + BleListener::onWrite）
+    ZONE_DISPLAY,     // 画面 1 行の描画
+    ZONE_SERIAL,      // シリアル出力
+    ZONE_IMU_READ,    // IMU の FIFO 読み出し（I2C）
+    ZONE_SCHED_TICK,  // NotifyScheduler::tick()（ペーシング・パケット作成・送信）
+    ZONE_RX_DISPATCH, // 受信した書き込み 1 つの処理（分割復元・コマンド振り分け）
+    ZONE_COUNT,
+};
+
+namespace profiler {
+
+struct ZoneReport {
+    uint32_t count;
+    uint32_t minTicks;
+    uint32_t avgTicks;
+    uint32_t maxTicks;
+    uint32_t p99Ticks;
+};
+
+// 1 マイクロ秒あたりのティック数（実機は CPU クロック [MHz]）
+uint32_t ticksPerMicrosecond();
+
+#if defined(__XTENSA__)
+inline uint32_t ticks() {
+    uint32_t ccount;
+    asm volatile("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+}
+#else
+inline uint32_t ticks() {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+#endif
+
+void record(uint8_t zone, uint32_t elapsed);
+bool report(uint8_t zone, ZoneReport& out);
+void reset();
+
+const char* zoneName(uint8_t zone);
+
+// CMD_GET_PROFILE / CMD_RESET_PROFILE を登録する
+void registerCommands(CommandDispatcher& dispatcher);
+
+class ScopedZone {
+public:
+    explicit ScopedZone(uint8_t zone) : zone(zone), start(ticks()) {}
+    ~ScopedZone() { record(zone, ticks() - start); }
+
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+
+private:
+    uint8_t zone;
+    uint32_t start;
+};
+
+}  // namespace profiler
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if APP_PROFILING
+#define PROFILE_ZONE(zone) profiler::ScopedZone PROFILE_CONCAT(profileZone_, __LINE__)(zone)
+#else
+#define PROFILE_ZONE(zone) ((void)0)
+#endif
@@ -0,0 +1,127 @@
+#include "diag/RxTrace.h"
+
+#include <cstring>
+
+#include "app/Wire.h"
+
+static const uint8_t kMagic[3] = {'R', 'X', 'T'};
+
+void RxTrace::start(uint32_t nowUs) {
+    stop();
+    if (capacity < kHeaderSize) {
+        return;
+    }
+    std::memcpy(buffer, kMagic, sizeof(kMagic));
+    buffer[3] = kVersion;
+    lastUs = nowUs;
+    overflows.store(0, std::memory_order_relaxed);
+    used.store(kHeaderSize, std::memory_order_release);
+    recording.store(true, std::memory_order_release);
+}
+
+bool RxTrace::reserve(size_t bytes, size_t& offset) {
+    offset = used.load(std::memory_order_relaxed);
+    if (offset + bytes > capacity) {
+        // 満杯になったら記録をやめる（途中までのトレースは有効なまま）
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        recording.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void RxTrace::recordLink(uint8_t type, uint32_t nowUs, uint16_t connId) {
+    if (!isRecording()) {
+        return;
+    }
+    uint8_t event[1 + 5 + 1];
+    size_t n = 0;
+    event[n++] = type;
+    n += wire::putVarint(&event[n], nowUs - lastUs);
+    event[n++] = static_cast<uint8_t>(connId);
+
+    size_t offset;
+    if (!reserve(n, offset)) {
+        return;
+    }
+    std::memcpy(buffer + offset, event, n);
+    lastUs = nowUs;
+    used.store(offset + n, std::memory_order_release);
+}
+
+void RxTrace::recordWrite(uint32_t nowUs, uint8_t ch, const uint8_t* data, size_t len) {
+    if (!isRecording()) {
+        return;
+    }
+    uint8_t header[1 + 5 + 1 + 5];
+    size_t n = 0;
+    header[n++] = TRACE_WRITE;
+    n += wire::putVarint(&header[n], nowUs - lastUs);
+    header[n++] = ch;
+    n += wire::putVarint(&header[n], static_cast<uint32_t>(len));
+
+    size_t offset;
+    if (!reserve(n + len, offset)) {
+        return;
+    }
+    std::memcpy(buffer + offset, header, n);
+    std::memcpy(buffer + offset + n, data, len);
+    lastUs = nowUs;
+    used.store(offset + n + len, std::memory_order_release);
+}
+
+bool RxTraceReader::begin(const uint8_t* data, size_t len) {
+    if (len < RxTrace::kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+        data[3] != RxTrace::kVersion) {
+        return false;
+    }
+    this->data = data;
+    size = len;
+    offset = RxTrace::kHeaderSize;
+    return true;
+}
+
+bool RxTraceReader::next(Event& event) {
+    if (offset >= size) {
+        return false;
+    }
+    size_t p = offset;
+    event.type = data[p++];
+    size_t n = wire::getVarint(data + p, size - p, event.dtUs);
+    if (n == 0) {
+        return false;
+    }
+    p += n;
+
+    event.connId = 0;
+    event.ch = 0;
+    event.data = nullptr;
+    event.length = 0;
+
+    switch (event.type) {
+        case TRACE_CONNECT:
+        case TRACE_DISCONNECT:
+            if (p >= size) {
+                return false;
+            }
+            event.connId = data[p++];
+            break;
+        case TRACE_WRITE:
+            if (p >= size) {
+                return false;
+            }
+            event.ch = data[p++];
+            n = wire::getVarint(data + p, size - p, event.length);
+            if (n == 0 || p + n + event.length > size) {
+                return false;
+            }
+            p += n;
+            event.data = data + p;
+            p += event.length;
+            break;
+        default:
+            return false;
+    }
+    offset = p;
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 受信トレース：セントラルからの書き込みと接続イベントをタイムスタンプ付きで記録する
+ * - フィールドで起きた不具合や性能低下を、ネイティブ環境（host/replay）で同じ順序・タイミングで再生するためのもの
+ * - 固定長バッファに追記し、満杯になったら記録を止める（古いものは消さない）
+ * - 記録は BLE タスク（生産者1）、読み出しは loop() から行う
+ *
+ * 形式（リトルエンディアン、varint は LEB128）
+ *   ヘッダ: "RXT" + version(u8)
+ *   イベント: [type u8][dtUs varint]
+ *     TRACE_CONNECT / TRACE_DISCONNECT: [connId u8]
+ *     TRACE_WRITE:                      [ch u8][len varint][data]
+ *   dtUs は直前のイベント（最初のイベントは記録開始）からの経過時間 [us]
+ */
+
+enum TraceEventType : uint8_t {
+    TRACE_CONNECT = 1,
+    TRACE_DISCONNECT = 2,
+    TRACE_WRITE = 3,
+};
+
+class RxTrace {
+public:
+    static constexpr uint8_t kVersion = 1;
+    static constexpr size_t kHeaderSize = 4;
+
+    RxTrace(uint8_t* buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+
+    // 以前の記録を消して記録を始める
+    void start(uint32_t nowUs);
+    void stop() { recording.store(false, std::memory_order_release); }
+    bool isRecording() const { return recording.load(std::memory_order_acquire); }
+
+    void recordConnect(uint32_t nowUs, uint16_t connId) { recordLink(TRACE_CONNECT, nowUs, connId); }
+    void recordDisconnect(uint32_t nowUs, uint16_t connId) { recordLink(TRACE_DISCONNECT, nowUs, connId); }
+    void recordWrite(uint32_t nowUs, uint8_t ch, const uint8_t* data, size_t len);
+
+    // 記録済みのバイト列（ヘッダ込み）。記録中でも先頭 length() バイトは確定している
+    const uint8_t* data() const { return buffer; }
+    size_t length() const { return used.load(std::memory_order_acquire); }
+    uint32_t overflowCount() const { return overflows.load(std::memory_order_relaxed); }
+
+private:
+    void recordLink(uint8_t type, uint32_t nowUs, uint16_t connId);
+    bool reserve(size_t bytes, size_t& offset);
+
+    uint8_t* buffer;
+    size_t capacity;
+    std::atomic<size_t> used{0};
+    std::atomic<bool> recording{false};
+    std::atomic<uint32_t> overflows{0};
+    uint32_t lastUs = 0;
+};
+
+// 受信トレースの読み出し（ホストの再生ドライバ・ツール用）
+class RxTraceReader {
+public:
+    struct Event {
+        uint8_t type;
+        uint32_t dtUs;
+        uint8_t connId;
+        uint8_t ch;
+        const uint8_t* data;
+        uint32_t length;
+    };
+
+    bool begin(const uint8_t* data, size_t len);
+    bool next(Event& event);
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+};
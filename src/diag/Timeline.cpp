@@ -0,0 +1,114 @@
+#include "diag/Timeline.h"
+
+#include <atomic>
+#include <cstring>
+
+#include "app/AppConfig.h"
+#include "app/Wire.h"
+#include "hal/Clock.h"
+
+namespace timeline {
+
+static_assert((TIMELINE_CAPACITY & (TIMELINE_CAPACITY - 1)) == 0, "TIMELINE_CAPACITY must be a power of two");
+
+struct Entry {
+    uint32_t startUs;
+    uint32_t durationUs;
+    uint8_t type;
+    uint8_t track;
+    uint16_t arg;
+};
+
+static Entry entries[TIMELINE_CAPACITY];
+static std::atomic<uint32_t> writeIndex{0};
+static std::atomic<bool> recording{false};
+static const hal::Clock* timeSource = nullptr;
+
+void setClock(const hal::Clock* clock) {
+    timeSource = clock;
+}
+
+uint32_t now() {
+    return timeSource != nullptr ? timeSource->micros() : 0;
+}
+
+void start() {
+    recording.store(false, std::memory_order_release);
+    writeIndex.store(0, std::memory_order_relaxed);
+    recording.store(timeSource != nullptr, std::memory_order_release);
+}
+
+void stop() {
+    recording.store(false, std::memory_order_release);
+}
+
+bool isRecording() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+// 複数タスクから呼ばれるので、スロットの確保だけアトミックに行う
+// （ダンプは stop() してから読むので、書き込み途中のスロットを読むことはない）
+void record(uint8_t type, uint8_t track, uint16_t arg, uint32_t startUs, uint32_t durationUs) {
+    if (!isRecording()) {
+        return;
+    }
+    uint32_t index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+    Entry& e = entries[index & (TIMELINE_CAPACITY - 1)];
+    e.startUs = startUs;
+    e.durationUs = durationUs;
+    e.type = type;
+    e.track = track;
+    e.arg = arg;
+}
+
+static uint32_t eventCount() {
+    uint32_t written = writeIndex.load(std::memory_order_acquire);
+    return written < TIMELINE_CAPACITY ? written : TIMELINE_CAPACITY;
+}
+
+size_t serializedLength() {
+    return kHeaderSize + static_cast<size_t>(eventCount()) * kEventSize;
+}
+
+size_t readSerialized(size_t offset, uint8_t* out, size_t len) {
+    uint32_t count = eventCount();
+    uint32_t first = writeIndex.load(std::memory_order_acquire) - count;
+    size_t total = kHeaderSize + static_cast<size_t>(count) * kEventSize;
+    size_t copied = 0;
+
+    while (copied < len && offset + copied < total) {
+        size_t pos = offset + copied;
+        uint8_t chunk[kEventSize];
+        size_t chunkStart;
+        size_t chunkSize;
+        if (pos < kHeaderSize) {
+            chunk[0] = 'T';
+            chunk[1] = 'L';
+            chunk[2] = 'N';
+            chunk[3] = kVersion;
+            wire::putU32(&chunk[4], count);
+            chunkStart = 0;
+            chunkSize = kHeaderSize;
+        } else {
+            size_t index = (pos - kHeaderSize) / kEventSize;
+            const Entry& e = entries[(first + index) & (TIMELINE_CAPACITY - 1)];
+            wire::putU32(&chunk[0], e.startUs);
+            wire::putU32(&chunk[4], e.durationUs);
+            chunk[8] = e.type;
+            chunk[9] = e.track;
+            wire::putU16(&chunk[10], e.arg);
+            chunkStart = kHeaderSize + index * kEventSize;
+            chunkSize = kEventSize;
+        }
+        size_t skip = pos - chunkStart;
+        size_t n = chunkSize - skip;
+        if (n > len - copied) {
+            n = len - copied;
+        }
+        std::memcpy(out + copied, chunk + skip, n);
+        copied += n;
+    }
+    return copied;
+}
+
+}  // namespace timeline
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+class Clock;
+}
+
+/**
+ * イベントタイムライン（loop()・BLE タスク・UI がどう割り込み合っているかを見るためのもの）
+ * - 固定長リングに [時刻 us][継続時間 us][種類][トラック][引数] を記録し、古いものから上書きする
+ * - ダンプは時系列順に並べたバイト列（readSerialized()）で取り出し、
+ *   tools/timeline_to_chrome.py で Chrome の trace event 形式（chrome://tracing, Perfetto）に変換する
+ * - APP_TIMELINE=0（既定）ではマクロごと消える
+ *
+ * 形式（リトルエンディアン）
+ *   ヘッダ: "TLN" + version(u8) + count(u32)
+ *   イベント × count: [tsUs u32][durUs u32][type u8][track u8][arg u16]
+ *   durUs = 0 は瞬間イベント
+ */
+
+#ifndef APP_TIMELINE
+#define APP_TIMELINE 0
+#endif
+
+enum TimelineEvent : uint8_t {
+    TL_CONNECT = 1,       // arg = connId
+    TL_DISCONNECT,        // arg = connId
+    TL_PARAM_UPDATE,      // arg = コネクションインターバル（1.25 ms 単位）
+    TL_MTU_CHANGE,        // arg = MTU
+    TL_WRITE_RECEIVED,    // arg = 長さ
+    TL_NOTIFY_QUEUED,     // arg = パケット seq
+    TL_NOTIFY_SENT,       // arg = パケット seq（継続時間 = notify() の所要時間）
+    TL_UI_FRAME,          // arg = 行の y（継続時間 = 描画時間）
+    TL_STALL,             // arg = 0（継続時間 = loop() の間隔）
+    TL_LOOP,              // arg = 0（継続時間 = loop() 1 回の処理時間）
+};
+
+enum TimelineTrack : uint8_t {
+    TRACK_LOOP = 0,
+    TRACK_BLE = 1,
+    TRACK_UI = 2,
+};
+
+namespace timeline {
+
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kEventSize = 12;
+
+// 記録に使う時計（BleApp::setup() で設定する）
+void setClock(const hal::Clock* clock);
+uint32_t now();
+
+void start();  // 記録済みのイベントを消して記録を始める
+void stop();
+bool isRecording();
+
+void record(uint8_t type, uint8_t track, uint16_t arg, uint32_t startUs, uint32_t durationUs);
+
+inline void instant(uint8_t type, uint8_t track, uint16_t arg) {
+    if (isRecording()) {
+        record(type, track, arg, now(), 0);
+    }
+}
+
+// ダンプ用：時系列順に並べたバイト列（ヘッダ込み）の長さと、その offset から len バイト
+size_t serializedLength();
+size_t readSerialized(size_t offset, uint8_t* out, size_t len);
+
+class ScopedEvent {
+public:
+    ScopedEvent(uint8_t type, uint8_t track, uint16_t arg)
+        : type(type), track(track), arg(arg), active(isRecording()), startUs(active ? now() : 0) {}
+    ~ScopedEvent() {
+        if (active) {
+            record(type, track, arg, startUs, now() - startUs);
+        }
+    }
+
+    ScopedEvent(const ScopedEvent&) = delete;
+    ScopedEvent& operator=(const ScopedEvent&) = delete;
+
+private:
+    uint8_t type;
+    uint8_t track;
+    uint16_t arg;
+    bool active;
+    uint32_t startUs;
+};
+
+}  // namespace timeline
+
+#define TIMELINE_CONCAT_INNER(a, b) a##b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT_INNER(a, b)
+
+#if APP_TIMELINE
+#define TIMELINE_INSTANT(type, track, arg) timeline::instant((type), (track), static_cast<uint16_t>(arg))
+#define TIMELINE_SCOPE(type, track, arg) \
+    timeline::ScopedEvent TIMELINE_CONCAT(timelineEvent_, __LINE__)((type), (track), static_cast<uint16_t>(arg))
+#define TIMELINE_SPAN(type, track, arg, startUs, durationUs) \
+    timeline::record((type), (track), static_cast<uint16_t>(arg), (startUs), (durationUs))
+#else
+#define TIMELINE_INSTANT(type, track, arg) ((void)0)
+#define TIMELINE_SCOPE(type, track, arg) ((void)0)
+#define TIMELINE_SPAN(type, track, arg, startUs, durationUs) ((void)0)
+#endif
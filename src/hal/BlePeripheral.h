@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+// キャラクタリスティックのプロパティ（ビットOR で指定）
+enum CharProperty : uint8_t {
+    PROP_READ     = 0x01,
+    PROP_WRITE    = 0x02,
+    PROP_WRITE_NR = 0x04,
+    PROP_NOTIFY   = 0x08,
+    PROP_INDICATE = 0x10,
+};
+
+using ServiceId = uint8_t;
+using CharId = uint8_t;
+
+constexpr uint8_t kInvalidId = 0xFF;
+
+// 128 bit の UUID。bytes は文字列で書いたときの順（先頭の 2 桁が bytes[0]）
+struct Uuid {
+    uint8_t bytes[16];
+};
+
+constexpr bool operator==(const Uuid& a, const Uuid& b) {
+    for (size_t i = 0; i < 16; ++i) {
+        if (a.bytes[i] != b.bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool operator!=(const Uuid& a, const Uuid& b) { return !(a == b); }
+
+// "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx"（大文字・小文字どちらでもよい）を読む。読めなければ false
+constexpr bool parseUuid(const char* text, Uuid& out) {
+    size_t n = 0;
+    for (size_t i = 0; i < 36; ++i) {
+        char c = text[i];
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (c != '-') {
+                return false;
+            }
+            continue;
+        }
+        uint8_t v = 0;
+        if (c >= '0' && c <= '9') {
+            v = static_cast<uint8_t>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            v = static_cast<uint8_t>(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            v = static_cast<uint8_t>(c - 'A' + 10);
+        } else {
+            return false;
+        }
+        out.bytes[n / 2] = static_cast<uint8_t>(n % 2 == 0 ? v << 4 : out.bytes[n / 2] | v);
+        ++n;
+    }
+    return text[36] == '\0';
+}
+
+// constexpr でない関数：uuid() の中で呼ばれると、定数式として評価できずにコンパイルエラーになる
+inline void invalidUuidText() {}
+
+// コンパイル時に UUID を読む（constexpr の変数の初期化に使えば、書き間違いはコンパイルエラー）
+constexpr Uuid uuid(const char* text) {
+    Uuid out = {};
+    if (!parseUuid(text, out)) {
+        invalidUuidText();
+    }
+    return out;
+}
+
+// BLE スタックからのイベント通知先
+// 実機では BLE タスクのコンテキストから呼ばれるので、重い処理はしないこと
+class BleListener {
+public:
+    virtual ~BleListener() = default;
+
+    virtual void onConnect(uint16_t connId) = 0;
+    virtual void onDisconnect(uint16_t connId) = 0;
+    virtual void onWrite(CharId ch, const uint8_t* data, size_t len) = 0;
+
+    // セントラルが読み出す直前に呼ばれる（ここで setValue() すれば最新値を返せる）
+    virtual void onRead(CharId ch) { (void)ch; }
+
+    // セントラルが CCCD（0x2902）を書いた（Notify か Indicate が有効なら enabled）
+    virtual void onSubscribeChanged(CharId ch, bool enabled) {
+        (void)ch;
+        (void)enabled;
+    }
+
+    // ATT_MTU のネゴシエーション完了
+    virtual void onMtuChanged(uint16_t mtu) { (void)mtu; }
+
+    // コネクションパラメータの更新（interval と timeout は 1.25 ms / 10 ms 単位の BLE の値そのまま）
+    virtual void onConnParamsUpdated(uint16_t interval, uint16_t latency, uint16_t timeout) {
+        (void)interval;
+        (void)latency;
+        (void)timeout;
+    }
+};
+
+// BLE ペリフェラル（GATT サーバー + 広告）の抽象化
+class BlePeripheral {
+public:
+    virtual ~BlePeripheral() = default;
+
+    virtual void begin(const char* deviceName, BleListener* listener) = 0;
+
+    // GATT データベース構築（begin() の後、startService() の前に呼ぶ）
+    // handleCount はサービスが使う属性ハンドルの数（サービス宣言・キャラクタリスティック・ディスクリプタ）
+    virtual ServiceId addService(const Uuid& uuid, uint16_t handleCount) = 0;
+    virtual CharId addCharacteristic(ServiceId service, const Uuid& uuid, uint8_t properties) = 0;
+    virtual void startService(ServiceId service) = 0;
+
+    // 広告データにサービス UUID を載せる
+    virtual void advertiseService(const Uuid& uuid) = 0;
+    virtual void startAdvertising() = 0;
+
+    virtual void setValue(CharId ch, const uint8_t* data, size_t len) = 0;
+    // BLE スタックが送信を受け付けなければ false（バッファ満杯・未接続など）
+    virtual bool notify(CharId ch) = 0;
+
+    // 現在の接続でネゴシエートされた ATT_MTU（未接続時は 23）
+    virtual uint16_t mtu() const = 0;
+
+    // 接続中のセントラルに Service Changed（全ハンドル）を Indicate する。送れなければ false
+    virtual bool indicateServiceChanged() = 0;
+};
+
+}  // namespace hal
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+// JPEG 1 枚（capture() から release() までの間だけ有効）
+struct CameraFrame {
+    const uint8_t* data;
+    size_t length;
+    uint16_t width;
+    uint16_t height;
+};
+
+// JPEG 静止画を撮るカメラの抽象化
+class Camera {
+public:
+    virtual ~Camera() = default;
+
+    // 解像度（160x120 / 320x240）と JPEG 品質（1〜100、大きいほど高画質）。対応していなければ false
+    virtual bool start(uint16_t width, uint16_t height, uint8_t quality) = 0;
+    virtual void stop() = 0;
+
+    // 1 枚撮って JPEG にする（実機ではフレーム時間 + 圧縮時間だけブロックする）
+    virtual bool capture(CameraFrame& frame) = 0;
+    virtual void release() = 0;
+
+    // 他のセンサー（IMU・タッチ）と同じバスにつながっているか（動かしている間はそれらを使えない）
+    virtual bool sharesSensorBus() const { return false; }
+};
+
+}  // namespace hal
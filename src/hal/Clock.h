@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hal {
+
+// 時刻取得・待機の抽象化
+// 実機では millis()/micros()/delay()、ネイティブ環境では仮想時計を使う
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    virtual uint32_t millis() const = 0;
+    virtual uint32_t micros() const = 0;
+    virtual void delay(uint32_t ms) = 0;
+};
+
+}  // namespace hal
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hal {
+
+// RGB565（M5GFX の TFT_* と同じ値）
+enum class Color : uint16_t {
+    Black   = 0x0000,
+    White   = 0xFFFF,
+    Green   = 0x07E0,
+    Yellow  = 0xFFE0,
+    Cyan    = 0x07FF,
+    Magenta = 0xF81F,
+};
+
+// ステータス表示用ディスプレイの抽象化
+// 画面は高さ 20px の行単位で使う（y は行の上端）
+class Display {
+public:
+    virtual ~Display() = default;
+
+    // 画面全体を黒で塗りつぶす
+    virtual void clear() = 0;
+
+    // y の行を消去してから text を描画する
+    virtual void drawLine(int16_t y, Color color, const char* text) = 0;
+};
+
+}  // namespace hal
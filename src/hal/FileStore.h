@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+// フラッシュ上のファイルシステム（実機は LittleFS）の抽象化
+// 呼び出しごとに開いて閉じるので、小さな書き込みを繰り返さず、まとめて書くこと
+class FileStore {
+public:
+    virtual ~FileStore() = default;
+
+    // path を data で置き換える（なければ作る）
+    virtual bool write(const char* path, const uint8_t* data, size_t len) = 0;
+    // path の末尾に追記する（なければ作る）
+    virtual bool append(const char* path, const uint8_t* data, size_t len) = 0;
+    // offset から最大 len バイトを読み、読めたバイト数を返す（ファイルがなければ 0）
+    virtual size_t read(const char* path, size_t offset, uint8_t* out, size_t len) = 0;
+    // ファイルのバイト数（なければ -1）
+    virtual int32_t size(const char* path) = 0;
+    virtual bool remove(const char* path) = 0;
+    // 書き込みを溜める実装は、溜めている分をフラッシュに書く
+    virtual bool sync() { return true; }
+
+    // 消去ブロックの大きさと空き容量 [byte]
+    virtual size_t blockSize() const = 0;
+    virtual size_t freeBytes() = 0;
+};
+
+}  // namespace hal
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+// 6 軸 IMU の 1 サンプル（センサの生値。スケールは ImuConfig のレンジで決まる）
+struct ImuSample {
+    int16_t ax, ay, az;
+    int16_t gx, gy, gz;
+};
+
+struct ImuConfig {
+    uint16_t rateHz;        // 加速度・ジャイロ共通の出力レート
+    uint8_t accelRangeG;    // 2 / 4 / 8 / 16
+    uint16_t gyroRangeDps;  // 125 / 250 / 500 / 1000 / 2000
+};
+
+// ハードウェア FIFO 付き IMU の抽象化
+// start() 後はセンサが FIFO にサンプルをためるので、readFifo() でまとめて読み出す
+class Imu {
+public:
+    virtual ~Imu() = default;
+
+    // FIFO を空にしてサンプリングを始める。対応していないレート・レンジなら false
+    virtual bool start(const ImuConfig& config) = 0;
+    virtual void stop() = 0;
+
+    // FIFO にたまったサンプルを古い順に最大 maxSamples 個読み出し、読んだ数を返す
+    virtual size_t readFifo(ImuSample* out, size_t maxSamples) = 0;
+
+    // start() 以降に FIFO があふれてサンプルを失った回数
+    virtual uint32_t fifoOverruns() const = 0;
+};
+
+}  // namespace hal
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+// マイク入力の抽象化（ダブルバッファ）
+// start() 後はドライバが 2 つのバッファに交互に録音する。録音済みのバッファを acquire() で受け取り、
+// 処理が終わったら release() で録音キューに戻す。
+class Microphone {
+public:
+    virtual ~Microphone() = default;
+
+    // モノラル 16 bit で録音を始める。対応していないレートなら false
+    virtual bool start(uint32_t sampleRate) = 0;
+    virtual void stop() = 0;
+
+    // 録音済みのバッファがあれば古い方を返す（なければ nullptr）
+    virtual const int16_t* acquire(size_t& samples) = 0;
+    virtual void release() = 0;
+
+    // 録音キューが空になって入力を取りこぼした回数
+    virtual uint32_t underruns() const = 0;
+};
+
+}  // namespace hal
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+// ログ出力用シリアルポートの抽象化
+class SerialPort {
+public:
+    virtual ~SerialPort() = default;
+
+    virtual void print(const char* text) = 0;
+    virtual void println(const char* text) = 0;
+    virtual size_t write(const uint8_t* data, size_t len) = 0;
+};
+
+}  // namespace hal
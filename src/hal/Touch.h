@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+enum class TouchType : uint8_t {
+    Down = 0,
+    Move = 1,
+    Up = 2,
+};
+
+struct TouchEvent {
+    uint32_t timestampUs;  // タッチコントローラの割り込みを受けた時刻（micros()）
+    int16_t x;
+    int16_t y;
+    TouchType type;
+    uint8_t id;
+};
+
+// 割り込みで検出するタッチ入力の抽象化
+// 実機では割り込みで時刻だけ記録し、座標は read() を呼んだタスクでコントローラから読む
+class TouchInput {
+public:
+    virtual ~TouchInput() = default;
+
+    // 検出済みのイベントを古い順に読み出し、読んだ数を返す
+    virtual size_t read(TouchEvent* out, size_t maxEvents) = 0;
+
+    // 読み出しが追いつかず捨てた割り込みの数
+    virtual uint32_t overflows() const = 0;
+};
+
+}  // namespace hal
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * ホスト用マイクロベンチマークの最小ハーネス
+ * - 1 回の計測が minTimeMs 以上になるまで反復回数を倍々にして較正
+ * - 結果は ns/op と bytes/op（処理したペイロード量）で記録し、JSON で出力する
+ * - addJitter() で 1 回ごとの所要時間の分布（最小・平均・p99・最大）も JSON に載せられる
+ */
+namespace bench {
+
+// 最適化で計算が消されないようにする
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void clobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double bytesPerOp;
+};
+
+// 1 回ごとの所要時間の分布 [ns]
+struct Jitter {
+    std::string name;
+    uint32_t count;
+    double minNs;
+    double avgNs;
+    double p99Ns;
+    double maxNs;
+};
+
+class Runner {
+public:
+    Runner(const char* filter, uint32_t minTimeMs) : filter(filter), minTimeMs(minTimeMs) {}
+
+    // fn(iterations) は iterations 回分の処理を行う
+    template <typename F>
+    void run(const std::string& name, double bytesPerOp, F&& fn) {
+        if (!enabled(name)) {
+            return;
+        }
+        using clock = std::chrono::steady_clock;
+        uint64_t iterations = 1;
+        double elapsedNs = 0;
+        for (;;) {
+            auto start = clock::now();
+            fn(iterations);
+            auto end = clock::now();
+            elapsedNs = std::chrono::duration<double, std::nano>(end - start).count();
+            if (elapsedNs >= minTimeMs * 1e6 || iterations >= (1ull << 40)) {
+                break;
+            }
+            iterations *= 2;
+        }
+        Result r{name, iterations, elapsedNs / static_cast<double>(iterations), bytesPerOp};
+        std::fprintf(stderr, "%-40s %12.2f ns/op %10.1f B/op\n", r.name.c_str(), r.nsPerOp, r.bytesPerOp);
+        results.push_back(r);
+    }
+
+    bool enabled(const std::string& name) const {
+        return filter == nullptr || name.find(filter) != std::string::npos;
+    }
+
+    void addJitter(const Jitter& j) {
+        std::fprintf(stderr, "%-40s min %8.1f  avg %8.1f  p99 %8.1f  max %10.1f ns (%u ops)\n", j.name.c_str(),
+                     j.minNs, j.avgNs, j.p99Ns, j.maxNs, j.count);
+        jitters.push_back(j);
+    }
+
+    void writeJson(FILE* out) const {
+        std::fprintf(out, "{\n  \"suite\": \"datapath\",\n  \"results\": [\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            double mbPerSec = r.nsPerOp > 0 ? r.bytesPerOp / r.nsPerOp * 1e3 : 0;
+            std::fprintf(out,
+                         "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, "
+                         "\"bytes_per_op\": %.1f, \"mb_per_s\": %.2f}%s\n",
+                         r.name.c_str(), static_cast<unsigned long long>(r.iterations), r.nsPerOp, r.bytesPerOp,
+                         mbPerSec, i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ],\n  \"jitter\": [\n");
+        for (size_t i = 0; i < jitters.size(); ++i) {
+            const Jitter& j = jitters[i];
+            std::fprintf(out,
+                         "    {\"name\": \"%s\", \"count\": %u, \"min_ns\": %.1f, \"avg_ns\": %.1f, "
+                         "\"p99_ns\": %.1f, \"max_ns\": %.1f}%s\n",
+                         j.name.c_str(), j.count, j.minNs, j.avgNs, j.p99Ns, j.maxNs,
+                         i + 1 < jitters.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    const char* filter;
+    uint32_t minTimeMs;
+    std::vector<Result> results;
+    std::vector<Jitter> jitters;
+};
+
+}  // namespace bench
@@ -0,0 +1,452 @@
+/**
+ * データパスのマイクロベンチマーク（ネイティブ環境）
+ * - フレームエンコード / リングバッファ push・pop / パケット詰め込み / コマンド振り分け / 分割復元
+ * - IMU レコードのエンコード（int16 × 6 のサンプル詰め・差分 + zigzag varint）/ IMA-ADPCM の符号化
+ * - 姿勢推定フィルタ（Madgwick / Mahony）の 1 サンプルあたりの更新
+ * - プロファイリングゾーン自体のオーバーヘッド（APP_PROFILING=1 でビルドしたときのみ）
+ * - ホットパスの 1 回ごとのばらつき（ZONE_SCHED_TICK・ZONE_RX_DISPATCH と同じ処理、APP_PROFILING=1 のみ）
+ * - 結果は JSON（標準出力または --out）。人間向けの表は標準エラーに出す
+ *
+ * 実行: pio run -e native-bench -t exec
+ *       .pio/build/native-bench/program --filter ring --out bench.json
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <cmath>
+
+#include "app/AdpcmCodec.h"
+#include "app/CommandDispatcher.h"
+#include "app/DeltaCodec.h"
+#include "app/Dsp.h"
+#include "app/FrameCodec.h"
+#include "app/ImuStream.h"
+#include "app/OrientationFilter.h"
+#include "app/Reassembler.h"
+#include "app/RecordRing.h"
+#include "diag/Profiler.h"
+#include "host/bench/Bench.h"
+
+static void benchFrameEncode(bench::Runner& runner) {
+    static const size_t kSizes[] = {4, 16, 64, 200};
+    uint8_t payload[frame::kMaxRecordPayload] = {};
+    uint8_t out[frame::kMaxPacketSize];
+    for (size_t size : kSizes) {
+        runner.run("frame.encode_record/" + std::to_string(size) + "B", static_cast<double>(size), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                payload[0] = static_cast<uint8_t>(i);
+                size_t written = frame::encodeRecord(out, sizeof(out), 1, payload, size);
+                bench::doNotOptimize(written);
+                bench::clobberMemory();
+            }
+        });
+    }
+}
+
+static void benchRing(bench::Runner& runner) {
+    static const size_t kSizes[] = {4, 16, 64, 200};
+    static RecordRing<4096> ring;
+    uint8_t payload[frame::kMaxRecordPayload] = {};
+    uint8_t out[frame::kMaxRecordPayload];
+    for (size_t size : kSizes) {
+        runner.run("ring.push_pop/" + std::to_string(size) + "B", static_cast<double>(size), [&](uint64_t n) {
+            uint8_t tag;
+            for (uint64_t i = 0; i < n; ++i) {
+                ring.push(1, payload, size);
+                int len = ring.pop(tag, out, sizeof(out));
+                bench::doNotOptimize(len);
+            }
+        });
+    }
+
+    // 半分埋まった状態での push（折り返しコピーを含む）
+    runner.run("ring.push_pop_halffull/16B", 16.0, [&](uint64_t n) {
+        uint8_t tag;
+        while (ring.used() < ring.capacity() / 2) {
+            ring.push(1, payload, 16);
+        }
+        for (uint64_t i = 0; i < n; ++i) {
+            ring.push(1, payload, 16);
+            int len = ring.pop(tag, out, sizeof(out));
+            bench::doNotOptimize(len);
+        }
+        ring.clear();
+    });
+}
+
+// 8 byte のレコードを MTU ごとにパケットへ詰める（1 op = 1 パケット）
+static void benchPacking(bench::Runner& runner) {
+    static const uint16_t kMtus[] = {23, 185, 247, 517};
+    static RecordRing<4096> ring;
+    uint8_t payload[8] = {};
+    uint8_t record[frame::kMaxRecordPayload];
+    uint8_t packet[frame::kMaxPacketSize];
+
+    for (uint16_t mtu : kMtus) {
+        size_t capacity = frame::packetCapacity(mtu);
+        size_t perPacket = (capacity - frame::kPacketHeaderSize) / (frame::kRecordHeaderSize + sizeof(payload));
+        runner.run("batch.pack/mtu" + std::to_string(mtu), static_cast<double>(perPacket * sizeof(payload)),
+                   [&](uint64_t n) {
+                       uint16_t seq = 0;
+                       for (uint64_t i = 0; i < n; ++i) {
+                           for (size_t r = 0; r < perPacket; ++r) {
+                               ring.push(2, payload, sizeof(payload));
+                           }
+                           frame::PacketBuilder builder;
+                           builder.begin(packet, capacity, seq++, static_cast<uint32_t>(i));
+                           int len;
+                           while ((len = ring.peekLength()) >= 0 && builder.fits(static_cast<size_t>(len))) {
+                               uint8_t stream = 0;
+                               ring.pop(stream, record, sizeof(record));
+                               builder.add(stream, record, static_cast<size_t>(len));
+                           }
+                           size_t size = builder.finish();
+                           bench::doNotOptimize(size);
+                       }
+                       ring.clear();
+                   });
+    }
+}
+
+static void noopHandler(void* context, const uint8_t* args, size_t len, CommandReply& reply) {
+    (void)context;
+    reply.append(args, len);
+}
+
+static void benchDispatch(bench::Runner& runner) {
+    CommandDispatcher dispatcher;
+    dispatcher.registerHandler(CMD_PING, &noopHandler, nullptr);
+    const uint8_t ping[] = {CMD_PING, 1, 2, 3, 4, 5, 6, 7, 8};
+    const uint8_t unknown[] = {0x3F};
+    uint8_t out[2 + CommandReply::kMaxPayload];
+
+    runner.run("command.dispatch/ping8", static_cast<double>(sizeof(ping)), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            size_t len = dispatcher.dispatch(ping, sizeof(ping), out, sizeof(out));
+            bench::doNotOptimize(len);
+        }
+    });
+    runner.run("command.dispatch/unknown", static_cast<double>(sizeof(unknown)), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            size_t len = dispatcher.dispatch(unknown, sizeof(unknown), out, sizeof(out));
+            bench::doNotOptimize(len);
+        }
+    });
+}
+
+// 20 byte の書き込み（MTU 23）を fragments 個つないで 1 メッセージに復元する
+static void benchReassembly(bench::Runner& runner) {
+    static const size_t kFragments[] = {1, 4, 16};
+    static Reassembler reassembler;
+    uint8_t writes[16][20];
+    for (size_t f = 0; f < 16; ++f) {
+        std::memset(writes[f], static_cast<int>(f), sizeof(writes[f]));
+    }
+
+    for (size_t fragments : kFragments) {
+        for (size_t f = 0; f < fragments; ++f) {
+            uint8_t header = static_cast<uint8_t>(f & Reassembler::kIndexMask);
+            if (f == 0) header |= Reassembler::kFirst;
+            if (f + 1 == fragments) header |= Reassembler::kLast;
+            writes[f][0] = header;
+        }
+        runner.run("reassembly/" + std::to_string(fragments) + "frag", static_cast<double>(fragments * 19),
+                   [&](uint64_t n) {
+                       for (uint64_t i = 0; i < n; ++i) {
+                           Reassembler::Result r = Reassembler::Result::Incomplete;
+                           for (size_t f = 0; f < fragments; ++f) {
+                               r = reassembler.feed(writes[f], sizeof(writes[f]));
+                           }
+                           bench::doNotOptimize(r);
+                       }
+                   });
+    }
+}
+
+static void benchProfiler(bench::Runner& runner) {
+#if APP_PROFILING
+    runner.run("profile.zone_overhead", 0.0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            PROFILE_ZONE(ZONE_NOTIFY);
+            bench::clobberMemory();
+        }
+    });
+    profiler::reset();
+#else
+    (void)runner;
+#endif
+}
+
+#if APP_PROFILING
+// ゾーンの集計を 1 回ごとの所要時間の分布として結果に載せる
+static void addZoneJitter(bench::Runner& runner, const std::string& name, uint8_t zone) {
+    profiler::ZoneReport r;
+    if (profiler::report(zone, r) && r.count > 0) {
+        double nsPerTick = 1000.0 / profiler::ticksPerMicrosecond();
+        runner.addJitter({name, r.count, r.minTicks * nsPerTick, r.avgTicks * nsPerTick, r.p99Ticks * nsPerTick,
+                          r.maxTicks * nsPerTick});
+    }
+    profiler::reset();
+}
+#endif
+
+/**
+ * ホットパスのばらつき（HOT_PATH の効果を見る基準値）
+ * - sched_tick: MTU 247 の 1 パケット分のレコードを積み、リングから取り出して詰める（notify() は除く）
+ * - rx_dispatch: 1 フラグメントの書き込みを復元して CMD_PING を振り分ける
+ * 1 回ごとに実機と同じゾーンで測るので、結果の p99・最大は CMD_GET_PROFILE の値と同じ意味になる。
+ * ホストには IRAM もフラッシュのキャッシュもないので、ここでの値は命令キャッシュのミスを含まない下限。
+ * 実機の A/B（IRAM とフラッシュ）の比較は README の手順で行う。
+ */
+static void benchHotPathJitter(bench::Runner& runner) {
+#if APP_PROFILING
+    static RecordRing<4096> ring;
+    uint8_t payload[8] = {};
+    uint8_t record[frame::kMaxRecordPayload];
+    uint8_t packet[frame::kMaxPacketSize];
+    size_t capacity = frame::packetCapacity(247);
+    size_t perPacket = (capacity - frame::kPacketHeaderSize) / (frame::kRecordHeaderSize + sizeof(payload));
+
+    const std::string tickName = "hotpath.sched_tick/mtu247";
+    if (runner.enabled(tickName)) {
+        profiler::reset();
+        runner.run(tickName, static_cast<double>(perPacket * sizeof(payload)), [&](uint64_t n) {
+            uint16_t seq = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                for (size_t r = 0; r < perPacket; ++r) {
+                    ring.push(2, payload, sizeof(payload));
+                }
+                PROFILE_ZONE(ZONE_SCHED_TICK);
+                frame::PacketBuilder builder;
+                builder.begin(packet, capacity, seq++, static_cast<uint32_t>(i));
+                int len;
+                while ((len = ring.peekLength()) >= 0 && builder.fits(static_cast<size_t>(len))) {
+                    uint8_t stream = 0;
+                    ring.pop(stream, record, sizeof(record));
+                    builder.add(stream, record, static_cast<size_t>(len));
+                }
+                size_t size = builder.finish();
+                bench::doNotOptimize(size);
+            }
+            ring.clear();
+        });
+        addZoneJitter(runner, tickName, ZONE_SCHED_TICK);
+    }
+
+    const std::string rxName = "hotpath.rx_dispatch/ping8";
+    if (runner.enabled(rxName)) {
+        static Reassembler reassembler;
+        CommandDispatcher dispatcher;
+        dispatcher.registerHandler(CMD_PING, &noopHandler, nullptr);
+        const uint8_t write[] = {Reassembler::kFirst | Reassembler::kLast, CMD_PING, 1, 2, 3, 4, 5, 6, 7, 8};
+        uint8_t out[2 + CommandReply::kMaxPayload];
+        profiler::reset();
+        runner.run(rxName, static_cast<double>(sizeof(write)), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                PROFILE_ZONE(ZONE_RX_DISPATCH);
+                size_t len = 0;
+                if (reassembler.feed(write, sizeof(write)) == Reassembler::Result::Complete) {
+                    len = dispatcher.dispatch(reassembler.message(), reassembler.messageLength(), out, sizeof(out));
+                }
+                bench::doNotOptimize(len);
+            }
+        });
+        addZoneJitter(runner, rxName, ZONE_RX_DISPATCH);
+    }
+#else
+    (void)runner;
+#endif
+}
+
+static void benchImu(bench::Runner& runner) {
+    hal::ImuSample samples[ImuStream::kMaxSamplesPerRecord];
+    for (size_t i = 0; i < ImuStream::kMaxSamplesPerRecord; ++i) {
+        int16_t v = static_cast<int16_t>(i * 37);
+        samples[i] = {v, static_cast<int16_t>(-v), 4096, static_cast<int16_t>(v / 2), 0, -1};
+    }
+    uint8_t out[ImuStream::kRecordHeaderSize + ImuStream::kMaxSamplesPerRecord * ImuStream::kSampleSize];
+
+    // MTU 247 の 1 パケット分（18 サンプル）
+    size_t count = ImuStream::samplesPerRecord(frame::packetCapacity(247));
+    double bytes = static_cast<double>(ImuStream::kRecordHeaderSize + count * ImuStream::kSampleSize);
+    runner.run("imu.encode_record/" + std::to_string(count) + "samples", bytes, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            size_t written = ImuStream::encodeRecord(static_cast<uint32_t>(i), 0, 625, samples, count, out);
+            bench::doNotOptimize(written);
+            bench::clobberMemory();
+        }
+    });
+
+    // 同じサンプルを差分符号化する。bytes は生の形式でのバイト数（ns/op ÷ count が 1 サンプルあたり）
+    int32_t values[ImuStream::kMaxSamplesPerRecord][ImuStream::kChannels];
+    for (size_t i = 0; i < count; ++i) {
+        const hal::ImuSample& s = samples[i];
+        int32_t v[ImuStream::kChannels] = {s.ax, s.ay, s.az, s.gx, s.gy, s.gz};
+        std::memcpy(values[i], v, sizeof(v));
+    }
+    runner.run("imu.encode_delta/" + std::to_string(count) + "samples", bytes, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            size_t written = 0;
+            for (size_t k = 0; k < count; ++k) {
+                written += delta::encodeSample(k == 0 ? nullptr : values[k - 1], values[k], ImuStream::kChannels,
+                                               out + written);
+            }
+            bench::doNotOptimize(written);
+            bench::clobberMemory();
+        }
+    });
+}
+
+static void benchOrientation(bench::Runner& runner) {
+    // 1 周期分（64 サンプル）のゆっくり揺れる動き。bytes は入力のサンプルのバイト数
+    static constexpr size_t kSamples = 64;
+    float gyro[kSamples][3];
+    float accel[kSamples][3];
+    for (size_t i = 0; i < kSamples; ++i) {
+        float t = 2.0f * 3.14159265f * static_cast<float>(i) / kSamples;
+        gyro[i][0] = 0.5f * std::sin(t);
+        gyro[i][1] = 0.3f * std::cos(t);
+        gyro[i][2] = 1.5f;
+        accel[i][0] = 0.1f * std::sin(t);
+        accel[i][1] = 0.1f * std::cos(t);
+        accel[i][2] = 1.0f;
+    }
+    const OrientationFilter::Algorithm algorithms[] = {OrientationFilter::Algorithm::Madgwick,
+                                                       OrientationFilter::Algorithm::Mahony};
+    const char* names[] = {"orientation.madgwick/64updates", "orientation.mahony/64updates"};
+    for (int a = 0; a < 2; ++a) {
+        OrientationFilter filter;
+        filter.configure(algorithms[a], a == 0 ? 0.1f : 1.0f);
+        runner.run(names[a], kSamples * 12.0, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                for (size_t k = 0; k < kSamples; ++k) {
+                    filter.update(gyro[k][0], gyro[k][1], gyro[k][2], accel[k][0], accel[k][1], accel[k][2],
+                                  0.0025f);
+                }
+                bench::doNotOptimize(filter.orientation().w);
+                bench::clobberMemory();
+            }
+        });
+    }
+}
+
+static void benchAdpcm(bench::Runner& runner) {
+    static constexpr size_t kSamples = 512;
+    int16_t pcm[kSamples];
+    for (size_t i = 0; i < kSamples; ++i) {
+        pcm[i] = static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * i / 16000.0));
+    }
+    uint8_t out[kSamples / 2];
+    int16_t decoded[kSamples];
+
+    // マイクのバッファ 1 面分（16 kHz で 32 ms）。bytes は入力の PCM バイト数
+    runner.run("adpcm.encode/512samples", sizeof(pcm), [&](uint64_t n) {
+        adpcm::State state;
+        for (uint64_t i = 0; i < n; ++i) {
+            size_t written = adpcm::encode(state, pcm, kSamples, out);
+            bench::doNotOptimize(written);
+            bench::clobberMemory();
+        }
+    });
+    runner.run("adpcm.decode/512samples", sizeof(pcm), [&](uint64_t n) {
+        adpcm::State state;
+        for (uint64_t i = 0; i < n; ++i) {
+            adpcm::decode(state, out, kSamples, decoded);
+            bench::clobberMemory();
+        }
+    });
+}
+
+static void benchDsp(bench::Runner& runner) {
+    // マイクのバッファ 1 面分（512 サンプル）。ホストではスカラー版だけ測れる（esp-dsp 版との比較は実機の
+    // CMD_DSP_BENCH で行う）。bytes は入力の float のバイト数
+    static constexpr size_t kSamples = 512;
+    static constexpr size_t kTaps = 32;
+    static float input[kSamples];
+    static float output[kSamples];
+    for (size_t i = 0; i < kSamples; ++i) {
+        input[i] = 0.25f * std::sin(2.0f * 3.14159265f * 440.0f * static_cast<float>(i) / 16000.0f);
+    }
+
+    float coeffs[kTaps];
+    dsp::designLowpass(0.2f, coeffs, kTaps);
+    static dsp::FirDecimator fir;
+    fir.init(coeffs, kTaps, 2, dsp::Backend::Scalar);
+    runner.run("dsp.fir_decimate2/32taps/512samples", sizeof(input), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            size_t produced = fir.process(input, kSamples, output);
+            bench::doNotOptimize(produced);
+            bench::clobberMemory();
+        }
+    });
+
+    dsp::Biquad biquad;
+    biquad.setLowpass(0.1f, 0.7071f);
+    runner.run("dsp.biquad/512samples", sizeof(input), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            biquad.process(input, output, kSamples);
+            bench::clobberMemory();
+        }
+    });
+
+    static const size_t kSizes[] = {64, 256};
+    static dsp::Fft fft;
+    for (size_t size : kSizes) {
+        char name[48];
+        std::snprintf(name, sizeof(name), "dsp.fft_magnitude/%zu", size);
+        fft.init(size, dsp::Backend::Scalar);
+        runner.run(name, size * sizeof(float), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                fft.magnitude(input, output);
+                bench::clobberMemory();
+            }
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* filter = nullptr;
+    const char* outPath = nullptr;
+    uint32_t minTimeMs = 200;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTimeMs = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else {
+            std::fprintf(stderr, "usage: %s [--filter substr] [--out file.json] [--min-time ms]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    bench::Runner runner(filter, minTimeMs);
+    benchFrameEncode(runner);
+    benchRing(runner);
+    benchPacking(runner);
+    benchDispatch(runner);
+    benchReassembly(runner);
+    benchProfiler(runner);
+    benchHotPathJitter(runner);
+    benchImu(runner);
+    benchAdpcm(runner);
+    benchOrientation(runner);
+    benchDsp(runner);
+
+    FILE* out = stdout;
+    if (outPath != nullptr) {
+        out = std::fopen(outPath, "w");
+        if (out == nullptr) {
+            std::perror(outPath);
+            return 1;
+        }
+    }
+    runner.writeJson(out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
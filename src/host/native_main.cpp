@@ -0,0 +1,1278 @@
+/**
+ * ネイティブ環境（Linux ホスト）用エントリポイント
+ * - モック HAL の上で BleApp を仮想時計で最高速に動かす
+ * - 接続 → Notify → 書き込み → 切断 → 広告再開 → 再接続 のシナリオを再生
+ * - IMU ストリーム（1600 Hz）をモック IMU で流し、サンプルの欠落がないことを確かめる
+ *   差分符号化（STREAM_IMU_DELTA）でも同じサンプル列に復号できることと圧縮率を確かめる
+ * - 音声ストリーム（16 kHz ADPCM）を復号して、元の波形との SNR を確かめる
+ * - カメラストリーム：リンクが詰まったときに遅れたフレームを送らず捨てることを確かめる
+ * - 姿勢ストリーム：z 軸まわりに回るモック IMU から推定したヨー角が回転量と合うことを確かめる
+ * - 時刻同期：遅延がばらつくリンク越しに、80 ppm ずれたセントラルの時計を 1 ms 未満の誤差で推定できることを確かめる
+ * - タッチストリーム：バッチ送信中でもタッチのイベントだけは同じ loop() で送られることを確かめる
+ * - バックログ：切断中の IMU をフラッシュ（モック）に溜め、途中で切れても ACK の次から重複なく再生することを確かめる
+ * - 設定：ハートビートの周期はすぐに効き、デバイス名と UUID は保存して起動し直すと効くことを確かめる
+ * - 時系列ログ：記録した IMU を seq・時刻の範囲で問い合わせ、範囲にかかるページだけを読むことを確かめる
+ * - 購読：ストリームの CCCD が書かれるまで IMU を読まず、何も Notify しないことを確かめる
+ * - コマンドの応答：MTU 23 でも長い応答をフラグメントに分けて、切り詰めずに返すことを確かめる
+ *
+ * 実行: pio run -e native -t exec
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "app/AdpcmCodec.h"
+#include "app/AppConfig.h"
+#include "app/AudioStream.h"
+#include "app/Backlog.h"
+#include "app/CameraStream.h"
+#include "app/ClockSync.h"
+#include "app/BleApp.h"
+#include "app/DeltaCodec.h"
+#include "app/Dsp.h"
+#include "app/FrameCodec.h"
+#include "app/GattTable.h"
+#include "app/ImuStream.h"
+#include "app/OrientationStream.h"
+#include "app/Reassembler.h"
+#include "app/RecordLog.h"
+#include "app/WriteBehind.h"
+#include "app/RuntimeConfig.h"
+#include "app/RuntimeStats.h"
+#include "app/Streams.h"
+#include "app/TouchStream.h"
+#include "app/TriggerTable.h"
+#include "app/Wire.h"
+#include "platform/native/MockHal.h"
+
+// 仮想時間で ms だけ loop() を回す（実機の loop() と同じく 1回ごとに LOOP_DELAY_MS 待つ）
+static void runFor(BleApp& app, MockClock& clock, uint32_t ms) {
+    uint32_t end = clock.millis() + ms;
+    while (clock.millis() < end) {
+        app.loop();
+        clock.delay(LOOP_DELAY_MS);
+    }
+}
+
+// ch 宛ての Notify の数
+static size_t countNotifies(const MockBlePeripheral& ble, hal::CharId ch) {
+    size_t n = 0;
+    for (const auto& notification : ble.notifications()) {
+        if (notification.ch == ch) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+// コマンド用キャラクタリスティックの Notify をフラグメントヘッダで復元し、最後に揃った応答を返す
+static std::vector<uint8_t> lastReply(const MockBlePeripheral& ble, hal::CharId commandCh) {
+    Reassembler replies;
+    std::vector<uint8_t> reply;
+    for (const auto& notification : ble.notifications()) {
+        if (notification.ch == commandCh &&
+            replies.feed(notification.data.data(), notification.data.size()) == Reassembler::Result::Complete) {
+            reply.assign(replies.message(), replies.message() + replies.messageLength());
+        }
+    }
+    return reply;
+}
+
+// ストリームの Notify から STREAM_IMU のレコードを取り出し、サンプル通番が連続しているか調べる
+static bool imuSamplesContiguous(const MockBlePeripheral& ble, hal::CharId streamCh, uint32_t& samples) {
+    uint32_t expected = 0;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notification.ch != streamCh ||
+            !reader.begin(notification.data.data(), notification.data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream != STREAM_IMU) {
+                continue;
+            }
+            uint8_t count = payload[10];
+            if (wire::getU32(payload) != expected ||
+                len != ImuStream::kRecordHeaderSize + count * ImuStream::kSampleSize ||
+                static_cast<int16_t>(wire::getU16(payload + ImuStream::kRecordHeaderSize)) !=
+                    static_cast<int16_t>(expected & 0xFFFF)) {
+                return false;
+            }
+            expected += count;
+        }
+    }
+    samples = expected;
+    return true;
+}
+
+// streamId のレコードの数
+static size_t countRecords(const MockBlePeripheral& ble, hal::CharId streamCh, uint8_t streamId) {
+    size_t n = 0;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notification.ch != streamCh ||
+            !reader.begin(notification.data.data(), notification.data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream == streamId) {
+                ++n;
+            }
+        }
+    }
+    return n;
+}
+
+// STREAM_IMU_DELTA のレコードを復号し、サンプル通番が連続していて値がモック IMU の通りか調べる
+static bool imuDeltaDecodes(const MockBlePeripheral& ble, hal::CharId streamCh, uint32_t& samples,
+                            uint32_t& keyframes) {
+    uint32_t expected = 0;
+    int32_t prev[ImuStream::kChannels] = {};
+    bool havePrev = false;
+    keyframes = 0;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notification.ch != streamCh ||
+            !reader.begin(notification.data.data(), notification.data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream != STREAM_IMU_DELTA) {
+                continue;
+            }
+            bool keyframe = (payload[11] & ImuStream::kFlagKeyframe) != 0;
+            if (wire::getU32(payload) != expected || (!keyframe && !havePrev)) {
+                return false;
+            }
+            keyframes += keyframe ? 1 : 0;
+            size_t pos = ImuStream::kDeltaHeaderSize;
+            for (uint8_t i = 0; i < payload[10]; ++i) {
+                int32_t values[ImuStream::kChannels];
+                size_t used = delta::decodeSample(i == 0 && keyframe ? nullptr : prev, payload + pos, len - pos,
+                                                  ImuStream::kChannels, values);
+                if (used == 0 || static_cast<int16_t>(values[0]) != static_cast<int16_t>(expected & 0xFFFF) ||
+                    values[2] != 4096) {
+                    return false;
+                }
+                std::memcpy(prev, values, sizeof(prev));
+                pos += used;
+                ++expected;
+            }
+            havePrev = true;
+            if (pos != len) {
+                return false;
+            }
+        }
+    }
+    samples = expected;
+    return true;
+}
+
+// STREAM_ORIENTATION のレコードを読み、姿勢の数・最後の姿勢の IMU 通番とヨー角 [deg]・レコードのバイト数を返す
+static uint32_t lastOrientation(const MockBlePeripheral& ble, hal::CharId streamCh, uint32_t& lastIndex,
+                                double& yawDeg, size_t& bytes) {
+    uint32_t quaternions = 0;
+    bytes = 0;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notification.ch != streamCh ||
+            !reader.begin(notification.data.data(), notification.data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream != STREAM_ORIENTATION) {
+                continue;
+            }
+            uint8_t count = payload[10];
+            const uint8_t* last = payload + OrientationStream::kRecordHeaderSize +
+                                  (count - 1) * OrientationStream::kQuaternionSize;
+            double x = static_cast<int16_t>(wire::getU16(last)) / 32767.0;
+            double y = static_cast<int16_t>(wire::getU16(last + 2)) / 32767.0;
+            double z = static_cast<int16_t>(wire::getU16(last + 4)) / 32767.0;
+            double w = std::sqrt(std::max(0.0, 1.0 - x * x - y * y - z * z));
+            uint32_t step = static_cast<uint32_t>(wire::getU16(payload + 8) / 2500u);  // 400 Hz の IMU 前提
+            lastIndex = wire::getU32(payload) + (count - 1) * step;
+            yawDeg = 2.0 * std::atan2(z, w) * 180.0 / 3.14159265358979;
+            quaternions += count;
+            bytes += frame::kRecordHeaderSize + len;
+        }
+    }
+    return quaternions;
+}
+
+// STREAM_AUDIO のレコードを復号し、モックマイクの入力との SNR [dB] を求める（欠落・不整合なら -1）
+static double audioSnrDb(const MockBlePeripheral& ble, hal::CharId streamCh, uint32_t sampleRate,
+                         uint32_t& samples) {
+    uint32_t expected = 0;
+    double signal = 0;
+    double noise = 0;
+    int16_t decoded[AudioStream::kMaxSamplesPerRecord];
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notification.ch != streamCh ||
+            !reader.begin(notification.data.data(), notification.data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream != STREAM_AUDIO) {
+                continue;
+            }
+            adpcm::State state;
+            state.predictor = static_cast<int16_t>(wire::getU16(payload + 4));
+            state.stepIndex = payload[6];
+            uint16_t count = wire::getU16(payload + 7);
+            if (wire::getU32(payload) != expected || count > AudioStream::kMaxSamplesPerRecord ||
+                len != AudioStream::kRecordHeaderSize + (count + 1) / 2) {
+                return -1;
+            }
+            adpcm::decode(state, payload + AudioStream::kRecordHeaderSize, count, decoded);
+            for (uint16_t i = 0; i < count; ++i) {
+                double original = MockMicrophone::sampleAt(expected + i, sampleRate);
+                signal += original * original;
+                noise += (original - decoded[i]) * (original - decoded[i]);
+            }
+            expected += count;
+        }
+    }
+    samples = expected;
+    return noise > 0 ? 10.0 * std::log10(signal / noise) : 99.0;
+}
+
+// スカラー版の DSP カーネルを素朴な実装と比べ、FIR 間引き・FFT の誤差の最大値を返す
+static void dspKernelErrors(double& firError, double& fftError) {
+    static constexpr size_t kSamples = 256;
+    static constexpr size_t kTaps = 32;
+    float input[kSamples];
+    for (size_t i = 0; i < kSamples; ++i) {
+        input[i] = static_cast<float>(0.3 * std::sin(0.21 * i) + 0.2 * std::cos(1.7 * i));
+    }
+
+    float coeffs[kTaps];
+    dsp::designLowpass(0.2f, coeffs, kTaps);
+    dsp::FirDecimator fir;
+    float decimated[kSamples / 2];
+    fir.init(coeffs, kTaps, 2, dsp::Backend::Scalar);
+    fir.process(input, kSamples, decimated);
+    firError = 0;
+    for (size_t m = 0; m < kSamples / 2; ++m) {
+        // 出力 m は入力 2m + 1 までの畳み込み（それより前は 0）
+        double expected = 0;
+        for (size_t k = 0; k < kTaps && k <= 2 * m + 1; ++k) {
+            expected += coeffs[k] * input[2 * m + 1 - k];
+        }
+        firError = std::max(firError, std::fabs(expected - decimated[m]));
+    }
+
+    dsp::Fft fft;
+    float magnitude[kSamples / 2];
+    fft.init(kSamples, dsp::Backend::Scalar);
+    fft.magnitude(input, magnitude);
+    fftError = 0;
+    double windowSum = kSamples / 2.0;
+    for (size_t k = 0; k < kSamples / 2; ++k) {
+        double re = 0;
+        double im = 0;
+        for (size_t i = 0; i < kSamples; ++i) {
+            double w = 0.5 - 0.5 * std::cos(2.0 * 3.14159265358979 * i / kSamples);
+            double angle = 2.0 * 3.14159265358979 * k * i / kSamples;
+            re += input[i] * w * std::cos(angle);
+            im -= input[i] * w * std::sin(angle);
+        }
+        double expected = std::sqrt(re * re + im * im) * (k == 0 ? 1.0 : 2.0) / windowSum;
+        fftError = std::max(fftError, std::fabs(expected - magnitude[k]));
+    }
+}
+
+// STREAM_SPECTRUM のレコードを読み、スペクトル数・最大のビン・その値・レコードのバイト数を返す
+// 通番が飛んだ・最大のビンがスペクトルごとに違えば false
+static bool readSpectra(const MockBlePeripheral& ble, hal::CharId streamCh, uint32_t& spectra, size_t& peakBin,
+                        uint8_t& peakValue, size_t& bytes) {
+    spectra = 0;
+    bytes = 0;
+    uint32_t expected = 0;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notification.ch != streamCh ||
+            !reader.begin(notification.data.data(), notification.data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream != STREAM_SPECTRUM) {
+                continue;
+            }
+            uint16_t rate = wire::getU16(payload + 4);
+            uint16_t fftSize = wire::getU16(payload + 6);
+            uint8_t count = payload[9];
+            if (wire::getU32(payload) != expected || len != AudioStream::kSpectrumHeaderSize + count || rate == 0) {
+                return false;
+            }
+            const uint8_t* bins = payload + AudioStream::kSpectrumHeaderSize;
+            size_t best = static_cast<size_t>(std::max_element(bins, bins + count) - bins);
+            if (spectra > 0 && best != peakBin) {
+                return false;
+            }
+            peakBin = best;
+            peakValue = bins[best];
+            expected += static_cast<uint32_t>(fftSize) * payload[8] * (16000 / rate);
+            bytes += frame::kRecordHeaderSize + len;
+            ++spectra;
+        }
+    }
+    return spectra > 0;
+}
+
+// STREAM_CAMERA のチャンクをフレームに組み立て、JPEG マーカーで挟まれた完全なフレームの数を返す
+static uint32_t countCompleteFrames(const MockBlePeripheral& ble, hal::CharId streamCh) {
+    uint32_t complete = 0;
+    uint16_t frameId = 0;
+    std::vector<uint8_t> jpeg;
+    size_t received = 0;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notification.ch != streamCh ||
+            !reader.begin(notification.data.data(), notification.data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream != STREAM_CAMERA || len < CameraStream::kChunkHeaderSize) {
+                continue;
+            }
+            uint16_t id = wire::getU16(payload);
+            uint32_t offset = wire::getU32(payload + 2);
+            uint32_t size = wire::getU32(payload + 6);
+            size_t n = len - CameraStream::kChunkHeaderSize;
+            if (id != frameId || jpeg.size() != size) {
+                // 新しいフレーム（前のフレームが揃っていなければ捨てる）
+                frameId = id;
+                jpeg.assign(size, 0);
+                received = 0;
+            }
+            if (offset + n > size || offset != received) {
+                continue;
+            }
+            std::memcpy(&jpeg[offset], payload + CameraStream::kChunkHeaderSize, n);
+            received += n;
+            if (received == size && size >= 4 && jpeg[0] == 0xFF && jpeg[1] == 0xD8 && jpeg[size - 2] == 0xFF &&
+                jpeg[size - 1] == 0xD9) {
+                ++complete;
+            }
+        }
+    }
+    return complete;
+}
+
+// fromMs 以降に届いた STREAM_CAMERA のチャンクのうち、揃わなかったフレームのもの（最後のフレームは除く）を数える。
+// packets には、そのチャンクを含んでいたパケットの数を返す
+static uint32_t countLateChunks(const MockBlePeripheral& ble, hal::CharId streamCh, uint32_t fromMs,
+                                uint32_t& packets) {
+    struct Chunk {
+        uint16_t id;
+        uint32_t size;
+        size_t n;
+        size_t notification;
+        bool late;
+    };
+    std::vector<Chunk> chunks;
+    const auto& notifications = ble.notifications();
+    for (size_t i = 0; i < notifications.size(); ++i) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (notifications[i].ch != streamCh ||
+            !reader.begin(notifications[i].data.data(), notifications[i].data.size(), header)) {
+            continue;
+        }
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream == STREAM_CAMERA && len >= CameraStream::kChunkHeaderSize) {
+                chunks.push_back({wire::getU16(payload), wire::getU32(payload + 6),
+                                  len - CameraStream::kChunkHeaderSize, i, notifications[i].timeMs >= fromMs});
+            }
+        }
+    }
+    uint32_t late = 0;
+    size_t lastPacket = notifications.size();
+    packets = 0;
+    for (const Chunk& c : chunks) {
+        if (!c.late || c.id == chunks.back().id) {
+            continue;
+        }
+        size_t received = 0;
+        for (const Chunk& other : chunks) {
+            if (other.id == c.id) {
+                received += other.n;
+            }
+        }
+        if (received < c.size) {
+            ++late;
+            if (c.notification != lastPacket) {
+                ++packets;
+                lastPacket = c.notification;
+            }
+        }
+    }
+    return late;
+}
+
+int main() {
+    MockClock clock;
+    MockSerialPort serial(&clock);
+    MockDisplay display;
+    MockBlePeripheral ble(clock);
+    MockImu imu(clock);
+    MockMicrophone mic(clock, MIC_BUFFER_SAMPLES);
+    MockCamera camera(clock);
+    MockTouch touch(clock);
+    MockFileStore fileStore;
+
+    BleApp app(clock, serial, display, ble);
+    app.attachImu(&imu);
+    app.attachMicrophone(&mic);
+    app.attachCamera(&camera);
+    app.attachTouch(&touch);
+    app.attachStorage(&fileStore);
+    app.setup();
+
+    hal::CharId ch = ble.findCharacteristic(CHARACTERISTIC_UUID);
+    hal::CharId streamCh = ble.findCharacteristic(STREAM_CHAR_UUID);
+    hal::CharId commandCh = ble.findCharacteristic(COMMAND_CHAR_UUID);
+    hal::CharId statsCh = ble.findCharacteristic(STATS_CHAR_UUID);
+    int failures = 0;
+    auto check = [&failures](bool ok, const char* what) {
+        std::printf("%s: %s\n", ok ? "OK  " : "FAIL", what);
+        if (!ok) {
+            ++failures;
+        }
+    };
+
+    check(ble.isAdvertising(), "advertising after setup");
+    // GATT は app/GattTable.h の表の順に、コンパイル時に読んだ UUID とプロパティで登録される
+    bool gattFromTable = ble.characteristics().size() == gatt::kCharCount + 1 &&
+                         ble.handleCount() == gatt::serviceHandleCount() && ble.handleCount() == 14;
+    for (size_t i = 0; gattFromTable && i < gatt::kCharCount; ++i) {
+        gattFromTable = ble.characteristics()[i].uuid == gatt::kChars[i].defaultUuid &&
+                        ble.characteristics()[i].properties == gatt::kChars[i].properties;
+    }
+    check(gattFromTable && ch == gatt::CHAR_DATA && statsCh == gatt::CHAR_STATS,
+          "GATT database is registered from the constexpr table");
+    // Database Hash は探索せずに読める。初めての起動なので Service Changed は送らない
+    uint8_t expectedHash[gatt::kDatabaseHashSize];
+    gatt::databaseHash(app.settings(), expectedHash);
+    hal::CharId hashCh = ble.findCharacteristic("00002B2A-0000-1000-8000-00805F9B34FB");
+    std::vector<uint8_t> hashValue = hashCh != hal::kInvalidId ? ble.read(hashCh) : std::vector<uint8_t>();
+    check(hashValue.size() == sizeof(expectedHash) &&
+              std::memcmp(hashValue.data(), expectedHash, sizeof(expectedHash)) == 0 &&
+              !app.serviceChangePending() && fileStore.size("/gatt.bin") == gatt::kDatabaseHashSize + 1,
+          "database hash characteristic is published and recorded at first boot");
+
+    runFor(app, clock, 1000);
+    ble.connect(0);
+    runFor(app, clock, 7000);
+    check(countNotifies(ble, ch) == 3, "3 notifies in 7 s while connected");
+    check(countNotifies(ble, streamCh) == 3, "3 heartbeat packets on the stream characteristic");
+
+    ble.write(ch, "hello from central");
+    runFor(app, clock, LOOP_DELAY_MS);
+    const MockDisplay::Line* rx = display.lineAt(80);
+    check(rx != nullptr && rx->text == "RX: hello from central", "RX shown on display");
+
+    const uint8_t ping[] = {Reassembler::kFirst | Reassembler::kLast, CMD_PING, 'h', 'i'};
+    ble.write(commandCh, ping, sizeof(ping));
+    runFor(app, clock, LOOP_DELAY_MS);
+    const auto& last = ble.notifications().back();
+    std::vector<uint8_t> pingReply = lastReply(ble, commandCh);
+    check(last.ch == commandCh && last.data[0] == (Reassembler::kFirst | Reassembler::kLast) &&
+              pingReply.size() == 4 && pingReply[0] == (CMD_PING | 0x80) && pingReply[1] == 0,
+          "ping command answered on the command characteristic");
+
+    ble.disconnect();
+    runFor(app, clock, 1000);
+    check(ble.isAdvertising() && ble.advertisingStarts() == 2, "advertising restarted after disconnect");
+
+    size_t before = countNotifies(ble, ch);
+    runFor(app, clock, 5000);
+    check(countNotifies(ble, ch) == before, "no notifies while disconnected");
+
+    ble.connect(1);
+    runFor(app, clock, 3000);
+    check(countNotifies(ble, ch) > before, "notifies resume after reconnect");
+
+    std::vector<uint8_t> raw = ble.read(statsCh);
+    StatsPayload stats = {};
+    check(payload::decode(raw.data(), raw.size(), stats), "stats characteristic returns StatsPayload");
+    check(stats.maxFirstNotifyMs > 0 && stats.maxFirstNotifyMs <= NOTIFY_PERIOD_MS &&
+              stats.firstNotifyMs <= stats.maxFirstNotifyMs,
+          "stats measure connect-to-first-notify time");
+    std::printf("connect to first notify: last %u ms, max %u ms\n", stats.firstNotifyMs, stats.maxFirstNotifyMs);
+    check(stats.connects == 2 && stats.disconnects == 1 && stats.lastReconnectMs == 6000,
+          "stats count connects and reconnect duration");
+    check(stats.writesReceived == 2 && stats.notifiesSent > 0, "stats count writes and notifies");
+
+    // 長い書き込み（512 byte）も受信時刻を付けて積む。ATT の上限を超えるものは積まずに数える
+    std::vector<uint8_t> longWrite(512, 'x');
+    longWrite[0] = Reassembler::kFirst | Reassembler::kLast;
+    longWrite[1] = CMD_PING;
+    ble.write(commandCh, longWrite.data(), longWrite.size());
+    runFor(app, clock, LOOP_DELAY_MS);
+    std::vector<uint8_t> longReply = lastReply(ble, commandCh);
+    bool longStamped = longReply.size() == 2 && longReply[0] == (CMD_PING | 0x80) &&
+                       longReply[1] == static_cast<uint8_t>(CommandStatus::BadArguments);
+    size_t repliesBefore = countNotifies(ble, commandCh);
+    std::vector<uint8_t> oversized(600, 'x');
+    oversized[0] = Reassembler::kFirst | Reassembler::kLast;
+    oversized[1] = CMD_PING;
+    ble.write(commandCh, oversized.data(), oversized.size());
+    runFor(app, clock, LOOP_DELAY_MS);
+    check(longStamped && app.oversizedWriteCount() == 1 && countNotifies(ble, commandCh) == repliesBefore,
+          "512-byte command writes are stamped, larger ones are counted and dropped");
+
+    const uint8_t reset[] = {Reassembler::kFirst | Reassembler::kLast, CMD_RESET_STATS};
+    ble.write(commandCh, reset, sizeof(reset));
+    runFor(app, clock, LOOP_DELAY_MS);
+    raw = ble.read(statsCh);
+    payload::decode(raw.data(), raw.size(), stats);
+    check(stats.connects == 0 && stats.writesReceived == 0, "CMD_RESET_STATS clears counters");
+
+    // IMU 1600 Hz（±8 g, ±2000 dps）を 5 秒流す。センサは 0.1% 速めにずらしておく
+    imu.setDriftPpm(1000);
+    ble.clearNotifications();
+    const uint8_t imuStart[] = {Reassembler::kFirst | Reassembler::kLast, CMD_IMU_START, 0x40, 0x06, 8, 0xD0, 0x07};
+    ble.write(commandCh, imuStart, sizeof(imuStart));
+    runFor(app, clock, 5000);
+    const uint8_t imuStop[] = {Reassembler::kFirst | Reassembler::kLast, CMD_IMU_STOP};
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    ImuStreamStats imuStats = app.imu().stats();
+    uint32_t imuSamples = 0;
+    check(imuStats.samplesRead >= 7900 && imuStats.samplesDropped == 0 && imuStats.fifoOverruns == 0,
+          "IMU 1600 Hz streamed without drops or FIFO overruns");
+    check(imuSamplesContiguous(ble, streamCh, imuSamples) && imuSamples == imuStats.samplesSent,
+          "IMU records carry contiguous sample indices");
+
+    // 同じ IMU を差分符号化で 2 秒流す
+    ble.clearNotifications();
+    const uint8_t imuStartDelta[] = {Reassembler::kFirst | Reassembler::kLast, CMD_IMU_START, 0x40, 0x06, 8, 0xD0,
+                                     0x07, 1};
+    ble.write(commandCh, imuStartDelta, sizeof(imuStartDelta));
+    runFor(app, clock, 2000);
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    const ImuStreamStats& deltaStats = app.imu().stats();
+    uint32_t deltaSamples = 0;
+    uint32_t keyframes = 0;
+    double ratio = deltaStats.encodedBytes > 0 ? static_cast<double>(deltaStats.rawBytes) / deltaStats.encodedBytes : 0;
+    check(imuDeltaDecodes(ble, streamCh, deltaSamples, keyframes) && deltaSamples == deltaStats.samplesSent &&
+              deltaStats.samplesDropped == 0 && keyframes > 1,
+          "delta-encoded IMU records decode to the same samples");
+    check(ratio > 1.5, "delta encoding shrinks IMU records");
+    std::printf("imu delta: %u samples, %u keyframes, %u -> %u bytes (ratio %.2f), encode %u ns/sample\n",
+                deltaSamples, keyframes, deltaStats.rawBytes, deltaStats.encodedBytes, ratio,
+                deltaStats.encodeNsPerSample);
+
+    // 16 kHz の音声を 3 秒流す
+    ble.clearNotifications();
+    const uint8_t audioStart[] = {Reassembler::kFirst | Reassembler::kLast, CMD_AUDIO_START, 0x80, 0x3E};
+    ble.write(commandCh, audioStart, sizeof(audioStart));
+    runFor(app, clock, 3000);
+    const uint8_t audioStop[] = {Reassembler::kFirst | Reassembler::kLast, CMD_AUDIO_STOP};
+    ble.write(commandCh, audioStop, sizeof(audioStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    const AudioStreamStats& audioStats = app.audio().stats();
+    uint32_t audioSamples = 0;
+    double snr = audioSnrDb(ble, streamCh, 16000, audioSamples);
+    check(audioStats.samplesCaptured >= 16000 * 3 - 2 * MIC_BUFFER_SAMPLES && audioStats.samplesDropped == 0 &&
+              audioStats.underruns == 0,
+          "audio 16 kHz streamed without drops or underruns");
+    check(audioSamples == audioStats.samplesSent && snr > 20.0, "ADPCM records decode to the input (SNR > 20 dB)");
+    std::printf("audio: %u samples, SNR %.1f dB, encode %u us total (max %u us per buffer)\n", audioSamples, snr,
+                audioStats.encodeUs, audioStats.encodeMaxUs);
+    size_t adpcmBytes =
+        audioSamples / 2 + audioStats.records * (frame::kRecordHeaderSize + AudioStream::kRecordHeaderSize);
+
+    // DSP カーネル（スカラー版）を素朴な実装と比べる
+    double firError = 0;
+    double fftError = 0;
+    dspKernelErrors(firError, fftError);
+    check(firError < 1e-5 && fftError < 1e-4, "scalar FIR decimator and FFT match the reference");
+
+    // 同じ 440 Hz を 1/2 に間引き、2 kHz ローパス・256 点 FFT・4 フレーム平均のスペクトルにして 3 秒流す
+    ble.clearNotifications();
+    const uint8_t spectrumStart[] = {Reassembler::kFirst | Reassembler::kLast, CMD_AUDIO_START, 0x80, 0x3E, 2,
+                                     SPECTRUM_FILTER_LOWPASS, 0xD0, 0x07, 0x00, 0x01, 4};
+    ble.write(commandCh, spectrumStart, sizeof(spectrumStart));
+    runFor(app, clock, 3000);
+    ble.write(commandCh, audioStop, sizeof(audioStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    const AudioStreamStats& spectrumStats = app.audio().stats();
+    uint32_t spectra = 0;
+    size_t peakBin = 0;
+    uint8_t peakValue = 0;
+    size_t spectrumBytes = 0;
+    bool spectraOk = readSpectra(ble, streamCh, spectra, peakBin, peakValue, spectrumBytes);
+    // 440 Hz はビン幅 31.25 Hz の 14 番目、振幅 8000 は -12.2 dBFS（値 216）
+    check(spectraOk && spectra == spectrumStats.spectra && spectra >= 22 && spectrumStats.spectraDropped == 0 &&
+              peakBin == 14 && peakValue >= 210 && peakValue <= 220,
+          "spectrum mode reports the 440 Hz tone in the right bin");
+    double airtimeRatio = spectrumBytes > 0 ? static_cast<double>(adpcmBytes) / spectrumBytes : 0;
+    check(airtimeRatio > 4.0, "spectrum frames use a fraction of the ADPCM airtime");
+    std::printf("spectrum: %u spectra, peak bin %zu (%u), %zu bytes vs ADPCM %zu (ratio %.1f), dsp %u us total, "
+                "fir err %.1e, fft err %.1e\n",
+                spectra, peakBin, peakValue, spectrumBytes, adpcmBytes, airtimeRatio, spectrumStats.encodeUs, firError,
+                fftError);
+
+    // カメラ 160x120（品質 60）を 5 fps・期限 500 ms で流し、途中でリンクを 1.5 秒詰まらせる
+    ble.clearNotifications();
+    const uint8_t cameraStart[] = {Reassembler::kFirst | Reassembler::kLast, CMD_CAMERA_START, 160, 0, 120, 0, 60,
+                                   200, 0, 0xF4, 0x01};
+    ble.write(commandCh, cameraStart, sizeof(cameraStart));
+    runFor(app, clock, 2000);
+    const CameraStreamStats& cameraStats = app.camera().stats();
+    uint32_t sentBeforeStall = cameraStats.framesSent;
+    check(sentBeforeStall >= 9 && cameraStats.framesSkipped == 0 && cameraStats.framesAborted == 0 &&
+              countCompleteFrames(ble, streamCh) == sentBeforeStall,
+          "camera 5 fps delivers whole frames on a free link");
+    ble.setLinkStalled(true);
+    runFor(app, clock, 1500);
+    ble.setLinkStalled(false);
+    uint32_t stallEndMs = clock.millis();
+    runFor(app, clock, 2000);
+    uint32_t latePackets = 0;
+    uint32_t lateChunks = countLateChunks(ble, streamCh, stallEndMs, latePackets);
+    // 打ち切ったフレームで後から届くのは、詰まる前に BLE スタックに渡していた 1 パケットの分だけ
+    check(cameraStats.framesAborted > 0 && latePackets <= 1,
+          "camera purges queued chunks of an aborted frame");
+    const uint8_t cameraStop[] = {Reassembler::kFirst | Reassembler::kLast, CMD_CAMERA_STOP};
+    ble.write(commandCh, cameraStop, sizeof(cameraStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    check(cameraStats.framesSkipped + cameraStats.framesAborted > 0 && cameraStats.latencyMaxMs <= 500 &&
+              cameraStats.framesSent > sentBeforeStall + 5,
+          "camera drops whole frames while the link is stalled and recovers");
+    std::printf("camera: captured %u, sent %u, skipped %u, aborted %u, %.2f fps, latency avg %u ms max %u ms, "
+                "late chunks %u\n",
+                cameraStats.framesCaptured, cameraStats.framesSent, cameraStats.framesSkipped,
+                cameraStats.framesAborted, cameraStats.fpsX100 / 100.0, cameraStats.latencyAvgMs,
+                cameraStats.latencyMaxMs, lateChunks);
+
+    // カメラが IMU・タッチと内部 I2C を共用する実機と同じ条件：どちらかが動いている間はカメラを始めない
+    camera.setSharesSensorBus(true);
+    bool imuWasRunning = app.imu().isRunning();
+    app.imu().stop();
+    ble.write(commandCh, cameraStart, sizeof(cameraStart));
+    runFor(app, clock, LOOP_DELAY_MS);
+    bool refusedWithTouch = lastReply(ble, commandCh)[1] == static_cast<uint8_t>(CommandStatus::Failed) &&
+                            !app.camera().isRunning();
+    app.attachTouch(nullptr);
+    ble.write(commandCh, imuStart, sizeof(imuStart));
+    runFor(app, clock, LOOP_DELAY_MS);
+    bool refusedWithImu = app.imu().isRunning();
+    ble.write(commandCh, cameraStart, sizeof(cameraStart));
+    runFor(app, clock, LOOP_DELAY_MS);
+    refusedWithImu = refusedWithImu && !app.camera().isRunning();
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    ble.write(commandCh, cameraStart, sizeof(cameraStart));
+    runFor(app, clock, LOOP_DELAY_MS);
+    bool startedAlone = app.camera().isRunning();
+    ble.write(commandCh, imuStart, sizeof(imuStart));
+    runFor(app, clock, LOOP_DELAY_MS);
+    bool imuRefused = lastReply(ble, commandCh)[1] == static_cast<uint8_t>(CommandStatus::Failed) &&
+                      !app.imu().isRunning();
+    ble.write(commandCh, cameraStop, sizeof(cameraStop));
+    ble.write(commandCh, imuStart, sizeof(imuStart));
+    runFor(app, clock, LOOP_DELAY_MS);
+    check(refusedWithTouch && refusedWithImu && startedAlone && imuRefused && app.imu().isRunning(),
+          "camera on the shared sensor bus never runs together with the IMU or touch");
+    app.attachTouch(&touch);
+    camera.setSharesSensorBus(false);
+    if (!imuWasRunning) {
+        app.imu().stop();
+    }
+
+    // タッチ：バッチ送信（200 ms 保留）中に積んだレコードより先に、タッチだけがその loop() で出る
+    ble.clearNotifications();
+    app.streamScheduler().setPolicy(PacingPolicy::batched(200));
+    const uint8_t marker[] = {0};
+    app.streamScheduler().enqueue(STREAM_TRACE, marker, sizeof(marker));
+    // 割り込みから loop() に入るまで 4 ms かかったとする
+    touch.inject(hal::TouchType::Down, 120, 80);
+    clock.delay(4);
+    app.loop();
+    touch.inject(hal::TouchType::Up, 120, 80);
+    clock.delay(4);
+    app.loop();
+    const TouchStreamStats& touchStats = app.touch().stats();
+    check(countRecords(ble, streamCh, STREAM_TOUCH) == 2 && countRecords(ble, streamCh, STREAM_TRACE) == 0 &&
+              touchStats.measured == 2 && touchStats.latencyMaxUs < LOOP_DELAY_MS * 1000,
+          "touch events bypass the batched lane and are sent in the same loop()");
+    runFor(app, clock, 300);
+    check(countRecords(ble, streamCh, STREAM_TRACE) == 1, "batched record follows after the hold time");
+    app.streamScheduler().setPolicy(PacingPolicy::eager());
+    std::printf("touch: events %u, dropped %u, detect avg %u us, latency avg %u us max %u us\n",
+                touchStats.events, touchStats.dropped, touchStats.detectAvgUs, touchStats.latencyAvgUs,
+                touchStats.latencyMaxUs);
+
+    // 姿勢：400 Hz の IMU を 90 deg/s で回し、100 Hz の姿勢だけを送る（生のサンプルは止める）
+    ble.clearNotifications();
+    imu.setRotation(90.0f);
+    const uint8_t imuStart400[] = {Reassembler::kFirst | Reassembler::kLast, CMD_IMU_START, 0x90, 0x01, 8, 0xD0, 0x07};
+    const uint8_t orientationStart[] = {Reassembler::kFirst | Reassembler::kLast, CMD_ORIENTATION_START, 100, 0, 0,
+                                        100, 0, 0};
+    ble.write(commandCh, imuStart400, sizeof(imuStart400));
+    ble.write(commandCh, orientationStart, sizeof(orientationStart));
+    runFor(app, clock, 1000);
+    const uint8_t orientationStop[] = {Reassembler::kFirst | Reassembler::kLast, CMD_ORIENTATION_STOP};
+    ble.write(commandCh, orientationStop, sizeof(orientationStop));
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    imu.setRotation(0.0f);
+    const OrientationStreamStats& orientationStats = app.orientation().stats();
+    uint32_t lastIndex = 0;
+    double yaw = 0;
+    size_t orientationBytes = 0;
+    uint32_t quaternions = lastOrientation(ble, streamCh, lastIndex, yaw, orientationBytes);
+    double expectedYaw = (lastIndex + 1) * 0.0025 * 90.0;
+    check(quaternions >= 95 && quaternions == orientationStats.quaternionsSent &&
+              orientationStats.quaternionsDropped == 0 && countRecords(ble, streamCh, STREAM_IMU) == 0,
+          "orientation stream sends 100 Hz quaternions instead of raw samples");
+    check(std::fabs(yaw - expectedYaw) < 1.0, "fused yaw follows the gyro rotation");
+    std::printf("orientation: %u quaternions in %u bytes (raw would be %u bytes), yaw %.2f deg (expected %.2f), "
+                "update avg %u ns max %u ns\n",
+                quaternions, static_cast<unsigned>(orientationBytes),
+                static_cast<unsigned>(orientationStats.updates * ImuStream::kSampleSize), yaw, expectedYaw,
+                orientationStats.updateAvgNs, orientationStats.updateMaxNs);
+
+    // トリガー：ハートビートを 5 秒ごとにすると、11 秒で 2 回だけ送る
+    ble.clearNotifications();
+    uint8_t heartbeatRule[12] = {Reassembler::kFirst | Reassembler::kLast, CMD_TRIGGER_SET, STREAM_HEARTBEAT,
+                                 static_cast<uint8_t>(TriggerMode::HeartbeatOnly)};
+    wire::putU32(heartbeatRule + 8, 5000);
+    ble.write(commandCh, heartbeatRule, sizeof(heartbeatRule));
+    runFor(app, clock, 11000);
+    check(countNotifies(ble, ch) == 2 && countRecords(ble, streamCh, STREAM_HEARTBEAT) == 2,
+          "heartbeat trigger stretches the notify period");
+    wire::putU32(heartbeatRule + 8, NOTIFY_PERIOD_MS);
+    ble.write(commandCh, heartbeatRule, sizeof(heartbeatRule));
+
+    // 回っているだけの IMU は 0.1 g 以上の変化と 1 秒ごとのハートビートだけ送り、揺れたらすぐに送る
+    ble.clearNotifications();
+    imu.setRotation(10.0f);
+    uint8_t imuRule[12] = {Reassembler::kFirst | Reassembler::kLast, CMD_TRIGGER_SET, STREAM_IMU,
+                           static_cast<uint8_t>(TriggerMode::OnChange)};
+    wire::putU32(imuRule + 4, 100);
+    wire::putU32(imuRule + 8, 1000);
+    ble.write(commandCh, imuRule, sizeof(imuRule));
+    ble.write(commandCh, imuStart400, sizeof(imuStart400));
+    runFor(app, clock, 2500);
+    TriggerStats quietTrigger = app.triggerTable().stats(STREAM_IMU);
+    imu.setLinearAccel(0.5f);
+    runFor(app, clock, 20);
+    TriggerStats shakeTrigger = app.triggerTable().stats(STREAM_IMU);
+    runFor(app, clock, 480);
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    imu.setLinearAccel(0.0f);
+    imu.setRotation(0.0f);
+    const TriggerStats& imuTrigger = app.triggerTable().stats(STREAM_IMU);
+    const ImuStreamStats& triggeredImu = app.imu().stats();
+    check(quietTrigger.admitted == 3 && quietTrigger.heartbeats == 2 && shakeTrigger.admitted == 4 &&
+              imuTrigger.admitted == 4 && countRecords(ble, streamCh, STREAM_IMU) >= imuTrigger.admitted,
+          "IMU on-change trigger sends the first batch, heartbeats and the shake only");
+    check(triggeredImu.samplesSuppressed > 9 * triggeredImu.samplesSent,
+          "suppressed IMU batches are not encoded or sent");
+    std::printf("trigger: imu admitted %u (heartbeats %u), suppressed %u batches, samples sent %u of %u\n",
+                imuTrigger.admitted, imuTrigger.heartbeats, imuTrigger.suppressed, triggeredImu.samplesSent,
+                triggeredImu.samplesRead);
+    imuRule[3] = static_cast<uint8_t>(TriggerMode::Always);
+    ble.write(commandCh, imuRule, sizeof(imuRule));
+
+    // バックログ：IMU（400 Hz）を流したまま 5 秒切断し、再接続したら ACK 0 から再生させる。
+    // 再生の途中でもう一度切断し、受け取った最後の seq を ACK して続きを受け取る。
+    // 続きの再生の途中でストリームの購読をやめ、購読し直したら受け取った最後の seq を ACK する
+    ble.clearNotifications();
+    const uint8_t backlogOn[] = {Reassembler::kFirst | Reassembler::kLast, CMD_BACKLOG_ENABLE, 1};
+    ble.write(commandCh, backlogOn, sizeof(backlogOn));
+    ble.write(commandCh, imuStart400, sizeof(imuStart400));
+    runFor(app, clock, 100);
+    ble.disconnect();
+    runFor(app, clock, 5000);
+    BacklogStats offlineBacklog = app.backlogStore().stats();
+    // /gatt.bin（Database Hash の記録）以外はバックログのブロック
+    size_t offlineFiles = fileStore.fileCount() - 1;
+    auto backlogAck = [&](uint32_t seq) {
+        uint8_t ack[6] = {Reassembler::kFirst | Reassembler::kLast, CMD_BACKLOG_ACK};
+        wire::putU32(ack + 2, seq);
+        ble.write(commandCh, ack, sizeof(ack));
+    };
+    // 受け取った STREAM_BACKLOG の seq（重複を含む）と、中身が IMU のレコードか
+    auto backlogSeqs = [&](std::vector<uint32_t>& seqs) {
+        bool imuOnly = true;
+        seqs.clear();
+        for (const auto& notification : ble.notifications()) {
+            frame::PacketHeader header;
+            frame::PacketReader reader;
+            if (notification.ch != streamCh ||
+                !reader.begin(notification.data.data(), notification.data.size(), header)) {
+                continue;
+            }
+            uint8_t stream;
+            const uint8_t* payload;
+            uint8_t len;
+            while (reader.next(stream, payload, len)) {
+                if (stream == STREAM_BACKLOG && len > Backlog::kWrapHeaderSize) {
+                    seqs.push_back(wire::getU32(payload));
+                    imuOnly = imuOnly && payload[4] == STREAM_IMU;
+                }
+            }
+        }
+        return imuOnly;
+    };
+    std::vector<uint32_t> seqs;
+    ble.connect(2);
+    runFor(app, clock, LOOP_DELAY_MS);
+    backlogAck(0);
+    runFor(app, clock, 2 * LOOP_DELAY_MS);
+    backlogSeqs(seqs);
+    uint32_t firstPass = seqs.empty() ? 0 : *std::max_element(seqs.begin(), seqs.end());
+    ble.disconnect();
+    runFor(app, clock, 1000);
+    ble.connect(3);
+    runFor(app, clock, LOOP_DELAY_MS);
+    backlogAck(firstPass);
+    runFor(app, clock, 2 * LOOP_DELAY_MS);
+    ble.subscribe(streamCh, false);
+    runFor(app, clock, 200);
+    ble.subscribe(streamCh, true);
+    backlogSeqs(seqs);
+    backlogAck(seqs.empty() ? 0 : *std::max_element(seqs.begin(), seqs.end()));
+    runFor(app, clock, 3000);
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    bool backlogImu = backlogSeqs(seqs);
+    backlogAck(seqs.empty() ? 0 : *std::max_element(seqs.begin(), seqs.end()));
+    runFor(app, clock, LOOP_DELAY_MS);
+    std::vector<uint32_t> sorted = seqs;
+    std::sort(sorted.begin(), sorted.end());
+    bool exactlyOnce = !sorted.empty() && sorted.front() == 1;
+    for (size_t i = 1; i < sorted.size(); ++i) {
+        exactlyOnce = exactlyOnce && sorted[i] == sorted[i - 1] + 1;
+    }
+    const Backlog& backlog = app.backlogStore();
+    const BacklogStats& backlogStats = backlog.stats();
+    check(offlineBacklog.stored > 0 && offlineBacklog.blockWrites > 0 && offlineBacklog.dropped == 0 &&
+              offlineFiles == offlineBacklog.blockWrites,
+          "records stored while disconnected spill to flash blocks");
+    check(firstPass > 0 && backlogImu && exactlyOnce && sorted.size() == backlogStats.stored &&
+              backlog.pending() == 0 && fileStore.fileCount() == 1,
+          "backlog replays every record once and resumes after the acknowledged seq");
+    std::printf("backlog: %u records, %u blocks (%u bytes) while offline, first pass %u, replayed %u\n",
+                offlineBacklog.stored, offlineBacklog.blockWrites, offlineBacklog.spilledBytes, firstPass,
+                backlogStats.replayed);
+    const uint8_t backlogOff[] = {Reassembler::kFirst | Reassembler::kLast, CMD_BACKLOG_ENABLE, 0};
+    ble.write(commandCh, backlogOff, sizeof(backlogOff));
+    runFor(app, clock, LOOP_DELAY_MS);
+
+    WriteBehind& storageWrites = app.storageWrites();
+    storageWrites.resetStats();
+
+    // 時系列ログ：IMU（400 Hz）を 15 秒記録して、seq の範囲と、時刻の範囲を 10 個に 1 つ間引いて問い合わせる
+    uint8_t logStart[4] = {Reassembler::kFirst | Reassembler::kLast, CMD_LOG_START};
+    wire::putU16(logStart + 2, 1u << STREAM_IMU);
+    ble.write(commandCh, logStart, sizeof(logStart));
+    ble.write(commandCh, imuStart400, sizeof(imuStart400));
+    runFor(app, clock, 15000);
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    const uint8_t logStop[] = {Reassembler::kFirst | Reassembler::kLast, CMD_LOG_STOP};
+    ble.write(commandCh, logStop, sizeof(logStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+    const RecordLog& recordLog = app.log();
+    // 問い合わせの結果（[seq u32][timeMs u32][stream u8][data]）と終わりのレコードの件数
+    struct LogResult {
+        uint32_t seq;
+        uint32_t timeMs;
+        uint8_t stream;
+    };
+    auto logQuery = [&](uint8_t key, uint32_t from, uint32_t to, uint16_t step, std::vector<LogResult>& results) {
+        uint8_t query[13] = {Reassembler::kFirst | Reassembler::kLast, CMD_LOG_QUERY, key};
+        wire::putU32(query + 3, from);
+        wire::putU32(query + 7, to);
+        wire::putU16(query + 11, step);
+        ble.clearNotifications();
+        ble.write(commandCh, query, sizeof(query));
+        runFor(app, clock, 500);
+        int64_t endCount = -1;
+        results.clear();
+        for (const auto& notification : ble.notifications()) {
+            frame::PacketHeader header;
+            frame::PacketReader reader;
+            if (notification.ch != streamCh ||
+                !reader.begin(notification.data.data(), notification.data.size(), header)) {
+                continue;
+            }
+            uint8_t stream;
+            const uint8_t* payload;
+            uint8_t len;
+            while (reader.next(stream, payload, len)) {
+                if (stream == STREAM_LOG && len == 4) {
+                    endCount = wire::getU32(payload);
+                } else if (stream == STREAM_LOG && len > RecordLog::kResultHeaderSize) {
+                    results.push_back({wire::getU32(payload), wire::getU32(payload + 4), payload[8]});
+                }
+            }
+        }
+        return endCount;
+    };
+    std::vector<LogResult> logResults;
+    uint32_t readBefore = recordLog.stats().pagesRead;
+    int64_t seqEnd = logQuery(RecordLog::BySeq, 100, 299, 1, logResults);
+    uint32_t seqPagesRead = recordLog.stats().pagesRead - readBefore;
+    bool seqRangeOk = seqEnd == 200 && logResults.size() == 200;
+    for (size_t i = 0; i < logResults.size(); ++i) {
+        seqRangeOk = seqRangeOk && logResults[i].seq == 100 + i && logResults[i].stream == STREAM_IMU;
+    }
+    uint32_t fromMs = logResults.empty() ? 0 : logResults.front().timeMs;
+    uint32_t toMs = logResults.empty() ? 0 : logResults.back().timeMs;
+    readBefore = recordLog.stats().pagesRead;
+    int64_t timeEnd = logQuery(RecordLog::ByTime, fromMs, toMs, 10, logResults);
+    uint32_t timePagesRead = recordLog.stats().pagesRead - readBefore;
+    bool timeRangeOk = timeEnd == static_cast<int64_t>(logResults.size()) && logResults.size() >= 20;
+    for (size_t i = 0; i < logResults.size(); ++i) {
+        timeRangeOk = timeRangeOk && logResults[i].timeMs >= fromMs && logResults[i].timeMs <= toMs &&
+                      (i == 0 || logResults[i].seq == logResults[i - 1].seq + 10);
+    }
+    // 同じフラッシュから索引を作り直す（ページの見出しだけを読む）
+    uint64_t bytesBefore = fileStore.bytesRead();
+    static RecordLog reopened(clock);
+    reopened.setStore(&fileStore);
+    uint64_t recoverBytes = fileStore.bytesRead() - bytesBefore;
+    check(recordLog.segments() >= 2 && recordLog.stats().dropped == 0 &&
+              recordLog.nextSeq() == recordLog.stats().records + 1,
+          "IMU records are logged to append-only segments");
+    // 200 レコードは 4 KB のページ 4 つ前後にまたがる
+    check(seqRangeOk && seqPagesRead <= 5 && seqPagesRead * 4 < recordLog.pages(),
+          "sequence range query streams the range and reads only its pages");
+    check(timeRangeOk && timePagesRead <= 5 && timePagesRead * 4 < recordLog.pages(),
+          "time range query is decimated and reads only its pages");
+    check(reopened.nextSeq() == recordLog.nextSeq() && reopened.pages() == recordLog.pages() &&
+              recoverBytes <= 2u * recordLog.pages() * RecordLog::kPageHeaderSize,
+          "log index is rebuilt from page headers at boot");
+    std::printf("log: %u records in %u pages / %u segments (%u bytes), seq query read %u pages, time query %u "
+                "pages, rebuild read %u bytes\n",
+                recordLog.stats().records, recordLog.pages(), recordLog.segments(), recordLog.stats().bytesWritten,
+                seqPagesRead, timePagesRead, static_cast<unsigned>(recoverBytes));
+
+    // 書き込みのまとめ：ページの長さはまちまちで追記の位置は消去ブロックからずれていくが、
+    // フラッシュには消去ブロックの境界まで溜めてから書く（途中で終わるのはセグメントの終わりと記録を止めたときだけ）
+    const WriteBehindStats& logWrites = storageWrites.stats();
+    uint16_t logAmplification = storageWrites.amplificationX100();
+    check(logWrites.logicalBytes == recordLog.stats().bytesWritten && logAmplification <= 106 &&
+              logWrites.partialCommits <= recordLog.segments() && storageWrites.staged() == 0,
+          "log pages are committed to flash in whole erase blocks");
+    std::printf("storage: %u bytes logged as %u commits, amplification %u.%02ux, flush avg %u us max %u us\n",
+                logWrites.logicalBytes, logWrites.commits, logAmplification / 100, logAmplification % 100,
+                logWrites.commits > 0 ? logWrites.flushUsTotal / logWrites.commits : 0, logWrites.flushMaxUs);
+
+    // まとめ方を変えてハートビートを記録し、フラッシュ（下の FileStore）だけから索引を作り直して確かめる
+    auto storageMode = [&](WriteMode mode, uint32_t maxDelayMs) {
+        uint8_t command[7] = {Reassembler::kFirst | Reassembler::kLast, CMD_STORAGE_MODE, static_cast<uint8_t>(mode)};
+        wire::putU32(command + 3, maxDelayMs);
+        ble.write(commandCh, command, sizeof(command));
+        runFor(app, clock, LOOP_DELAY_MS);
+    };
+    auto nextHeartbeatLogged = [&]() {
+        uint32_t seq = recordLog.nextSeq();
+        for (uint32_t waited = 0; recordLog.nextSeq() == seq && waited < 3000; waited += LOOP_DELAY_MS) {
+            runFor(app, clock, LOOP_DELAY_MS);
+        }
+    };
+    auto durableSeq = [&]() {
+        reopened.setStore(&fileStore);
+        return reopened.nextSeq();
+    };
+    uint8_t logHeartbeat[4] = {Reassembler::kFirst | Reassembler::kLast, CMD_LOG_START};
+    wire::putU16(logHeartbeat + 2, 1u << STREAM_HEARTBEAT);
+    ble.write(commandCh, logHeartbeat, sizeof(logHeartbeat));
+    // Timed（500 ms）：記録してから 500 ms でフラッシュに届く
+    storageMode(WriteMode::Timed, 500);
+    nextHeartbeatLogged();
+    runFor(app, clock, 300);
+    bool timedHeld = durableSeq() < recordLog.nextSeq();
+    runFor(app, clock, 300);
+    bool timedDurable = durableSeq() == recordLog.nextSeq() && storageWrites.staged() == 0;
+    check(timedHeld && timedDurable, "timed write-behind commits within its delay");
+    // Batched：ブロックが埋まるまで書かないが、切断したらそこまでの分を書く
+    storageMode(WriteMode::Batched, 0);
+    nextHeartbeatLogged();
+    runFor(app, clock, 1000);
+    bool batchedHeld = durableSeq() < recordLog.nextSeq();
+    uint32_t commitsBefore = storageWrites.stats().commits;
+    ble.disconnect();
+    runFor(app, clock, LOOP_DELAY_MS);
+    bool flushedOnDisconnect = durableSeq() == recordLog.nextSeq() && storageWrites.stats().commits > commitsBefore;
+    check(batchedHeld && flushedOnDisconnect, "batched write-behind holds data until disconnect");
+    ble.connect(4);
+    runFor(app, clock, LOOP_DELAY_MS);
+    ble.write(commandCh, logStop, sizeof(logStop));
+    storageMode(WriteMode::Timed, STORAGE_FLUSH_DELAY_MS);
+
+    // 設定：ハートビートを 500 ms にしてすぐ効くことを見てから、デバイス名とストリームの UUID を変えて保存し、
+    // 同じフラッシュで起動し直した 2 台目で効いていることを確かめる
+    ble.clearNotifications();
+    uint8_t setPeriod[7] = {Reassembler::kFirst | Reassembler::kLast, CMD_CONFIG_SET, CONFIG_NOTIFY_PERIOD};
+    wire::putU32(setPeriod + 3, 500);
+    ble.write(commandCh, setPeriod, sizeof(setPeriod));
+    runFor(app, clock, 2000);
+    size_t fastNotifies = countNotifies(ble, ch);
+    static const char kSiteName[] = "M5-SITE-A";
+    uint8_t setName[3 + sizeof(kSiteName) - 1] = {Reassembler::kFirst | Reassembler::kLast, CMD_CONFIG_SET,
+                                                 CONFIG_DEVICE_NAME};
+    std::memcpy(setName + 3, kSiteName, sizeof(kSiteName) - 1);
+    ble.write(commandCh, setName, sizeof(setName));
+    uint8_t setUuid[3 + 16] = {Reassembler::kFirst | Reassembler::kLast, CMD_CONFIG_SET, CONFIG_STREAM_UUID};
+    for (uint8_t i = 0; i < 16; ++i) {
+        setUuid[3 + i] = static_cast<uint8_t>(0xA0 + i);
+    }
+    ble.write(commandCh, setUuid, sizeof(setUuid));
+    const uint8_t saveConfig[] = {Reassembler::kFirst | Reassembler::kLast, CMD_CONFIG_SAVE, 0};
+    ble.write(commandCh, saveConfig, sizeof(saveConfig));
+    runFor(app, clock, LOOP_DELAY_MS);
+    bool savedOk = app.settings().restartPending() && ble.notifications().back().ch == commandCh &&
+                   lastReply(ble, commandCh)[1] == 0;
+    uint32_t configReads = fileStore.readCalls();
+    RuntimeConfig loaded;
+    loaded.setStore(&fileStore);
+    bool loadedOk = loaded.load();
+    configReads = fileStore.readCalls() - configReads;
+    static MockBlePeripheral rebootedBle(clock);
+    static BleApp rebooted(clock, serial, display, rebootedBle);
+    rebooted.attachStorage(&fileStore);
+    rebooted.setup();
+    // UUID を変えたので GATT が変わった。どのセントラルにも知らせる前にもう一度起動しても忘れない
+    bool changePending = rebooted.serviceChangePending();
+    static MockBlePeripheral relaunchedBle(clock);
+    static BleApp relaunched(clock, serial, display, relaunchedBle);
+    relaunched.attachStorage(&fileStore);
+    relaunched.setup();
+    bool stillPending = relaunched.serviceChangePending();
+    // 送れた接続を SERVICE_CHANGED_CONNECTIONS 回数えたら送り終える（アドレスでは見分けない）
+    uint32_t writesBefore = fileStore.writeCalls();
+    for (uint16_t i = 0; i < SERVICE_CHANGED_CONNECTIONS + 2; ++i) {
+        relaunchedBle.connect(i % 2);
+        relaunched.loop();
+        relaunchedBle.disconnect();
+        relaunched.loop();
+    }
+    relaunched.storageWrites().sync();
+    bool sentBounded = relaunchedBle.serviceChangedCount() == SERVICE_CHANGED_CONNECTIONS &&
+                       relaunched.serviceChangeAnnounced() == SERVICE_CHANGED_CONNECTIONS &&
+                       !relaunched.serviceChangePending();
+    uint32_t gattWrites = fileStore.writeCalls() - writesBefore;
+    // 同じ設定でもう一度起動：GATT は変わらず、送り終えているので送らない
+    static MockBlePeripheral unchangedBle(clock);
+    static BleApp unchanged(clock, serial, display, unchangedBle);
+    unchanged.attachStorage(&fileStore);
+    unchanged.setup();
+    unchangedBle.connect(0);
+    unchanged.loop();
+    unchangedBle.disconnect();
+    unchanged.loop();
+    unchangedBle.connect(1);
+    unchanged.loop();
+    check(changePending && stillPending && rebootedBle.serviceChangedCount() == 0 && sentBounded &&
+              gattWrites <= SERVICE_CHANGED_CONNECTIONS && !unchanged.serviceChangePending() &&
+              unchangedBle.serviceChangedCount() == 0,
+          "Service Changed is indicated on a bounded number of connections after the GATT database hash changes");
+    check(fastNotifies == 4 && app.triggerTable().rule(STREAM_HEARTBEAT).heartbeatMs == 500,
+          "notify period change takes effect immediately");
+    check(savedOk && loadedOk && configReads == 1 && loaded.notifyPeriodMs() == 500 &&
+              rebootedBle.deviceName() == kSiteName &&
+              rebootedBle.findCharacteristic("A0A1A2A3-A4A5-A6A7-A8A9-AAABACADAEAF") != hal::kInvalidId &&
+              rebootedBle.findCharacteristic(STREAM_CHAR_UUID) == hal::kInvalidId &&
+              rebooted.triggerTable().rule(STREAM_HEARTBEAT).heartbeatMs == 500,
+          "saved config is loaded in one read and applied at boot");
+    const uint8_t eraseConfig[] = {Reassembler::kFirst | Reassembler::kLast, CMD_CONFIG_SAVE, 1};
+    ble.write(commandCh, eraseConfig, sizeof(eraseConfig));
+    wire::putU32(setPeriod + 3, NOTIFY_PERIOD_MS);
+    ble.write(commandCh, setPeriod, sizeof(setPeriod));
+    runFor(app, clock, LOOP_DELAY_MS);
+
+    // 時刻同期：セントラルの時計はデバイスより 80 ppm 速く、片道の遅れはコネクションイベント待ちで 0〜7.5 ms
+    ble.clearNotifications();
+    auto centralUs = [](uint64_t deviceUs) {
+        return static_cast<uint64_t>(1.7e15 + static_cast<double>(deviceUs) * (1.0 + 80e-6));
+    };
+    uint32_t lcg = 12345;
+    auto linkDelayUs = [&lcg]() {
+        lcg = lcg * 1103515245u + 12345u;
+        return (lcg >> 8) % 7500;
+    };
+    uint64_t prevT4 = 0;
+    bool repliesOk = true;
+    for (int i = 0; i < 240; ++i) {
+        uint8_t seq = static_cast<uint8_t>(i);
+        uint8_t sync[3 + 16] = {Reassembler::kFirst | Reassembler::kLast, CMD_TIME_SYNC, seq};
+        wire::putU64(sync + 3, centralUs(clock.nowMicros()));
+        wire::putU64(sync + 11, prevT4);
+        clock.advanceUs(linkDelayUs());
+        ble.write(commandCh, sync, sizeof(sync));
+        clock.delay(3);  // loop() が Write を処理するまでの遅れ（t2 には含まれない）
+        app.loop();
+        clock.advanceUs(linkDelayUs());
+        prevT4 = centralUs(clock.nowMicros());
+        std::vector<uint8_t> reply = lastReply(ble, commandCh);
+        repliesOk = repliesOk && reply.size() == 19 && reply[2] == seq;
+        runFor(app, clock, 500);
+    }
+    const ClockSync& timeSync = app.timeSync();
+    double syncErrorUs =
+        static_cast<double>(static_cast<int64_t>(timeSync.toCentral(clock.nowMicros()) - centralUs(clock.nowMicros())));
+    check(repliesOk && timeSync.synced() && std::fabs(syncErrorUs) < 1000.0 &&
+              std::abs(timeSync.driftPpb() - 80000) < 20000,
+          "clock sync tracks central offset and drift to sub-millisecond accuracy");
+
+    // 同期後のパケットには STREAM_CLOCK のタグが付き、その時刻がセントラルの時計と合う
+    ble.clearNotifications();
+    runFor(app, clock, 2000);
+    double tagErrorUs = -1;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        if (notification.ch == streamCh && reader.begin(notification.data.data(), notification.data.size(), header) &&
+            reader.next(stream, payload, len) && stream == STREAM_CLOCK && len == ClockSync::kTagSize) {
+            // タグの deviceUs（32 bit）を仮想時計の 64 bit に戻して真の時刻と比べる
+            uint64_t device = clock.nowMicros() - (clock.micros() - wire::getU32(payload));
+            int64_t error = static_cast<int64_t>(wire::getU64(payload + 4) - centralUs(device));
+            tagErrorUs = std::fabs(static_cast<double>(error));
+        }
+    }
+    check(tagErrorUs >= 0 && tagErrorUs < 1000.0, "stream packets carry synchronized time tags");
+    std::printf("clock sync: %u exchanges, %u samples, min delay %u us, residual %u us, drift %d ppb, error %.0f us "
+                "(tag %.0f us)\n",
+                timeSync.stats().exchanges, timeSync.stats().samples, timeSync.stats().minDelayUs,
+                timeSync.stats().residualUs, timeSync.driftPpb(), syncErrorUs, tagErrorUs);
+
+    // 購読されていないキャラクタリスティックの値は作らない（CCCD は接続ごとなので、再接続したら未購読から）
+    ble.disconnect();
+    runFor(app, clock, 200);
+    ble.setAutoSubscribe(false);
+    ble.connect(2);
+    ble.subscribe(commandCh, true);
+    runFor(app, clock, 200);
+    const uint8_t resetSubscriptions[] = {Reassembler::kFirst | Reassembler::kLast, CMD_SUBSCRIPTIONS, 1};
+    ble.write(commandCh, resetSubscriptions, sizeof(resetSubscriptions));
+    ble.write(commandCh, imuStart, sizeof(imuStart));
+    runFor(app, clock, LOOP_DELAY_MS);
+    ble.clearNotifications();
+    uint32_t gatedReads = app.imu().stats().samplesRead;
+    uint32_t gatedNotifies = app.notifyCount();
+    runFor(app, clock, 2000);
+    bool nothingSent = countNotifies(ble, streamCh) == 0 && countNotifies(ble, ch) == 0;
+    gatedReads = app.imu().stats().samplesRead - gatedReads;
+    bool imuPaused = app.imu().isPaused();
+    gatedNotifies = app.notifyCount() - gatedNotifies;
+    SubscriptionStats gated = app.subscriptionState().stats();
+
+    // ストリームだけ購読すると、プロデューサが動き出す（"ping" の Notify は購読されていないので送らない）
+    ble.subscribe(streamCh, true);
+    ble.clearNotifications();
+    runFor(app, clock, 2000);
+    size_t streamPackets = countNotifies(ble, streamCh);
+    size_t dataNotifies = countNotifies(ble, ch);
+    // 再開した最初の IMU のレコードは FIFO に残っていた古いサンプルではなく、時刻も Notify の時刻と合う
+    int64_t resumeSkewUs = -1;
+    for (const auto& notification : ble.notifications()) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        if (resumeSkewUs < 0 && notification.ch == streamCh &&
+            reader.begin(notification.data.data(), notification.data.size(), header)) {
+            while (reader.next(stream, payload, len)) {
+                if (stream == STREAM_IMU) {
+                    int64_t skew = static_cast<int64_t>(notification.timeMs) * 1000 - wire::getU32(payload + 4);
+                    resumeSkewUs = skew < 0 ? -skew : skew;
+                    break;
+                }
+            }
+        }
+    }
+    const uint8_t querySubscriptions[] = {Reassembler::kFirst | Reassembler::kLast, CMD_SUBSCRIPTIONS, 0};
+    ble.write(commandCh, querySubscriptions, sizeof(querySubscriptions));
+    runFor(app, clock, LOOP_DELAY_MS);
+    std::vector<uint8_t> subscriptionReply = lastReply(ble, commandCh);
+    bool replyOk = subscriptionReply.size() == 2 + 22 && subscriptionReply[0] == (CMD_SUBSCRIPTIONS | 0x80) &&
+                   wire::getU16(subscriptionReply.data() + 2) == ((1u << streamCh) | (1u << commandCh)) &&
+                   wire::getU32(subscriptionReply.data() + 8) == gated.gatedLoops;
+    SubscriptionStats resumed = app.subscriptionState().stats();
+    check(nothingSent && gatedReads == 0 && gatedNotifies == 0 && gated.gatedLoops > 0 && gated.activeLoops == 0 &&
+              streamPackets > 0 && dataNotifies == 0 && resumed.activeLoops > 0 && app.imu().stats().samplesRead > 0 &&
+              replyOk && imuPaused && app.imu().stats().fifoOverruns == 0 && resumeSkewUs >= 0 &&
+              resumeSkewUs < 2 * LOOP_DELAY_MS * 1000,
+          "producers are suspended until the central subscribes to the stream characteristic");
+    std::printf("subscriptions: gated %u loops, active %u loops, producer avg %u us, saved ~%u us\n",
+                resumed.gatedLoops, resumed.activeLoops, resumed.producerAvgUs, resumed.savedUs);
+    ble.write(commandCh, imuStop, sizeof(imuStop));
+    runFor(app, clock, LOOP_DELAY_MS);
+
+    // MTU 23 のまま（20 byte の Notify）でも、長い応答はフラグメントに分けて切り詰めずに返す
+    ble.disconnect();
+    runFor(app, clock, 200);
+    ble.setAutoSubscribe(true);
+    ble.connect(3, 23);
+    runFor(app, clock, 200);
+    ble.clearNotifications();
+    const uint8_t logStatus[] = {Reassembler::kFirst | Reassembler::kLast, CMD_LOG_STATUS};
+    ble.write(commandCh, logStatus, sizeof(logStatus));
+    runFor(app, clock, LOOP_DELAY_MS);
+    size_t replyFragments = 0;
+    bool fragmentsFit = true;
+    for (const auto& notification : ble.notifications()) {
+        if (notification.ch == commandCh) {
+            ++replyFragments;
+            fragmentsFit = fragmentsFit && notification.data.size() <= frame::packetCapacity(23);
+        }
+    }
+    std::vector<uint8_t> logReply = lastReply(ble, commandCh);
+    check(replyFragments == 2 && fragmentsFit && logReply.size() == 2 + 36 &&
+              logReply[0] == (CMD_LOG_STATUS | 0x80) && logReply[1] == 0 &&
+              wire::getU32(logReply.data() + 2 + 32) == app.log().stats().recordsSent,
+          "command replies longer than one MTU 23 notify are fragmented, not truncated");
+
+    std::printf("virtual time %.3f s, notifies %u, display draws %u, imu samples %u (max backlog %u)\n",
+                clock.millis() / 1000.0, app.notifyCount(), display.drawCount(), imuStats.samplesSent,
+                imuStats.maxBacklog);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+/**
+ * 受信トレースの再生ドライバ（ネイティブ環境）
+ * - 実機で記録した RxTrace（書き込み・接続イベント）をモック HAL 経由で BleApp に流し込む
+ *   → 実機と同じ RX・コマンド処理のコードが同じ順序で動く
+ * - 仮想時計は記録どおりの間隔（--speed 1）、加速（--speed N）、間隔なし（--speed 0）で進める
+ * - イベントの種類ごとに、注入から次の loop() までの処理時間（ホストの実時間）を集計する
+ *
+ * 実行: .pio/build/native-replay/program trace.bin [--speed N] [--loops N] [--verbose]
+ *       trace.bin はシリアルのダンプ（CMD_TRACE_DUMP 0）から tools/trace_extract.py で作る
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "app/AppConfig.h"
+#include "app/BleApp.h"
+#include "diag/RxTrace.h"
+#include "platform/native/MockHal.h"
+
+struct EventCost {
+    const char* name;
+    uint32_t count = 0;
+    double totalNs = 0;
+    double maxNs = 0;
+};
+
+static void usage(const char* argv0) {
+    std::fprintf(stderr, "usage: %s trace.bin [--speed N] [--loops N] [--verbose]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    double speed = 1.0;
+    uint32_t loopsPerEvent = 1;
+    bool verbose = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            loopsPerEvent = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else if (path == nullptr && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (path == nullptr || speed < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    RxTraceReader reader;
+    if (!reader.begin(bytes.data(), bytes.size())) {
+        std::fprintf(stderr, "%s: not an RX trace (version %u expected)\n", path, RxTrace::kVersion);
+        return 1;
+    }
+
+    MockClock clock;
+    MockSerialPort serial(&clock, verbose);
+    MockDisplay display;
+    MockBlePeripheral ble(clock);
+    BleApp app(clock, serial, display, ble);
+    app.setup();
+
+    EventCost costs[] = {{"connect"}, {"disconnect"}, {"write"}};
+    uint32_t events = 0;
+    uint32_t loops = 0;
+    uint64_t tracedUs = 0;
+    auto wallStart = std::chrono::steady_clock::now();
+
+    RxTraceReader::Event event;
+    while (reader.next(event)) {
+        // 記録された間隔だけ仮想時計を進めながら loop() を回す
+        tracedUs += event.dtUs;
+        uint64_t waitUs = speed > 0 ? static_cast<uint64_t>(event.dtUs / speed) : 0;
+        uint64_t targetUs = clock.nowMicros() + waitUs;
+        while (clock.nowMicros() + LOOP_DELAY_MS * 1000 <= targetUs) {
+            app.loop();
+            ++loops;
+            clock.delay(LOOP_DELAY_MS);
+        }
+        clock.advanceUs(targetUs - clock.nowMicros());
+
+        auto start = std::chrono::steady_clock::now();
+        switch (event.type) {
+            case TRACE_CONNECT:
+                ble.connect(event.connId);
+                break;
+            case TRACE_DISCONNECT:
+                ble.disconnect();
+                break;
+            case TRACE_WRITE:
+                ble.write(event.ch, event.data, event.length);
+                break;
+        }
+        for (uint32_t i = 0; i < loopsPerEvent; ++i) {
+            app.loop();
+            ++loops;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        EventCost& cost = costs[event.type - TRACE_CONNECT];
+        ++cost.count;
+        cost.totalNs += ns;
+        cost.maxNs = std::max(cost.maxNs, ns);
+        ++events;
+    }
+
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+    std::printf("{\n  \"trace\": \"%s\", \"events\": %u, \"traced_ms\": %.3f, \"virtual_ms\": %.3f, "
+                "\"wall_ms\": %.3f, \"loops\": %u, \"notifies\": %zu,\n  \"costs\": [\n",
+                path, events, tracedUs / 1000.0, clock.nowMicros() / 1000.0, wallMs, loops,
+                ble.notifications().size());
+    for (size_t i = 0; i < sizeof(costs) / sizeof(costs[0]); ++i) {
+        const EventCost& c = costs[i];
+        std::printf("    {\"event\": \"%s\", \"count\": %u, \"avg_ns\": %.1f, \"max_ns\": %.1f}%s\n", c.name, c.count,
+                    c.count > 0 ? c.totalNs / c.count : 0.0, c.maxNs, i + 1 < 3 ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "host/sim/SimLink.h"
+
+#include "app/FrameCodec.h"
+
+// LL PDU のオーバーヘッド [byte]（プリアンブルは PHY 依存なので別扱い）
+static constexpr uint32_t kAccessAddress = 4;
+static constexpr uint32_t kLlHeader = 2;
+static constexpr uint32_t kCrc = 3;
+static constexpr uint32_t kL2capHeader = 4;
+static constexpr uint32_t kIfsUs = 150;
+
+SimLink::SimLink(MockClock& clock, const LinkParams& params, const LinkImpairments& impairments)
+    : clock(clock), params(params), impairments(impairments) {
+    nextEventUs = params.connIntervalUs;
+}
+
+uint32_t SimLink::packetAirtimeUs(size_t len) const {
+    uint32_t preamble = params.phyBps >= 2000000 ? 2 : 1;
+    uint32_t overhead = preamble + kAccessAddress + kLlHeader + kCrc;
+    uint32_t l2cap = static_cast<uint32_t>(len + frame::kAttHeaderSize + kL2capHeader);
+    uint32_t pdus = (l2cap + params.dataLength - 1) / params.dataLength;
+
+    // データ PDU + IFS + セントラルの空 PDU + IFS を PDU ごとに
+    uint64_t bits = static_cast<uint64_t>(l2cap + pdus * overhead) * 8;
+    uint64_t emptyBits = static_cast<uint64_t>(overhead) * 8 * pdus;
+    uint64_t us = (bits + emptyBits) * 1000000ull / params.phyBps;
+    return static_cast<uint32_t>(us + pdus * 2 * kIfsUs);
+}
+
+void SimLink::advance() {
+    uint64_t now = clock.nowMicros();
+
+    if (connected && nextDisconnect < impairments.disconnectAtMs.size() &&
+        now >= static_cast<uint64_t>(impairments.disconnectAtMs[nextDisconnect]) * 1000) {
+        ++nextDisconnect;
+        // コントローラに残っていたパケットは失われる
+        counters.packetsLostOnDisconnect += static_cast<uint32_t>(controller.size());
+        controller.clear();
+        reconnectAtUs = now + static_cast<uint64_t>(impairments.reconnectDelayMs) * 1000;
+        setConnected(false);
+        return;
+    }
+
+    if (!connected) {
+        if (now >= reconnectAtUs) {
+            nextEventUs = now + params.connIntervalUs;
+            setConnected(true);
+        }
+        return;
+    }
+
+    while (now >= nextEventUs) {
+        connectionEvent(nextEventUs);
+        nextEventUs += params.connIntervalUs;
+    }
+}
+
+bool SimLink::isStalled(uint64_t nowUs) const {
+    if (impairments.stallEveryMs == 0 || impairments.stallMs == 0) {
+        return false;
+    }
+    uint64_t period = static_cast<uint64_t>(impairments.stallEveryMs) * 1000;
+    uint64_t phase = nowUs % period;
+    return nowUs >= period && phase < static_cast<uint64_t>(impairments.stallMs) * 1000;
+}
+
+void SimLink::connectionEvent(uint64_t eventUs) {
+    ++counters.connectionEvents;
+    if (isStalled(eventUs)) {
+        ++counters.stalledEvents;
+        return;
+    }
+
+    uint32_t usedUs = 0;
+    uint32_t pdus = 0;
+    while (!controller.empty()) {
+        const std::vector<uint8_t>& packet = controller.front();
+        uint32_t l2cap = static_cast<uint32_t>(packet.size() + frame::kAttHeaderSize + kL2capHeader);
+        uint32_t packetPdus = (l2cap + params.dataLength - 1) / params.dataLength;
+        uint32_t airtime = packetAirtimeUs(packet.size());
+        if (pdus + packetPdus > params.packetsPerEvent || usedUs + airtime > params.connIntervalUs) {
+            break;
+        }
+        pdus += packetPdus;
+        usedUs += airtime;
+        ++counters.packetsDelivered;
+        if (delivery) {
+            delivery(eventUs + usedUs, packet);
+        }
+        controller.pop_front();
+    }
+    counters.airtimeUs += usedUs;
+}
+
+void SimLink::setConnected(bool value) {
+    connected = value;
+    if (listener == nullptr) {
+        return;
+    }
+    if (value) {
+        listener->onConnect(0);
+        listener->onConnParamsUpdated(static_cast<uint16_t>(params.connIntervalUs / 1250), 0, 400);
+        listener->onMtuChanged(params.mtu);
+    } else {
+        listener->onDisconnect(0);
+    }
+}
+
+void SimLink::begin(const char* deviceName, hal::BleListener* listener) {
+    (void)deviceName;
+    this->listener = listener;
+}
+
+hal::ServiceId SimLink::addService(const hal::Uuid& uuid, uint16_t handleCount) {
+    (void)uuid;
+    (void)handleCount;
+    return 0;
+}
+
+hal::CharId SimLink::addCharacteristic(hal::ServiceId service, const hal::Uuid& uuid, uint8_t properties) {
+    (void)service;
+    (void)uuid;
+    (void)properties;
+    values.emplace_back();
+    return static_cast<hal::CharId>(values.size() - 1);
+}
+
+void SimLink::startService(hal::ServiceId service) {
+    (void)service;
+}
+
+void SimLink::advertiseService(const hal::Uuid& uuid) {
+    (void)uuid;
+}
+
+void SimLink::startAdvertising() {}
+
+void SimLink::setValue(hal::CharId ch, const uint8_t* data, size_t len) {
+    if (ch < values.size()) {
+        values[ch].assign(data, data + len);
+    }
+}
+
+bool SimLink::notify(hal::CharId ch) {
+    if (!connected || ch >= values.size() || controller.size() >= params.controllerQueue) {
+        ++counters.notifyRejected;
+        return false;
+    }
+    controller.push_back(values[ch]);
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "hal/BlePeripheral.h"
+#include "platform/native/MockHal.h"
+
+/**
+ * 決定論的な BLE リンクモデル（ホスト用）
+ * - hal::BlePeripheral を実装し、notify() したパケットをコントローラのキューに積む
+ * - コネクションイベントごとに、1イベントのパケット数上限とイベント長（PHY の airtime）の範囲で
+ *   キューからセントラルへ配送する
+ * - セントラル側のストール（ACK が返らずイベントが空振り）と切断・再接続を時刻指定で注入できる
+ *
+ * 乱数は使わないので、同じパラメータなら常に同じ結果になる。
+ */
+
+struct LinkParams {
+    uint32_t connIntervalUs = 30000;  // コネクションインターバル
+    uint8_t packetsPerEvent = 4;      // 1 コネクションイベントで送れる LL PDU 数
+    uint16_t mtu = 247;               // ATT_MTU
+    uint16_t dataLength = 251;        // LL ペイロード長（DLE なしなら 27）
+    uint32_t phyBps = 1000000;        // 1M / 2M PHY
+    uint8_t controllerQueue = 12;     // BLE スタックがバッファできる Notify 数
+};
+
+struct LinkImpairments {
+    uint32_t stallEveryMs = 0;  // この周期でセントラルが stallMs だけ応答しない（0 なら無効）
+    uint32_t stallMs = 0;
+    std::vector<uint32_t> disconnectAtMs;  // 切断する時刻
+    uint32_t reconnectDelayMs = 1000;      // 切断から再接続までの時間
+};
+
+struct LinkStats {
+    uint32_t connectionEvents = 0;
+    uint32_t stalledEvents = 0;
+    uint32_t packetsDelivered = 0;
+    uint32_t packetsLostOnDisconnect = 0;
+    uint32_t notifyRejected = 0;
+    uint64_t airtimeUs = 0;
+};
+
+class SimLink : public hal::BlePeripheral {
+public:
+    // セントラルに届いたパケット（配送時刻 [us]、データ）
+    using DeliveryHandler = std::function<void(uint64_t timeUs, const std::vector<uint8_t>& data)>;
+
+    SimLink(MockClock& clock, const LinkParams& params, const LinkImpairments& impairments);
+
+    void onDelivery(DeliveryHandler handler) { delivery = std::move(handler); }
+
+    // 現在時刻までのコネクションイベント・切断・再接続を処理する
+    void advance();
+
+    bool isConnected() const { return connected; }
+    const LinkStats& stats() const { return counters; }
+    const LinkParams& parameters() const { return params; }
+
+    // 1 パケット（ATT ペイロード len バイト）の airtime [us]（空の ACK と IFS を含む）
+    uint32_t packetAirtimeUs(size_t len) const;
+
+    // hal::BlePeripheral
+    void begin(const char* deviceName, hal::BleListener* listener) override;
+    hal::ServiceId addService(const hal::Uuid& uuid, uint16_t handleCount) override;
+    hal::CharId addCharacteristic(hal::ServiceId service, const hal::Uuid& uuid, uint8_t properties) override;
+    void startService(hal::ServiceId service) override;
+    void advertiseService(const hal::Uuid& uuid) override;
+    void startAdvertising() override;
+    void setValue(hal::CharId ch, const uint8_t* data, size_t len) override;
+    bool notify(hal::CharId ch) override;
+    uint16_t mtu() const override { return connected ? params.mtu : 23; }
+    bool indicateServiceChanged() override { return connected; }
+
+private:
+    void connectionEvent(uint64_t nowUs);
+    bool isStalled(uint64_t nowUs) const;
+    void setConnected(bool value);
+
+    MockClock& clock;
+    LinkParams params;
+    LinkImpairments impairments;
+    hal::BleListener* listener = nullptr;
+    DeliveryHandler delivery;
+
+    std::vector<std::vector<uint8_t>> values;
+    std::deque<std::vector<uint8_t>> controller;
+
+    bool connected = true;
+    uint64_t nextEventUs = 0;
+    uint64_t reconnectAtUs = 0;
+    size_t nextDisconnect = 0;
+    LinkStats counters;
+};
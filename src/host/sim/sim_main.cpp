@@ -0,0 +1,338 @@
+/**
+ * BLE リンクシミュレータ（ネイティブ環境）
+ * - SimLink（コネクションインターバル・イベントあたりパケット数・MTU・PHY・ストール・切断）の上で
+ *   本物の NotifyScheduler（ペーシング・再送）を仮想時計で動かす
+ * - 同じシナリオを複数の PacingPolicy で走らせ、スループット・レイテンシ・詰め込み率を比較する
+ * - 結果は JSON（標準出力）。人間向けの表は標準エラーに出す
+ *
+ * 実行: pio run -e native-sim -t exec
+ *       .pio/build/native-sim/program --interval-ms 15 --phy 2 --stall-every-ms 5000 --stall-ms 800
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "app/AppConfig.h"
+#include "app/CommandDispatcher.h"
+#include "app/FrameCodec.h"
+#include "app/NotifyScheduler.h"
+#include "app/Wire.h"
+#include "host/sim/SimLink.h"
+#include "platform/native/MockHal.h"
+
+static constexpr uint32_t kStepUs = 50;
+static constexpr uint8_t kSimStream = 1;
+
+struct Scenario {
+    LinkParams link;
+    LinkImpairments impairments;
+    uint32_t durationMs = 60000;
+    uint32_t recordsPerSec = 1000;
+    uint16_t recordSize = 16;  // [id u32][createdUs u32][padding]
+    uint32_t loopUs = LOOP_DELAY_MS * 1000;
+};
+
+struct NamedPolicy {
+    std::string name;
+    PacingPolicy policy;
+};
+
+struct SimResult {
+    std::string policy;
+    uint32_t produced = 0;
+    uint32_t delivered = 0;
+    uint32_t duplicates = 0;
+    uint32_t retransmitRequests = 0;
+    uint64_t payloadBytes = 0;
+    std::vector<uint32_t> latencyUs;
+    SchedulerStats scheduler = {};
+    LinkStats link = {};
+};
+
+// セントラル：パケットを復号し、seq の欠落を CMD_RETRANSMIT で要求する
+class Central {
+public:
+    Central(CommandDispatcher& dispatcher, SimResult& result) : dispatcher(dispatcher), result(result) {}
+
+    void receive(uint64_t timeUs, const std::vector<uint8_t>& data) {
+        frame::PacketHeader header;
+        frame::PacketReader reader;
+        if (!reader.begin(data.data(), data.size(), header)) {
+            return;
+        }
+
+        int16_t ahead = static_cast<int16_t>(header.seq - expectedSeq);
+        if (ahead > 0) {
+            requestRetransmit(expectedSeq, static_cast<uint16_t>(ahead));
+        }
+        if (ahead >= 0) {
+            expectedSeq = static_cast<uint16_t>(header.seq + 1);
+        }
+
+        uint8_t stream;
+        const uint8_t* payload;
+        uint8_t len;
+        while (reader.next(stream, payload, len)) {
+            if (stream != kSimStream || len < 8) {
+                continue;
+            }
+            uint32_t id = wire::getU32(payload);
+            uint32_t createdUs = wire::getU32(payload + 4);
+            if (id >= seen.size()) {
+                seen.resize(id + 1024, false);
+            }
+            if (seen[id]) {
+                ++result.duplicates;
+                continue;
+            }
+            seen[id] = true;
+            ++result.delivered;
+            result.payloadBytes += len;
+            result.latencyUs.push_back(static_cast<uint32_t>(timeUs) - createdUs);
+        }
+    }
+
+private:
+    void requestRetransmit(uint16_t first, uint16_t count) {
+        while (count > 0) {
+            uint8_t n = count > 255 ? 255 : static_cast<uint8_t>(count);
+            uint8_t message[4] = {CMD_RETRANSMIT, 0, 0, n};
+            wire::putU16(&message[1], first);
+            uint8_t response[8];
+            dispatcher.dispatch(message, sizeof(message), response, sizeof(response));
+            ++result.retransmitRequests;
+            first = static_cast<uint16_t>(first + n);
+            count = static_cast<uint16_t>(count - n);
+        }
+    }
+
+    CommandDispatcher& dispatcher;
+    SimResult& result;
+    uint16_t expectedSeq = 0;
+    std::vector<bool> seen;
+};
+
+static SimResult runScenario(const Scenario& scenario, const NamedPolicy& named) {
+    SimResult result;
+    result.policy = named.name;
+
+    MockClock clock;
+    SimLink link(clock, scenario.link, scenario.impairments);
+    hal::CharId ch = link.addCharacteristic(0, hal::uuid(STREAM_CHAR_UUID), hal::PROP_NOTIFY);
+
+    NotifyScheduler scheduler(clock, link);
+    scheduler.setCharacteristic(ch);
+    scheduler.setPolicy(named.policy);
+
+    CommandDispatcher dispatcher;
+    scheduler.registerCommands(dispatcher);
+
+    Central central(dispatcher, result);
+    link.onDelivery([&central](uint64_t timeUs, const std::vector<uint8_t>& data) { central.receive(timeUs, data); });
+
+    uint64_t endUs = static_cast<uint64_t>(scenario.durationMs) * 1000;
+    uint64_t produceIntervalUs = scenario.recordsPerSec > 0 ? 1000000ull / scenario.recordsPerSec : endUs;
+    uint64_t nextProduceUs = 0;
+    uint64_t nextLoopUs = 0;
+    std::vector<uint8_t> record(std::max<uint16_t>(scenario.recordSize, 8), 0);
+
+    while (clock.nowMicros() < endUs) {
+        uint64_t now = clock.nowMicros();
+
+        // センサは接続状態に関係なくデータを出し続ける
+        while (nextProduceUs <= now) {
+            wire::putU32(&record[0], result.produced++);
+            wire::putU32(&record[4], static_cast<uint32_t>(nextProduceUs));
+            scheduler.enqueue(kSimStream, record.data(), record.size());
+            nextProduceUs += produceIntervalUs;
+        }
+
+        if (now >= nextLoopUs) {
+            if (link.isConnected()) {
+                scheduler.tick();
+            }
+            nextLoopUs += scenario.loopUs;
+        }
+
+        link.advance();
+        clock.advanceUs(kStepUs);
+    }
+
+    result.scheduler = scheduler.stats();
+    result.link = link.stats();
+    return result;
+}
+
+static uint32_t percentile(std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+static void printResults(const Scenario& scenario, std::vector<SimResult>& results) {
+    const LinkParams& l = scenario.link;
+    size_t capacity = frame::packetCapacity(l.mtu);
+
+    std::fprintf(stderr, "%-12s %10s %10s %8s %9s %9s %9s %8s %8s\n", "policy", "delivered", "payloadB/s",
+                 "fill%", "p50 ms", "p99 ms", "max ms", "retries", "retx");
+
+    std::printf("{\n  \"scenario\": {\"interval_ms\": %.2f, \"packets_per_event\": %u, \"mtu\": %u, "
+                "\"data_length\": %u, \"phy_mbps\": %u, \"controller_queue\": %u, \"records_per_s\": %u, "
+                "\"record_size\": %u, \"duration_ms\": %u, \"stall_every_ms\": %u, \"stall_ms\": %u, "
+                "\"disconnects\": %zu},\n  \"results\": [\n",
+                l.connIntervalUs / 1000.0, l.packetsPerEvent, l.mtu, l.dataLength, l.phyBps / 1000000,
+                l.controllerQueue, scenario.recordsPerSec, scenario.recordSize, scenario.durationMs,
+                scenario.impairments.stallEveryMs, scenario.impairments.stallMs,
+                scenario.impairments.disconnectAtMs.size());
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        SimResult& r = results[i];
+        std::sort(r.latencyUs.begin(), r.latencyUs.end());
+        double seconds = scenario.durationMs / 1000.0;
+        double throughput = static_cast<double>(r.payloadBytes) / seconds;
+        double fill = r.scheduler.packetsSent > 0
+                          ? 100.0 * r.scheduler.bytesSent / (static_cast<double>(r.scheduler.packetsSent) * capacity)
+                          : 0;
+        double p50 = percentile(r.latencyUs, 0.50) / 1000.0;
+        double p99 = percentile(r.latencyUs, 0.99) / 1000.0;
+        double max = r.latencyUs.empty() ? 0 : r.latencyUs.back() / 1000.0;
+
+        std::fprintf(stderr, "%-12s %10u %10.0f %8.1f %9.2f %9.2f %9.2f %8u %8u\n", r.policy.c_str(), r.delivered,
+                     throughput, fill, p50, p99, max, r.scheduler.notifyRetries, r.scheduler.retransmits);
+
+        std::printf("    {\"policy\": \"%s\", \"produced\": %u, \"delivered\": %u, \"lost\": %u, "
+                    "\"duplicates\": %u, \"payload_bytes_per_s\": %.1f, \"packets\": %u, \"fill_percent\": %.1f, "
+                    "\"latency_ms\": {\"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f}, "
+                    "\"records_dropped\": %u, \"notify_retries\": %u, \"retransmit_requests\": %u, "
+                    "\"retransmits\": %u, \"retransmit_misses\": %u, \"connection_events\": %u, "
+                    "\"stalled_events\": %u, \"lost_on_disconnect\": %u, \"airtime_percent\": %.1f}%s\n",
+                    r.policy.c_str(), r.produced, r.delivered, r.produced - r.delivered, r.duplicates, throughput,
+                    r.scheduler.packetsSent, fill, p50, p99, max, r.scheduler.recordsDropped,
+                    r.scheduler.notifyRetries, r.retransmitRequests, r.scheduler.retransmits,
+                    r.scheduler.retransmitMisses, r.link.connectionEvents, r.link.stalledEvents,
+                    r.link.packetsLostOnDisconnect, 100.0 * r.link.airtimeUs / (scenario.durationMs * 1000.0),
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+static void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [options]\n"
+                 "  --interval-ms N      connection interval (default 30)\n"
+                 "  --ppe N              LL PDUs per connection event (default 4)\n"
+                 "  --mtu N              ATT MTU (default 247)\n"
+                 "  --dle N              LL data length (default 251, 27 = no DLE)\n"
+                 "  --phy 1|2            PHY rate in Mbit/s (default 1)\n"
+                 "  --queue N            controller notify queue depth (default 12)\n"
+                 "  --rate N             records per second (default 1000)\n"
+                 "  --size N             record size in bytes, >= 8 (default 16)\n"
+                 "  --duration-s N       simulated time (default 60)\n"
+                 "  --stall-every-ms N   central stall period (default 10000, 0 = off)\n"
+                 "  --stall-ms N         central stall length (default 300)\n"
+                 "  --disconnect-at-ms N disconnect at time N (repeatable, default 30000)\n"
+                 "  --no-disconnect      no disconnects\n"
+                 "  --reconnect-ms N     reconnect delay (default 1000)\n"
+                 "  --policy NAME        eager | batched | paced | all (default all)\n"
+                 "  --batch-ms N         batch delay for batched/paced (default 20)\n",
+                 argv0);
+}
+
+int main(int argc, char** argv) {
+    Scenario scenario;
+    scenario.impairments.stallEveryMs = 10000;
+    scenario.impairments.stallMs = 300;
+    scenario.impairments.disconnectAtMs = {30000};
+    std::string policyName = "all";
+    uint32_t batchMs = 20;
+    bool customDisconnects = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--no-disconnect") == 0) {
+            scenario.impairments.disconnectAtMs.clear();
+            customDisconnects = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        uint32_t n = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        if (std::strcmp(arg, "--interval-ms") == 0) {
+            scenario.link.connIntervalUs = static_cast<uint32_t>(std::strtod(value, nullptr) * 1000);
+        } else if (std::strcmp(arg, "--ppe") == 0) {
+            scenario.link.packetsPerEvent = static_cast<uint8_t>(n);
+        } else if (std::strcmp(arg, "--mtu") == 0) {
+            scenario.link.mtu = static_cast<uint16_t>(n);
+        } else if (std::strcmp(arg, "--dle") == 0) {
+            scenario.link.dataLength = static_cast<uint16_t>(n);
+        } else if (std::strcmp(arg, "--phy") == 0) {
+            scenario.link.phyBps = n * 1000000;
+        } else if (std::strcmp(arg, "--queue") == 0) {
+            scenario.link.controllerQueue = static_cast<uint8_t>(n);
+        } else if (std::strcmp(arg, "--rate") == 0) {
+            scenario.recordsPerSec = n;
+        } else if (std::strcmp(arg, "--size") == 0) {
+            scenario.recordSize = static_cast<uint16_t>(n);
+        } else if (std::strcmp(arg, "--duration-s") == 0) {
+            scenario.durationMs = n * 1000;
+        } else if (std::strcmp(arg, "--stall-every-ms") == 0) {
+            scenario.impairments.stallEveryMs = n;
+        } else if (std::strcmp(arg, "--stall-ms") == 0) {
+            scenario.impairments.stallMs = n;
+        } else if (std::strcmp(arg, "--disconnect-at-ms") == 0) {
+            if (!customDisconnects) {
+                scenario.impairments.disconnectAtMs.clear();
+                customDisconnects = true;
+            }
+            scenario.impairments.disconnectAtMs.push_back(n);
+        } else if (std::strcmp(arg, "--reconnect-ms") == 0) {
+            scenario.impairments.reconnectDelayMs = n;
+        } else if (std::strcmp(arg, "--policy") == 0) {
+            policyName = value;
+        } else if (std::strcmp(arg, "--batch-ms") == 0) {
+            batchMs = n;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (scenario.recordSize < 8 || scenario.link.mtu < 23 || scenario.link.dataLength < 27 ||
+        scenario.link.phyBps == 0 || scenario.link.connIntervalUs == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::sort(scenario.impairments.disconnectAtMs.begin(), scenario.impairments.disconnectAtMs.end());
+
+    // paced はコネクションイベントあたりのパケット数に合わせて間隔を空ける
+    uint32_t pacedIntervalUs = scenario.link.connIntervalUs / std::max<uint8_t>(scenario.link.packetsPerEvent, 1);
+    std::vector<NamedPolicy> policies;
+    if (policyName == "all" || policyName == "eager") {
+        policies.push_back({"eager", PacingPolicy::eager()});
+    }
+    if (policyName == "all" || policyName == "batched") {
+        policies.push_back({"batched", PacingPolicy::batched(batchMs)});
+    }
+    if (policyName == "all" || policyName == "paced") {
+        policies.push_back({"paced", PacingPolicy::paced(pacedIntervalUs, batchMs)});
+    }
+    if (policies.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<SimResult> results;
+    for (const NamedPolicy& policy : policies) {
+        results.push_back(runScenario(scenario, policy));
+    }
+    printResults(scenario, results);
+    return 0;
+}
@@ -0,0 +1,751 @@
+#include "platform/m5/M5Hal.h"
+
+#include <BLE2902.h>
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLEUtils.h>
+#include <LittleFS.h>
+#include <M5Unified.h>
+#include <esp_camera.h>
+#include <esp_timer.h>
+#include <img_converters.h>
+
+#include "diag/Profiler.h"
+
+// ===== Serial =====
+
+void M5SerialPort::print(const char* text) {
+    PROFILE_ZONE(ZONE_SERIAL);
+    out.print(text);
+}
+
+void M5SerialPort::println(const char* text) {
+    PROFILE_ZONE(ZONE_SERIAL);
+    out.println(text);
+}
+
+size_t M5SerialPort::write(const uint8_t* data, size_t len) {
+    PROFILE_ZONE(ZONE_SERIAL);
+    return out.write(data, len);
+}
+
+// ===== Display =====
+
+void M5Display::clear() {
+    M5.Display.setTextSize(2);
+    M5.Display.fillScreen(BLACK);
+}
+
+void M5Display::drawLine(int16_t y, hal::Color color, const char* text) {
+    PROFILE_ZONE(ZONE_DISPLAY);
+    M5.Display.fillRect(0, y, 320, 20, BLACK);
+    M5.Display.setCursor(10, y);
+    M5.Display.setTextColor(static_cast<uint16_t>(color));
+    M5.Display.println(text);
+}
+
+// ===== BLE =====
+
+// サーバーコールバック：接続・切断を BleListener に転送
+class ServerCallbacks : public BLEServerCallbacks {
+public:
+    explicit ServerCallbacks(M5BlePeripheral* owner) : owner(owner) {}
+
+    void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override {
+        owner->connId = param->connect.conn_id;
+        memcpy(owner->peerAddress, param->connect.remote_bda, sizeof(owner->peerAddress));
+        owner->connected = true;
+        owner->resetSubscriptions();
+        owner->listener->onConnect(param->connect.conn_id);
+    }
+
+    void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override {
+        owner->connected = false;
+        owner->listener->onDisconnect(param->disconnect.conn_id);
+    }
+
+private:
+    M5BlePeripheral* owner;
+};
+
+// キャラクタリスティックコールバック：書き込みを BleListener に転送し、Notify の結果を記録する
+// （onStatus() は BLECharacteristic::notify() の中から同期的に呼ばれる）
+class CharacteristicCallbacks : public BLECharacteristicCallbacks {
+public:
+    void bind(M5BlePeripheral* owner, hal::CharId id) {
+        this->owner = owner;
+        this->id = id;
+    }
+
+    void onWrite(BLECharacteristic* pCharacteristic) override {
+        PROFILE_ZONE(ZONE_ON_WRITE);
+        std::string value = pCharacteristic->getValue();
+        owner->listener->onWrite(id, reinterpret_cast<const uint8_t*>(value.data()), value.length());
+    }
+
+    void onRead(BLECharacteristic* pCharacteristic) override {
+        owner->listener->onRead(id);
+    }
+
+    void onStatus(BLECharacteristic* pCharacteristic, Status s, uint32_t code) override {
+        owner->lastNotifyOk = (s == SUCCESS_NOTIFY || s == SUCCESS_INDICATE);
+    }
+
+private:
+    M5BlePeripheral* owner = nullptr;
+    hal::CharId id = hal::kInvalidId;
+};
+
+// CCCD コールバック：セントラルが Notify・Indicate を有効にしたか BleListener に転送
+class CccdCallbacks : public BLEDescriptorCallbacks {
+public:
+    void bind(M5BlePeripheral* owner, hal::CharId id) {
+        this->owner = owner;
+        this->id = id;
+    }
+
+    void onWrite(BLEDescriptor* pDescriptor) override {
+        BLE2902* cccd = static_cast<BLE2902*>(pDescriptor);
+        owner->listener->onSubscribeChanged(id, cccd->getNotifications() || cccd->getIndications());
+    }
+
+private:
+    M5BlePeripheral* owner = nullptr;
+    hal::CharId id = hal::kInvalidId;
+};
+
+// キャラクタリスティックごとのコールバックと CCCD は静的に持つ（属性ごとに new しない）
+static CharacteristicCallbacks charCallbacks[M5BlePeripheral::kMaxCharacteristics];
+static CccdCallbacks cccdCallbacks[M5BlePeripheral::kMaxCharacteristics];
+static BLE2902 cccds[M5BlePeripheral::kMaxCharacteristics];
+
+// 16 byte のまま BLEUUID にする（文字列の解析をしない）
+static BLEUUID toBleUuid(const hal::Uuid& uuid) {
+    return BLEUUID(const_cast<uint8_t*>(uuid.bytes), sizeof(uuid.bytes), true);
+}
+
+// MTU 交換・コネクションパラメータ更新は BLEServerCallbacks に無いので、
+// BLEDevice のカスタムハンドラで GAP/GATTS イベントを直接受ける
+static M5BlePeripheral* activePeripheral = nullptr;
+
+static void gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+    if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT && activePeripheral != nullptr) {
+        activePeripheral->bleListener()->onConnParamsUpdated(param->update_conn_params.conn_int,
+                                                             param->update_conn_params.latency,
+                                                             param->update_conn_params.timeout);
+    }
+}
+
+static void gattsEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t* param) {
+    if (event == ESP_GATTS_MTU_EVT && activePeripheral != nullptr) {
+        activePeripheral->bleListener()->onMtuChanged(param->mtu.mtu);
+    }
+}
+
+void M5BlePeripheral::begin(const char* deviceName, hal::BleListener* listener) {
+    this->listener = listener;
+    activePeripheral = this;
+
+    // BLEデバイス初期化
+    BLEDevice::init(deviceName);
+    BLEDevice::setMTU(517);  // セントラルが大きい MTU を要求したら受け入れる
+    BLEDevice::setCustomGapHandler(gapEventHandler);
+    BLEDevice::setCustomGattsHandler(gattsEventHandler);
+
+    // BLEサーバー作成
+    server = BLEDevice::createServer();
+    server->setCallbacks(new ServerCallbacks(this));
+}
+
+hal::ServiceId M5BlePeripheral::addService(const hal::Uuid& uuid, uint16_t handleCount) {
+    if (serviceCount >= kMaxServices) {
+        return hal::kInvalidId;
+    }
+    services[serviceCount] = server->createService(toBleUuid(uuid), handleCount);
+    return serviceCount++;
+}
+
+hal::CharId M5BlePeripheral::addCharacteristic(hal::ServiceId service, const hal::Uuid& uuid, uint8_t properties) {
+    if (service >= serviceCount || charCount >= kMaxCharacteristics) {
+        return hal::kInvalidId;
+    }
+
+    uint32_t props = 0;
+    if (properties & hal::PROP_READ) props |= BLECharacteristic::PROPERTY_READ;
+    if (properties & hal::PROP_WRITE) props |= BLECharacteristic::PROPERTY_WRITE;
+    if (properties & hal::PROP_WRITE_NR) props |= BLECharacteristic::PROPERTY_WRITE_NR;
+    if (properties & hal::PROP_NOTIFY) props |= BLECharacteristic::PROPERTY_NOTIFY;
+    if (properties & hal::PROP_INDICATE) props |= BLECharacteristic::PROPERTY_INDICATE;
+
+    hal::CharId id = charCount++;
+    BLECharacteristic* c = services[service]->createCharacteristic(toBleUuid(uuid), props);
+
+    // ディスクリプタ追加（Notify用）
+    if (properties & (hal::PROP_NOTIFY | hal::PROP_INDICATE)) {
+        cccdCallbacks[id].bind(this, id);
+        cccds[id].setCallbacks(&cccdCallbacks[id]);
+        c->addDescriptor(&cccds[id]);
+    }
+    charCallbacks[id].bind(this, id);
+    c->setCallbacks(&charCallbacks[id]);
+
+    characteristics[id] = c;
+    return id;
+}
+
+void M5BlePeripheral::startService(hal::ServiceId service) {
+    if (service < serviceCount) {
+        services[service]->start();
+    }
+}
+
+void M5BlePeripheral::advertiseService(const hal::Uuid& uuid) {
+    BLEAdvertising* pAdvertising = BLEDevice::getAdvertising();
+    pAdvertising->addServiceUUID(toBleUuid(uuid));
+    pAdvertising->setScanResponse(true);
+    pAdvertising->setMinPreferred(0x06);  // iPhone接続の問題対策
+    pAdvertising->setMinPreferred(0x12);
+}
+
+void M5BlePeripheral::startAdvertising() {
+    BLEDevice::startAdvertising();
+}
+
+void M5BlePeripheral::setValue(hal::CharId ch, const uint8_t* data, size_t len) {
+    if (ch < charCount) {
+        PROFILE_ZONE(ZONE_SET_VALUE);
+        characteristics[ch]->setValue(const_cast<uint8_t*>(data), len);
+    }
+}
+
+bool M5BlePeripheral::notify(hal::CharId ch) {
+    if (ch >= charCount || !connected) {
+        return false;
+    }
+    lastNotifyOk = true;
+    PROFILE_ZONE(ZONE_NOTIFY);
+    characteristics[ch]->notify();
+    return lastNotifyOk;
+}
+
+// BLE2902 は前の接続で書かれた値を持ち続けるので、接続したら未購読に戻す
+// （ボンディングしないセントラルの CCCD は接続ごと。購読するなら接続後に書き直す）
+void M5BlePeripheral::resetSubscriptions() {
+    for (hal::CharId id = 0; id < charCount; ++id) {
+        cccds[id].setNotifications(false);
+        cccds[id].setIndications(false);
+    }
+}
+
+// Service Changed は BLE スタックの GATT サービス（0x1801）にあるので、スタックに送らせる
+bool M5BlePeripheral::indicateServiceChanged() {
+    if (!connected) {
+        return false;
+    }
+    return esp_ble_gatts_send_service_change_indication(server->getGattsIf(), peerAddress) == ESP_OK;
+}
+
+uint16_t M5BlePeripheral::mtu() const {
+    if (!connected) {
+        return 23;
+    }
+    return server->getPeerMTU(connId);
+}
+
+// ===== IMU =====
+
+namespace {
+
+constexpr uint8_t kBmi270Address = 0x69;
+constexpr uint32_t kI2cFreq = 400000;
+
+// BMI270 レジスタ
+constexpr uint8_t REG_FIFO_LENGTH_0 = 0x24;
+constexpr uint8_t REG_FIFO_DATA = 0x26;
+constexpr uint8_t REG_ACC_CONF = 0x40;
+constexpr uint8_t REG_ACC_RANGE = 0x41;
+constexpr uint8_t REG_GYR_CONF = 0x42;
+constexpr uint8_t REG_GYR_RANGE = 0x43;
+constexpr uint8_t REG_FIFO_CONFIG_0 = 0x48;
+constexpr uint8_t REG_FIFO_CONFIG_1 = 0x49;
+constexpr uint8_t REG_PWR_CONF = 0x7C;
+constexpr uint8_t REG_PWR_CTRL = 0x7D;
+constexpr uint8_t REG_CMD = 0x7E;
+
+constexpr uint8_t CMD_FIFO_FLUSH = 0xB0;
+constexpr uint8_t FIFO_GYR_EN = 0x80;
+constexpr uint8_t FIFO_ACC_EN = 0x40;
+constexpr uint8_t PWR_ACC_GYR_EN = 0x06;
+
+// ヘッダなしモードの 1 フレーム：gyr xyz, acc xyz（各 i16 リトルエンディアン）
+constexpr size_t kFrameSize = 12;
+constexpr size_t kFifoSize = 2048;
+constexpr size_t kFramesPerBurst = 8;
+
+// ODR の設定値（acc_odr / gyr_odr 共通）。対応していなければ 0
+uint8_t odrCode(uint16_t rateHz) {
+    switch (rateHz) {
+        case 25: return 0x06;
+        case 50: return 0x07;
+        case 100: return 0x08;
+        case 200: return 0x09;
+        case 400: return 0x0A;
+        case 800: return 0x0B;
+        case 1600: return 0x0C;
+        default: return 0;
+    }
+}
+
+int accelRangeCode(uint8_t g) {
+    switch (g) {
+        case 2: return 0;
+        case 4: return 1;
+        case 8: return 2;
+        case 16: return 3;
+        default: return -1;
+    }
+}
+
+int gyroRangeCode(uint16_t dps) {
+    switch (dps) {
+        case 2000: return 0;
+        case 1000: return 1;
+        case 500: return 2;
+        case 250: return 3;
+        case 125: return 4;
+        default: return -1;
+    }
+}
+
+int16_t readI16(const uint8_t* p) {
+    return static_cast<int16_t>(p[0] | (p[1] << 8));
+}
+
+}  // namespace
+
+bool M5Imu::writeRegister(uint8_t reg, uint8_t value) {
+    return M5.In_I2C.writeRegister8(kBmi270Address, reg, value, kI2cFreq);
+}
+
+bool M5Imu::start(const hal::ImuConfig& config) {
+    uint8_t odr = odrCode(config.rateHz);
+    int accRange = accelRangeCode(config.accelRangeG);
+    int gyrRange = gyroRangeCode(config.gyroRangeDps);
+    if (odr == 0 || accRange < 0 || gyrRange < 0) {
+        return false;
+    }
+
+    // 省電力モードを切り、フィルタは性能優先（bwp = normal）にする
+    bool ok = writeRegister(REG_PWR_CONF, 0x00);
+    delayMicroseconds(500);
+    ok = ok && writeRegister(REG_ACC_CONF, 0xA0 | odr);
+    ok = ok && writeRegister(REG_ACC_RANGE, static_cast<uint8_t>(accRange));
+    ok = ok && writeRegister(REG_GYR_CONF, 0xE0 | odr);
+    ok = ok && writeRegister(REG_GYR_RANGE, static_cast<uint8_t>(gyrRange));
+    ok = ok && writeRegister(REG_PWR_CTRL, PWR_ACC_GYR_EN);
+
+    // ヘッダなし・センサ時刻なし・満杯時は古いフレームを上書き
+    ok = ok && writeRegister(REG_FIFO_CONFIG_0, 0x00);
+    ok = ok && writeRegister(REG_FIFO_CONFIG_1, FIFO_GYR_EN | FIFO_ACC_EN);
+    ok = ok && writeRegister(REG_CMD, CMD_FIFO_FLUSH);
+
+    overruns = 0;
+    running = ok;
+    return ok;
+}
+
+void M5Imu::stop() {
+    if (running) {
+        writeRegister(REG_FIFO_CONFIG_1, 0x00);
+        writeRegister(REG_CMD, CMD_FIFO_FLUSH);
+        running = false;
+    }
+}
+
+size_t M5Imu::readFifo(hal::ImuSample* out, size_t maxSamples) {
+    if (!running) {
+        return 0;
+    }
+    PROFILE_ZONE(ZONE_IMU_READ);
+
+    uint8_t lengthBytes[2];
+    if (!M5.In_I2C.readRegister(kBmi270Address, REG_FIFO_LENGTH_0, lengthBytes, sizeof(lengthBytes), kI2cFreq)) {
+        return 0;
+    }
+    size_t fifoBytes = static_cast<size_t>(lengthBytes[0] | ((lengthBytes[1] & 0x3F) << 8));
+
+    // 満杯近くまでたまっていたら、読み出しが間に合わず上書きが起きている
+    if (fifoBytes + kFrameSize > kFifoSize) {
+        ++overruns;
+    }
+
+    size_t frames = fifoBytes / kFrameSize;
+    if (frames > maxSamples) {
+        frames = maxSamples;
+    }
+
+    size_t done = 0;
+    uint8_t burst[kFramesPerBurst * kFrameSize];
+    while (done < frames) {
+        size_t n = frames - done < kFramesPerBurst ? frames - done : kFramesPerBurst;
+        if (!M5.In_I2C.readRegister(kBmi270Address, REG_FIFO_DATA, burst, n * kFrameSize, kI2cFreq)) {
+            break;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const uint8_t* f = burst + i * kFrameSize;
+            hal::ImuSample& s = out[done + i];
+            s.gx = readI16(f + 0);
+            s.gy = readI16(f + 2);
+            s.gz = readI16(f + 4);
+            s.ax = readI16(f + 6);
+            s.ay = readI16(f + 8);
+            s.az = readI16(f + 10);
+        }
+        done += n;
+    }
+    return done;
+}
+
+// ===== Microphone =====
+
+bool M5Microphone::start(uint32_t sampleRate) {
+    stop();
+    if (sampleRate < 8000 || sampleRate > 48000) {
+        return false;
+    }
+    M5.Speaker.end();
+    if (!M5.Mic.begin()) {
+        return false;
+    }
+    rate = sampleRate;
+    head = 0;
+    held = false;
+    underrunCount = 0;
+    M5.Mic.record(buffers[0], MIC_BUFFER_SAMPLES, rate);
+    M5.Mic.record(buffers[1], MIC_BUFFER_SAMPLES, rate);
+    running = true;
+    return true;
+}
+
+void M5Microphone::stop() {
+    if (running) {
+        M5.Mic.end();
+        running = false;
+    }
+}
+
+const int16_t* M5Microphone::acquire(size_t& samples) {
+    if (!running || held) {
+        return nullptr;
+    }
+    // isRecording(): 0=キューが空 1=録音中（空きあり） 2=録音中（キュー満杯）
+    size_t inFlight = M5.Mic.isRecording();
+    if (inFlight >= 2) {
+        return nullptr;
+    }
+    if (inFlight == 0) {
+        ++underrunCount;  // 2 面とも録音済みで、返されるまでの入力は失われている
+    }
+    held = true;
+    samples = MIC_BUFFER_SAMPLES;
+    return buffers[head];
+}
+
+void M5Microphone::release() {
+    if (held) {
+        M5.Mic.record(buffers[head], MIC_BUFFER_SAMPLES, rate);
+        head ^= 1;
+        held = false;
+    }
+}
+
+// ===== Camera =====
+
+bool M5Camera::start(uint16_t width, uint16_t height, uint8_t quality) {
+    framesize_t size;
+    if (width == 160 && height == 120) {
+        size = FRAMESIZE_QQVGA;
+    } else if (width == 320 && height == 240) {
+        size = FRAMESIZE_QVGA;
+    } else {
+        return false;
+    }
+    if (quality == 0 || quality > 100) {
+        return false;
+    }
+
+    if (initialized && (width != this->width || height != this->height)) {
+        deinit();
+    }
+    if (!initialized) {
+        camera_config_t config = {};
+        config.pin_pwdn = -1;
+        config.pin_reset = -1;
+        config.pin_xclk = 2;
+        config.pin_sccb_sda = 12;
+        config.pin_sccb_scl = 11;
+        config.pin_d7 = 47;
+        config.pin_d6 = 48;
+        config.pin_d5 = 16;
+        config.pin_d4 = 15;
+        config.pin_d3 = 42;
+        config.pin_d2 = 41;
+        config.pin_d1 = 40;
+        config.pin_d0 = 39;
+        config.pin_vsync = 46;
+        config.pin_href = 38;
+        config.pin_pclk = 45;
+        config.xclk_freq_hz = 20000000;
+        config.ledc_timer = LEDC_TIMER_0;
+        config.ledc_channel = LEDC_CHANNEL_0;
+        config.pixel_format = PIXFORMAT_RGB565;
+        config.frame_size = size;
+        config.fb_count = 2;
+        config.fb_location = CAMERA_FB_IN_PSRAM;
+        config.grab_mode = CAMERA_GRAB_LATEST;
+        config.sccb_i2c_port = M5.In_I2C.getPort();
+
+        // SCCB は内部 I2C（IMU・タッチ・電源 IC と共用）。1 つのポートに 2 つのドライバを入れないよう、
+        // M5Unified のドライバを解放して渡し、deinit() でカメラのドライバを外してから戻す。
+        // カメラが動いている間は M5.In_I2C を使えない（BleApp が IMU・タッチとの同時使用を断る）
+        i2cPort = M5.In_I2C.getPort();
+        i2cSda = M5.In_I2C.getSDA();
+        i2cScl = M5.In_I2C.getSCL();
+        M5.In_I2C.release();
+        if (esp_camera_init(&config) != ESP_OK) {
+            M5.In_I2C.begin(static_cast<i2c_port_t>(i2cPort), i2cSda, i2cScl);
+            return false;
+        }
+        initialized = true;
+    }
+    this->width = width;
+    this->height = height;
+    this->quality = quality;
+    return true;
+}
+
+void M5Camera::stop() {
+    release();
+    // ドライバを残すと内部 I2C をカメラが持ったままになるので、毎回外して M5Unified に戻す
+    deinit();
+}
+
+void M5Camera::deinit() {
+    if (!initialized) {
+        return;
+    }
+    esp_camera_deinit();
+    initialized = false;
+    M5.In_I2C.begin(static_cast<i2c_port_t>(i2cPort), i2cSda, i2cScl);
+}
+
+bool M5Camera::capture(hal::CameraFrame& frame) {
+    if (!initialized || jpeg != nullptr) {
+        return false;
+    }
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (fb == nullptr) {
+        return false;
+    }
+    size_t length = 0;
+    bool ok = frame2jpg(fb, quality, &jpeg, &length);
+    esp_camera_fb_return(fb);
+    if (!ok) {
+        jpeg = nullptr;
+        return false;
+    }
+    frame = {jpeg, length, width, height};
+    return true;
+}
+
+void M5Camera::release() {
+    if (jpeg != nullptr) {
+        free(jpeg);
+        jpeg = nullptr;
+    }
+}
+
+// ===== Touch =====
+
+namespace {
+
+constexpr uint8_t kFt6336Address = 0x38;
+constexpr int kTouchIntPin = 21;
+
+// FT6336 レジスタ
+constexpr uint8_t REG_TD_STATUS = 0x02;  // 続けて P1_XH, P1_XL, P1_YH, P1_YL
+constexpr uint8_t REG_G_MODE = 0xA4;
+constexpr uint8_t G_MODE_TRIGGER = 0x01;  // 報告ごとに INT をパルスで出す
+
+// 指を離したときの割り込みが来ないことがあるので、触れている間はこの間隔で読む
+constexpr uint32_t kReleasePollUs = 50000;
+
+// 割り込みハンドラと loop() の間で共有する
+portMUX_TYPE touchMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool touchPending = false;
+volatile uint32_t touchFirstUs = 0;   // まだ読んでいない最初の割り込みの時刻
+volatile uint32_t touchIrqCount = 0;  // まだ読んでいない割り込みの数
+TaskHandle_t touchWaiter = nullptr;
+
+}  // namespace
+
+void IRAM_ATTR M5Touch::onInterrupt() {
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    portENTER_CRITICAL_ISR(&touchMux);
+    if (!touchPending) {
+        touchFirstUs = now;
+        touchPending = true;
+    }
+    ++touchIrqCount;
+    portEXIT_CRITICAL_ISR(&touchMux);
+
+    BaseType_t woken = pdFALSE;
+    if (touchWaiter != nullptr) {
+        vTaskNotifyGiveFromISR(touchWaiter, &woken);
+    }
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+bool M5Touch::begin() {
+    if (!M5.In_I2C.writeRegister8(kFt6336Address, REG_G_MODE, G_MODE_TRIGGER, kI2cFreq)) {
+        return false;
+    }
+    touchWaiter = xTaskGetCurrentTaskHandle();
+    pinMode(kTouchIntPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(kTouchIntPin), &M5Touch::onInterrupt, FALLING);
+    initialized = true;
+    return true;
+}
+
+size_t M5Touch::read(hal::TouchEvent* out, size_t maxEvents) {
+    if (!initialized || maxEvents == 0) {
+        return 0;
+    }
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    bool pending;
+    uint32_t firstUs;
+    uint32_t count;
+    portENTER_CRITICAL(&touchMux);
+    pending = touchPending;
+    firstUs = touchFirstUs;
+    count = touchIrqCount;
+    touchPending = false;
+    touchIrqCount = 0;
+    portEXIT_CRITICAL(&touchMux);
+
+    if (!pending && !(touching && now - lastReadUs >= kReleasePollUs)) {
+        return 0;
+    }
+    if (count > 1) {
+        coalesced += count - 1;
+    }
+    lastReadUs = now;
+
+    uint8_t regs[5];
+    if (!M5.In_I2C.readRegister(kFt6336Address, REG_TD_STATUS, regs, sizeof(regs), kI2cFreq)) {
+        return 0;
+    }
+    uint32_t timestampUs = pending ? firstUs : now;
+    uint8_t points = regs[0] & 0x0F;
+    if (points == 0 || points > 2) {
+        if (!touching) {
+            return 0;
+        }
+        touching = false;
+        out[0] = {timestampUs, lastX, lastY, hal::TouchType::Up, lastId};
+        return 1;
+    }
+
+    int16_t x = static_cast<int16_t>(((regs[1] & 0x0F) << 8) | regs[2]);
+    int16_t y = static_cast<int16_t>(((regs[3] & 0x0F) << 8) | regs[4]);
+    uint8_t id = regs[3] >> 4;
+    hal::TouchType type;
+    if (!touching) {
+        type = hal::TouchType::Down;
+    } else if (x != lastX || y != lastY) {
+        type = hal::TouchType::Move;
+    } else {
+        return 0;
+    }
+    touching = true;
+    lastX = x;
+    lastY = y;
+    lastId = id;
+    out[0] = {timestampUs, x, y, type, id};
+    return 1;
+}
+
+void M5Touch::waitForInterrupt(uint32_t timeoutMs) {
+    if (!initialized) {
+        delay(timeoutMs);
+        return;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+}
+
+// ===== FileStore =====
+
+bool M5FileStore::begin() {
+    mounted = LittleFS.begin(true);
+    return mounted;
+}
+
+bool M5FileStore::writeFile(const char* path, const char* mode, const uint8_t* data, size_t len) {
+    if (!mounted) {
+        return false;
+    }
+    File file = LittleFS.open(path, mode);
+    if (!file) {
+        return false;
+    }
+    size_t n = file.write(data, len);
+    file.close();
+    return n == len;
+}
+
+bool M5FileStore::write(const char* path, const uint8_t* data, size_t len) {
+    return writeFile(path, "w", data, len);
+}
+
+bool M5FileStore::append(const char* path, const uint8_t* data, size_t len) {
+    return writeFile(path, "a", data, len);
+}
+
+size_t M5FileStore::read(const char* path, size_t offset, uint8_t* out, size_t len) {
+    if (!mounted || !LittleFS.exists(path)) {
+        return 0;
+    }
+    File file = LittleFS.open(path, "r");
+    if (!file || !file.seek(offset)) {
+        return 0;
+    }
+    size_t n = file.read(out, len);
+    file.close();
+    return n;
+}
+
+int32_t M5FileStore::size(const char* path) {
+    if (!mounted || !LittleFS.exists(path)) {
+        return -1;
+    }
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        return -1;
+    }
+    int32_t n = static_cast<int32_t>(file.size());
+    file.close();
+    return n;
+}
+
+bool M5FileStore::remove(const char* path) {
+    return mounted && LittleFS.remove(path);
+}
+
+size_t M5FileStore::freeBytes() {
+    if (!mounted) {
+        return 0;
+    }
+    return LittleFS.totalBytes() - LittleFS.usedBytes();
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "app/AppConfig.h"
+#include "hal/BlePeripheral.h"
+#include "hal/Camera.h"
+#include "hal/Clock.h"
+#include "hal/Display.h"
+#include "hal/FileStore.h"
+#include "hal/Imu.h"
+#include "hal/Microphone.h"
+#include "hal/SerialPort.h"
+#include "hal/Touch.h"
+
+class BLEServer;
+class BLEService;
+class BLECharacteristic;
+
+// 実機（M5Stack CoreS3 + Arduino-ESP32）向けの HAL 実装
+
+class M5Clock : public hal::Clock {
+public:
+    uint32_t millis() const override { return ::millis(); }
+    uint32_t micros() const override { return ::micros(); }
+    void delay(uint32_t ms) override { ::delay(ms); }
+};
+
+class M5SerialPort : public hal::SerialPort {
+public:
+    explicit M5SerialPort(Print& out) : out(out) {}
+
+    void print(const char* text) override;
+    void println(const char* text) override;
+    size_t write(const uint8_t* data, size_t len) override;
+
+private:
+    Print& out;
+};
+
+class M5Display : public hal::Display {
+public:
+    void clear() override;
+    void drawLine(int16_t y, hal::Color color, const char* text) override;
+};
+
+class M5BlePeripheral : public hal::BlePeripheral {
+public:
+    static constexpr uint8_t kMaxServices = 4;
+    static constexpr uint8_t kMaxCharacteristics = 8;
+
+    void begin(const char* deviceName, hal::BleListener* listener) override;
+
+    hal::ServiceId addService(const hal::Uuid& uuid, uint16_t handleCount) override;
+    hal::CharId addCharacteristic(hal::ServiceId service, const hal::Uuid& uuid, uint8_t properties) override;
+    void startService(hal::ServiceId service) override;
+
+    void advertiseService(const hal::Uuid& uuid) override;
+    void startAdvertising() override;
+
+    void setValue(hal::CharId ch, const uint8_t* data, size_t len) override;
+    bool notify(hal::CharId ch) override;
+    uint16_t mtu() const override;
+    bool indicateServiceChanged() override;
+
+    hal::BleListener* bleListener() const { return listener; }
+
+private:
+    friend class ServerCallbacks;
+    friend class CharacteristicCallbacks;
+    friend class CccdCallbacks;
+
+    // 接続したときにすべての CCCD を未購読に戻す
+    void resetSubscriptions();
+
+    hal::BleListener* listener = nullptr;
+    BLEServer* server = nullptr;
+    BLEService* services[kMaxServices] = {};
+    BLECharacteristic* characteristics[kMaxCharacteristics] = {};
+    uint8_t serviceCount = 0;
+    uint8_t charCount = 0;
+    uint16_t connId = 0;
+    uint8_t peerAddress[6] = {};
+    bool connected = false;
+    bool lastNotifyOk = true;  // notify() 中に onStatus() で更新される
+};
+
+// 内蔵 IMU（BMI270, 内部 I2C 0x69）の FIFO を直接使う
+// M5.begin() で M5Unified が初期化（設定ファイルの書き込み）を済ませた後に start() する。
+// FIFO と取り合いになるので、ストリーム中は M5.Imu.update() を呼ばないこと。
+// サンプルはセンサ座標系の生値（M5.Imu の軸の入れ替えは適用しない）
+class M5Imu : public hal::Imu {
+public:
+    bool start(const hal::ImuConfig& config) override;
+    void stop() override;
+    size_t readFifo(hal::ImuSample* out, size_t maxSamples) override;
+    uint32_t fifoOverruns() const override { return overruns; }
+
+private:
+    bool writeRegister(uint8_t reg, uint8_t value);
+
+    bool running = false;
+    uint32_t overruns = 0;
+};
+
+// 内蔵マイク（M5.Mic）。M5Unified が I2S の DMA から録音キューのバッファへ書き込むので、
+// 2 面のバッファを常にキューに入れておき、録音が終わった面から順に受け取る。
+// CoreS3 はスピーカーと I2S を共有しているため、start() でスピーカーを止める
+class M5Microphone : public hal::Microphone {
+public:
+    bool start(uint32_t sampleRate) override;
+    void stop() override;
+    const int16_t* acquire(size_t& samples) override;
+    void release() override;
+    uint32_t underruns() const override { return underrunCount; }
+
+private:
+    int16_t buffers[2][MIC_BUFFER_SAMPLES];
+    uint8_t head = 0;  // 次に録音が終わる面
+    bool held = false;
+    bool running = false;
+    uint32_t rate = 0;
+    uint32_t underrunCount = 0;
+};
+
+// 内蔵カメラ（GC0308, esp32-camera）。GC0308 は JPEG を出せないので RGB565 で撮って frame2jpg() で圧縮する
+// フレームバッファは PSRAM に 2 面、常に最新のフレームを取る（古いフレームは撮影側でも捨てる）
+class M5Camera : public hal::Camera {
+public:
+    bool start(uint16_t width, uint16_t height, uint8_t quality) override;
+    void stop() override;
+    bool capture(hal::CameraFrame& frame) override;
+    void release() override;
+    // SCCB は内部 I2C（IMU・タッチ・電源 IC）につながっている
+    bool sharesSensorBus() const override { return true; }
+
+private:
+    void deinit();
+
+    bool initialized = false;
+    int i2cPort = 0;  // 解放した M5.In_I2C のポートとピン（deinit() で戻す）
+    int i2cSda = -1;
+    int i2cScl = -1;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint8_t quality = 0;
+    uint8_t* jpeg = nullptr;  // frame2jpg() が確保したバッファ
+};
+
+// 内蔵タッチパネル（FT6336, 内部 I2C 0x38、INT は GPIO 21）
+// 割り込みでは時刻を記録して loop() のタスクを起こすだけにし、座標の読み出しは read() で行う。
+// コントローラは最新の座標しか持たないので、読み出しまでに重なった割り込みは 1 つにまとめて overflows() に数える
+class M5Touch : public hal::TouchInput {
+public:
+    // M5.begin() の後、loop() と同じタスク（setup()）から呼ぶ
+    bool begin();
+
+    size_t read(hal::TouchEvent* out, size_t maxEvents) override;
+    uint32_t overflows() const override { return coalesced; }
+
+    // 割り込みが来るか timeoutMs が過ぎるまで待つ（loop() の delay() の代わり）
+    void waitForInterrupt(uint32_t timeoutMs);
+
+private:
+    static void onInterrupt();
+
+    bool initialized = false;
+    bool touching = false;
+    int16_t lastX = 0;
+    int16_t lastY = 0;
+    uint8_t lastId = 0;
+    uint32_t lastReadUs = 0;
+    uint32_t coalesced = 0;
+};
+
+// 内蔵フラッシュの LittleFS（パーティションは board_build.filesystem = littlefs）
+// ファイルは呼び出しごとに開いて閉じる。LittleFS は書き込みのたびにメタデータのブロックも更新するので、
+// 書き込みはブロック単位にまとめて呼ぶこと
+class M5FileStore : public hal::FileStore {
+public:
+    static constexpr size_t kBlockSize = 4096;
+
+    // setup() から呼ぶ。マウントできなければフォーマットしてやり直す
+    bool begin();
+
+    bool write(const char* path, const uint8_t* data, size_t len) override;
+    bool append(const char* path, const uint8_t* data, size_t len) override;
+    size_t read(const char* path, size_t offset, uint8_t* out, size_t len) override;
+    int32_t size(const char* path) override;
+    bool remove(const char* path) override;
+    size_t blockSize() const override { return kBlockSize; }
+    size_t freeBytes() override;
+
+private:
+    bool writeFile(const char* path, const char* mode, const uint8_t* data, size_t len);
+
+    bool mounted = false;
+};
@@ -0,0 +1,413 @@
+#include "platform/native/MockHal.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// ===== Serial =====
+
+void MockSerialPort::print(const char* text) {
+    current += text;
+}
+
+void MockSerialPort::println(const char* text) {
+    current += text;
+    if (echo) {
+        if (clock != nullptr) {
+            std::printf("[%8.3f] %s\n", clock->millis() / 1000.0, current.c_str());
+        } else {
+            std::printf("%s\n", current.c_str());
+        }
+    }
+    completed.push_back(current);
+    current.clear();
+}
+
+size_t MockSerialPort::write(const uint8_t* data, size_t len) {
+    if (echo) {
+        std::fwrite(data, 1, len, stdout);
+    }
+    return len;
+}
+
+// ===== Display =====
+
+void MockDisplay::drawLine(int16_t y, hal::Color color, const char* text) {
+    ++draws;
+    for (auto& row : rows) {
+        if (row.y == y) {
+            row.color = color;
+            row.text = text;
+            return;
+        }
+    }
+    rows.push_back({y, color, text});
+}
+
+const MockDisplay::Line* MockDisplay::lineAt(int16_t y) const {
+    for (const auto& row : rows) {
+        if (row.y == y) {
+            return &row;
+        }
+    }
+    return nullptr;
+}
+
+// ===== BLE =====
+
+void MockBlePeripheral::begin(const char* deviceName, hal::BleListener* listener) {
+    name = deviceName;
+    this->listener = listener;
+}
+
+hal::ServiceId MockBlePeripheral::addService(const hal::Uuid& uuid, uint16_t handleCount) {
+    services.push_back(uuid);
+    handles = static_cast<uint16_t>(handles + handleCount);
+    return static_cast<hal::ServiceId>(services.size() - 1);
+}
+
+hal::CharId MockBlePeripheral::addCharacteristic(hal::ServiceId service, const hal::Uuid& uuid, uint8_t properties) {
+    if (service >= services.size()) {
+        return hal::kInvalidId;
+    }
+    chars.push_back({service, uuid, properties, {}, false});
+    return static_cast<hal::CharId>(chars.size() - 1);
+}
+
+void MockBlePeripheral::startService(hal::ServiceId service) {
+    (void)service;
+}
+
+void MockBlePeripheral::advertiseService(const hal::Uuid& uuid) {
+    advertisedServices.push_back(uuid);
+}
+
+void MockBlePeripheral::startAdvertising() {
+    advertising = true;
+    ++advertisingStartCount;
+}
+
+void MockBlePeripheral::setValue(hal::CharId ch, const uint8_t* data, size_t len) {
+    if (ch < chars.size()) {
+        chars[ch].value.assign(data, data + len);
+    }
+}
+
+bool MockBlePeripheral::notify(hal::CharId ch) {
+    if (ch >= chars.size() || !connected || linkStalled || !chars[ch].subscribed) {
+        return false;
+    }
+    sent.push_back({ch, clock.millis(), chars[ch].value});
+    return true;
+}
+
+void MockBlePeripheral::connect(uint16_t id, uint16_t mtu) {
+    // 接続されると広告は止まる（BLE スタックと同じ挙動）
+    advertising = false;
+    connected = true;
+    connId = id;
+    negotiatedMtu = mtu;
+    for (Characteristic& c : chars) {
+        c.subscribed = false;
+    }
+    if (listener != nullptr) {
+        listener->onConnect(id);
+        if (mtu != 23) {
+            listener->onMtuChanged(mtu);
+        }
+    }
+    if (autoSubscribe) {
+        for (size_t i = 0; i < chars.size(); ++i) {
+            if ((chars[i].properties & hal::PROP_NOTIFY) != 0) {
+                subscribe(static_cast<hal::CharId>(i), true);
+            }
+        }
+    }
+}
+
+void MockBlePeripheral::subscribe(hal::CharId ch, bool enabled) {
+    if (ch >= chars.size() || !connected) {
+        return;
+    }
+    chars[ch].subscribed = enabled;
+    if (listener != nullptr) {
+        listener->onSubscribeChanged(ch, enabled);
+    }
+}
+
+void MockBlePeripheral::disconnect() {
+    if (!connected) {
+        return;
+    }
+    connected = false;
+    if (listener != nullptr) {
+        listener->onDisconnect(connId);
+    }
+}
+
+void MockBlePeripheral::write(hal::CharId ch, const uint8_t* data, size_t len) {
+    if (ch >= chars.size()) {
+        return;
+    }
+    chars[ch].value.assign(data, data + len);
+    if (listener != nullptr) {
+        listener->onWrite(ch, data, len);
+    }
+}
+
+void MockBlePeripheral::write(hal::CharId ch, const std::string& text) {
+    write(ch, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+void MockBlePeripheral::updateConnParams(uint16_t interval, uint16_t latency, uint16_t timeout) {
+    if (connected && listener != nullptr) {
+        listener->onConnParamsUpdated(interval, latency, timeout);
+    }
+}
+
+std::vector<uint8_t> MockBlePeripheral::read(hal::CharId ch) {
+    if (ch >= chars.size()) {
+        return {};
+    }
+    if (listener != nullptr) {
+        listener->onRead(ch);
+    }
+    return chars[ch].value;
+}
+
+bool MockBlePeripheral::indicateServiceChanged() {
+    if (!connected) {
+        return false;
+    }
+    ++serviceChanged;
+    return true;
+}
+
+hal::CharId MockBlePeripheral::findCharacteristic(const char* uuid) const {
+    hal::Uuid wanted = {};
+    if (!hal::parseUuid(uuid, wanted)) {
+        return hal::kInvalidId;
+    }
+    for (size_t i = 0; i < chars.size(); ++i) {
+        if (chars[i].uuid == wanted) {
+            return static_cast<hal::CharId>(i);
+        }
+    }
+    return hal::kInvalidId;
+}
+
+// ===== IMU =====
+
+bool MockImu::start(const hal::ImuConfig& config) {
+    if (config.rateHz < 25 || config.rateHz > 1600) {
+        return false;
+    }
+    this->config = config;
+    rateHz = config.rateHz;
+    startUs = clock.nowMicros();
+    produced = 0;
+    consumed = 0;
+    overruns = 0;
+    running = true;
+    return true;
+}
+
+void MockImu::fill() {
+    uint64_t elapsedUs = clock.nowMicros() - startUs;
+    int64_t scaledRate = static_cast<int64_t>(rateHz) * (1000000 + driftPpm);
+    produced = elapsedUs * static_cast<uint64_t>(scaledRate) / 1000000000000ull;
+
+    // FIFO に入りきらない分は古い方から消える
+    if (produced - consumed > kFifoCapacity) {
+        consumed = produced - kFifoCapacity;
+        ++overruns;
+    }
+}
+
+size_t MockImu::readFifo(hal::ImuSample* out, size_t maxSamples) {
+    if (!running) {
+        return 0;
+    }
+    fill();
+    size_t n = 0;
+    if (rotationDps != 0.0f) {
+        int16_t gravity = static_cast<int16_t>(32768 / config.accelRangeG);
+        int16_t gz = static_cast<int16_t>(std::lround(rotationDps * 32768.0f / config.gyroRangeDps));
+        int16_t ax = static_cast<int16_t>(std::lround(linearAccelG * gravity));
+        while (n < maxSamples && consumed < produced) {
+            out[n++] = {ax, 0, gravity, 0, 0, gz};
+            ++consumed;
+        }
+        return n;
+    }
+    while (n < maxSamples && consumed < produced) {
+        int16_t v = static_cast<int16_t>(consumed & 0xFFFF);
+        out[n++] = {v, static_cast<int16_t>(-v), 4096, 0, 0, 0};
+        ++consumed;
+    }
+    return n;
+}
+
+// ===== Microphone =====
+
+bool MockMicrophone::start(uint32_t sampleRate) {
+    if (sampleRate < 8000 || sampleRate > 48000) {
+        return false;
+    }
+    rate = sampleRate;
+    startUs = clock.nowMicros();
+    released = 0;
+    skipped = 0;
+    underrunCount = 0;
+    held = false;
+    running = true;
+    return true;
+}
+
+int16_t MockMicrophone::sampleAt(uint64_t index, uint32_t sampleRate) {
+    double t = static_cast<double>(index) / sampleRate;
+    return static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * t));
+}
+
+const int16_t* MockMicrophone::acquire(size_t& samples) {
+    if (!running) {
+        return nullptr;
+    }
+    uint64_t due = (clock.nowMicros() - startUs) * rate / 1000000 / buffer.size() - skipped;
+
+    // キューに 2 面しかないので、それ以上進んでいたら入力が捨てられている
+    if (due > released + 2) {
+        skipped += due - (released + 2);
+        due = released + 2;
+        ++underrunCount;
+    }
+    if (due <= released) {
+        return nullptr;
+    }
+    uint64_t first = (released + skipped) * buffer.size();
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = sampleAt(first + i, rate);
+    }
+    held = true;
+    samples = buffer.size();
+    return buffer.data();
+}
+
+void MockMicrophone::release() {
+    if (held) {
+        held = false;
+        ++released;
+    }
+}
+
+// ===== Camera =====
+
+bool MockCamera::start(uint16_t width, uint16_t height, uint8_t quality) {
+    if (!((width == 160 && height == 120) || (width == 320 && height == 240)) || quality == 0 || quality > 100) {
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    jpeg.resize(static_cast<size_t>(width) * height * quality / 400);
+    running = true;
+    return true;
+}
+
+bool MockCamera::capture(hal::CameraFrame& frame) {
+    if (!running || held) {
+        return false;
+    }
+    clock.delay(captureMs);
+    ++frameCount;
+    for (size_t i = 0; i < jpeg.size(); ++i) {
+        jpeg[i] = static_cast<uint8_t>(frameCount + i);
+    }
+    jpeg[0] = 0xFF;
+    jpeg[1] = 0xD8;
+    jpeg[jpeg.size() - 2] = 0xFF;
+    jpeg[jpeg.size() - 1] = 0xD9;
+    held = true;
+    frame = {jpeg.data(), jpeg.size(), width, height};
+    return true;
+}
+
+// ===== Touch =====
+
+size_t MockTouch::read(hal::TouchEvent* out, size_t maxEvents) {
+    size_t n = queue.size() < maxEvents ? queue.size() : maxEvents;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = queue[i];
+    }
+    queue.erase(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(n));
+    return n;
+}
+
+void MockTouch::inject(hal::TouchType type, int16_t x, int16_t y, uint8_t id) {
+    if (queue.size() >= kQueueCapacity) {
+        ++overflowCount;
+        return;
+    }
+    queue.push_back({clock.micros(), x, y, type, id});
+}
+
+// ===== FileStore =====
+
+size_t MockFileStore::usedBlocks() const {
+    size_t blocks = 0;
+    for (const auto& file : files) {
+        blocks += blocksFor(file.second.size());
+    }
+    return blocks;
+}
+
+size_t MockFileStore::freeBytes() {
+    size_t used = usedBlocks() * blockBytes;
+    return used < capacity ? capacity - used : 0;
+}
+
+bool MockFileStore::write(const char* path, const uint8_t* data, size_t len) {
+    auto it = files.find(path);
+    size_t current = it != files.end() ? blocksFor(it->second.size()) : 0;
+    if ((usedBlocks() - current + blocksFor(len)) * blockBytes > capacity) {
+        return false;
+    }
+    files[path].assign(data, data + len);
+    ++writes;
+    written += len;
+    return true;
+}
+
+bool MockFileStore::append(const char* path, const uint8_t* data, size_t len) {
+    auto it = files.find(path);
+    size_t current = it != files.end() ? it->second.size() : 0;
+    size_t extra = blocksFor(current + len) - (it != files.end() ? blocksFor(current) : 0);
+    if ((usedBlocks() + extra) * blockBytes > capacity) {
+        return false;
+    }
+    std::vector<uint8_t>& file = files[path];
+    file.insert(file.end(), data, data + len);
+    ++writes;
+    written += len;
+    return true;
+}
+
+size_t MockFileStore::read(const char* path, size_t offset, uint8_t* out, size_t len) {
+    auto it = files.find(path);
+    if (it == files.end() || offset >= it->second.size()) {
+        return 0;
+    }
+    size_t n = it->second.size() - offset < len ? it->second.size() - offset : len;
+    std::memcpy(out, it->second.data() + offset, n);
+    ++reads;
+    readBytes += n;
+    return n;
+}
+
+int32_t MockFileStore::size(const char* path) {
+    auto it = files.find(path);
+    return it != files.end() ? static_cast<int32_t>(it->second.size()) : -1;
+}
+
+bool MockFileStore::remove(const char* path) {
+    return files.erase(path) > 0;
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hal/BlePeripheral.h"
+#include "hal/Camera.h"
+#include "hal/Clock.h"
+#include "hal/Display.h"
+#include "hal/FileStore.h"
+#include "hal/Imu.h"
+#include "hal/Microphone.h"
+#include "hal/SerialPort.h"
+#include "hal/Touch.h"
+
+// ネイティブ（Linux ホスト）向けのモック HAL 実装
+// 実機なしでアプリケーションロジックを最高速で動かすためのもの
+
+// 仮想時計：delay() は待たずに時刻を進める
+class MockClock : public hal::Clock {
+public:
+    uint32_t millis() const override { return static_cast<uint32_t>(nowUs / 1000); }
+    uint32_t micros() const override { return static_cast<uint32_t>(nowUs); }
+    void delay(uint32_t ms) override { nowUs += static_cast<uint64_t>(ms) * 1000; }
+
+    void advanceUs(uint64_t us) { nowUs += us; }
+    uint64_t nowMicros() const { return nowUs; }
+
+private:
+    uint64_t nowUs = 0;
+};
+
+// 標準出力（または echo=false でバッファのみ）に書き出すシリアル
+class MockSerialPort : public hal::SerialPort {
+public:
+    explicit MockSerialPort(const hal::Clock* clock = nullptr, bool echo = true) : clock(clock), echo(echo) {}
+
+    void print(const char* text) override;
+    void println(const char* text) override;
+    size_t write(const uint8_t* data, size_t len) override;
+
+    const std::vector<std::string>& lines() const { return completed; }
+    void clearLines() { completed.clear(); }
+
+private:
+    const hal::Clock* clock;
+    bool echo;
+    std::string current;
+    std::vector<std::string> completed;
+};
+
+// 行ごとの最終表示内容を保持するディスプレイ
+class MockDisplay : public hal::Display {
+public:
+    struct Line {
+        int16_t y;
+        hal::Color color;
+        std::string text;
+    };
+
+    void clear() override { rows.clear(); }
+    void drawLine(int16_t y, hal::Color color, const char* text) override;
+
+    const Line* lineAt(int16_t y) const;
+    uint32_t drawCount() const { return draws; }
+
+private:
+    std::vector<Line> rows;
+    uint32_t draws = 0;
+};
+
+// GATT サーバーのモック：セントラル側の操作（接続・書き込み・切断）をテストから駆動できる
+class MockBlePeripheral : public hal::BlePeripheral {
+public:
+    struct Characteristic {
+        hal::ServiceId service;
+        hal::Uuid uuid;
+        uint8_t properties;
+        std::vector<uint8_t> value;
+        bool subscribed;  // CCCD で Notify が有効（接続ごと）
+    };
+
+    struct Notification {
+        hal::CharId ch;
+        uint32_t timeMs;
+        std::vector<uint8_t> data;
+    };
+
+    explicit MockBlePeripheral(const hal::Clock& clock) : clock(clock) {}
+
+    // hal::BlePeripheral
+    void begin(const char* deviceName, hal::BleListener* listener) override;
+    hal::ServiceId addService(const hal::Uuid& uuid, uint16_t handleCount) override;
+    hal::CharId addCharacteristic(hal::ServiceId service, const hal::Uuid& uuid, uint8_t properties) override;
+    void startService(hal::ServiceId service) override;
+    void advertiseService(const hal::Uuid& uuid) override;
+    void startAdvertising() override;
+    void setValue(hal::CharId ch, const uint8_t* data, size_t len) override;
+    bool notify(hal::CharId ch) override;
+    uint16_t mtu() const override { return connected ? negotiatedMtu : 23; }
+    bool indicateServiceChanged() override;
+
+    // セントラル側の操作
+    void connect(uint16_t connId = 0, uint16_t mtu = 247);
+    void disconnect();
+    void write(hal::CharId ch, const uint8_t* data, size_t len);
+    void write(hal::CharId ch, const std::string& text);
+    void updateConnParams(uint16_t interval, uint16_t latency, uint16_t timeout);
+    // true の間は notify() が失敗する（送信キューが詰まったリンクの代わり）
+    void setLinkStalled(bool stalled) { linkStalled = stalled; }
+    // CCCD を書く。未購読のキャラクタリスティックへの notify() は失敗する（BLE スタックと同じ挙動）
+    void subscribe(hal::CharId ch, bool enabled);
+    // true（既定）なら connect() の直後に Notify できるキャラクタリスティックをすべて購読する
+    void setAutoSubscribe(bool enabled) { autoSubscribe = enabled; }
+    std::vector<uint8_t> read(hal::CharId ch);
+
+    // uuid は文字列で書いたもの
+    hal::CharId findCharacteristic(const char* uuid) const;
+    // addService() で渡された属性ハンドルの数の合計
+    uint16_t handleCount() const { return handles; }
+
+    const std::string& deviceName() const { return name; }
+    bool isAdvertising() const { return advertising; }
+    bool isConnected() const { return connected; }
+    uint32_t advertisingStarts() const { return advertisingStartCount; }
+    uint32_t serviceChangedCount() const { return serviceChanged; }
+    const std::vector<Characteristic>& characteristics() const { return chars; }
+    const std::vector<Notification>& notifications() const { return sent; }
+    void clearNotifications() { sent.clear(); }
+
+private:
+    const hal::Clock& clock;
+    hal::BleListener* listener = nullptr;
+    std::string name;
+    std::vector<hal::Uuid> services;
+    std::vector<hal::Uuid> advertisedServices;
+    uint16_t handles = 0;
+    uint32_t serviceChanged = 0;
+    std::vector<Characteristic> chars;
+    std::vector<Notification> sent;
+    bool advertising = false;
+    bool connected = false;
+    bool linkStalled = false;
+    bool autoSubscribe = true;
+    uint16_t connId = 0;
+    uint16_t negotiatedMtu = 23;
+    uint32_t advertisingStartCount = 0;
+};
+
+// FIFO 付き IMU のモック：仮想時計の経過時間に応じて FIFO にサンプルがたまる
+// サンプル値は通番から決まる（ax = 通番の下位 16 bit、ay = -ax、az = 4096、ジャイロは 0）
+class MockImu : public hal::Imu {
+public:
+    static constexpr size_t kFifoCapacity = 170;  // BMI270 の 2 KB FIFO に入る 6 軸フレーム数
+
+    explicit MockImu(const MockClock& clock) : clock(clock) {}
+
+    bool start(const hal::ImuConfig& config) override;
+    void stop() override { running = false; }
+    size_t readFifo(hal::ImuSample* out, size_t maxSamples) override;
+    uint32_t fifoOverruns() const override { return overruns; }
+
+    // センサの発振器のずれ（+1000 なら公称レートより 0.1% 速い）
+    void setDriftPpm(int32_t ppm) { driftPpm = ppm; }
+    // 0 以外なら、水平に置いて z 軸まわりに dps [deg/s] で回っているサンプルを出す
+    // （0 なら ax に通番の下位 16 bit を入れた、欠落検出用のサンプル）
+    void setRotation(float dps) { rotationDps = dps; }
+    // 回っているサンプルの ax に足す加速度 [g]（揺れ・衝撃の代わり）
+    void setLinearAccel(float g) { linearAccelG = g; }
+    uint64_t samplesProduced() const { return produced; }
+
+private:
+    void fill();
+
+    const MockClock& clock;
+    bool running = false;
+    hal::ImuConfig config = {};
+    uint32_t rateHz = 0;
+    int32_t driftPpm = 0;
+    float rotationDps = 0.0f;
+    float linearAccelG = 0.0f;
+    uint64_t startUs = 0;
+    uint64_t produced = 0;  // start() からセンサが生成したサンプル数
+    uint64_t consumed = 0;  // FIFO から読み出された（またはあふれて消えた）サンプル数
+    uint32_t overruns = 0;
+};
+
+// マイクのモック：仮想時計の経過時間に応じて 2 面のバッファが録音済みになる
+// 入力は 440 Hz の正弦波。アプリがバッファを返すのが遅れて 2 面とも埋まっていたら、その間の入力は捨てる
+class MockMicrophone : public hal::Microphone {
+public:
+    explicit MockMicrophone(const MockClock& clock, size_t bufferSamples = 512)
+        : clock(clock), buffer(bufferSamples) {}
+
+    bool start(uint32_t sampleRate) override;
+    void stop() override { running = false; }
+    const int16_t* acquire(size_t& samples) override;
+    void release() override;
+    uint32_t underruns() const override { return underrunCount; }
+
+    // 通番 index のサンプル値（テストで復号結果と比べる用）
+    static int16_t sampleAt(uint64_t index, uint32_t sampleRate);
+
+private:
+    const MockClock& clock;
+    std::vector<int16_t> buffer;
+    bool running = false;
+    bool held = false;
+    uint32_t rate = 0;
+    uint64_t startUs = 0;
+    uint64_t released = 0;  // アプリから返されたバッファ数
+    uint64_t skipped = 0;   // 取りこぼしで録音されなかったバッファ数
+    uint32_t underrunCount = 0;
+};
+
+// カメラのモック：JPEG のマーカーで挟んだダミーデータを返す。撮影には captureMs だけ仮想時間がかかる
+// フレームの大きさは width * height * quality / 400 byte（160x120・品質 60 で 2880 byte）
+class MockCamera : public hal::Camera {
+public:
+    explicit MockCamera(MockClock& clock, uint32_t captureMs = 40) : clock(clock), captureMs(captureMs) {}
+
+    bool start(uint16_t width, uint16_t height, uint8_t quality) override;
+    void stop() override { running = false; }
+    bool capture(hal::CameraFrame& frame) override;
+    void release() override { held = false; }
+
+    bool sharesSensorBus() const override { return sharesBus; }
+    void setSharesSensorBus(bool shares) { sharesBus = shares; }
+
+    uint32_t frames() const { return frameCount; }
+
+private:
+    MockClock& clock;
+    uint32_t captureMs;
+    bool sharesBus = false;
+    std::vector<uint8_t> jpeg;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    bool running = false;
+    bool held = false;
+    uint32_t frameCount = 0;
+};
+
+// タッチ入力。inject() した時点の仮想時刻を割り込みの時刻として記録する
+class MockTouch : public hal::TouchInput {
+public:
+    static constexpr size_t kQueueCapacity = 16;
+
+    explicit MockTouch(MockClock& clock) : clock(clock) {}
+
+    size_t read(hal::TouchEvent* out, size_t maxEvents) override;
+    uint32_t overflows() const override { return overflowCount; }
+
+    void inject(hal::TouchType type, int16_t x, int16_t y, uint8_t id = 0);
+
+private:
+    MockClock& clock;
+    std::vector<hal::TouchEvent> queue;
+    uint32_t overflowCount = 0;
+};
+
+// ファイルシステム：ファイルをメモリに持つ。容量はブロック単位で数える（LittleFS と同じく 1 ファイル 1 ブロック以上）
+class MockFileStore : public hal::FileStore {
+public:
+    explicit MockFileStore(size_t capacity = 1024 * 1024, size_t blockBytes = 4096)
+        : capacity(capacity), blockBytes(blockBytes) {}
+
+    bool write(const char* path, const uint8_t* data, size_t len) override;
+    bool append(const char* path, const uint8_t* data, size_t len) override;
+    size_t read(const char* path, size_t offset, uint8_t* out, size_t len) override;
+    int32_t size(const char* path) override;
+    bool remove(const char* path) override;
+    size_t blockSize() const override { return blockBytes; }
+    size_t freeBytes() override;
+
+    size_t fileCount() const { return files.size(); }
+    uint32_t writeCalls() const { return writes; }
+    uint64_t bytesWritten() const { return written; }
+    uint32_t readCalls() const { return reads; }
+    uint64_t bytesRead() const { return readBytes; }
+
+private:
+    size_t blocksFor(size_t bytes) const { return bytes == 0 ? 1 : (bytes + blockBytes - 1) / blockBytes; }
+    size_t usedBlocks() const;
+
+    size_t capacity;
+    size_t blockBytes;
+    std::map<std::string, std::vector<uint8_t>> files;
+    uint32_t writes = 0;
+    uint64_t written = 0;
+    uint32_t reads = 0;
+    uint64_t readBytes = 0;
+};
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""タイムラインのダンプを Chrome の trace event 形式（JSON）に変換する
+
+    python3 tools/timeline_to_chrome.py monitor.log timeline.json
+    python3 tools/timeline_to_chrome.py timeline.bin timeline.json
+
+入力はシリアルログ（CMD_TIMELINE_DUMP 0 の出力を含むもの）か、ストリームから組み立てたバイナリ。
+出力は chrome://tracing や https://ui.perfetto.dev でそのまま開ける。
+形式は src/diag/Timeline.h を参照。
+"""
+
+import json
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from trace_extract import extract  # noqa: E402
+
+EVENT_NAMES = {
+    1: "connect",
+    2: "disconnect",
+    3: "param update",
+    4: "MTU change",
+    5: "write received",
+    6: "notify queued",
+    7: "notify sent",
+    8: "UI frame",
+    9: "stall",
+    10: "loop",
+}
+
+ARG_NAMES = {
+    1: "connId",
+    2: "connId",
+    3: "interval_1250us",
+    4: "mtu",
+    5: "bytes",
+    6: "seq",
+    7: "seq",
+    8: "row",
+}
+
+TRACKS = {0: "loop()", 1: "BLE task", 2: "UI"}
+
+
+def parse(data):
+    if len(data) < 8 or data[:3] != b"TLN" or data[3] != 1:
+        raise ValueError("not a timeline dump (version 1 expected)")
+    (count,) = struct.unpack_from("<I", data, 4)
+    events = []
+    offset = 8
+    for _ in range(count):
+        if offset + 12 > len(data):
+            raise ValueError("timeline dump is truncated")
+        events.append(struct.unpack_from("<IIBBH", data, offset))
+        offset += 12
+    return events
+
+
+def to_chrome(events):
+    out = []
+    for tid, name in TRACKS.items():
+        out.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": name}})
+
+    # 32 bit の us は 71 分で一周するので、直前のイベントとの差分で伸ばす
+    base = 0
+    previous = None
+    for start, duration, kind, track, arg in events:
+        if previous is not None:
+            delta = (start - previous + 2**31) % 2**32 - 2**31
+            base += delta
+        else:
+            base = start
+        previous = start
+
+        event = {
+            "name": EVENT_NAMES.get(kind, f"event {kind}"),
+            "pid": 1,
+            "tid": track,
+            "ts": base,
+        }
+        if kind in ARG_NAMES:
+            event["args"] = {ARG_NAMES[kind]: arg}
+        if duration > 0:
+            event["ph"] = "X"
+            event["dur"] = duration
+        else:
+            event["ph"] = "i"
+            event["s"] = "t"
+        out.append(event)
+    return {"traceEvents": out, "displayTimeUnit": "ms"}
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__, file=sys.stderr)
+        return 2
+    with open(sys.argv[1], "rb") as f:
+        raw = f.read()
+    if raw[:3] != b"TLN":
+        raw = extract(raw.decode("utf-8", errors="replace").splitlines(), "TIMELINE")
+    events = parse(raw)
+    with open(sys.argv[2], "w", encoding="utf-8") as f:
+        json.dump(to_chrome(events), f)
+    print(f"{len(events)} events written to {sys.argv[2]}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
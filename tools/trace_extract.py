@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""シリアルログから診断ダンプ（CMD_TRACE_DUMP 0 などの出力）を取り出してバイナリにする
+
+    python3 tools/trace_extract.py monitor.log trace.bin
+    python3 tools/trace_extract.py --label TIMELINE monitor.log timeline.bin
+
+ログ中の "<LABEL> BEGIN <len>" ～ "<LABEL> END" の間の "<LABEL> <offset> <hex>" 行を連結する。
+LABEL の既定は TRACE。複数のダンプがある場合は最後のものを使う。
+"""
+
+import re
+import sys
+
+
+def extract(lines, label="TRACE"):
+    line_re = re.compile(re.escape(label) + r" ([0-9a-f]{6}) ([0-9a-f]*)\s*$")
+    begin_re = re.compile(re.escape(label) + r" BEGIN (\d+)")
+    data = None
+    expected = 0
+    for line in lines:
+        m = begin_re.search(line)
+        if m:
+            data = bytearray()
+            expected = int(m.group(1))
+            continue
+        if data is None:
+            continue
+        m = line_re.search(line)
+        if m:
+            offset = int(m.group(1), 16)
+            if offset != len(data):
+                raise ValueError(f"gap in dump at offset {offset:#x} (have {len(data):#x})")
+            data += bytes.fromhex(m.group(2))
+    if data is None:
+        raise ValueError(f"no {label} BEGIN found")
+    if len(data) != expected:
+        raise ValueError(f"dump is truncated: {len(data)} of {expected} bytes")
+    return bytes(data)
+
+
+def main():
+    args = sys.argv[1:]
+    label = "TRACE"
+    if len(args) == 4 and args[0] == "--label":
+        label = args[1]
+        args = args[2:]
+    if len(args) != 2:
+        print(__doc__, file=sys.stderr)
+        return 2
+    with open(args[0], encoding="utf-8", errors="replace") as f:
+        data = extract(f, label)
+    with open(args[1], "wb") as f:
+        f.write(data)
+    print(f"{len(data)} bytes written to {args[1]}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())